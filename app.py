@@ -2,26 +2,15 @@ import sys
 import cv2 
 import imutils
 from yoloDet import YoloTRT
-import twd97
+from changegate import ChangeGate
+import yolov7_trt
 
 def read_gps_data():
-    '''
-    with open('PLSATTIT_data.txt', 'r') as f:
-        data = f.readlines()[-1]
-        parts = data.split(',')
-        latitude = parts[9]
-        latitude = float(latitude)
-        longitude = parts[10]
-        longitude = float(longitude)
-    '''
-    with open('PLSATTIT_data.txt', 'r') as f:
-        data = f.readlines()[-1]
-        parts = data.split(',')
-        latitude = parts[0]
-        latitude = float(latitude)
-        longitude = parts[1]
-        longitude = float(longitude)
-    return latitude, longitude
+    # readgpstocube_5hz.py / write_gps_data.py 寫入的最新一筆定位，O(1)，不隨飛行時間變慢
+    rec = telemetry.latest()
+    if rec is None:
+        return None, None
+    return rec["lat"], rec["lon"]
 
 def PlotCord(img, latitude, longitude):
     text = '(' + str(latitude) + ', ' + str(longitude) + ')'
@@ -65,9 +54,15 @@ def gstreamer_pipeline(
 #a = threading.Thread(target=read_gps_data, args=('/dev/ttyUSB1', 115200))
 #a.start()
 
-# use path for library and engine file
+# use path for library and engine file (yoloDet 需要 yolov7/build 中的 yolov7_trt 模組)
 model = YoloTRT(library="yolov7/build/libmyplugins.so", engine="yolov7/build/bestV2.engine", conf=0.5, yolo_ver="v7")
 
+# 懸停時畫面幾乎不變，沿用上次偵測結果，最多連續略過 max_skip 張
+gate = ChangeGate(max_skip=10)
+
+# C++ 的 TelemetryReader，以seqlock擋下寫到一半的紀錄
+telemetry = yolov7_trt.TelemetryReader()
+
 # 使用影片來源
 # cap = cv2.VideoCapture("videos/testvideo.mp4")
 
@@ -86,10 +81,17 @@ cap.set(cv2.CAP_PROP_FPS, 30)
 while True:
     ret, frame = cap.read()
     frame = imutils.resize(frame, width=1280)
-    detections, t = model.Inference(frame)
+    detections = gate.reuse(frame)
+    if detections is None:
+        detections, t = model.Inference(frame)
+        gate.inferred(detections)
+    else:
+        for obj in detections:
+            model.PlotBbox(obj['box'], frame, label="{}:{:.2f}".format(obj['class'], obj['conf']))
     latitude_wgs84, longitude_wgs84 = read_gps_data()
-    latitude_twd97, longitude_twd97 = twd97.fromwgs84(latitude_wgs84, longitude_wgs84)
-    PlotCord(frame, latitude_twd97, longitude_twd97)
+    if latitude_wgs84 is not None:
+        latitude_twd97, longitude_twd97 = yolov7_trt.wgs84_to_twd97(latitude_wgs84, longitude_wgs84)
+        PlotCord(frame, latitude_twd97, longitude_twd97)
     # for obj in detections:
     #    print(obj['class'], obj['conf'], obj['box'])
     # print("FPS: {} sec".format(1/t))
@@ -99,4 +101,5 @@ while True:
         break
 
 cap.release()
-cv2.destroyAllWindows()
\ No newline at end of file
+cv2.destroyAllWindows()
+print(gate.report())
\ No newline at end of file
@@ -0,0 +1,94 @@
+import time
+import cv2
+import numpy as np
+
+
+class ChangeGate():
+    '''
+    與 yolov7/include/change_detector.h 相同的判斷：以縮小的灰階影像與上一張推論過的影像比對，
+    先補償整體平移，再以區塊SAD計算變化比例。畫面靜止時沿用上次的偵測結果(依平移量移動)，
+    連續沿用超過 max_skip 張則強制推論。cv2.resize / cv2.absdiff 皆以SIMD實作。
+    '''
+    def __init__(self, scale=4, search=4, block=8, block_thresh=6.0, change_frac=0.02, max_skip=10):
+        self.scale = scale
+        self.search = search
+        self.block = block
+        self.block_thresh = block_thresh
+        self.change_frac = change_frac
+        self.max_skip = max_skip
+        self.ref = None
+        self.ref_dets = []
+        self.cur = None
+        self.skipped_in_row = 0
+        self.frames = 0
+        self.skipped = 0
+        self.forced = 0
+        self.cpu_time = 0.0
+
+    def _gray(self, frame):
+        h, w = frame.shape[:2]
+        small = cv2.resize(frame, (w // self.scale, h // self.scale), interpolation=cv2.INTER_AREA)
+        return cv2.cvtColor(small, cv2.COLOR_BGR2GRAY)
+
+    def _shift(self, ref, cur):
+        s = self.search
+        h, w = cur.shape
+        if s <= 0 or h <= 2 * s or w <= 2 * s:
+            return 0, 0
+        center = cur[s:h - s:2, s:w - s]
+        best = None
+        for dy in range(-s, s + 1):
+            for dx in range(-s, s + 1):
+                shifted = ref[s - dy:h - s - dy:2, s - dx:w - s - dx]
+                sad = int(cv2.absdiff(center, shifted).sum())
+                key = (sad, abs(dx) + abs(dy))
+                if best is None or key < best[0]:
+                    best = (key, dx, dy)
+        return best[1], best[2]
+
+    def _changed(self, ref, cur, dx, dy):
+        h, w = cur.shape
+        # cur(x, y) ~ ref(x - dx, y - dy) over the region both frames cover
+        cur_part = cur[max(0, dy):h + min(0, dy), max(0, dx):w + min(0, dx)]
+        ref_part = ref[max(0, -dy):h + min(0, -dy), max(0, -dx):w + min(0, -dx)]
+        b = self.block
+        bh, bw = cur_part.shape[0] // b, cur_part.shape[1] // b
+        if bh == 0 or bw == 0:
+            return 1.0
+        diff = cv2.absdiff(cur_part[:bh * b, :bw * b], ref_part[:bh * b, :bw * b])
+        means = diff.reshape(bh, b, bw, b).mean(axis=(1, 3))
+        return float((means > self.block_thresh).mean())
+
+    def reuse(self, frame):
+        '''畫面靜止時回傳沿用的偵測結果，否則回傳 None，推論後需呼叫 inferred()'''
+        t0 = time.time()
+        self.frames += 1
+        self.cur = self._gray(frame)
+        dets = None
+        if self.ref is not None and self.ref.shape == self.cur.shape:
+            dx, dy = self._shift(self.ref, self.cur)
+            if self._changed(self.ref, self.cur, dx, dy) <= self.change_frac:
+                if self.skipped_in_row >= self.max_skip:
+                    self.forced += 1
+                else:
+                    offset = np.array([dx, dy, dx, dy], dtype=np.float32) * self.scale
+                    dets = []
+                    for det in self.ref_dets:
+                        moved = dict(det)
+                        moved["box"] = np.asarray(det["box"]) + offset
+                        dets.append(moved)
+                    self.skipped_in_row += 1
+                    self.skipped += 1
+        self.cpu_time += time.time() - t0
+        return dets
+
+    def inferred(self, dets):
+        self.ref = self.cur
+        self.ref_dets = dets
+        self.skipped_in_row = 0
+
+    def report(self):
+        if self.frames == 0:
+            return ""
+        return "change detection: {:.1f}% of inferences avoided ({} forced by max_skip), {:.2f}ms CPU per frame".format(
+            100.0 * self.skipped / self.frames, self.forced, 1000.0 * self.cpu_time / self.frames)
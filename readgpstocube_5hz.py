@@ -1,18 +1,45 @@
 import serial
 from pymavlink import mavutil
 import time
+import os
+import sys
+
+# yolov7_trt 由 yolov7/CMakeLists.txt 編譯於 yolov7/build
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "yolov7", "build"))
+import yolov7_trt
+
+# 最新定位以C++的 TelemetryWriter 寫入共享記憶體(寫入順序在aarch64上也有保證)，app.py 以 TelemetryReader 讀取
+telemetry = yolov7_trt.TelemetryWriter()
+
+# $PLSATTIT 欄位位置，與 yolov7/src/nmea.cpp 相同：3 狀態(3 = 有效)，9/10 緯度/經度。
+# 航向、俯仰、滾轉與高度(4、5、6、11)尚未以接收器的實際輸出確認，見 yolov7/include/nmea.h
+ATT_STATUS, ATT_YAW, ATT_PITCH, ATT_ROLL, ATT_LAT, ATT_LON, ATT_ALT = 3, 4, 5, 6, 9, 10, 11
+
+# 欄位空白或缺少時沿用上一筆，與 telemetry_replay 相同
+last = {"alt": 0.0, "roll": 0.0, "pitch": 0.0, "yaw": 0.0}
+
+def field(parts, i):
+    try:
+        return float(parts[i].split('*')[0])
+    except (IndexError, ValueError):
+        return None
 
 def parse_gnrmc(data):
     if data.startswith('$PLSATTIT'):
         parts = data.split(',')
-        if parts[3] == '3':  # Check if the data is valid
-            latitude = parts[9]
-            latitude = float(latitude)
-            longitude = parts[10]
-            longitude = float(longitude)
-            with open('PLSATTIT_data.txt', 'a') as file:
-                file.write(data)
-                file.write("\n")
+        if len(parts) > ATT_LON and parts[ATT_STATUS] == '3':  # Check if the data is valid
+            latitude = field(parts, ATT_LAT)
+            longitude = field(parts, ATT_LON)
+            if latitude is None or longitude is None:
+                return None, None
+            alt = field(parts, ATT_ALT)
+            if alt is not None:
+                last["alt"] = alt
+            yaw, pitch, roll = field(parts, ATT_YAW), field(parts, ATT_PITCH), field(parts, ATT_ROLL)
+            if yaw is not None and pitch is not None and roll is not None:
+                last["yaw"], last["pitch"], last["roll"] = yaw, pitch, roll
+            telemetry.write(latitude, longitude, alt=last["alt"], roll=last["roll"], pitch=last["pitch"],
+                            yaw=last["yaw"], fix=int(parts[ATT_STATUS]))
             return latitude, longitude
     return None, None
 # def parse_gnrmc(data):
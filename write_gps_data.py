@@ -1,5 +1,11 @@
+import os
+import sys
 import time
 
+# yolov7_trt 由 yolov7/CMakeLists.txt 編譯於 yolov7/build
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "yolov7", "build"))
+import yolov7_trt
+
 start_lat = 23.45055556
 start_lon = 120.28611111
 end_lat = 23.45222222
@@ -8,13 +14,15 @@ end_lon = 120.27861111
 lat = start_lat
 lon = start_lon
 
+# 模擬飛行軌跡，以C++的 TelemetryWriter 寫入與 readgpstocube_5hz.py 相同的共享記憶體
+telemetry = yolov7_trt.TelemetryWriter()
+
 time.sleep(250)
 
 for _ in range(0,130):
     lat = lat + (end_lat - start_lat)/130
     lon = lon + (end_lon- start_lon)/130
-    with open('PLSATTIT_data.txt', 'a') as f:
-        f.write(str(lat) + "," + str(lon)+"\n")
+    telemetry.write(lat, lon)
     time.sleep(1)
 
 lat = end_lat
@@ -23,6 +31,5 @@ lon = end_lon
 for _ in range(0,130):
     lat = lat - (end_lat - start_lat)/130
     lon = lon - (end_lon- start_lon)/130
-    with open('PLSATTIT_data.txt', 'a') as f:
-        f.write(str(lat) + "," + str(lon)+"\n")
+    telemetry.write(lat, lon)
     time.sleep(1)
\ No newline at end of file
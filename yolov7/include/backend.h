@@ -0,0 +1,99 @@
+#pragma once
+
+#include "slot_ring.h"
+#include "types.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Timing of a backend's slots, read it when nothing is in flight
+struct BackendStats {
+  uint64_t batches = 0;
+  double submit_ms = 0;  // host time in submit(): staging copies and launches
+  double device_ms = 0;  // per batch from upload start to download end, summed
+  double wait_ms = 0;    // host time collect() spent blocked on a slot
+};
+
+// Runs the network on batches of BGR frames. A backend owns all of its
+// device state (streams, buffers, preprocess staging), so any number of
+// them can coexist in one process.
+//
+// Work goes through num_slots() input/output slots: submit() fills the next
+// free slot and returns without waiting, collect() waits for the oldest one.
+// With two or more slots, batch k+1 is uploaded and preprocessed while
+// batch k is still inferring. submit() and collect() may be called from two
+// different threads.
+class DetectorBackend {
+ public:
+  virtual ~DetectorBackend() {}
+
+  virtual int input_w() const = 0;
+  virtual int input_h() const = 0;
+  virtual int max_batch_size() const = 0;
+  virtual int num_slots() const = 0;
+
+  // Preprocess img_batch (at most max_batch_size() frames) into the next
+  // free slot and queue it, blocks while all slots are in flight.
+  virtual void submit(std::vector<cv::Mat>& img_batch) = 0;
+
+  // Wait for the oldest submitted batch, write batch * kOutputSize floats
+  // in the yololayer layout to output and return the batch size.
+  virtual int collect(float* output) = 0;
+
+  virtual int in_flight() const = 0;
+  virtual BackendStats stats() const = 0;
+
+  // Synchronous round trip, only when nothing else is in flight
+  void infer(std::vector<cv::Mat>& img_batch, float* output) {
+    submit(img_batch);
+    collect(output);
+  }
+};
+
+// The emulated GPU behind MockBackends: runs one batch at a time, so
+// backends sharing a device contend for it like contexts on one GPU.
+struct MockDevice {
+  std::mutex mutex;
+  std::chrono::steady_clock::time_point free = std::chrono::steady_clock::now();
+};
+
+// CPU stand-in for the TensorRT backend. It letterboxes every frame on the
+// CPU like the calibrator does, then emulates a serial device that needs
+// latency_us per batch and reports the same canned detections (in network
+// input coordinates) for every frame. It goes through the same SlotRing as
+// TrtBackend, so slot handling and overlap can be exercised without a GPU.
+// Pass one MockDevice to several backends to emulate workers on one GPU.
+class MockBackend : public DetectorBackend {
+ public:
+  MockBackend(int input_w, int input_h, int max_batch_size, int latency_us, const std::vector<Detection>& dets, int num_slots = 2,
+              std::shared_ptr<MockDevice> device = nullptr);
+
+  int input_w() const override { return input_w_; }
+  int input_h() const override { return input_h_; }
+  int max_batch_size() const override { return max_batch_size_; }
+  int num_slots() const override { return ring_.size(); }
+
+  void submit(std::vector<cv::Mat>& img_batch) override;
+  int collect(float* output) override;
+  int in_flight() const override { return ring_.in_flight(); }
+  BackendStats stats() const override { return stats_; }
+
+ private:
+  struct Slot {
+    std::vector<float> input;
+    std::vector<float> output;
+    int batch = 0;
+    std::chrono::steady_clock::time_point ready;
+  };
+
+  int input_w_;
+  int input_h_;
+  int max_batch_size_;
+  int latency_us_;
+  std::vector<Detection> dets_;
+  SlotRing<Slot> ring_;
+  std::shared_ptr<MockDevice> device_;
+  BackendStats stats_;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "bounded_queue.h"
+#include "detector.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A frame of one of the scheduler's streams, and later its detections
+struct StreamFrame {
+  int stream = 0;
+  uint64_t seq = 0;  // per stream
+  cv::Mat img;
+  std::vector<Detection> dets;
+  std::chrono::steady_clock::time_point captured;
+  std::chrono::steady_clock::time_point enqueued;
+  std::chrono::steady_clock::time_point dispatched;
+};
+
+// When to close a batch: as soon as max_batch frames are pending, or once
+// the oldest pending frame has waited max_wait. No state and no clock of
+// its own, so the policy can be checked with made up time points.
+struct BatchPolicy {
+  int max_batch = 1;
+  std::chrono::microseconds max_wait{0};
+
+  // Number of frames to dispatch now. 0 means keep waiting, at the latest
+  // until wake (or until another frame arrives).
+  int decide(size_t pending, std::chrono::steady_clock::time_point oldest_enqueued,
+             std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point& wake) const {
+    if (pending == 0) return 0;
+    if ((int)pending >= max_batch) return max_batch;
+    wake = oldest_enqueued + max_wait;
+    return now >= wake ? (int)pending : 0;
+  }
+};
+
+struct BatchSchedulerStats {
+  uint64_t batches = 0;
+  uint64_t frames = 0;
+  uint64_t dropped = 0;             // replaced by a newer frame of the same stream while pending
+  std::vector<uint64_t> fill;       // fill[n]: batches that went out with n frames
+  double queue_ms = 0;              // enqueue -> dispatch, summed over frames
+  double queue_max_ms = 0;
+  std::vector<uint64_t> stream_frames;
+
+  // Mean batch size over max_batch
+  double mean_fill() const;
+};
+
+// Forms batches from frames of several streams (e.g. two or three cameras
+// sharing one Jetson) and hands each frame's detections back with its
+// stream id:
+//
+//   BatchScheduler scheduler(detector, 2, policy, 2, [](StreamFrame& f) { ... });
+//   scheduler.start();
+//   scheduler.push(0, img_a, t_a);   // from the stream threads
+//   scheduler.push(1, img_b, t_b);
+//   scheduler.stop();
+//
+// One thread dispatches batches into the detector's slots and another
+// collects them, so a batch can form while the previous one infers. Results
+// come back in dispatch order, which is per stream frame order. A stream
+// never has more than max_pending frames waiting: a live camera would
+// rather lose its oldest frame than add latency.
+class BatchScheduler {
+ public:
+  typedef std::function<void(StreamFrame&)> ResultFn;
+
+  BatchScheduler(Detector& detector, int num_streams, const BatchPolicy& policy, int max_pending, ResultFn on_result);
+  ~BatchScheduler();
+
+  BatchScheduler(const BatchScheduler&) = delete;
+  BatchScheduler& operator=(const BatchScheduler&) = delete;
+
+  void start();
+
+  // Queue a frame of the given stream, returns false once stopped
+  bool push(int stream, const cv::Mat& img, std::chrono::steady_clock::time_point captured);
+
+  // Flush what is still pending, deliver every result and join the threads
+  void stop();
+
+  BatchSchedulerStats stats() const;
+  void print_report() const;
+
+ private:
+  void dispatch_loop();
+  void collect_loop();
+
+  Detector& detector_;
+  int num_streams_;
+  BatchPolicy policy_;
+  int max_pending_;
+  ResultFn on_result_;
+
+  // Arrival order across all streams
+  std::deque<StreamFrame> pending_;
+  std::vector<int> pending_per_stream_;
+  std::vector<uint64_t> next_seq_;
+  bool stopping_ = false;
+  mutable std::mutex mutex_;
+  std::condition_variable arrived_;
+
+  BoundedQueue<std::vector<StreamFrame>> in_flight_;
+  std::thread dispatcher_;
+  std::thread collector_;
+  BatchSchedulerStats stats_;
+};
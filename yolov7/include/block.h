@@ -7,6 +7,20 @@
 
 std::map<std::string, nvinfer1::Weights> loadWeights(const std::string file);
 
+// Implicit batch (setMaxBatchSize) or explicit batch with a dynamic batch
+// dimension, whose size is chosen per enqueue within an optimization profile.
+nvinfer1::INetworkDefinition* createNetwork(nvinfer1::IBuilder* builder, bool explicit_batch);
+
+// 3 x input_h x input_w, or -1 x 3 x input_h x input_w for explicit batch networks
+nvinfer1::ITensor* addImageInput(nvinfer1::INetworkDefinition* network, nvinfer1::DataType dt, int input_w, int input_h);
+
+// CHW scales of a resize layer, with a 1 in front for explicit batch networks
+void setResizeScales(nvinfer1::IResizeLayer* layer, const float chw_scales[3]);
+
+// setMaxBatchSize for implicit batch networks; a 1..maxBatchSize profile
+// (optimized for maxBatchSize) for explicit batch networks
+void setBatchSize(nvinfer1::IBuilder* builder, nvinfer1::IBuilderConfig* config, nvinfer1::INetworkDefinition* network, int maxBatchSize, int input_w, int input_h);
+
 nvinfer1::IElementWiseLayer* convBnSilu(nvinfer1::INetworkDefinition* network, std::map<std::string, nvinfer1::Weights>& weightMap, nvinfer1::ITensor& input, int c2, int k, int s, int p, std::string lname);
 
 nvinfer1::ILayer* ReOrg(nvinfer1::INetworkDefinition* network, std::map<std::string, nvinfer1::Weights>& weightMap, nvinfer1::ITensor& input, int inch);
@@ -19,5 +33,5 @@ nvinfer1::IElementWiseLayer* RepConv(nvinfer1::INetworkDefinition* network, std:
 
 nvinfer1::IActivationLayer* convBlockLeakRelu(nvinfer1::INetworkDefinition* network, std::map<std::string, nvinfer1::Weights>& weightMap, nvinfer1::ITensor& input, int outch, int ksize, int s, int p, std::string lname);
 
-nvinfer1::IPluginV2Layer* addYoLoLayer(nvinfer1::INetworkDefinition *network, std::map<std::string, nvinfer1::Weights>& weightMap, std::string lname, std::vector<nvinfer1::IConvolutionLayer*> dets);
+nvinfer1::IPluginV2Layer* addYoLoLayer(nvinfer1::INetworkDefinition *network, std::map<std::string, nvinfer1::Weights>& weightMap, std::string lname, std::vector<nvinfer1::IConvolutionLayer*> dets, int input_w, int input_h, float ignore_thresh);
 
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Blocking FIFO with a fixed capacity. push() blocks while the queue is
+// full, which is how back-pressure travels upstream between pipeline
+// stages. close() wakes everybody up: pop() then drains what is left and
+// returns false once the queue is empty.
+template<typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+  // Returns false if the queue was closed
+  bool push(const T& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) return false;
+    items_.push_back(item);
+    sample();
+    not_empty_.notify_one();
+    return true;
+  }
+
+  bool pop(T& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) return false;
+    item = items_.front();
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Non-blocking pop, used to top up a batch with whatever is already queued
+  bool try_pop(T& item) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (items_.empty()) return false;
+    item = items_.front();
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Waits until pop would succeed or the deadline passes
+  template<typename Clock, typename Duration>
+  bool pop_until(T& item, const std::chrono::time_point<Clock, Duration>& deadline) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!not_empty_.wait_until(lock, deadline, [this] { return closed_ || !items_.empty(); })) return false;
+    if (items_.empty()) return false;
+    item = items_.front();
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return items_.size();
+  }
+
+  size_t capacity() const { return capacity_; }
+
+  // Occupancy seen by push() over the queue's lifetime
+  double mean_occupancy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_ ? (double)occupancy_sum_ / samples_ : 0.0;
+  }
+
+  size_t max_occupancy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return occupancy_max_;
+  }
+
+ private:
+  void sample() {
+    occupancy_sum_ += items_.size();
+    occupancy_max_ = std::max(occupancy_max_, items_.size());
+    samples_++;
+  }
+
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::deque<T> items_;
+  bool closed_ = false;
+  size_t occupancy_sum_ = 0;
+  size_t occupancy_max_ = 0;
+  size_t samples_ = 0;
+};
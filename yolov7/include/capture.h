@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+
+// A frame as it left the camera, stamped right after the grab returned
+struct CapturedFrame {
+  cv::Mat img;
+  uint64_t seq = 0;
+  std::chrono::steady_clock::time_point captured;
+};
+
+// Produces frames at the device's own pace; read() blocks until the next
+// one is available and returns false at end of stream or on error.
+class FrameSource {
+ public:
+  virtual ~FrameSource() {}
+  virtual bool read(cv::Mat& img) = 0;
+};
+
+// cv::VideoCapture on a V4L2 device (/dev/videoN), a camera index, a
+// GStreamer pipeline (anything containing '!') or a video file.
+class VideoSource : public FrameSource {
+ public:
+  VideoSource(const std::string& source, int width, int height, int fps);
+  bool read(cv::Mat& img) override;
+  bool opened() const { return cap_.isOpened(); }
+
+ private:
+  cv::VideoCapture cap_;
+};
+
+// Deterministic frames at a fixed rate for testing without a camera: a
+// square moving across a gray background with the frame number printed.
+class SyntheticSource : public FrameSource {
+ public:
+  SyntheticSource(int width, int height, int fps);
+  bool read(cv::Mat& img) override;
+
+ private:
+  int width_;
+  int height_;
+  std::chrono::steady_clock::duration period_;
+  std::chrono::steady_clock::time_point next_;
+  uint64_t count_ = 0;
+};
+
+// Single-slot "latest frame wins" mailbox between the grab thread and the
+// consumer. put() replaces a frame nobody took yet, and that frame counts
+// as dropped; take() always gets the freshest frame.
+class LatestFrameMailbox {
+ public:
+  // Publish frame. On return frame holds the dropped frame's buffer for
+  // reuse, or an empty Mat if the previous frame was taken.
+  void put(CapturedFrame& frame);
+  // Blocks until a frame newer than the last one taken is available,
+  // returns false once closed and empty.
+  bool take(CapturedFrame& frame);
+  void close();
+  uint64_t dropped() const;
+
+ private:
+  CapturedFrame slot_;
+  bool full_ = false;
+  bool closed_ = false;
+  uint64_t dropped_ = 0;
+  mutable std::mutex mutex_;
+  std::condition_variable ready_;
+};
+
+struct CaptureStats {
+  uint64_t grabbed = 0;
+  uint64_t dropped = 0;
+  uint64_t delivered = 0;
+};
+
+// Grabs frames from a source on a dedicated thread as fast as the device
+// delivers them, so the driver's own buffer never fills up with stale
+// frames. The consumer only ever sees the newest frame; whatever it was
+// too slow for is dropped and counted. Stops after max_frames grabs
+// (0 = until the source ends or stop() is called).
+class LiveCapture {
+ public:
+  LiveCapture(std::unique_ptr<FrameSource> source, uint64_t max_frames = 0);
+  ~LiveCapture();
+
+  LiveCapture(const LiveCapture&) = delete;
+  LiveCapture& operator=(const LiveCapture&) = delete;
+
+  void start();
+  void stop();
+
+  // Blocks for the next fresh frame, false once capture has ended
+  bool latest(CapturedFrame& frame);
+
+  CaptureStats stats() const;
+
+ private:
+  void grab_loop();
+
+  std::unique_ptr<FrameSource> source_;
+  uint64_t max_frames_;
+  LatestFrameMailbox mailbox_;
+  std::thread thread_;
+  std::atomic<bool> running_;
+  std::atomic<uint64_t> grabbed_;
+  std::atomic<uint64_t> delivered_;
+};
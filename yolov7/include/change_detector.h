@@ -0,0 +1,73 @@
+#pragma once
+
+#include "pipeline_config.h"
+#include "types.h"
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Downsampled luma, one byte per pixel
+struct GrayFrame {
+  int w = 0;
+  int h = 0;
+  std::vector<uint8_t> px;
+};
+
+// Mean of each factor x factor block's (B + 2G + R) / 4
+void downsample_gray(const cv::Mat& bgr, int factor, GrayFrame& out);
+
+// Global motion as the integer shift within +-search that best maps ref onto
+// cur (cur(x, y) ~ ref(x - dx, y - dy)), by SAD over the central region.
+// Enough for the drift of a hovering UAV; anything larger is a scene change.
+void estimate_shift(const GrayFrame& ref, const GrayFrame& cur, int search, int& dx, int& dy);
+
+// Fraction of block x block blocks of cur whose mean absolute difference
+// to the shifted ref is above thresh. Blocks shifted in from outside ref
+// are left out; the search range keeps that strip narrow.
+float changed_fraction(const GrayFrame& ref, const GrayFrame& cur, int dx, int dy, int block, float thresh);
+
+struct ChangeStats {
+  uint64_t frames = 0;
+  uint64_t skipped = 0;  // inference avoided
+  uint64_t forced = 0;   // static but inferred because max_skip was reached
+  double cpu_ms = 0;
+};
+
+// Decides whether a frame needs the engine at all. Each frame is compared
+// with the last inferred one after compensating global motion; when
+// almost no block changed, the frame reuses that frame's detections moved
+// by the motion. After max_skip reused frames in a row the next one is
+// inferred regardless, which bounds how stale detections can get. The
+// shift is one integer for the whole frame; with tracking on, the sink
+// moves each reused detection along its track (ByteTracker::propagate).
+//
+//   std::vector<Detection> dets;
+//   if (!gate.reuse(frame, dets)) {
+//     dets = detect(frame);
+//     gate.inferred(dets);
+//   }
+class ChangeDetector {
+ public:
+  explicit ChangeDetector(const PipelineConfig& cfg);
+
+  // true if frame is static, dets then holds the propagated detections
+  // (frame coordinates). false means infer it and call inferred().
+  bool reuse(const cv::Mat& frame, std::vector<Detection>& dets);
+  void inferred(const std::vector<Detection>& dets);
+
+  const ChangeStats& stats() const { return stats_; }
+
+ private:
+  int scale_;
+  int search_;
+  int block_;
+  float block_thresh_;
+  float change_frac_;
+  int max_skip_;
+  GrayFrame ref_;
+  GrayFrame cur_;
+  std::vector<Detection> ref_dets_;
+  bool have_ref_ = false;
+  int skipped_in_row_ = 0;
+  ChangeStats stats_;
+};
@@ -18,9 +18,18 @@ const static int kNumClass = 1;
 const static int kBatchSize = 1;
 
 // Yolo's input width and height must by divisible by 32
+// (by 64 for the P6 models w6/e6/d6/e6e)
 const static int kInputH = 640;
 const static int kInputW = 640;
 
+// Input shapes {width, height} an engine can be built with. The shape matching
+// the stream's aspect ratio is selected when serializing, e.g. 640x384 for
+// 1280x720 video, so that less of the tensor is letterbox padding.
+const static int kNumInputShapes = 5;
+const static int kInputShapes[kNumInputShapes][2] = {
+  {640, 640}, {640, 384}, {640, 512}, {384, 640}, {512, 640}
+};
+
 // Maximum number of output bounding boxes from yololayer plugin.
 // That is maximum number of output bounding boxes before NMS.
 const static int kMaxNumOutputBbox = 1000;
@@ -31,8 +40,10 @@ const static int kNumAnchor = 3;
 const static float kIgnoreThresh = 0.1f;
 
 /* --------------------------------------------------------
- * These configs are not related to tensorrt model, if these are changed,
- * please re-compile, but no need to re-serialize the tensorrt model.
+ * These configs are not related to tensorrt model. They are only the
+ * defaults of PipelineConfig (see pipeline_config.h) and can be
+ * overridden at runtime from a config file or the command line,
+ * together with kBatchSize and kIgnoreThresh above.
  * --------------------------------------------------------*/
 
 // NMS overlapping thresh and final detection confidence thresh
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Header of a raw elevation grid file, little endian:
+//
+//   header   64 bytes, below
+//   heights  rows * cols float32 metres, row major, row 0 northernmost
+//
+// Samples sit on a regular TWD97 TM2 grid (the datum of Taiwan's open
+// DTMs): sample (col, row) is at x0 + col * cell east, y0 - row * cell
+// north. dem_convert writes it from an ESRI ASCII grid, which GDAL exports
+// from GeoTIFF (gdal_translate -of AAIGrid).
+struct DemHeader {
+  char magic[4];     // "YDEM"
+  uint32_t version;  // 1
+  uint32_t cols;
+  uint32_t rows;
+  double x0;  // TWD97 easting/northing of sample (0, 0), metres
+  double y0;
+  double cell;  // sample spacing, metres
+  float nodata;
+  uint32_t reserved[5];
+};
+
+static_assert(sizeof(DemHeader) == 64, "DEM header layout");
+
+// Write a grid in the layout above, false on I/O errors
+bool write_dem(const std::string& path, uint32_t cols, uint32_t rows, double x0, double y0, double cell, float nodata,
+               const float* heights);
+
+// Cells per side of the pyramid's finest blocks
+const static uint32_t kDemTile = 8;
+
+// A memory mapped elevation grid that intersects rays with the terrain,
+// heights bilinear between samples.
+//
+// Rays march through a min/max pyramid over tiles of kDemTile x kDemTile
+// cells: a ray segment that stays above a block's maximum skips the whole
+// block, so open terrain is crossed a few large blocks at a time and cells
+// are only visited where the ray gets down to the surface. Each cell on
+// the way solves the ray against the bilinear patch exactly (a quadratic).
+// Only the pyramid (1/kDemTile^2 of the grid, twice) lives on the heap,
+// the heights are paged in from the file as rays touch them.
+//
+// intersect() doesn't modify the grid, so threads can share a Dem.
+class Dem {
+ public:
+  Dem() {}
+  ~Dem();
+
+  Dem(const Dem&) = delete;
+  Dem& operator=(const Dem&) = delete;
+
+  // Map the file and build the pyramid, false with a message on errors
+  bool open(const std::string& path);
+  bool is_open() const { return heights_ != nullptr; }
+
+  uint32_t cols() const { return cols_; }
+  uint32_t rows() const { return rows_; }
+  double cell() const { return cell_; }
+  float min_height() const { return levels_.empty() ? 0.f : levels_.back().min[0]; }
+  float max_height() const { return levels_.empty() ? 0.f : levels_.back().max[0]; }
+
+  // Bilinear height at TWD97 (x, y), false outside the grid or on nodata
+  bool height_at(double x, double y, float& h) const;
+
+  // First point where the ray (x, y, z) + t * (dx, dy, dz), TWD97 metres
+  // and metres up, meets the terrain with t > 0. False if it leaves the
+  // grid first or starts below the surface; cells with a nodata corner
+  // are holes the ray passes through.
+  bool intersect(double x, double y, double z, double dx, double dy, double dz, double& t) const;
+
+ private:
+  struct Level {
+    uint32_t cols = 0, rows = 0;  // blocks
+    std::vector<float> min, max;
+  };
+
+  float sample(uint32_t col, uint32_t row) const { return heights_[(size_t)row * cols_ + col]; }
+  // Ray against the bilinear patch of cell (cx, cy), grid units, t in [t0, t1]
+  bool intersect_cell(uint32_t cx, uint32_t cy, const double* o, const double* d, double t0, double t1,
+                      double& t) const;
+
+  const uint8_t* map_ = nullptr;
+  size_t size_ = 0;
+  const float* heights_ = nullptr;
+  uint32_t cols_ = 0, rows_ = 0;
+  double x0_ = 0, y0_ = 0, cell_ = 1;
+  float nodata_ = 0;
+  std::vector<Level> levels_;  // levels_[0] is per tile, the last one 1x1
+};
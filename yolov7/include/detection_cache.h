@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 64 bit FNV-1a, chain calls through seed
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+// Hash of a whole file's content, false if it can't be read
+bool hash_file(const std::string& path, uint64_t& hash);
+
+struct DetectionCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t inserts = 0;
+  uint64_t evicted_segments = 0;
+  size_t bytes = 0;  // on disk, this engine and config
+};
+
+// Persistent cache of the yololayer output (decoded candidates before the
+// confidence threshold and NMS) per image, for re-processing recorded
+// flights: threshold and NMS sweeps replay from disk without decoding or
+// inferring anything.
+//
+// Entries are keyed by image content hash and live in segment files
+// named after the engine hash and the preprocess config hash, so a new
+// engine or input shape never sees stale results. purge() deletes the
+// segments of every other engine/config in the directory.
+//
+// Layout, all little endian and 8 byte aligned so a segment can be mapped
+// and read in place:
+//
+//   SegmentHeader                       magic, version, engine/config hash
+//   { RecordHeader, float[n], pad }*    n = 1 + count * floats per Detection,
+//                                       the same [count, Detection...] layout
+//                                       as one frame of yololayer output
+//
+// Segments are append only. Full ones are sealed and mapped read-only; once
+// the total exceeds max_bytes the oldest segments are deleted. A record cut
+// short by a crash ends its segment's scan on the next open.
+class DetectionCache {
+ public:
+  DetectionCache(const std::string& dir, uint64_t engine_hash, uint64_t config_hash, size_t max_bytes,
+                 size_t segment_bytes = 16 << 20);
+  ~DetectionCache();
+
+  DetectionCache(const DetectionCache&) = delete;
+  DetectionCache& operator=(const DetectionCache&) = delete;
+
+  // Copy the cached output of the image to output (1 + count * 6 floats),
+  // false on a miss
+  bool lookup(uint64_t image_hash, std::vector<float>& output);
+  // Store one frame of yololayer output (kOutputSize floats, only the
+  // candidates it holds are written)
+  void insert(uint64_t image_hash, const float* output);
+
+  DetectionCacheStats stats() const;
+  // False once a segment couldn't be created (directory missing or not
+  // writable): lookups still serve what was read, inserts are dropped
+  bool writable() const;
+
+  // Delete the segments in dir that belong to any other engine or config,
+  // returns how many were removed
+  static int purge(const std::string& dir, uint64_t engine_hash, uint64_t config_hash);
+
+ private:
+  struct Segment {
+    std::string path;
+    int fd = -1;
+    const uint8_t* map = nullptr;  // sealed segments only
+    size_t size = 0;
+  };
+  struct Entry {
+    uint32_t segment;
+    uint64_t offset;  // of the floats
+    uint32_t floats;
+  };
+
+  bool open_segment(uint32_t seq);
+  bool start_segment(uint32_t seq);
+  void seal_active();
+  void evict();
+
+  std::string dir_;
+  uint64_t engine_hash_;
+  uint64_t config_hash_;
+  size_t max_bytes_;
+  size_t segment_bytes_;
+  std::map<uint32_t, Segment> segments_;  // by sequence number, oldest first
+  uint32_t active_ = 0;
+  bool writable_ = false;
+  std::unordered_map<uint64_t, Entry> index_;
+  DetectionCacheStats stats_;
+  mutable std::mutex mutex_;
+};
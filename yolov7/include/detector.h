@@ -0,0 +1,59 @@
+#pragma once
+
+#include "backend.h"
+#include "pipeline_config.h"
+#include "types.h"
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+// Frames in, NMS'ed detections out. Owns its backend and host output
+// buffer; move-only, so several detectors can live in one process.
+//
+//   Detector detector("yolov7-tiny.engine", cfg);
+//   auto res_batch = detector.detect(img_batch);
+//
+// Boxes are in network input coordinates, map them back with get_rect().
+//
+// submit()/collect() expose the backend's slots for callers that want to
+// stage the next batch while the previous one is still on the device:
+//
+//   detector.submit(batch_a);
+//   detector.submit(batch_b);            // uploads while batch_a infers
+//   auto res_a = detector.collect();
+class Detector {
+ public:
+  // Deserialize engine_path and run it with TensorRT (in trt_backend.cpp)
+  Detector(const std::string& engine_path, const PipelineConfig& cfg);
+  // Run on any backend, e.g. a MockBackend
+  Detector(std::unique_ptr<DetectorBackend> backend, const PipelineConfig& cfg);
+
+  Detector(Detector&&) = default;
+  Detector& operator=(Detector&&) = default;
+  Detector(const Detector&) = delete;
+  Detector& operator=(const Detector&) = delete;
+
+  // Any number of frames, split into batches of at most max_batch_size()
+  std::vector<std::vector<Detection>> detect(std::vector<cv::Mat>& frames);
+
+  // Queue at most max_batch_size() frames, blocks while all slots are in flight
+  void submit(std::vector<cv::Mat>& img_batch);
+  // NMS'ed detections of the oldest submitted batch, one vector per frame
+  std::vector<std::vector<Detection>> collect();
+  int in_flight() const { return backend_->in_flight(); }
+
+  // Raw yololayer output of the last batch, kOutputSize floats per frame
+  const float* raw_output() const { return output_.data(); }
+
+  int input_w() const { return backend_->input_w(); }
+  int input_h() const { return backend_->input_h(); }
+  int max_batch_size() const { return backend_->max_batch_size(); }
+  const PipelineConfig& config() const { return cfg_; }
+  BackendStats backend_stats() const { return backend_->stats(); }
+
+ private:
+  std::unique_ptr<DetectorBackend> backend_;
+  PipelineConfig cfg_;
+  std::vector<float> output_;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "change_detector.h"
+#include "pipeline_config.h"
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <vector>
+
+// Camera motion between two frames as the homography taking the previous
+// frame's pixels to this one's
+struct GlobalMotion {
+  bool valid = false;                         // identity when not
+  double h[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};  // row major
+  int tracked = 0;                            // points followed into this frame
+  int inliers = 0;                            // of them agreeing with h
+};
+
+void warp_point(const GlobalMotion& m, double x, double y, double& u, double& v);
+
+// The same motion in coordinates u = scale * x + (ox, oy), e.g. the
+// letterboxed network input
+GlobalMotion rescale_motion(const GlobalMotion& m, double scale, double ox, double oy);
+
+struct Corner {
+  float x, y;
+  int score;
+};
+
+// FAST-9 corners (9 contiguous pixels of the radius 3 circle all brighter
+// or all darker than the center by thresh) at least border pixels from the
+// edge, non-maximum suppressed over 3x3. score_map is scratch.
+void fast_corners(const GrayFrame& img, int thresh, int border, std::vector<Corner>& corners,
+                  std::vector<int>& score_map);
+
+struct EgoMotionStats {
+  uint64_t frames = 0;
+  uint64_t valid = 0;
+  uint64_t tracked = 0;  // summed over frames
+  uint64_t inliers = 0;
+  double cpu_ms = 0;
+  double max_ms = 0;
+};
+
+// Global motion of the camera from frame to frame, so the tracker can move
+// its predictions along before association: from a UAV the image velocity
+// of a target is mostly the platform's own motion, which a constant
+// velocity filter in image space can't follow through turns.
+//
+// The frame is reduced to luma at 1/ego_scale and a 3 level pyramid of
+// 2x2 means. At most ego_points FAST corners of its second level, spread
+// over a grid so no textured patch or target dominates, are picked in each
+// frame and followed into the next one with pyramidal Lucas-Kanade,
+// starting from the last motion. A RANSAC fit (a homography for ground seen at an
+// angle, or ego_model affine) on a fixed number of samples rejects the
+// points on moving targets, then the inliers are refit by least squares.
+//
+// The CPU cost is bounded by the point budget and the sample count rather
+// than the scene. The two pyramids swap roles every frame and keep their
+// buffers, so nothing is allocated once the frame size is settled.
+class EgoMotion {
+ public:
+  explicit EgoMotion(const PipelineConfig& cfg);
+
+  // Motion from the previous frame given to this one, in frame pixels.
+  // false (and identity) for the first frame, after a size change and when
+  // too few points agree on one motion.
+  bool estimate(const cv::Mat& frame, GlobalMotion& motion);
+
+  const EgoMotionStats& stats() const { return stats_; }
+
+ private:
+  typedef std::vector<GrayFrame> Pyramid;
+  struct Point {
+    float x, y;
+  };
+
+  void build_pyramid(const cv::Mat& frame, Pyramid& pyr);
+  void select_points();
+  // Follow points_ from prev_ into cur_, the matched pairs go to src_/dst_
+  void track_points();
+  bool fit(double h[9], int& inliers);
+  bool fit_model(const int* idx, int n, double h[9]) const;
+  int count_inliers(const double h[9], std::vector<uint8_t>* mask) const;
+
+  int scale_;
+  int budget_;
+  bool homography_;
+  int fast_thresh_;
+  Pyramid prev_;
+  Pyramid cur_;
+  bool have_prev_ = false;
+  double last_[9];  // last motion on the level 0 grid, the first guess for the next
+  std::vector<Point> points_;
+  std::vector<Point> src_;
+  std::vector<Point> dst_;
+  std::vector<Corner> corners_;
+  std::vector<int> score_map_;
+  std::vector<int> cell_count_;
+  std::vector<float> patch_;
+  std::vector<uint8_t> inlier_mask_;
+  std::vector<int> inlier_idx_;
+  double norm_src_[3];  // isotropic normalisation (scale, cx, cy) for the fits
+  double norm_dst_[3];
+  std::mt19937 rng_;
+  EgoMotionStats stats_;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "dem.h"
+#include "telemetry_fusion.h"
+#include "types.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class PointUndistorter;
+
+// Pinhole camera, pixels. Lens distortion is corrected on the points
+// before they are projected (see undistort.h).
+struct CameraIntrinsics {
+  int width = 0;
+  int height = 0;
+  float fx = 0;
+  float fy = 0;
+  float cx = 0;
+  float cy = 0;
+};
+
+// Intrinsics of an ideal camera with the given horizontal field of view and
+// square pixels
+CameraIntrinsics intrinsics_from_fov(int width, int height, float hfov_deg);
+
+// A detection on the ground. north/east are metres from the point right
+// below the camera, lat/lon the same point in WGS84 and twd97_x/twd97_y
+// its TWD97 TM2 easting/northing.
+struct GroundTarget {
+  double lat = 0;
+  double lon = 0;
+  double twd97_x = 0;
+  double twd97_y = 0;
+  float north = 0;
+  float east = 0;
+  float width_m = 0;   // footprint, mean length of the box's top/bottom edges on the ground
+  float height_m = 0;  // and of its left/right edges
+  float range = 0;     // camera to target, metres
+  float alt = 0;       // of the ground at the target
+  bool valid = false;  // every ray hit the ground
+  bool on_dem = false;  // the centre ray hit the elevation model, not the flat plane
+};
+
+struct GeolocationStats {
+  uint64_t frames = 0;
+  uint64_t boxes = 0;
+  uint64_t missed = 0;  // a ray at or above the horizon
+  uint64_t dem_rays = 0;
+  uint64_t dem_misses = 0;  // left the elevation model, flat ground instead
+  double cpu_ms = 0;
+};
+
+// Projects image points onto flat ground (a level plane ground_alt below
+// the camera's altitude) through the camera pose.
+//
+// Frames: world is local north-east-down at the camera, the body follows
+// with yaw, pitch, roll (Z-Y-X) from telemetry, and the camera is mounted
+// looking forward and tilted down by tilt_deg about the body's right axis
+// (90 = nadir, image top towards the nose). A camera ray (x right, y down,
+// z along the optical axis) is R_world_body * R_body_cam * ((u - cx) / fx,
+// (v - cy) / fy, 1); it meets the ground at depth alt - ground_alt.
+//
+// For a pinhole camera the pixel to ray map is linear, so the inverse
+// intrinsics fold into the rotation: one 3x3 matrix per attitude, rebuilt
+// only when the attitude changes, takes (u, v, 1) straight to a world ray.
+// The pass over the points is branch free float math on structure of
+// arrays and vectorizes. lat/lon offsets use the WGS84 radii of curvature
+// at the camera's latitude.
+//
+// With an elevation model the rays are marched over the terrain instead
+// (see dem.h), in TWD97 grid coordinates: the local north/east axes map to
+// the grid through the TM2 projection's Jacobian at the camera, which
+// takes care of grid convergence and scale. Boxes whose centre ray leaves
+// the model fall back to the flat ground.
+class GroundProjector {
+ public:
+  GroundProjector(const CameraIntrinsics& camera, float tilt_deg, float ground_alt);
+
+  // Project n points (px[i], py[i], frame pixels) for pose, writing ground
+  // north/east offsets (metres) and a hit flag per point. Returns hits.
+  size_t project(const FramePose& pose, const float* px, const float* py, size_t n, float* north, float* east,
+                 uint8_t* hit);
+
+  // Every detection's box centre and corners in one pass. Boxes are center
+  // x/y, w/h in frame pixels.
+  void locate(const FramePose& pose, const std::vector<Detection>& dets, std::vector<GroundTarget>& targets);
+
+  // Locate on this terrain (not owned, nullptr for flat ground). Heights
+  // are in the telemetry altitude's vertical datum.
+  void set_dem(const Dem* dem) { dem_ = dem; }
+
+  // Correct the box points for lens distortion before projecting them (not
+  // owned, nullptr for an ideal lens). Its camera should be this one.
+  void set_undistorter(const PointUndistorter* undistorter) { undistorter_ = undistorter; }
+
+  const CameraIntrinsics& camera() const { return camera_; }
+  const GeolocationStats& stats() const { return stats_; }
+
+ private:
+  void update_rotation(const FramePose& pose);
+  // Redo locate()'s boxes on dem_: the centre ray is marched over the
+  // terrain, the corners meet the level plane through the centre's ground
+  // point (a box is a few metres across, the march costs 5x as much)
+  void project_dem(const FramePose& pose, size_t boxes);
+
+  CameraIntrinsics camera_;
+  float tilt_deg_;
+  float ground_alt_;
+  const Dem* dem_ = nullptr;
+  const PointUndistorter* undistorter_ = nullptr;
+  float M_[9];  // world ray from (u, v, 1), row major
+  float roll_ = 0, pitch_ = 0, yaw_ = 0;
+  bool have_rotation_ = false;
+  // Scratch for locate(), grown once and reused
+  std::vector<float> px_, py_, north_, east_, ground_;
+  std::vector<uint8_t> hit_;
+  std::vector<double> lat_, lon_, twd97_x_, twd97_y_;
+  GeolocationStats stats_;
+};
+
+// North/east metres from (lat, lon) to degrees, flat earth at that latitude
+void offset_to_latlon(double lat, double lon, double north, double east, double& out_lat, double& out_lon);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "mavlink.h"
+#include "telemetry.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct GpsEmitterConfig {
+  double rate_hz = 5;
+  uint8_t sysid = 255;  // pymavlink's defaults, which readgpstocube_5hz.py sent with
+  uint8_t compid = 0;
+  int64_t max_age_ns = 1000000000;  // older positions go out as no fix
+  float hdop = 0.7f;
+  float vdop = 0.7f;
+  uint8_t satellites = 7;
+  bool send_yaw = false;  // the record's heading in the yaw extension
+};
+
+struct GpsEmitterStats {
+  uint64_t ticks = 0;         // deadlines served
+  uint64_t missed = 0;        // deadlines skipped after oversleeping a whole period
+  uint64_t sent = 0;          // frames written
+  uint64_t no_fix = 0;        // of them without a fresh position
+  uint64_t write_errors = 0;
+  uint64_t bytes = 0;
+  int64_t jitter_max_ns = 0;  // woke up this long after the deadline
+  double jitter_sum_ns = 0;
+  int64_t send_max_ns = 0;    // read the ring, pack and write
+};
+
+// Sends the telemetry ring's newest position to a flight controller as
+// MAVLink v2 GPS_INPUT at a fixed rate, replacing readgpstocube_5hz.py's
+// pymavlink loop.
+//
+// Deadlines are absolute: the n-th frame is due at start + n * period on
+// CLOCK_MONOTONIC and the thread sleeps until then with clock_nanosleep
+// (TIMER_ABSTIME), so the time spent reading, packing and writing never
+// shifts the next frame and the rate doesn't drift the way sleep(0.15)
+// after each send did. If a whole period was overslept the missed
+// deadlines are skipped and counted rather than sent back to back.
+//
+// GPS week, time of week and time_usec are not provided, they go out as 0
+// like readgpstocube_5hz.py sent them: the telemetry records carry neither
+// GPS time nor a clock the flight controller shares.
+//
+// Each frame is packed into a fixed buffer and written with one write() to
+// any file descriptor: a serial port, a pty, or a plain file for testing.
+// The wake-up lateness goes into a 1 us histogram for percentiles.
+class GpsEmitter {
+ public:
+  // Positions from the ring called telemetry, opened when the writer is up
+  GpsEmitter(const std::string& telemetry, int fd, const GpsEmitterConfig& cfg);
+
+  // Send at every deadline until stop is set or after ticks more deadlines
+  // (0 = no limit). Calling it again continues on the same schedule.
+  void run(const std::atomic<bool>& stop, uint64_t ticks = 0);
+
+  // Pack the current position into frame(), returns its length
+  size_t pack(int64_t now_ns);
+  const uint8_t* frame() const { return frame_; }
+
+  const GpsEmitterStats& stats() const { return stats_; }
+  // Wake-up lateness at quantile q of the ticks so far, rounded up to the
+  // microsecond and capped at 10 ms
+  int64_t jitter_quantile_ns(double q) const;
+
+ private:
+  std::string name_;
+  TelemetryReader telemetry_;
+  int fd_;
+  GpsEmitterConfig cfg_;
+  int64_t period_ns_;
+  int64_t deadline_ns_ = 0;  // of the next frame, 0 before the first run
+  uint8_t seq_ = 0;
+  uint8_t frame_[kMavlinkMaxFrame];
+  std::vector<uint32_t> jitter_us_;  // ticks per microsecond of lateness
+  GpsEmitterStats stats_;
+};
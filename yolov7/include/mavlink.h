@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// MAVLink v2 framing, just what the GPS_INPUT emitter sends:
+//
+//   0xFD len incompat compat seq sysid compid msgid(3) payload(len) crc(2)
+//
+// All fields little endian. Trailing zero bytes of the payload are left
+// out (len >= 1), the receiver zero fills them. The checksum is CRC-16/X.25
+// (MCRF4XX) over everything after 0xFD plus the message's CRC_EXTRA byte.
+const static uint8_t kMavlinkStx = 0xFD;
+const static size_t kMavlinkHeaderLen = 10;
+const static size_t kMavlinkMaxFrame = kMavlinkHeaderLen + 255 + 2;
+
+const static uint32_t kMavlinkMsgGpsInput = 232;
+const static uint8_t kMavlinkGpsInputCrcExtra = 151;
+const static size_t kMavlinkGpsInputLen = 65;  // 63 + the yaw extension
+
+// GPS_INPUT ignore_flags
+enum {
+  kGpsInputIgnoreAlt = 1,
+  kGpsInputIgnoreHdop = 2,
+  kGpsInputIgnoreVdop = 4,
+  kGpsInputIgnoreVelHoriz = 8,
+  kGpsInputIgnoreVelVert = 16,
+  kGpsInputIgnoreSpeedAccuracy = 32,
+  kGpsInputIgnoreHorizAccuracy = 64,
+  kGpsInputIgnoreVertAccuracy = 128,
+};
+
+// GPS_INPUT (#232) fields, units as in common.xml
+struct GpsInput {
+  uint64_t time_usec = 0;  // since boot or the Unix epoch, 0 = unknown
+  uint8_t gps_id = 0;
+  uint16_t ignore_flags = 0;
+  uint32_t time_week_ms = 0;
+  uint16_t time_week = 0;
+  uint8_t fix_type = 0;  // 0-1 no fix, 2 2D, 3 3D, 4 DGPS, 5 RTK float, 6 RTK fixed
+  int32_t lat = 0;       // degrees * 1e7
+  int32_t lon = 0;
+  float alt = 0;         // metres AMSL
+  float hdop = 0;
+  float vdop = 0;
+  float vn = 0;          // m/s, NED
+  float ve = 0;
+  float vd = 0;
+  float speed_accuracy = 0;
+  float horiz_accuracy = 0;
+  float vert_accuracy = 0;
+  uint8_t satellites_visible = 0;
+  uint16_t yaw = 0;      // centidegrees, 0 = unknown, 36000 = north
+};
+
+// X.25 CRC accumulation as in MAVLink's checksum.h, start from 0xFFFF
+uint16_t mavlink_crc(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF);
+
+// Frame msg into buf (kMavlinkMaxFrame bytes), returns the frame length.
+// Nothing is allocated.
+size_t mavlink_pack_gps_input(const GpsInput& msg, uint8_t seq, uint8_t sysid, uint8_t compid, uint8_t* buf);
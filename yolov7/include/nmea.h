@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum NmeaType {
+  kNmeaPlsattit,  // $PLSATTIT: position and attitude
+  kNmeaGnrmc,     // $GNRMC / $GPRMC: position, speed, course
+  kNmeaGngga,     // $GNGGA / $GPGGA: position, fix quality, altitude
+};
+
+// One decoded sentence, plain data. Fields the sentence doesn't carry are
+// left at 0 and their has_ flag false.
+struct NmeaSentence {
+  NmeaType type;
+  bool valid;            // the receiver reports a usable fix
+  double utc_seconds;    // of day
+  double lat;            // degrees, south negative
+  double lon;            // degrees, west negative
+  bool has_position;
+  float alt;             // metres above mean sea level
+  bool has_alt;
+  float roll;            // degrees
+  float pitch;
+  float yaw;             // heading, clockwise from north
+  bool has_attitude;
+  float speed;           // m/s over ground
+  float course;          // degrees, clockwise from north
+  int fix_quality;       // GGA 0-8, PLSATTIT status
+  int satellites;
+  float hdop;
+};
+
+struct NmeaStats {
+  uint64_t bytes = 0;
+  uint64_t sentences = 0;        // decoded
+  uint64_t checksum_errors = 0;
+  uint64_t unchecked = 0;        // decoded without a checksum
+  uint64_t malformed = 0;        // known type with unparseable fields
+  uint64_t ignored = 0;          // other sentence types
+  uint64_t overflows = 0;        // lines longer than kNmeaMaxLine
+};
+
+// Incremental NMEA 0183 parser over raw bytes from a serial port or a log
+// file. Chunks may split sentences anywhere; the partial line is kept in a
+// fixed buffer, so parsing never allocates. Numbers are parsed by hand,
+// independent of the C locale.
+//
+//   NmeaParser parser;
+//   NmeaSentence s;
+//   ssize_t n = read(fd, buf, sizeof(buf));
+//   const char* p = buf;
+//   while (parser.next(p, buf + n, s)) handle(s);
+//
+// A sentence is "$" ... ["*" two hex digits] CR/LF. A bad checksum drops the
+// sentence, a missing one is accepted and counted.
+//
+// $PLSATTIT field positions follow readgpstocube_5hz.py: field 3 is the
+// status (3 = valid), 9/10 latitude/longitude in decimal degrees. Heading,
+// pitch, roll and altitude are taken from fields 4, 5, 6 and 11; those four
+// are UNVERIFIED, no receiver log or datasheet was at hand to check them
+// against. Compare with a recorded sentence before trusting the attitude.
+class NmeaParser {
+ public:
+  static const int kMaxLine = 256;
+  static const int kMaxFields = 32;
+
+  // Consume bytes from data up to end until a sentence is complete. Returns
+  // true with out filled and data just past that sentence, false once all
+  // bytes are consumed (the tail waits for the next chunk).
+  bool next(const char*& data, const char* end, NmeaSentence& out);
+
+  const NmeaStats& stats() const { return stats_; }
+
+ private:
+  bool parse_line(NmeaSentence& out);
+
+  char line_[kMaxLine];
+  int len_ = 0;
+  bool in_sentence_ = false;
+  bool overflow_ = false;
+  NmeaStats stats_;
+};
+
+// Locale independent decimal parsing of [begin, end), the whole range has to
+// be consumed. Empty fields fail.
+bool parse_decimal(const char* begin, const char* end, double& value);
+bool parse_int(const char* begin, const char* end, int& value);
+// NMEA ddmm.mmmm / dddmm.mmmm with its N/S/E/W hemisphere field
+bool parse_nmea_coord(const char* begin, const char* end, char hemisphere, double& degrees);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "bounded_queue.h"
+#include "ego_motion.h"
+#include "geolocation.h"
+#include "telemetry_fusion.h"
+#include "types.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+// One frame travelling through the pipeline. Slots are allocated once and
+// recycled, so cv::Mat and vector storage is reused from frame to frame.
+struct FrameSlot {
+  uint64_t seq = 0;
+  std::string name;
+  cv::Mat img;
+  std::vector<Detection> dets;
+  uint64_t content_hash = 0;  // of the encoded image file, with a detection cache
+  bool cached = false;        // dets were replayed from the cache, skip inference
+  bool reused = false;        // dets carried over from the last inferred frame, with skip_static
+  FramePose pose;             // camera pose at capture time, live runs with telemetry
+  std::vector<GroundTarget> targets;  // per detection, when the pose was good for geolocation
+  std::vector<int> track_ids;         // per detection with track, the target's id or -1
+  GlobalMotion motion;                // camera motion into this frame, with roi and ego_motion
+  std::chrono::steady_clock::time_point start;
+};
+
+struct StageStats {
+  std::string name;
+  int threads = 0;
+  uint64_t items = 0;
+  uint64_t batches = 0;
+  double busy_ms = 0;  // summed over the stage's threads
+  double queue_mean = 0;  // occupancy of the stage's input queue
+  size_t queue_max = 0;
+  size_t queue_capacity = 0;
+};
+
+// Runs source -> stage 1 -> ... -> stage N -> sink with every stage on its
+// own thread(s), connected by bounded queues of recycled FrameSlots.
+//
+// - Back-pressure: the source blocks when all slots are in flight, and each
+//   stage blocks when the next queue is full.
+// - Ordering: stages with several threads may finish out of order, the sink
+//   still sees slots in source order. A stage that keeps state from frame
+//   to frame (tracks, a reference frame) is added in_order: it runs on one
+//   thread behind its own reorder buffer and also sees source order.
+// - A stage can take up to max_batch slots at once (e.g. inference); it
+//   blocks for the first one and tops up with whatever is already queued.
+class Pipeline {
+ public:
+  // Fill a slot, return false at end of stream
+  typedef std::function<bool(FrameSlot&)> SourceFn;
+  // Process a batch of slots on the given worker thread index
+  typedef std::function<void(std::vector<FrameSlot*>&, int)> StageFn;
+  typedef std::function<void(FrameSlot&)> SinkFn;
+
+  Pipeline(int num_slots, int queue_capacity);
+
+  void add_stage(const std::string& name, int threads, int max_batch, StageFn fn, bool in_order = false);
+
+  // Runs until the source is exhausted and every slot reached the sink
+  void run(SourceFn source, SinkFn sink);
+
+  std::vector<StageStats> stats() const;
+  double wall_ms() const { return wall_ms_; }
+  uint64_t frames() const { return frames_; }
+  void print_report() const;
+
+ private:
+  struct Stage {
+    std::string name;
+    int threads;
+    int max_batch;
+    bool in_order;
+    StageFn fn;
+    std::unique_ptr<BoundedQueue<FrameSlot*>> input;
+    std::vector<uint64_t> items;  // per thread, no sharing between workers
+    std::vector<uint64_t> batches;
+    std::vector<double> busy_ms;
+  };
+
+  void stage_worker(size_t index, int worker);
+
+  int num_slots_;
+  int queue_capacity_;
+  std::vector<FrameSlot> slots_;
+  std::vector<Stage> stages_;
+  std::unique_ptr<BoundedQueue<FrameSlot*>> free_;
+  std::unique_ptr<BoundedQueue<FrameSlot*>> done_;
+  double wall_ms_ = 0;
+  uint64_t frames_ = 0;
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "config.h"
+#include <string>
+
+/* --------------------------------------------------------
+ * Runtime parameters that don't change the network architecture.
+ * The constants in config.h are only the defaults; a mission can tune
+ * these from a config file and command line overrides without
+ * re-compiling. Loaded once at startup and passed around as const&.
+ * --------------------------------------------------------*/
+struct PipelineConfig {
+  // NMS overlapping thresh and final detection confidence thresh
+  float conf_thresh = kConfThresh;
+  float nms_thresh = kNmsThresh;
+
+  int batch_size = kBatchSize;
+  int gpu_id = kGpuId;
+  int max_input_image_size = kMaxInputImageSize;
+
+  // Applied inside the yololayer plugin, so it is baked in when the engine is serialized
+  float ignore_thresh = kIgnoreThresh;
+
+  // Serialize (-s) an explicit batch engine with a 1..batch_size optimization
+  // profile instead of an implicit batch one. Either kind can be loaded.
+  bool explicit_batch = false;
+
+  // "trt" runs the engine, "mock" runs MockBackend to exercise the host side without a GPU
+  std::string backend = "trt";
+  int mock_latency_us = 10000;
+  // Input shape the mock engine is "built" with, any multiple of 32, so
+  // rectangular shapes run without a GPU
+  int mock_input_w = kInputW;
+  int mock_input_h = kInputH;
+
+  // Input/output slots per backend, 2 lets upload overlap inference
+  int infer_slots = 2;
+
+  // Execution contexts (each with its own streams and slots) sharing one
+  // engine for offline runs (-d). worker_sweep runs the same images with
+  // 1..infer_workers workers and reports the scaling, without the result
+  // cache.
+  int infer_workers = 1;
+  bool worker_sweep = false;
+
+  // Frames in flight in the staged pipeline of main.cpp
+  int pipeline_slots = 8;
+
+  // Live capture (-c): requested camera mode, or the synthetic source's
+  // resolution and rate. capture_frames stops after that many grabs, 0 runs
+  // until the source ends.
+  int capture_width = 1280;
+  int capture_height = 720;
+  int capture_fps = 30;
+  int capture_frames = 0;
+
+  // Multi-stream micro-batching (-m): a batch goes out when batch_size
+  // frames are pending or the oldest one has waited max_wait_us. Each
+  // stream keeps at most stream_pending frames waiting, older ones drop.
+  int max_wait_us = 5000;
+  int stream_pending = 2;
+
+  // Tiled inference for frames much larger than the network input: detect
+  // on overlapping input sized tiles (plus, with tile_full_frame, the whole
+  // frame letterboxed) and merge across tiles. tile_contain_thresh is the
+  // intersection over the smaller box above which two boxes are taken as
+  // pieces of one object cut at a tile border.
+  bool tile = false;
+  float tile_overlap = 0.2f;
+  bool tile_full_frame = true;
+  float tile_contain_thresh = 0.8f;
+
+  // Skip tiles whose gradient energy (see saliency.h) is below
+  // tile_saliency_thresh, 0 disables the filter. Every tile_force_scan-th
+  // frame still runs the skipped tiles to count what the filter misses.
+  // The filter samples every tile_saliency_row_step-th row and column.
+  float tile_saliency_thresh = 0.f;
+  int tile_saliency_row_step = 4;
+  int tile_force_scan = 30;
+
+  // Region of interest mode: once targets are tracked, detect only on
+  // input sized crops around their predicted boxes (grown by roi_margin of
+  // the box size per side), with the full frame every roi_refresh frames
+  // to pick up new targets. More than roi_max_crops crops, or no tracks,
+  // also runs the full frame. A track survives roi_max_misses frames
+  // without a detection.
+  bool roi = false;
+  int roi_refresh = 10;
+  float roi_margin = 0.5f;
+  int roi_max_crops = 4;
+  int roi_max_misses = 2;
+
+  // Track targets across frames (see tracker.h) so every detection carries
+  // a persistent id, in the geo_log and for reporting each target once.
+  // Detections from track_high_thresh on are associated first and, from
+  // track_new_thresh on, start tracks; from track_low_thresh they only keep
+  // a tracked target going, so conf_thresh has to be that low for them to
+  // reach the tracker. A lost track waits track_max_misses frames.
+  bool track = false;
+  float track_high_thresh = 0.5f;
+  float track_low_thresh = 0.1f;
+  float track_new_thresh = 0.6f;
+  int track_max_misses = 30;
+
+  // Compensate the camera's own motion in the tracker (see ego_motion.h):
+  // the global motion from frame to frame is estimated on ego_points
+  // corners at 1/ego_scale resolution and fit as a "homography" or an
+  // "affine" map, and track predictions are moved along with it before
+  // association. Needs track or roi.
+  bool ego_motion = false;
+  int ego_scale = 2;
+  int ego_points = 150;
+  std::string ego_model = "homography";
+
+  // Reuse the last detections while the scene doesn't change (hovering).
+  // Frames are compared at 1/change_scale resolution after compensating a
+  // global shift of up to change_search (downsampled) pixels; the scene is
+  // static when at most change_frac of the change_block sized blocks differ
+  // by more than change_block_thresh gray levels on average. At most
+  // max_skip frames in a row reuse detections.
+  bool skip_static = false;
+  int change_scale = 4;
+  int change_search = 4;
+  int change_block = 8;
+  float change_block_thresh = 6.f;
+  float change_frac = 0.02f;
+  int max_skip = 10;
+
+  // Offline runs (-d) keep each image's raw yololayer output in cache_dir,
+  // keyed by engine, input shape and image content, and replay it on the
+  // next run over the same images: threshold and NMS sweeps skip decoding
+  // and inference. Bounded to cache_max_mb; cache_purge deletes entries of
+  // other engines first. write_output = 0 skips drawing and writing the
+  // result images.
+  std::string cache_dir;
+  int cache_max_mb = 1024;
+  bool cache_purge = false;
+  bool write_output = true;
+
+  // Live capture (-c) tags each frame with the camera pose at its capture
+  // time, interpolated from the telemetry ring of that name (see
+  // telemetry.h, empty = off) over the last telemetry_history samples.
+  // Extrapolation past the newest sample stops after
+  // telemetry_max_extrap_ms; poses further out, or between samples more
+  // than telemetry_max_gap_ms apart, are flagged stale.
+  std::string telemetry;
+  int telemetry_history = 64;
+  int telemetry_max_extrap_ms = 100;
+  int telemetry_max_gap_ms = 500;
+
+  // With telemetry, every detection is projected onto flat ground
+  // ground_alt metres above the telemetry's altitude datum (see
+  // geolocation.h). The camera has camera_hfov_deg horizontal field of view
+  // and looks forward tilted camera_tilt_deg down, 90 = straight down.
+  // A camera_calib file (see undistort.h, empty = off) replaces the field
+  // of view with the calibrated intrinsics and corrects lens distortion.
+  // geo_log appends one CSV line per located target, empty = off.
+  // With a dem grid (see dem.h, empty = off) targets are placed on the
+  // terrain instead, ground_alt remains for where the grid ends.
+  float camera_hfov_deg = 90.f;
+  float camera_tilt_deg = 90.f;
+  std::string camera_calib;
+  float ground_alt = 0.f;
+  std::string geo_log;
+  std::string dem;
+
+  // Located targets are also merged into distinct ground targets (see
+  // target_map.h) and, at the end of the run, the ones seen at least
+  // dedup_min_obs times are written to dedup_log (empty = off). Each
+  // observation is uncertain by dedup_sigma_m plus dedup_sigma_deg of
+  // pointing error over its range; it merges into a target within
+  // dedup_gate squared Mahalanobis distance, and is left out above
+  // dedup_max_sigma_m. Targets are indexed on dedup_cell_m cells.
+  std::string dedup_log;
+  float dedup_sigma_m = 2.f;
+  float dedup_sigma_deg = 0.5f;
+  float dedup_gate = 9.21f;
+  float dedup_max_sigma_m = 20.f;
+  float dedup_cell_m = 25.f;
+  int dedup_min_obs = 3;
+};
+
+// Set one parameter by name, returns false on unknown key or malformed value
+bool set_config_value(PipelineConfig& cfg, const std::string& key, const std::string& value);
+
+// Read "key = value" lines, '#' starts a comment
+bool load_pipeline_config(const std::string& path, PipelineConfig& cfg);
+
+// Parse "--config [file]" and "--[key] [value]" pairs in argv[begin, argc).
+// The file is applied first so that the command line always wins.
+bool parse_pipeline_config(int argc, char** argv, int begin, PipelineConfig& cfg);
+
+void print_pipeline_config(const PipelineConfig& cfg);
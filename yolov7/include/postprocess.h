@@ -3,11 +3,16 @@
 #include "types.h"
 #include <opencv2/opencv.hpp>
 
-cv::Rect get_rect(cv::Mat& img, float bbox[4]);
+cv::Rect get_rect(cv::Mat& img, float bbox[4], int input_w, int input_h);
+// Same, for an img_w x img_h image that was letterboxed into the network input
+cv::Rect get_rect(int img_w, int img_h, const float bbox[4], int input_w, int input_h);
 
-void nms(std::vector<Detection>& res, float *output, float conf_thresh, float nms_thresh = 0.5);
+// IoU of two center x/y, w/h boxes
+float iou(const float lbox[4], const float rbox[4]);
+
+void nms(std::vector<Detection>& res, const float *output, float conf_thresh, float nms_thresh = 0.5);
 
 void batch_nms(std::vector<std::vector<Detection>>& batch_res, float *output, int batch_size, int output_size, float conf_thresh, float nms_thresh = 0.5);
 
-void draw_bbox(std::vector<cv::Mat>& img_batch, std::vector<std::vector<Detection>>& res_batch);
+void draw_bbox(std::vector<cv::Mat>& img_batch, std::vector<std::vector<Detection>>& res_batch, int input_w, int input_h);
 
@@ -4,12 +4,21 @@
 #include <cstdint>
 #include <opencv2/opencv.hpp>
 
-void cuda_preprocess_init(int max_image_size);
-void cuda_preprocess_destroy();
-void cuda_preprocess(uint8_t* src, int src_width, int src_height,
+// Pinned host and device staging for the source images. Each pipeline owns
+// its own buffer, so several of them can run in one process.
+struct PreprocessBuffer {
+  uint8_t* host = nullptr;
+  uint8_t* device = nullptr;
+  int max_image_size = 0;
+};
+
+void cuda_preprocess_init(PreprocessBuffer& buffer, int max_image_size);
+void cuda_preprocess_destroy(PreprocessBuffer& buffer);
+void cuda_preprocess(PreprocessBuffer& buffer,
+                     uint8_t* src, int src_width, int src_height,
                      float* dst, int dst_width, int dst_height,
                      cudaStream_t stream);
-void cuda_batch_preprocess(std::vector<cv::Mat>& img_batch,
+void cuda_batch_preprocess(PreprocessBuffer& buffer,
+                           std::vector<cv::Mat>& img_batch,
                            float* dst, int dst_width, int dst_height,
                            cudaStream_t stream);
-
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "detector.h"
+#include "ego_motion.h"
+#include "tiling.h"
+#include "tracker.h"
+#include "types.h"
+#include <cstdint>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Crops of crop_w x crop_h (clamped to the frame) around the predicted
+// boxes, each box grown by margin of its size on every side. Boxes close
+// enough to share one crop are grouped; a group larger than a crop gets a
+// crop of its own size, which the letterbox then shrinks. Sorted top to
+// bottom, left to right, so the same input always gives the same plan.
+std::vector<cv::Rect> plan_crops(const std::vector<Detection>& boxes, int frame_w, int frame_h,
+                                 int crop_w, int crop_h, float margin);
+
+// Whether a frame runs the full frame (new targets can only show up there)
+// or just the crops: at least every refresh frames, whenever nothing is
+// tracked (or every track drifted off the frame), and when the crops would
+// take more passes than max_crops.
+class RoiScheduler {
+ public:
+  RoiScheduler(int refresh, int max_crops) : refresh_(refresh), max_crops_(max_crops) {}
+
+  bool full_frame(size_t num_tracks, size_t num_crops);
+
+ private:
+  int refresh_;
+  int max_crops_;
+  int since_refresh_ = 0;
+  bool first_ = true;
+};
+
+struct RoiStats {
+  uint64_t frames = 0;
+  uint64_t refreshes = 0;       // frames that ran the full frame
+  uint64_t crops = 0;
+  uint64_t passes = 0;          // batch entries sent to the engine
+  uint64_t refresh_passes = 0;  // what running the full frame every frame would have cost
+  double src_mpix = 0;          // frame pixels the engine looked at, megapixels
+  double frame_mpix = 0;
+
+  RoiStats& operator+=(const RoiStats& o);
+};
+
+// Detects on crops around tracked targets instead of the whole frame. The
+// crops go through the engine as one batch at native resolution; the full
+// frame (tiled if cfg.tile) runs every roi_refresh frames to pick up new
+// targets. Frames must come in order, the tracks (a ByteTracker where every
+// high score detection starts a track at once and lost ones last
+// roi_max_misses frames) carry over between them; with cfg.ego_motion they
+// are moved along with the camera before the crops are planned, so a fast
+// pan doesn't leave the crops behind. Returns detections in frame
+// coordinates.
+class RoiDetector {
+ public:
+  RoiDetector(Detector& detector, const PipelineConfig& cfg);
+
+  std::vector<Detection> detect(const cv::Mat& frame);
+
+  const RoiStats& stats() const { return stats_; }
+  const ByteTracker& tracker() const { return tracker_; }
+  // Camera motion into the last frame, invalid without ego_motion
+  const GlobalMotion& motion() const { return motion_; }
+  const EgoMotion* ego_motion() const { return ego_.get(); }
+
+ private:
+  std::vector<Detection> detect_full(const cv::Mat& frame);
+
+  Detector& detector_;
+  std::unique_ptr<TiledDetector> tiled_;
+  float margin_;
+  float nms_thresh_;
+  float contain_thresh_;
+  ByteTracker tracker_;
+  std::unique_ptr<EgoMotion> ego_;
+  GlobalMotion motion_;
+  RoiScheduler scheduler_;
+  uint64_t last_refresh_passes_ = 1;
+  std::vector<cv::Mat> views_;
+  std::vector<Detection> predicted_;
+  std::vector<int> track_ids_;
+  RoiStats stats_;
+};
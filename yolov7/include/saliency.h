@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+// Sum of |a[i] - b[i]| over n bytes. Uses SSE2 (psadbw) on x86 and NEON on
+// the Jetson's ARM cores, sad_u8_scalar() is the reference.
+uint64_t sad_u8(const uint8_t* a, const uint8_t* b, size_t n);
+uint64_t sad_u8_scalar(const uint8_t* a, const uint8_t* b, size_t n);
+
+// Gradient energy of a BGR tile: mean absolute difference between
+// horizontally neighbouring pixels and between consecutive sampled rows,
+// over every channel so colour edges count too. The tile is sampled on a
+// grid step times coarser each way: every step-th row, and along it runs
+// of kSaliencyRun pixels every step * kSaliencyRun pixels, so the loads
+// stay contiguous for SIMD. step 1 reads every pixel. Sky, water and bare
+// field score a few units, anything with structure well above that (range
+// 0..255). The tile may be a view into a larger frame.
+const int kSaliencyRun = 32;
+float tile_saliency(const cv::Mat& tile, int step);
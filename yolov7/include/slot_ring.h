@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cassert>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Fixed ring of N buffer slots shared by one producer and one consumer,
+// possibly on different threads:
+//
+//   producer: Slot& s = ring.acquire(); fill s; ring.commit();
+//   consumer: Slot& s = ring.front(); wait for s; ring.release();
+//
+// acquire() blocks while all N slots are in flight, so the producer can be
+// at most N batches ahead of the consumer. The ring only tracks ownership;
+// what "in flight" means (CUDA events, a host deadline) is up to the slot.
+template<typename Slot>
+class SlotRing {
+ public:
+  explicit SlotRing(int n) : slots_(n) { assert(n > 0); }
+
+  SlotRing(const SlotRing&) = delete;
+  SlotRing& operator=(const SlotRing&) = delete;
+
+  int size() const { return (int)slots_.size(); }
+
+  // Direct access for setting up and tearing down slot resources
+  Slot& at(int i) { return slots_[i]; }
+
+  Slot& acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    assert(!acquired_);
+    not_full_.wait(lock, [this] { return count_ < (int)slots_.size(); });
+    acquired_ = true;
+    return slots_[head_];
+  }
+
+  void commit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(acquired_);
+    acquired_ = false;
+    head_ = (head_ + 1) % slots_.size();
+    count_++;
+    not_empty_.notify_one();
+  }
+
+  Slot& front() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return count_ > 0; });
+    return slots_[tail_];
+  }
+
+  void release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(count_ > 0);
+    tail_ = (tail_ + 1) % slots_.size();
+    count_--;
+    not_full_.notify_one();
+  }
+
+  int in_flight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+  }
+
+ private:
+  std::vector<Slot> slots_;
+  mutable std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  int head_ = 0;
+  int tail_ = 0;
+  int count_ = 0;
+  bool acquired_ = false;
+};
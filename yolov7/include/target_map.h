@@ -0,0 +1,134 @@
+#pragma once
+
+#include "geolocation.h"
+#include "types.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct PipelineConfig;
+
+struct TargetMapConfig {
+  float sigma_m = 2.f;      // position error of every observation (GPS, DEM), metres
+  float sigma_deg = 0.5f;   // pointing error (attitude, timing), grows with range
+  float gate = 9.21f;       // squared Mahalanobis distance to merge, chi-square 2 dof 99%
+  float max_sigma_m = 20.f; // observations less certain than this are left out
+  float cell_m = 25.f;      // grid cell
+};
+
+// The dedup_* parameters
+TargetMapConfig target_map_config(const PipelineConfig& cfg);
+
+// Position covariance (east-east, east-north, north-north, m^2) of a located
+// target: sigma_m in every direction, plus the pointing error times the
+// range across the line of sight and stretched by the grazing angle along
+// it, where a small angle error moves the ground point the most
+void observation_covariance(const GroundTarget& t, float sigma_m, float sigma_rad, float cov[3]);
+
+// One distinct target on the ground
+struct MappedTarget {
+  int id;
+  int class_id;
+  double x, y;   // TWD97 easting, northing, fused over the observations
+  float cov[3];  // of x, y: east-east, east-north, north-north
+  float conf;    // best detection confidence
+  float width_m, height_m;  // mean footprint
+  uint32_t observations;
+  int track_id;  // last tracker id seen, -1 for none
+  int64_t first_ns, last_ns;
+  int merged_into;  // -1, or the target this one turned out to be
+};
+
+// Snapshot entry: the target and where it is in WGS84
+struct UniqueTarget {
+  MappedTarget target;
+  double lat, lon;
+  float sigma_m;  // along the covariance's major axis
+};
+
+struct TargetMapStats {
+  uint64_t observations = 0;
+  uint64_t merged = 0;     // went into a known target
+  uint64_t fused = 0;      // targets found to be another one
+  uint64_t uncertain = 0;  // left out, more than max_sigma_m
+  uint64_t candidates = 0; // targets gated, summed over observations
+  double cpu_ms = 0;
+};
+
+// Deduplicates geolocated detections into distinct ground targets. The
+// same parked car shows up in hundreds of frames and, after occlusions,
+// under several track ids; this keeps one entry per target with its
+// position fused over all of them.
+//
+// Each observation gets a covariance from the viewing geometry (see
+// observation_covariance()) and merges into the same class target it is
+// closest to by Mahalanobis distance over both covariances, if that is
+// within gate; the target's position and covariance are then the
+// information weighted fusion of the two. Anything else starts a target.
+// A target is gated as never more certain than sigma_m: telemetry and DEM
+// errors are shared by a pass and don't average down, and a target too
+// sure of itself pushes its own observations off into a second one.
+// Two targets started apart (a first sighting far off, seen from a low
+// angle) can converge onto one; once their estimates are within the gate
+// of each other they are fused too, and the later id points to the
+// earlier one.
+//
+// Targets are indexed by a uniform grid of cell_m cells on the TWD97
+// plane, keyed by the interleaved bits of the cell coordinates (a geohash
+// on the projected grid) in a hash map: an insert or query visits the few
+// cells within the gate radius, expected constant time however many
+// targets there are. The radius is bounded because observations above
+// max_sigma_m are left out and fusion only shrinks a covariance; cells
+// keep the largest covariance of their targets, so one uncertain target
+// doesn't widen the search around every other. A target whose estimate
+// moves into another cell moves with it.
+class TargetMap {
+ public:
+  explicit TargetMap(const TargetMapConfig& cfg);
+
+  // Adds one located detection, returns the id of the target it went to
+  // or -1 when it was left out
+  int add(const GroundTarget& t, const Detection& det, int track_id, int64_t t_ns);
+  // The same with the covariance given
+  int add(double x, double y, const float cov[3], int class_id, float conf, float width_m, float height_m,
+          int track_id, int64_t t_ns);
+
+  // Ids of the targets within radius metres of (x, y)
+  void query(double x, double y, double radius, std::vector<int>& ids) const;
+  // What id became: itself, or the target it was fused into
+  int resolve(int id) const;
+  const MappedTarget& target(int id) const { return targets_[id]; }
+
+  // Every target seen at least min_observations times, by id; a single
+  // sighting is more likely a false positive than a target
+  void snapshot(std::vector<UniqueTarget>& out, uint32_t min_observations) const;
+
+  size_t size() const { return targets_.size() - stats_.fused; }  // distinct targets
+  size_t ids() const { return targets_.size(); }                   // handed out
+  size_t cells() const { return cells_.size(); }
+  const TargetMapConfig& config() const { return cfg_; }
+  const TargetMapStats& stats() const { return stats_; }
+
+ private:
+  struct Cell {
+    std::vector<int> ids;
+    float max_var = 0;  // largest covariance eigenvalue of a target ever in it
+  };
+
+  void insert(int id);
+  void erase(int id, uint64_t key);
+  // The most likely same class target other than skip within the gate of
+  // (x, y) with covariance cov, -1 for none
+  int find(double x, double y, const float cov[3], int class_id, int skip);
+  // Moves target id's estimate by an observation (x, y, cov), keeping its cell
+  void fuse(int id, double x, double y, const float cov[3]);
+
+  TargetMapConfig cfg_;
+  double inv_cell_;
+  float max_var_ = 0;  // of any target
+  std::vector<MappedTarget> targets_;  // index = id
+  std::vector<uint64_t> target_cell_;
+  std::unordered_map<uint64_t, Cell> cells_;
+  TargetMapStats stats_;
+};
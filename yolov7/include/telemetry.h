@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// One telemetry sample. t_ns is CLOCK_MONOTONIC (steady_clock) nanoseconds
+// of when the sample was received, the same clock CapturedFrame::captured
+// uses, so frames and telemetry of different processes line up.
+struct TelemetryRecord {
+  int64_t t_ns;
+  double lat;    // WGS84 degrees
+  double lon;
+  float alt;     // metres
+  float roll;    // degrees
+  float pitch;
+  float yaw;     // heading, clockwise from north
+  uint32_t fix;  // 0 no fix, otherwise the receiver's fix quality
+  uint32_t reserved[3];
+};
+
+static_assert(sizeof(TelemetryRecord) == 56, "telemetry record layout");
+
+int64_t telemetry_now_ns();
+
+// Single writer / multi reader ring of TelemetryRecords in POSIX shared
+// memory (/dev/shm/<name>), replacing the text file every frame used to
+// re-read. Readers never block the writer and never take a lock.
+//
+// Layout, little endian (Python uses these classes through yolov7_trt):
+//
+//   header   64 bytes   magic "YTLM", version, capacity, slot size,
+//                       head = number of records written so far
+//   slots    capacity * { uint64 seq, TelemetryRecord }   64 bytes each
+//
+// Record i lives in slot i % capacity. Each slot is a seqlock: the writer
+// sets seq to 2i+1 before touching the record and 2i+2 after, readers copy
+// the record and accept it only if seq read 2i+2 both before and after the
+// copy. That rejects torn reads and slots the writer lapped in between.
+class TelemetryWriter {
+ public:
+  // Create (or take over) the ring, capacity records deep
+  TelemetryWriter(const std::string& name, uint32_t capacity = 256);
+  ~TelemetryWriter();
+
+  TelemetryWriter(const TelemetryWriter&) = delete;
+  TelemetryWriter& operator=(const TelemetryWriter&) = delete;
+
+  void write(const TelemetryRecord& rec);
+  uint64_t written() const;
+
+ private:
+  std::string name_;
+  uint8_t* map_ = nullptr;
+  size_t size_ = 0;
+};
+
+class TelemetryReader {
+ public:
+  TelemetryReader() {}
+  ~TelemetryReader();
+
+  TelemetryReader(const TelemetryReader&) = delete;
+  TelemetryReader& operator=(const TelemetryReader&) = delete;
+
+  // Map the ring, false while no writer has created it yet
+  bool open(const std::string& name);
+  bool is_open() const { return map_ != nullptr; }
+
+  // Records written so far; the last capacity() of them are readable
+  uint64_t head() const;
+  uint32_t capacity() const { return capacity_; }
+
+  // Record number index, false if it isn't written yet or was overwritten
+  bool read(uint64_t index, TelemetryRecord& rec) const;
+  // Newest record, false if there is none
+  bool latest(TelemetryRecord& rec) const;
+  // Newest record with t_ns <= t_ns, false if all readable records are
+  // newer. The index is guessed from the mean record interval, so at a
+  // steady rate this is a read or two regardless of capacity.
+  bool at(int64_t t_ns, TelemetryRecord& rec) const;
+
+ private:
+  const uint8_t* map_ = nullptr;
+  size_t size_ = 0;
+  uint32_t capacity_ = 0;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "telemetry.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Camera pose at a frame's capture time
+struct FramePose {
+  int64_t t_ns = 0;
+  double lat = 0;
+  double lon = 0;
+  float alt = 0;
+  float roll = 0;
+  float pitch = 0;
+  float yaw = 0;
+  bool valid = false;         // there was telemetry to go on
+  bool extrapolated = false;  // past the newest (or before the oldest) sample
+  bool stale = false;         // don't trust it for geolocation, see TelemetryFusion
+  float age_ms = 0;           // to the nearest sample
+};
+
+struct FusionStats {
+  uint64_t queries = 0;
+  uint64_t interpolated = 0;
+  uint64_t extrapolated = 0;
+  uint64_t stale = 0;
+  uint64_t missing = 0;  // no telemetry at all
+  uint64_t dropped = 0;  // samples out of time order
+};
+
+// Telemetry comes at ~5 Hz, frames at 30 Hz: tagging a frame with the last
+// sample is up to 200 ms of flight off. This keeps the last capacity
+// samples and interpolates each frame's capture time between the two
+// samples around it, position and altitude linearly and attitude by slerp.
+//
+// Past the newest sample the last two samples' motion is extrapolated for
+// at most max_extrapolation_ns and held there beyond; the pose is stale
+// then, and also when the two samples are more than max_gap_ns apart (a
+// telemetry dropout). Queries are a binary search over a preallocated
+// circular buffer, so nothing allocates after construction.
+//
+//   fusion.poll(reader);                      // pull new ring records
+//   FramePose pose;
+//   fusion.pose_at(frame_t_ns, pose);
+class TelemetryFusion {
+ public:
+  TelemetryFusion(size_t capacity, int64_t max_extrapolation_ns, int64_t max_gap_ns);
+
+  // Samples have to come in time order, older or equal ones are dropped.
+  // Samples without a fix are ignored.
+  void push(const TelemetryRecord& rec);
+  // Push every ring record written since the last poll, returns how many
+  int poll(const TelemetryReader& reader);
+
+  // false (pose.valid unset) without any sample
+  bool pose_at(int64_t t_ns, FramePose& pose);
+
+  size_t size() const { return count_; }
+  const FusionStats& stats() const { return stats_; }
+
+ private:
+  const TelemetryRecord& sample(size_t i) const { return history_[(start_ + i) % history_.size()]; }
+
+  std::vector<TelemetryRecord> history_;
+  size_t start_ = 0;
+  size_t count_ = 0;
+  int64_t max_extrapolation_ns_;
+  int64_t max_gap_ns_;
+  uint64_t next_index_ = 0;  // next ring record to poll
+  FusionStats stats_;
+};
+
+// Interpolate a -> b at u (u outside [0, 1] extrapolates). Attitude goes
+// through quaternions, so heading wraps and large roll/pitch stay consistent.
+void interpolate_pose(const TelemetryRecord& a, const TelemetryRecord& b, double u, FramePose& pose);
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "detector.h"
+#include "types.h"
+#include <cstdint>
+#include <map>
+#include <opencv2/opencv.hpp>
+#include <utility>
+#include <vector>
+
+// Where the network looks in a frame of one size. Tiles are network input
+// sized so small objects keep their full resolution instead of being
+// shrunk with the whole frame; neighbours overlap so an object cut by one
+// tile border is whole in the next tile.
+struct TileGrid {
+  int frame_w = 0;
+  int frame_h = 0;
+  std::vector<cv::Rect> tiles;  // frame pixels
+  // One more pass over the whole (letterboxed) frame for objects larger than a tile
+  bool full_frame = false;
+
+  int num_passes() const { return (int)tiles.size() + (full_frame ? 1 : 0); }
+};
+
+// Tiles of at most tile_w x tile_h covering the frame, neighbours overlapping
+// by at least overlap (0..1) of a tile. The tiles are spread evenly and the
+// last one ends on the frame border; a frame no larger than a tile along an
+// axis gets a single tile there. A frame that fits in one tile has nothing
+// to gain from the full frame pass, so it never gets one.
+TileGrid make_tile_grid(int frame_w, int frame_h, int tile_w, int tile_h, float overlap, bool full_frame);
+
+// Map detections of one pass (network input coordinates) to frame
+// coordinates; roi is the tile, or the whole frame for the full frame pass.
+void tile_to_frame(std::vector<Detection>& dets, const cv::Rect& roi, int input_w, int input_h);
+
+// Cross-tile NMS, class-wise. A box overlapping a higher scoring one by more
+// than nms_thresh IoU is a duplicate from a neighbouring tile; one lying
+// more than contain_thresh inside it (intersection over the smaller box) is
+// a piece of the same object cut at a tile border. With fuse, duplicates
+// are averaged into the kept box weighted by confidence and pieces extend
+// it; without, they are just dropped.
+void merge_detections(std::vector<Detection>& dets, float nms_thresh, float contain_thresh, bool fuse);
+
+struct TilingStats {
+  uint64_t frames = 0;
+  uint64_t tiles = 0;        // in the grids, full frame passes not counted
+  uint64_t skipped = 0;      // rejected by the saliency filter and not run
+  uint64_t forced = 0;       // rejected but run anyway by a force scan
+  uint64_t forced_hits = 0;  // forced tiles that had detections, i.e. filter misses
+  uint64_t passes = 0;       // batch entries sent to the engine
+  double filter_ms = 0;
+  double infer_ms = 0;
+
+  TilingStats& operator+=(const TilingStats& o);
+  // Engine time the skipped tiles would have cost, at the measured ms per pass
+  double saved_ms() const { return passes ? skipped * infer_ms / passes : 0.0; }
+};
+
+// Runs a Detector over the tiles of large frames. All tiles of a frame (and
+// the full frame pass) go through the engine as batches. Returns detections
+// in frame coordinates, draw them with draw_bbox(.., img.cols, img.rows).
+//
+// With tile_saliency_thresh > 0, tiles whose tile_saliency() is below it
+// (empty sky, water, bare field) are not sent to the engine at all. Every
+// tile_force_scan-th frame runs the rejected tiles anyway, and the ones
+// that turn out to hold detections are counted as misses, so the
+// threshold can be audited on real footage.
+//
+//   TiledDetector tiled(detector, cfg);
+//   std::vector<Detection> dets = tiled.detect(frame);
+class TiledDetector {
+ public:
+  TiledDetector(Detector& detector, const PipelineConfig& cfg);
+
+  std::vector<Detection> detect(const cv::Mat& frame);
+
+  // Computed on the first frame of each resolution and kept
+  const TileGrid& grid(int frame_w, int frame_h);
+
+  const TilingStats& stats() const { return stats_; }
+
+ private:
+  Detector& detector_;
+  float overlap_;
+  bool full_frame_;
+  float nms_thresh_;
+  float contain_thresh_;
+  float saliency_thresh_;
+  int saliency_row_step_;
+  int force_scan_;
+  std::map<std::pair<int, int>, TileGrid> grids_;
+  std::vector<cv::Mat> views_;
+  std::vector<cv::Rect> rois_;
+  std::vector<bool> forced_;
+  TilingStats stats_;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "types.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Minimum cost assignment between the rows and columns of a rows x cols
+// cost matrix (row major). Pairs costing more than limit are never
+// matched and leaving a row unmatched costs limit, so rows and columns
+// can stay unmatched. row_match[r] gets the column of row r or -1.
+// Returns the number of matched rows.
+//
+// Shortest augmenting paths over dual potentials (Jonker-Volgenant
+// without their initialisation heuristics). The feasible pairs are split
+// into connected components first and each one is solved on its own:
+// targets far apart never compete, so a frame of 200 of them is mostly
+// 1x1 problems and a few small clusters instead of one 200x200 matrix.
+int linear_assignment(const float* cost, int rows, int cols, float limit, int* row_match);
+
+struct TrackerConfig {
+  float high_thresh = 0.5f;       // detections at or above are associated first and can start tracks
+  float low_thresh = 0.1f;        // from here to high_thresh they only keep tracked targets going
+  float new_track_thresh = 0.6f;  // unmatched high detections at or above start a track
+  float match_iou = 0.2f;         // tracked and lost tracks against high detections
+  float low_match_iou = 0.5f;     // the rest of the tracked ones against low detections
+  float tentative_match_iou = 0.3f;
+  int min_hits = 2;     // matched frames before a track is confirmed and gets an id
+  int max_misses = 30;  // frames a lost track waits to be matched again
+};
+
+struct PipelineConfig;
+// The track_* parameters
+TrackerConfig tracker_config(const PipelineConfig& cfg);
+
+struct TrackerStats {
+  uint64_t frames = 0;
+  uint64_t detections = 0;
+  uint64_t matched_low = 0;  // low score detections that kept a track
+  uint64_t confirmed = 0;    // tracks that got an id
+  uint64_t recovered = 0;    // lost tracks matched again
+  double cpu_ms = 0;
+  double max_ms = 0;
+};
+
+struct Track {
+  int id;         // 0 while tentative
+  Detection det;  // filtered box, confidence of the last detection
+  int hits;
+  int misses;
+};
+
+// Multi-object tracker after ByteTrack: a constant velocity Kalman filter
+// per track on the box center and size, and association in two stages so
+// low confidence detections (a partly occluded or blurred target) keep an
+// existing track alive without ever starting one:
+//
+//   1. tracked and lost tracks against detections >= high_thresh
+//   2. tracked tracks left over against detections in [low_thresh, high_thresh)
+//   3. tentative tracks against the high detections left over
+//
+// each an IoU cost matrix (no match across classes) solved with
+// linear_assignment(). Unmatched high detections start tentative tracks,
+// which get an id once matched min_hits times; unmatched tracked ones are
+// lost and dropped after max_misses frames.
+//
+// The filter state is kept per component in contiguous arrays (structure of
+// arrays) rather than per track: F, Q and R don't couple x, y, w and h, so
+// the 8x8 covariance is four independent 2x2 position/velocity blocks, and
+// predict and update are straight loops over all tracks that vectorise.
+// Noise scales with the box size as in BoT-SORT.
+class ByteTracker {
+ public:
+  explicit ByteTracker(const TrackerConfig& cfg);
+
+  // The next frame's detections. ids[i] gets the id of the confirmed track
+  // detection i was assigned to, -1 for none.
+  void update(const std::vector<Detection>& dets, std::vector<int>& ids);
+
+  // Moves every track into the pixels of the next frame when the camera
+  // moved: h is the row major homography from the last frame's pixels to
+  // the next one's (see ego_motion.h). Call before update() with that
+  // frame. Centers and velocities follow h exactly, sizes and covariances
+  // are scaled by its local stretch; the rotation's coupling of x and y
+  // is left out to keep the blocks independent.
+  void warp(const double* h);
+
+  // Where every live track (tentative, tracked and lost) is expected in the
+  // next frame, in the detections' coordinates
+  void predict_boxes(std::vector<Detection>& boxes) const;
+  // Moves detections carried over from an earlier frame (ChangeDetector
+  // reuse) to where the live track each one overlaps best, same class and
+  // at least match_iou, is expected in the next frame; the rest keep their
+  // box. Call after warp() and before update() with that frame.
+  void propagate(std::vector<Detection>& dets) const;
+  // Confirmed tracks matched in the last frame, with their filtered boxes
+  void tracked(std::vector<Track>& tracks) const;
+
+  size_t size() const { return id_.size(); }
+  const TrackerConfig& config() const { return cfg_; }
+  const TrackerStats& stats() const { return stats_; }
+
+ private:
+  void predict();
+  void correct();
+  // Assign dets[cols] to tracks[rows] with cost 1 - IoU up to 1 - min_iou,
+  // recording the pairs in track_det_ and det_track_
+  void associate(const std::vector<int>& rows, const std::vector<int>& cols, float min_iou);
+  void add_track(const Detection& det);
+  void remove_tracks();
+
+  TrackerConfig cfg_;
+  int next_id_ = 1;
+  // Filter state, component d = center x, center y, width, height
+  std::vector<float> x_[4];    // value
+  std::vector<float> v_[4];    // change per frame
+  std::vector<float> pxx_[4];  // covariance block
+  std::vector<float> pxv_[4];
+  std::vector<float> pvv_[4];
+  std::vector<int> id_;
+  std::vector<float> class_;
+  std::vector<float> score_;
+  std::vector<int> hits_;
+  std::vector<int> misses_;
+  std::vector<uint8_t> state_;
+  // Per frame scratch
+  std::vector<float> z_[4];
+  std::vector<float> gain_;  // 1 for tracks with a detection this frame
+  std::vector<int> track_det_;
+  std::vector<int> det_track_;
+  std::vector<float> det_box_[5];  // x1, y1, x2, y2, area of every detection
+  std::vector<float> row_box_[5];
+  std::vector<float> col_box_[6];  // and class
+  std::vector<float> cost_;
+  std::vector<int> row_match_;
+  const std::vector<Detection>* dets_ = nullptr;
+  TrackerStats stats_;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "backend.h"
+#include "logging.h"
+#include "pipeline_config.h"
+#include "preprocess.h"
+#include "NvInfer.h"
+#include <atomic>
+#include <memory>
+#include <string>
+
+// A deserialized engine and the runtime it came from. Immutable once
+// loaded, so any number of TrtBackends (one execution context each) can
+// share it.
+struct TrtEngine {
+  Logger logger;
+  std::unique_ptr<nvinfer1::IRuntime> runtime;
+  std::unique_ptr<nvinfer1::ICudaEngine> engine;
+  // Contexts created so far. An explicit batch engine's optimization
+  // profile can only be used by one context at a time.
+  std::atomic<int> contexts{0};
+  // Baked into this engine's YoloLayer when serialized, -1 if unknown
+  float ignore_thresh = -1.f;
+
+  // The engine must go before the runtime
+  ~TrtEngine() { engine.reset(); }
+};
+
+std::shared_ptr<TrtEngine> load_trt_engine(const std::string& engine_path);
+
+// Runs an engine with everything that can't be shared between workers:
+// execution context, streams and cfg.infer_slots input/output
+// slots. Each slot has its own device input and output tensors, pinned
+// host output and preprocess staging, so batch k+1 is staged and
+// preprocessed on the copy stream while batch k infers on the infer
+// stream. Slots are handed over with events, never full stream syncs.
+// Both implicit batch engines and explicit batch engines with a dynamic
+// batch optimization profile are accepted.
+// Not copyable; hold it through a Detector.
+class TrtBackend : public DetectorBackend {
+ public:
+  TrtBackend(const std::string& engine_path, const PipelineConfig& cfg);
+  TrtBackend(std::shared_ptr<TrtEngine> engine, const PipelineConfig& cfg);
+  ~TrtBackend();
+
+  TrtBackend(const TrtBackend&) = delete;
+  TrtBackend& operator=(const TrtBackend&) = delete;
+
+  int input_w() const override { return input_w_; }
+  int input_h() const override { return input_h_; }
+  int max_batch_size() const override { return batch_size_; }
+  int num_slots() const override { return ring_.size(); }
+
+  void submit(std::vector<cv::Mat>& img_batch) override;
+  int collect(float* output) override;
+  int in_flight() const override { return ring_.in_flight(); }
+  BackendStats stats() const override { return stats_; }
+
+ private:
+  struct Slot {
+    float* input_device = nullptr;
+    float* output_device = nullptr;
+    float* output_host = nullptr;
+    PreprocessBuffer staging;
+    cudaEvent_t start = nullptr;
+    cudaEvent_t uploaded = nullptr;
+    cudaEvent_t done = nullptr;
+    int batch = 0;
+  };
+
+  bool check_engine(const PipelineConfig& cfg);
+
+  std::shared_ptr<TrtEngine> shared_;
+  nvinfer1::ICudaEngine* engine_ = nullptr;
+  std::unique_ptr<nvinfer1::IExecutionContext> context_;
+  cudaStream_t copy_stream_ = nullptr;
+  cudaStream_t infer_stream_ = nullptr;
+  SlotRing<Slot> ring_;
+  BackendStats stats_;
+  int input_w_ = 0;
+  int input_h_ = 0;
+  int batch_size_ = 0;
+  bool explicit_batch_ = false;
+};
@@ -15,3 +15,6 @@ struct alignas(float) Detection {
   float class_id;
 };
 
+
+// Floats per image in the yololayer output: [count, Detection * kMaxNumOutputBbox]
+const static int kOutputSize = kMaxNumOutputBbox * sizeof(Detection) / sizeof(float) + 1;
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "geolocation.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Camera matrix and distortion coefficients from an OpenCV calibration file
+// (YAML/XML as written by the calibration sample: camera_matrix,
+// distortion_coefficients, image_width, image_height). Coefficients are
+// OpenCV's k1, k2, p1, p2[, k3[, k4, k5, k6]]. False with a message on
+// errors.
+bool load_calibration(const std::string& path, CameraIntrinsics& camera, std::vector<double>& dist);
+
+// The calibration at another resolution of the same sensor area: the camera
+// matrix scales with the image, the coefficients (on normalized
+// coordinates) stay
+CameraIntrinsics scale_intrinsics(const CameraIntrinsics& camera, int width, int height);
+
+// Grid spacing of PointUndistorter, pixels
+const static int kUndistortStep = 8;
+
+// Moves distorted frame pixels to where the ideal pinhole camera with the
+// same fx, fy, cx, cy would have seen them, i.e. what cv::undistortPoints
+// returns with P = the camera matrix. Only the points geolocation needs are
+// corrected, the frames are never remapped.
+//
+// The distortion model has no closed form inverse (undistortPoints iterates
+// per point). Here it is solved once, to convergence, at the nodes of a
+// grid every step pixels over the frame and a few cells around it, for box
+// corners outside; a point is then the bilinear blend of its cell's
+// nodes, a few multiply-adds. max_error() is the worst blend error, checked
+// at every cell centre inside the frame when the grid is built.
+//
+// undistort() only reads the grid, so threads can share one.
+class PointUndistorter {
+ public:
+  PointUndistorter(const CameraIntrinsics& camera, const std::vector<double>& dist, int step = kUndistortStep);
+
+  // n points (px[i], py[i]) to (ux[i], uy[i]), may be in place
+  void undistort(const float* px, const float* py, size_t n, float* ux, float* uy) const;
+
+  // One point solved directly, what the grid nodes hold
+  void undistort_exact(double u, double v, double& ux, double& uy) const;
+
+  const CameraIntrinsics& camera() const { return camera_; }
+  int grid_cols() const { return cols_; }
+  int grid_rows() const { return rows_; }
+  float max_error() const { return max_error_; }
+
+ private:
+  // Normalized (x, y) through the lens model
+  void distort(double x, double y, double& xd, double& yd) const;
+
+  CameraIntrinsics camera_;
+  double k_[8];  // k1, k2, p1, p2, k3, k4, k5, k6
+  int step_;
+  int cols_ = 0, rows_ = 0;  // nodes, margin included
+  std::vector<float> grid_;  // undistorted minus distorted (du, dv) per node, row major
+  float max_error_ = 0;
+};
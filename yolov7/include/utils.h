@@ -2,6 +2,7 @@
 #define TRTX_YOLOV7_UTILS_H_
 
 #include <dirent.h>
+#include "config.h"
 #include <opencv2/opencv.hpp>
 
 static inline cv::Mat preprocess_img(cv::Mat& img, int input_w, int input_h) {
@@ -26,6 +27,33 @@ static inline cv::Mat preprocess_img(cv::Mat& img, int input_w, int input_h) {
     return out;
 }
 
+// Pick the entry of kInputShapes that wastes the least of the input tensor on
+// letterbox padding for a src_w x src_h stream. Ties go to the larger scale.
+static inline void select_input_shape(int src_w, int src_h, int& input_w, int& input_h) {
+    float best_fill = -1.f, best_scale = 0.f;
+    input_w = kInputW;
+    input_h = kInputH;
+    for (int i = 0; i < kNumInputShapes; i++) {
+        int w = kInputShapes[i][0];
+        int h = kInputShapes[i][1];
+        float scale = std::min(w / (src_w * 1.0f), h / (src_h * 1.0f));
+        float fill = (scale * src_w) * (scale * src_h) / (w * h);
+        if (fill > best_fill + 1e-3f || (fill > best_fill - 1e-3f && scale > best_scale)) {
+            best_fill = fill;
+            best_scale = scale;
+            input_w = w;
+            input_h = h;
+        }
+    }
+}
+
+static inline bool is_supported_input_shape(int input_w, int input_h) {
+    for (int i = 0; i < kNumInputShapes; i++) {
+        if (kInputShapes[i][0] == input_w && kInputShapes[i][1] == input_h) return true;
+    }
+    return false;
+}
+
 static inline int read_files_in_dir(const char *p_dir_name, std::vector<std::string> &file_names) {
     DIR *p_dir = opendir(p_dir_name);
     if (p_dir == nullptr) {
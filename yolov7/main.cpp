@@ -3,17 +3,37 @@
 #include "cuda_utils.h"
 #include "logging.h"
 #include "utils.h"
-#include "preprocess.h"
+#include "detector.h"
+#include "trt_backend.h"
+#include "pipeline.h"
 #include "postprocess.h"
+#include "pipeline_config.h"
+#include "capture.h"
+#include "batch_scheduler.h"
+#include "tiling.h"
+#include "roi.h"
+#include "change_detector.h"
+#include "detection_cache.h"
+#include "telemetry_fusion.h"
+#include "geolocation.h"
+#include "undistort.h"
+#include "tracker.h"
+#include "ego_motion.h"
+#include "target_map.h"
+#include <algorithm>
+#include <cassert>
 #include <chrono>
+#include <deque>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
 
 using namespace nvinfer1;
 
-const static int kOutputSize = kMaxNumOutputBbox * sizeof(Detection) / sizeof(float) + 1;
 static Logger gLogger;
 
-void serialize_engine(unsigned int maxBatchSize, std::string& wts_name, std::string& sub_type, std::string& engine_name) {
+void serialize_engine(unsigned int maxBatchSize, std::string& wts_name, std::string& sub_type, std::string& engine_name, int input_w, int input_h, float ignore_thresh, bool explicit_batch) {
   // Create builder
   IBuilder* builder = createInferBuilder(gLogger);
   IBuilderConfig* config = builder->createBuilderConfig();
@@ -21,19 +41,19 @@ void serialize_engine(unsigned int maxBatchSize, std::string& wts_name, std::str
   // Create model to populate the network, then set the outputs and create an engine
   IHostMemory* serialized_engine = nullptr;
   if (sub_type == "t") {
-    serialized_engine = build_engine_yolov7_tiny(maxBatchSize, builder, config, DataType::kFLOAT, wts_name);
+    serialized_engine = build_engine_yolov7_tiny(maxBatchSize, builder, config, DataType::kFLOAT, wts_name, input_w, input_h, ignore_thresh, explicit_batch);
   } else if (sub_type == "v7") {
-    serialized_engine = build_engine_yolov7(maxBatchSize, builder, config, DataType::kFLOAT, wts_name);
+    serialized_engine = build_engine_yolov7(maxBatchSize, builder, config, DataType::kFLOAT, wts_name, input_w, input_h, ignore_thresh, explicit_batch);
   } else if (sub_type == "x") {
-    serialized_engine = build_engine_yolov7x(maxBatchSize, builder, config, DataType::kFLOAT, wts_name);
+    serialized_engine = build_engine_yolov7x(maxBatchSize, builder, config, DataType::kFLOAT, wts_name, input_w, input_h, ignore_thresh, explicit_batch);
   } else if (sub_type == "w6") {
-    serialized_engine = build_engine_yolov7w6(maxBatchSize, builder, config, DataType::kFLOAT, wts_name);
+    serialized_engine = build_engine_yolov7w6(maxBatchSize, builder, config, DataType::kFLOAT, wts_name, input_w, input_h, ignore_thresh, explicit_batch);
   } else if (sub_type == "e6") {
-    serialized_engine = build_engine_yolov7e6(maxBatchSize, builder, config, DataType::kFLOAT, wts_name);
+    serialized_engine = build_engine_yolov7e6(maxBatchSize, builder, config, DataType::kFLOAT, wts_name, input_w, input_h, ignore_thresh, explicit_batch);
   } else if (sub_type == "d6") {
-    serialized_engine = build_engine_yolov7d6(maxBatchSize, builder, config, DataType::kFLOAT, wts_name);
+    serialized_engine = build_engine_yolov7d6(maxBatchSize, builder, config, DataType::kFLOAT, wts_name, input_w, input_h, ignore_thresh, explicit_batch);
   } else if (sub_type == "e6e") {
-    serialized_engine = build_engine_yolov7e6e(maxBatchSize, builder, config, DataType::kFLOAT, wts_name);
+    serialized_engine = build_engine_yolov7e6e(maxBatchSize, builder, config, DataType::kFLOAT, wts_name, input_w, input_h, ignore_thresh, explicit_batch);
   }
   assert(serialized_engine != nullptr);
 
@@ -49,154 +69,682 @@ void serialize_engine(unsigned int maxBatchSize, std::string& wts_name, std::str
   delete serialized_engine;
 }
 
-void deserialize_engine(std::string& engine_name, IRuntime** runtime, ICudaEngine** engine, IExecutionContext** context) {
-  std::ifstream file(engine_name, std::ios::binary);
-  if (!file.good()) {
-    std::cerr << "read " << engine_name << " error!" << std::endl;
-    assert(false);
+// "synthetic" or anything cv::VideoCapture opens, nullptr if it can't be opened
+static std::unique_ptr<FrameSource> open_source(const std::string& name, const PipelineConfig& cfg) {
+  if (name == "synthetic") {
+    return std::unique_ptr<FrameSource>(new SyntheticSource(cfg.capture_width, cfg.capture_height, cfg.capture_fps));
   }
-  size_t size = 0;
-  file.seekg(0, file.end);
-  size = file.tellg();
-  file.seekg(0, file.beg);
-  char* serialized_engine = new char[size];
-  assert(serialized_engine);
-  file.read(serialized_engine, size);
-  file.close();
-
-  *runtime = createInferRuntime(gLogger);
-  assert(*runtime);
-  *engine = (*runtime)->deserializeCudaEngine(serialized_engine, size);
-  assert(*engine);
-  *context = (*engine)->createExecutionContext();
-  assert(*context);
-  delete[] serialized_engine;
+  VideoSource* video = new VideoSource(name, cfg.capture_width, cfg.capture_height, cfg.capture_fps);
+  std::unique_ptr<FrameSource> source(video);
+  if (!video->opened()) source.reset();
+  return source;
 }
 
-void prepare_buffer(ICudaEngine* engine, float** input_buffer_device, float** output_buffer_device, float** output_buffer_host) {
-  assert(engine->getNbBindings() == 2);
-  // In order to bind the buffers, we need to know the names of the input and output tensors.
-  // Note that indices are guaranteed to be less than IEngine::getNbBindings()
-  const int inputIndex = engine->getBindingIndex(kInputTensorName);
-  const int outputIndex = engine->getBindingIndex(kOutputTensorName);
-  assert(inputIndex == 0);
-  assert(outputIndex == 1);
-  // Create GPU buffers on device
-  CUDA_CHECK(cudaMalloc((void**)input_buffer_device, kBatchSize * 3 * kInputH * kInputW * sizeof(float)));
-  CUDA_CHECK(cudaMalloc((void**)output_buffer_device, kBatchSize * kOutputSize * sizeof(float)));
-
-  *output_buffer_host = new float[kBatchSize * kOutputSize];
+// One live capture per stream feeding a shared micro-batching scheduler
+static int run_streams(Detector& detector, const std::vector<std::string>& names, const PipelineConfig& cfg) {
+  std::vector<std::unique_ptr<LiveCapture>> captures;
+  for (const std::string& name : names) {
+    std::unique_ptr<FrameSource> source = open_source(name, cfg);
+    if (!source) return -1;
+    captures.emplace_back(new LiveCapture(std::move(source), cfg.capture_frames));
+  }
+
+  // Results come back on the scheduler's collect thread only
+  std::vector<std::vector<double>> latencies(names.size());
+  BatchPolicy policy;
+  policy.max_batch = cfg.batch_size;
+  policy.max_wait = std::chrono::microseconds(cfg.max_wait_us);
+  BatchScheduler scheduler(detector, names.size(), policy, cfg.stream_pending, [&](StreamFrame& frame) {
+    latencies[frame.stream].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame.captured).count());
+  });
+  scheduler.start();
+
+  std::vector<std::thread> feeders;
+  for (size_t i = 0; i < captures.size(); i++) {
+    captures[i]->start();
+    feeders.emplace_back([&, i] {
+      CapturedFrame frame;
+      while (captures[i]->latest(frame)) {
+        if (!scheduler.push(i, frame.img, frame.captured)) break;
+      }
+    });
+  }
+  for (auto& t : feeders) t.join();
+  scheduler.stop();
+
+  scheduler.print_report();
+  for (size_t i = 0; i < captures.size(); i++) {
+    CaptureStats cs = captures[i]->stats();
+    std::vector<double>& l = latencies[i];
+    double sum = 0;
+    for (double v : l) sum += v;
+    std::sort(l.begin(), l.end());
+    std::cout << "stream " << i << " (" << names[i] << "): " << cs.grabbed << " grabbed, " << l.size() << " detected";
+    if (!l.empty()) {
+      std::cout << ", glass-to-detection mean " << sum / l.size() << "ms, p99 " << l[l.size() * 99 / 100] << "ms";
+    }
+    std::cout << std::endl;
+  }
+  return 0;
 }
 
-void infer(IExecutionContext& context, cudaStream_t& stream, void** buffers, float* output, int batchSize) {
-  // infer on the batch asynchronously, and DMA output back to host
-  context.enqueue(batchSize, buffers, stream, nullptr);
-  CUDA_CHECK(cudaMemcpyAsync(output, buffers[1], batchSize * kOutputSize * sizeof(float), cudaMemcpyDeviceToHost, stream));
-  CUDA_CHECK(cudaStreamSynchronize(stream));
+// One frame letterboxed into the network, detections in frame coordinates
+static std::vector<Detection> detect_full_frame(Detector& detector, const cv::Mat& img) {
+  std::vector<cv::Mat> img_batch(1, img);
+  std::vector<std::vector<Detection>> res_batch = detector.detect(img_batch);
+  tile_to_frame(res_batch[0], cv::Rect(0, 0, img.cols, img.rows), detector.input_w(), detector.input_h());
+  return res_batch[0];
 }
 
-bool parse_args(int argc, char** argv, std::string& wts, std::string& engine, std::string& img_dir, std::string& sub_type) {
+// Runs the staged pipeline over the images in img_dir, or over a live
+// capture when capture is set. Returns the throughput in frames/s.
+
+static double run_pipeline(std::vector<Detector>& detectors, int workers, LiveCapture* capture, DetectionCache* cache,
+                           const std::vector<std::string>& file_names, const std::string& img_dir, const PipelineConfig& cfg) {
+  assert(workers > 0 && workers <= (int)detectors.size());
+  bool live = capture != nullptr;
+  // The cache holds full frame network output, frame coordinate modes don't produce it
+  if (cache && (live || cfg.tile || cfg.roi || cfg.skip_static)) {
+    std::cout << "result cache only applies to plain offline runs, ignoring it" << std::endl;
+    cache = nullptr;
+  }
+  DetectionCacheStats cache_before;
+  if (cache) cache_before = cache->stats();
+  int input_w = detectors[0].input_w();
+  int input_h = detectors[0].input_h();
+
+  // read -> submit -> collect/nms -> draw -> write, each stage on its own threads.
+  // submit only stages a batch into a free backend slot, so the next batch
+  // uploads while collect waits for the previous one to finish inferring.
+  //
+  // With several workers, submit/collect become one infer stage with a
+  // thread per detector (execution context); the pipeline's reorder buffer
+  // still hands frames to the sink in file order.
+  //
+  // Live capture runs only submit -> collect/nms. Every slot in flight is a
+  // frame that ages while it waits, so there are just enough of them to keep
+  // the backend slots busy; the grab thread drops whatever else comes in.
+  int num_slots = live ? cfg.infer_slots * cfg.batch_size + 1 : cfg.pipeline_slots;
+  Pipeline pipeline(num_slots, num_slots);
+  if (!live) {
+    pipeline.add_stage("read", 2, 1, [&](std::vector<FrameSlot*>& batch, int) {
+      for (FrameSlot* slot : batch) {
+        if (!cache) {
+          slot->img = cv::imread(img_dir + "/" + slot->name);
+          if (slot->img.empty()) std::cerr << "read " << slot->name << " error!" << std::endl;
+          continue;
+        }
+        // Hash the encoded file; a hit replays NMS on the cached candidates
+        // and only decodes if the result image is wanted
+        std::ifstream file(img_dir + "/" + slot->name, std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        slot->content_hash = hash_bytes(bytes.data(), bytes.size());
+        std::vector<float> output;
+        slot->cached = cache->lookup(slot->content_hash, output);
+        if (slot->cached) nms(slot->dets, output.data(), cfg.conf_thresh, cfg.nms_thresh);
+        if (!slot->cached || cfg.write_output) {
+          slot->img = bytes.empty() ? cv::Mat() : cv::imdecode(bytes, cv::IMREAD_COLOR);
+        } else {
+          slot->img.release();
+        }
+        if (!slot->cached && slot->img.empty()) std::cerr << "read " << slot->name << " error!" << std::endl;
+      }
+    });
+  }
+  Detector& detector = detectors[0];
+  std::deque<std::vector<Detection>> pending;
+  std::vector<TiledDetector> tiled;
+  std::unique_ptr<RoiDetector> roi;
+  std::unique_ptr<ChangeDetector> gate;
+  bool frame_coords = cfg.tile || cfg.roi || cfg.skip_static;
+  if (frame_coords) {
+    // Each worker takes one frame at a time and gets its detections back in
+    // frame coordinates; a tiled frame makes up its own batches. Tracks and
+    // the change detector's reference frame carry over from frame to frame,
+    // so with those one thread sees every frame in order, reordered after
+    // the read threads.
+    bool sequential = cfg.roi || cfg.skip_static;
+    int threads = sequential ? 1 : workers;
+    if (sequential && workers > 1) std::cout << "roi/skip_static run a single infer worker" << std::endl;
+    if (cfg.roi) {
+      roi.reset(new RoiDetector(detector, cfg));
+    } else if (cfg.tile) {
+      tiled.reserve(threads);
+      for (int w = 0; w < threads; w++) tiled.emplace_back(detectors[w], cfg);
+    }
+    if (cfg.skip_static) gate.reset(new ChangeDetector(cfg));
+    pipeline.add_stage("infer", threads, 1, [&](std::vector<FrameSlot*>& batch, int worker) {
+      for (FrameSlot* slot : batch) {
+        slot->motion = GlobalMotion();
+        slot->reused = false;
+        if (slot->img.empty()) continue;
+        if (gate && gate->reuse(slot->img, slot->dets)) {
+          slot->reused = true;
+          continue;
+        }
+        if (roi) {
+          slot->dets = roi->detect(slot->img);
+          slot->motion = roi->motion();
+        } else if (cfg.tile) {
+          slot->dets = tiled[worker].detect(slot->img);
+        } else {
+          slot->dets = detect_full_frame(detectors[worker], slot->img);
+        }
+        if (gate) gate->inferred(slot->dets);
+      }
+    }, sequential);
+  } else if (cache) {
+    // One batch at a time per worker, so each frame's raw output can be
+    // stored under its content hash before NMS
+    pipeline.add_stage("infer", workers, cfg.batch_size, [&](std::vector<FrameSlot*>& batch, int worker) {
+      std::vector<cv::Mat> img_batch;
+      std::vector<FrameSlot*> misses;
+      for (FrameSlot* slot : batch) {
+        if (slot->cached || slot->img.empty()) continue;
+        img_batch.push_back(slot->img);
+        misses.push_back(slot);
+      }
+      if (img_batch.empty()) return;
+      Detector& d = detectors[worker];
+      d.submit(img_batch);
+      std::vector<std::vector<Detection>> res_batch = d.collect();
+      for (size_t j = 0; j < misses.size(); j++) {
+        cache->insert(misses[j]->content_hash, d.raw_output() + j * kOutputSize);
+        misses[j]->dets.swap(res_batch[j]);
+      }
+    });
+  } else if (workers > 1) {
+    pipeline.add_stage("infer", workers, cfg.batch_size, [&](std::vector<FrameSlot*>& batch, int worker) {
+      std::vector<cv::Mat> img_batch;
+      std::vector<FrameSlot*> valid;
+      for (FrameSlot* slot : batch) {
+        if (slot->img.empty()) continue;
+        img_batch.push_back(slot->img);
+        valid.push_back(slot);
+      }
+      std::vector<std::vector<Detection>> res_batch = detectors[worker].detect(img_batch);
+      for (size_t j = 0; j < valid.size(); j++) {
+        valid[j]->dets.swap(res_batch[j]);
+      }
+    });
+  } else {
+    pipeline.add_stage("submit", 1, cfg.batch_size, [&](std::vector<FrameSlot*>& batch, int) {
+      std::vector<cv::Mat> img_batch;
+      for (FrameSlot* slot : batch) {
+        if (!slot->img.empty()) img_batch.push_back(slot->img);
+      }
+      if (!img_batch.empty()) detector.submit(img_batch);
+    });
+    // Single threaded, so frames arrive in submission order and line up with
+    // the per-frame results of each collected batch
+    pipeline.add_stage("collect", 1, 1, [&](std::vector<FrameSlot*>& batch, int) {
+      for (FrameSlot* slot : batch) {
+        if (slot->img.empty()) continue;
+        if (pending.empty()) {
+          for (auto& res : detector.collect()) pending.push_back(std::move(res));
+        }
+        slot->dets.swap(pending.front());
+        pending.pop_front();
+      }
+    });
+  }
+  // Camera motion for the tracker, estimated on the frame as read: the draw
+  // stage paints boxes on it later. One thread in frame order, since each
+  // estimate starts from the previous frame; with roi the infer stage
+  // already estimated it.
+  std::unique_ptr<EgoMotion> ego;
+  if (cfg.track && cfg.ego_motion && !roi) {
+    ego.reset(new EgoMotion(cfg));
+    pipeline.add_stage("ego", 1, 1, [&](std::vector<FrameSlot*>& batch, int) {
+      for (FrameSlot* slot : batch) ego->estimate(slot->img, slot->motion);
+    }, true);
+  }
+  // Live frames with a usable pose get their detections located on the
+  // ground. The projector is sized by the first frame that comes through.
+  std::unique_ptr<GroundProjector> projector;
+  std::unique_ptr<PointUndistorter> undistorter;
+  std::ofstream geo_log;
+  // Distinct ground targets over the run, written out at the end
+  std::unique_ptr<TargetMap> target_map;
+  Dem dem;
+  CameraIntrinsics calib;
+  std::vector<double> calib_dist;
+  if (live && !cfg.telemetry.empty()) {
+    if (!cfg.camera_calib.empty() && !load_calibration(cfg.camera_calib, calib, calib_dist)) calib = CameraIntrinsics();
+    if (!cfg.dem.empty() && dem.open(cfg.dem)) {
+      std::cout << "dem: " << dem.cols() << "x" << dem.rows() << " samples at " << dem.cell() << "m, "
+                << dem.min_height() << ".." << dem.max_height() << "m" << std::endl;
+    }
+    if (!cfg.geo_log.empty()) {
+      geo_log.open(cfg.geo_log, std::ios::app);
+      if (!geo_log.good()) std::cerr << "open " << cfg.geo_log << " error!" << std::endl;
+    }
+    if (!cfg.dedup_log.empty()) target_map.reset(new TargetMap(target_map_config(cfg)));
+    pipeline.add_stage("geolocate", 1, 1, [&](std::vector<FrameSlot*>& batch, int) {
+      for (FrameSlot* slot : batch) {
+        if (slot->img.empty() || slot->dets.empty() || !slot->pose.valid || slot->pose.stale) continue;
+        if (!projector || projector->camera().width != slot->img.cols || projector->camera().height != slot->img.rows) {
+          CameraIntrinsics camera = intrinsics_from_fov(slot->img.cols, slot->img.rows, cfg.camera_hfov_deg);
+          if (calib.width > 0) {
+            // Built once, frames keep their size
+            camera = scale_intrinsics(calib, slot->img.cols, slot->img.rows);
+            undistorter.reset(new PointUndistorter(camera, calib_dist));
+            std::cout << "undistortion: " << calib.width << "x" << calib.height << " calibration on "
+                      << camera.width << "x" << camera.height << " frames, " << undistorter->grid_cols() << "x"
+                      << undistorter->grid_rows() << " grid, max error " << undistorter->max_error() << "px"
+                      << std::endl;
+          }
+          projector.reset(new GroundProjector(camera, cfg.camera_tilt_deg, cfg.ground_alt));
+          if (undistorter) projector->set_undistorter(undistorter.get());
+          if (dem.is_open()) projector->set_dem(&dem);
+        }
+        if (frame_coords) {
+          projector->locate(slot->pose, slot->dets, slot->targets);
+          continue;
+        }
+        std::vector<Detection> boxes = slot->dets;
+        for (Detection& d : boxes) {
+          cv::Rect r = get_rect(slot->img.cols, slot->img.rows, d.bbox, input_w, input_h);
+          d.bbox[0] = r.x + r.width / 2.f;
+          d.bbox[1] = r.y + r.height / 2.f;
+          d.bbox[2] = (float)r.width;
+          d.bbox[3] = (float)r.height;
+        }
+        projector->locate(slot->pose, boxes, slot->targets);
+      }
+    });
+  }
+  if (!live && cfg.write_output) {
+    pipeline.add_stage("draw", 1, 1, [&](std::vector<FrameSlot*>& batch, int) {
+      for (FrameSlot* slot : batch) {
+        if (slot->img.empty()) continue;
+        std::vector<cv::Mat> img_batch(1, slot->img);
+        std::vector<std::vector<Detection>> res_batch(1, slot->dets);
+        if (frame_coords) {
+          // Already in frame coordinates, which get_rect() leaves as they are
+          draw_bbox(img_batch, res_batch, slot->img.cols, slot->img.rows);
+        } else {
+          draw_bbox(img_batch, res_batch, input_w, input_h);
+        }
+      }
+    });
+    pipeline.add_stage("write", 2, 1, [&](std::vector<FrameSlot*>& batch, int) {
+      for (FrameSlot* slot : batch) {
+        if (!slot->img.empty()) cv::imwrite("_" + slot->name, slot->img);
+      }
+    });
+  }
+
+  // Backend stats accumulate over runs, report this run only
+  std::vector<BackendStats> before;
+  for (int w = 0; w < workers; w++) before.push_back(detectors[w].backend_stats());
+
+  // Ids have to follow targets from frame to frame, so tracking runs in the
+  // sink, which sees the frames in order
+  std::unique_ptr<ByteTracker> tracker;
+  if (cfg.track) {
+    tracker.reset(new ByteTracker(tracker_config(cfg)));
+    if (cfg.conf_thresh > cfg.track_low_thresh) {
+      std::cout << "tracking: conf_thresh " << cfg.conf_thresh << " is above track_low_thresh "
+                << cfg.track_low_thresh << ", low score detections don't reach the tracker" << std::endl;
+    }
+  }
+  if (cfg.ego_motion && !cfg.track && !cfg.roi) std::cout << "ego_motion needs track or roi, ignored" << std::endl;
+
+  // Live frames get the camera pose at their capture time
+  TelemetryReader telemetry;
+  std::unique_ptr<TelemetryFusion> fusion;
+  if (live && !cfg.telemetry.empty()) {
+    fusion.reset(new TelemetryFusion(cfg.telemetry_history, cfg.telemetry_max_extrap_ms * 1000000LL, cfg.telemetry_max_gap_ms * 1000000LL));
+  }
+
+  size_t next_file = 0;
+  std::vector<double> latencies;
+  double megapixels = 0;
+  if (capture) capture->start();
+  pipeline.run(
+      [&](FrameSlot& slot) {
+        if (live) {
+          // Blocks for the freshest frame; latency is measured from its capture time
+          CapturedFrame frame;
+          if (!capture->latest(frame)) return false;
+          slot.img = frame.img;
+          slot.name = std::to_string(frame.seq);
+          slot.start = frame.captured;
+          if (fusion) {
+            // The telemetry writer may come up after the capture
+            if (telemetry.is_open() || telemetry.open(cfg.telemetry)) fusion->poll(telemetry);
+            fusion->pose_at(std::chrono::duration_cast<std::chrono::nanoseconds>(frame.captured.time_since_epoch()).count(), slot.pose);
+          }
+          return true;
+        }
+        if (next_file >= file_names.size()) return false;
+        slot.name = file_names[next_file++];
+        return true;
+      },
+      [&](FrameSlot& slot) {
+        latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - slot.start).count());
+        megapixels += slot.img.cols * (double)slot.img.rows / 1e6;
+        // slot.motion comes from the ego stage or the roi infer stage
+        if (tracker && slot.motion.valid) {
+          if (frame_coords) {
+            tracker->warp(slot.motion.h);
+          } else {
+            // Detections are still in letterboxed network input pixels
+            double r = std::min(input_w / (double)slot.img.cols, input_h / (double)slot.img.rows);
+            GlobalMotion m = rescale_motion(slot.motion, r, (input_w - r * slot.img.cols) / 2,
+                                            (input_h - r * slot.img.rows) / 2);
+            tracker->warp(m.h);
+          }
+        }
+        // Reused detections only moved with the global shift, moving targets
+        // go on along their tracks
+        if (tracker && slot.reused) tracker->propagate(slot.dets);
+        if (tracker) tracker->update(slot.dets, slot.track_ids);
+        if (geo_log.is_open()) {
+          // frame, capture time, class, conf, lat, lon, TWD97 x, y, north, east, width_m, height_m, range, track id
+          for (size_t i = 0; i < slot.targets.size(); i++) {
+            const GroundTarget& t = slot.targets[i];
+            if (!t.valid) continue;
+            geo_log << slot.name << "," << slot.pose.t_ns << "," << (int)slot.dets[i].class_id << "," << slot.dets[i].conf
+                    << "," << std::setprecision(10) << t.lat << "," << t.lon << "," << t.twd97_x << "," << t.twd97_y
+                    << std::setprecision(6) << "," << t.north << "," << t.east << "," << t.width_m << "," << t.height_m
+                    << "," << t.range << "," << (i < slot.track_ids.size() ? slot.track_ids[i] : -1) << "\n";
+          }
+        }
+        if (target_map) {
+          for (size_t i = 0; i < slot.targets.size(); i++) {
+            if (!slot.targets[i].valid) continue;
+            target_map->add(slot.targets[i], slot.dets[i], i < slot.track_ids.size() ? slot.track_ids[i] : -1,
+                            slot.pose.t_ns);
+          }
+        }
+      });
+  if (capture) capture->stop();
+  pipeline.print_report();
+  if (!latencies.empty()) {
+    double sum = 0;
+    for (double l : latencies) sum += l;
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << (live ? "glass-to-detection" : "") << " latency: mean " << sum / latencies.size() << "ms"
+              << ", p50 " << latencies[latencies.size() / 2] << "ms"
+              << ", p99 " << latencies[latencies.size() * 99 / 100] << "ms"
+              << ", max " << latencies.back() << "ms" << std::endl;
+  }
+  if (megapixels > 0 && pipeline.wall_ms() > 0) {
+    // Comparable across resolutions and with tiling on or off
+    std::cout << "throughput: " << megapixels * 1000.0 / pipeline.wall_ms() << " MP/s"
+              << ", " << pipeline.wall_ms() / megapixels << "ms per MP" << std::endl;
+  }
+  if (cfg.tile) {
+    TilingStats ts;
+    for (const TiledDetector& t : tiled) ts += t.stats();
+    if (ts.frames) {
+      std::cout << "tiling: " << (double)ts.passes / ts.frames << " passes per frame"
+                << ", infer " << ts.infer_ms / ts.frames << "ms per frame";
+      if (cfg.tile_saliency_thresh > 0.f) {
+        std::cout << ", saliency skipped " << 100.0 * ts.skipped / std::max<uint64_t>(1, ts.tiles) << "% of tiles"
+                  << " costing " << ts.filter_ms / ts.frames << "ms"
+                  << " to save ~" << ts.saved_ms() / ts.frames << "ms per frame"
+                  << ", force scanned " << ts.forced << " with " << ts.forced_hits << " missed";
+      }
+      std::cout << std::endl;
+    }
+  }
+  if (roi && roi->stats().frames) {
+    const RoiStats& rs = roi->stats();
+    // Engine input pixels that running the full frame every frame would have cost on top
+    double saved_mpix = (rs.refresh_passes - std::min(rs.refresh_passes, rs.passes)) * input_w * (double)input_h / 1e6;
+    std::cout << "roi: full frame on " << 100.0 * rs.refreshes / rs.frames << "% of frames"
+              << ", " << (rs.frames > rs.refreshes ? (double)rs.crops / (rs.frames - rs.refreshes) : 0.0) << " crops otherwise"
+              << ", " << rs.passes << " engine passes vs " << rs.refresh_passes << " full frame"
+              << ", saved " << (pipeline.wall_ms() > 0 ? saved_mpix * 1000.0 / pipeline.wall_ms() : 0.0) << " MP/s of engine input"
+              << ", looked at " << 100.0 * rs.src_mpix / rs.frame_mpix << "% of frame pixels" << std::endl;
+  }
+  if (gate && gate->stats().frames) {
+    const ChangeStats& cs = gate->stats();
+    std::cout << "change detection: " << 100.0 * cs.skipped / cs.frames << "% of inferences avoided"
+              << " (" << cs.forced << " static frames inferred at max_skip)"
+              << ", costing " << cs.cpu_ms / cs.frames << "ms CPU per frame" << std::endl;
+  }
+  if (tracker && tracker->stats().frames) {
+    const TrackerStats& ts = tracker->stats();
+    std::cout << "tracking: " << ts.confirmed << " targets over " << ts.frames << " frames"
+              << ", " << ts.recovered << " found again after being lost"
+              << ", " << ts.matched_low << " low score detections kept a track"
+              << ", " << ts.cpu_ms / ts.frames << "ms per frame, max " << ts.max_ms << "ms" << std::endl;
+  }
+  const EgoMotion* ego_stats = ego ? ego.get() : roi ? roi->ego_motion() : nullptr;
+  if (ego_stats && ego_stats->stats().frames) {
+    const EgoMotionStats& es = ego_stats->stats();
+    std::cout << "ego motion: found on " << 100.0 * es.valid / es.frames << "% of frames"
+              << ", " << (double)es.tracked / es.frames << " points followed, "
+              << (es.valid ? (double)es.inliers / es.valid : 0.0) << " agreeing"
+              << ", " << es.cpu_ms / es.frames << "ms per frame, max " << es.max_ms << "ms" << std::endl;
+  }
+  if (cache) {
+    DetectionCacheStats ds = cache->stats();
+    std::cout << "result cache: " << ds.hits - cache_before.hits << " hits, " << ds.misses - cache_before.misses << " misses"
+              << ", " << ds.inserts - cache_before.inserts << " stored, " << ds.bytes / 1e6 << "MB on disk"
+              << ", " << ds.evicted_segments - cache_before.evicted_segments << " segments evicted" << std::endl;
+  }
+  if (fusion) {
+    const FusionStats& fs = fusion->stats();
+    std::cout << "telemetry: " << fs.interpolated << " frames interpolated, " << fs.extrapolated << " extrapolated, "
+              << fs.stale << " stale, " << fs.missing << " without telemetry" << std::endl;
+  }
+  if (projector && projector->stats().frames) {
+    const GeolocationStats& gs = projector->stats();
+    std::cout << "geolocation: " << gs.boxes << " boxes in " << gs.frames << " frames, " << gs.missed << " above the horizon";
+    if (gs.dem_rays) std::cout << ", " << gs.dem_misses << " of " << gs.dem_rays << " off the dem";
+    std::cout
+              << ", " << gs.cpu_ms * 1000.0 / gs.frames << "us per frame"
+              << ", " << (gs.cpu_ms > 0 ? gs.boxes / gs.cpu_ms / 1000.0 : 0.0) << " M boxes/s" << std::endl;
+  }
+  if (target_map && target_map->stats().observations) {
+    std::vector<UniqueTarget> unique;
+    target_map->snapshot(unique, cfg.dedup_min_obs);
+    std::ofstream dedup_log(cfg.dedup_log);
+    if (!dedup_log.good()) std::cerr << "open " << cfg.dedup_log << " error!" << std::endl;
+    // id, class, conf, lat, lon, TWD97 x, y, sigma_m, width_m, height_m, observations, track id, first, last capture time
+    for (const UniqueTarget& u : unique) {
+      const MappedTarget& t = u.target;
+      dedup_log << t.id << "," << t.class_id << "," << t.conf << "," << std::setprecision(10) << u.lat << "," << u.lon
+                << "," << t.x << "," << t.y << std::setprecision(6) << "," << u.sigma_m << "," << t.width_m << ","
+                << t.height_m << "," << t.observations << "," << t.track_id << "," << t.first_ns << "," << t.last_ns
+                << "\n";
+    }
+    const TargetMapStats& ms = target_map->stats();
+    std::cout << "dedup: " << ms.observations << " observations, " << target_map->size() << " targets, "
+              << unique.size() << " seen " << cfg.dedup_min_obs << "+ times written to " << cfg.dedup_log
+              << ", " << ms.fused << " found to be another, " << ms.uncertain << " too uncertain"
+              << ", " << (double)ms.candidates / ms.observations << " candidates and "
+              << ms.cpu_ms * 1000.0 / ms.observations << "us per observation" << std::endl;
+  }
+  if (capture) {
+    CaptureStats cs = capture->stats();
+    std::cout << "capture: " << cs.grabbed << " grabbed, " << cs.delivered << " processed, "
+              << cs.dropped << " dropped as stale" << std::endl;
+  }
+
+  // Fully serial slots would take submit + device time; whatever the wall
+  // clock saved on top of that is upload/preprocess hidden behind inference.
+  BackendStats bs;
+  for (int w = 0; w < workers; w++) {
+    BackendStats ws = detectors[w].backend_stats();
+    bs.batches += ws.batches - before[w].batches;
+    bs.submit_ms += ws.submit_ms - before[w].submit_ms;
+    bs.device_ms += ws.device_ms - before[w].device_ms;
+    bs.wait_ms += ws.wait_ms - before[w].wait_ms;
+  }
+  if (bs.batches) {
+    double serial_ms = bs.submit_ms + bs.device_ms;
+    std::cout << "backend: " << bs.batches << " batches, " << workers << " worker(s) x " << cfg.infer_slots << " slots"
+              << ", submit " << bs.submit_ms / bs.batches << "ms"
+              << ", device " << bs.device_ms / bs.batches << "ms"
+              << ", collect wait " << bs.wait_ms / bs.batches << "ms per batch"
+              << ", overlap " << 100.0 * std::max(0.0, 1.0 - pipeline.wall_ms() / serial_ms) << "%" << std::endl;
+  }
+  return pipeline.wall_ms() > 0 ? pipeline.frames() * 1000.0 / pipeline.wall_ms() : 0.0;
+}
+
+bool parse_args(int argc, char** argv, std::string& wts, std::string& engine, std::string& img_dir, std::string& capture_source, std::string& stream_sources, std::string& sub_type, int& stream_w, int& stream_h, PipelineConfig& cfg) {
   if (argc < 4) return false;
-  if (std::string(argv[1]) == "-s" && argc == 5) {
+  int options = 0;
+  if (std::string(argv[1]) == "-s" && argc >= 5) {
     wts = std::string(argv[2]);
     engine = std::string(argv[3]);
     sub_type = std::string(argv[4]);
-  } else if (std::string(argv[1]) == "-d" && argc == 4) {
+    options = 5;
+    if (argc > 5 && std::string(argv[5]).compare(0, 2, "--") != 0) {
+      if (sscanf(argv[5], "%dx%d", &stream_w, &stream_h) != 2) return false;
+      options = 6;
+    }
+  } else if (std::string(argv[1]) == "-d") {
     engine = std::string(argv[2]);
     img_dir = std::string(argv[3]);
+    options = 4;
+  } else if (std::string(argv[1]) == "-c") {
+    engine = std::string(argv[2]);
+    capture_source = std::string(argv[3]);
+    options = 4;
+  } else if (std::string(argv[1]) == "-m") {
+    engine = std::string(argv[2]);
+    stream_sources = std::string(argv[3]);
+    options = 4;
   } else {
     return false;
   }
-  return true;
+  return parse_pipeline_config(argc, argv, options, cfg);
 }
 
 int main(int argc, char** argv) {
-  cudaSetDevice(kGpuId);
-
   std::string wts_name = "";
   std::string engine_name = "";
   std::string img_dir;
+  std::string capture_source;
+  std::string stream_sources;
   std::string sub_type = "";
+  int stream_w = kInputW;
+  int stream_h = kInputH;
+  PipelineConfig parsed_cfg;
 
-  if (!parse_args(argc, argv, wts_name, engine_name, img_dir, sub_type)) {
+  if (!parse_args(argc, argv, wts_name, engine_name, img_dir, capture_source, stream_sources, sub_type, stream_w, stream_h, parsed_cfg)) {
     std::cerr << "Arguments not right!" << std::endl;
-    std::cerr << "./yolov7 -s [.wts] [.engine] [t/v7/x/w6/e6/d6/e6e]  // serialize model to plan file" << std::endl;
-    std::cerr << "./yolov7 -d [.engine] ../samples  // deserialize plan file and run inference" << std::endl;
+    std::cerr << "./yolov7 -s [.wts] [.engine] [t/v7/x/w6/e6/d6/e6e] [stream WxH] [options]  // serialize model to plan file" << std::endl;
+    std::cerr << "./yolov7 -d [.engine] ../samples [options]  // deserialize plan file and run inference" << std::endl;
+    std::cerr << "./yolov7 -c [.engine] [/dev/video0|gstreamer|video|synthetic] [options]  // live capture, latest frame wins" << std::endl;
+    std::cerr << "./yolov7 -m [.engine] [source,source,...] [options]  // several live streams batched together" << std::endl;
+    std::cerr << "options: --config [file] --conf_thresh --nms_thresh --batch_size --gpu_id --max_input_image_size --ignore_thresh" << std::endl;
+    std::cerr << "         --backend [trt/mock] --mock_latency_us --mock_input_w --mock_input_h --infer_slots --pipeline_slots" << std::endl;
+    std::cerr << "         --capture_width --capture_height --capture_fps --capture_frames --max_wait_us --stream_pending --explicit_batch" << std::endl;
+    std::cerr << "         --infer_workers --worker_sweep --tile --tile_overlap --tile_saliency_thresh --roi --roi_refresh" << std::endl;
+    std::cerr << "         --track --track_high_thresh --track_low_thresh --track_new_thresh --track_max_misses  // persistent target ids" << std::endl;
+    std::cerr << "         --ego_motion --ego_scale --ego_points --ego_model  // compensate camera motion in tracking" << std::endl;
+    std::cerr << "         --skip_static --max_skip --change_block_thresh --change_frac --cache_dir --cache_max_mb --cache_purge --write_output" << std::endl;
+    std::cerr << "         --telemetry [ring name] --telemetry_history --telemetry_max_extrap_ms --telemetry_max_gap_ms" << std::endl;
+    std::cerr << "         --camera_hfov_deg --camera_calib [yaml] --camera_tilt_deg --ground_alt --dem [grid] --geo_log [csv]  // locate detections with telemetry" << std::endl;
+    std::cerr << "         --dedup_log [csv] --dedup_sigma_m --dedup_sigma_deg --dedup_gate --dedup_max_sigma_m --dedup_cell_m --dedup_min_obs  // distinct ground targets" << std::endl;
     return -1;
   }
+  const PipelineConfig cfg = parsed_cfg;
+  print_pipeline_config(cfg);
+  cudaSetDevice(cfg.gpu_id);
 
   // Create a model using the API directly and serialize it to a file
   if (!wts_name.empty()) {
-    serialize_engine(kBatchSize, wts_name, sub_type, engine_name);
+    int input_w, input_h;
+    select_input_shape(stream_w, stream_h, input_w, input_h);
+    bool p6 = sub_type == "w6" || sub_type == "e6" || sub_type == "d6" || sub_type == "e6e";
+    if (p6 && cfg.explicit_batch) {
+      std::cerr << "explicit_batch is only supported for t/v7/x, P6 models need an implicit batch engine" << std::endl;
+      return -1;
+    }
+    int stride = p6 ? 64 : 32;
+    if (input_w % stride != 0 || input_h % stride != 0) {
+      std::cerr << "input shape " << input_w << "x" << input_h << " is not divisible by " << stride << std::endl;
+      return -1;
+    }
+    std::cout << "Input shape for " << stream_w << "x" << stream_h << " stream: " << input_w << "x" << input_h << std::endl;
+    serialize_engine(cfg.batch_size, wts_name, sub_type, engine_name, input_w, input_h, cfg.ignore_thresh, cfg.explicit_batch);
     return 0;
   }
 
-  // Deserialize the engine from file
-  IRuntime* runtime = nullptr;
-  ICudaEngine* engine = nullptr;
-  IExecutionContext* context = nullptr;
-  deserialize_engine(engine_name, &runtime, &engine, &context);
-  cudaStream_t stream;
-  CUDA_CHECK(cudaStreamCreate(&stream));
-
-  cuda_preprocess_init(kMaxInputImageSize);
+  // Deserialize the engine from file once; every worker gets its own
+  // execution context, streams and buffers on top of it. Mock workers share
+  // one emulated device the same way.
+  std::vector<Detector> detectors;
+  if (cfg.backend == "mock") {
+    std::shared_ptr<MockDevice> device(new MockDevice());
+    for (int w = 0; w < cfg.infer_workers; w++) {
+      detectors.emplace_back(std::unique_ptr<DetectorBackend>(new MockBackend(cfg.mock_input_w, cfg.mock_input_h, cfg.batch_size, cfg.mock_latency_us, std::vector<Detection>(), cfg.infer_slots, device)), cfg);
+    }
+  } else {
+    std::shared_ptr<TrtEngine> engine = load_trt_engine(engine_name);
+    for (int w = 0; w < cfg.infer_workers; w++) {
+      detectors.emplace_back(std::unique_ptr<DetectorBackend>(new TrtBackend(engine, cfg)), cfg);
+    }
+  }
+  Detector& detector = detectors[0];
 
-  // Prepare cpu and gpu buffers
-  float* device_buffers[2];
-  float* output_buffer_host = nullptr;
-  prepare_buffer(engine, &device_buffers[0], &device_buffers[1], &output_buffer_host);
+  if (!stream_sources.empty()) {
+    std::vector<std::string> names;
+    std::stringstream ss(stream_sources);
+    std::string name;
+    while (std::getline(ss, name, ',')) names.push_back(name);
+    return run_streams(detector, names, cfg);
+  }
 
-  // Read images from directory
+  bool live = !capture_source.empty();
+  std::unique_ptr<DetectionCache> cache;
+  if (!live && !cfg.cache_dir.empty()) {
+    // Results stay valid as long as the engine file and the preprocessing
+    // (input shape, output layout) are the same
+    uint64_t engine_hash = hash_bytes("mock", 4);
+    if (cfg.backend != "mock" && !hash_file(engine_name, engine_hash)) {
+      std::cerr << "read " << engine_name << " error!" << std::endl;
+      return -1;
+    }
+    const int preprocess[] = {detector.input_w(), detector.input_h(), kNumClass, kMaxNumOutputBbox, (int)sizeof(Detection)};
+    uint64_t config_hash = hash_bytes(preprocess, sizeof(preprocess));
+    if (cfg.cache_purge) {
+      std::cout << "purged " << DetectionCache::purge(cfg.cache_dir, engine_hash, config_hash) << " cache segments of other engines" << std::endl;
+    }
+    cache.reset(new DetectionCache(cfg.cache_dir, engine_hash, config_hash, (size_t)cfg.cache_max_mb << 20));
+  }
   std::vector<std::string> file_names;
-  if (read_files_in_dir(img_dir.c_str(), file_names) < 0) {
+  std::unique_ptr<LiveCapture> capture;
+  if (live) {
+    std::unique_ptr<FrameSource> source = open_source(capture_source, cfg);
+    if (!source) return -1;
+    capture.reset(new LiveCapture(std::move(source), cfg.capture_frames));
+  } else if (read_files_in_dir(img_dir.c_str(), file_names) < 0) {
+    // Read images from directory
     std::cerr << "read_files_in_dir failed." << std::endl;
     return -1;
   }
 
-  // batch predict
-  for (size_t i = 0; i < file_names.size(); i += kBatchSize) {
-    // Get a batch of images
-    std::vector<cv::Mat> img_batch;
-    std::vector<std::string> img_name_batch;
-    for (size_t j = i; j < i + kBatchSize && j < file_names.size(); j++) {
-      cv::Mat img = cv::imread(img_dir + "/" + file_names[j]);
-      img_batch.push_back(img);
-      img_name_batch.push_back(file_names[j]);
+  if (live) {
+    run_pipeline(detectors, 1, capture.get(), nullptr, file_names, img_dir, cfg);
+  } else if (cfg.worker_sweep) {
+    // Same recorded frames with 1..infer_workers execution contexts. Every
+    // run after the first would be served from the result cache, so the
+    // sweep always infers.
+    if (cache) std::cout << "worker_sweep measures inference, the result cache is off for it" << std::endl;
+    std::vector<double> fps;
+    for (int w = 1; w <= cfg.infer_workers; w++) {
+      std::cout << "---- " << w << " worker(s) ----" << std::endl;
+      fps.push_back(run_pipeline(detectors, w, nullptr, nullptr, file_names, img_dir, cfg));
     }
-
-    // Preprocess
-    cuda_batch_preprocess(img_batch, device_buffers[0], kInputW, kInputH, stream);
-
-    // Run inference
-    auto start = std::chrono::system_clock::now();
-    infer(*context, stream, (void**)device_buffers, output_buffer_host, kBatchSize);
-    auto end = std::chrono::system_clock::now();
-    std::cout << "inference time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
-
-    // NMS
-    std::vector<std::vector<Detection>> res_batch;
-    batch_nms(res_batch, output_buffer_host, img_batch.size(), kOutputSize, kConfThresh, kNmsThresh);
-
-    // Draw bounding boxes
-    draw_bbox(img_batch, res_batch);
-
-    // Save images
-    for (size_t j = 0; j < img_batch.size(); j++) {
-      cv::imwrite("_" + img_name_batch[j], img_batch[j]);
+    std::cout << "workers  fps      speedup  efficiency" << std::endl;
+    for (size_t i = 0; i < fps.size(); i++) {
+      double speedup = fps[0] > 0 ? fps[i] / fps[0] : 0.0;
+      printf("%-8d %-8.2f %-8.2f %.0f%%\n", (int)i + 1, fps[i], speedup, 100.0 * speedup / (i + 1));
     }
+  } else {
+    run_pipeline(detectors, cfg.infer_workers, nullptr, cache.get(), file_names, img_dir, cfg);
   }
 
-  // Release stream and buffers
-  cudaStreamDestroy(stream);
-  CUDA_CHECK(cudaFree(device_buffers[0]));
-  CUDA_CHECK(cudaFree(device_buffers[1]));
-  delete[] output_buffer_host;
-  cuda_preprocess_destroy();
-  // Destroy the engine
-  delete context;
-  delete engine;
-  delete runtime;
-
   // Print histogram of the output distribution
   //std::cout << "\nOutput:\n\n";
   //for (unsigned int i = 0; i < kOutputSize; i++)
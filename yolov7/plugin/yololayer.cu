@@ -1,6 +1,8 @@
 #include "yololayer.h"
 #include "cuda_utils.h"
+#include <algorithm>
 #include <assert.h>
+#include <cstring>
 #include <vector>
 #include <iostream>
 
@@ -18,12 +20,34 @@ void read(const char*& buffer, T& val) {
 }
 }  // namespace Tn
 
+float yolo_layer_ignore_thresh(const void* plan, size_t size, int net_w, int net_h) {
+  // The fields YoloLayerPlugin::serialize() writes first: kNumAnchor,
+  // sizeof(Detection), class count, then thread count, kernel count, net
+  // width and height, max output and ignore_thresh
+  const int prefix[] = {kNumAnchor, (int)sizeof(Detection), kNumClass};
+  const char* begin = static_cast<const char*>(plan);
+  const char* end = begin + size;
+  const size_t fields = 8 * sizeof(int) + sizeof(float);
+  for (const char* p = begin; ; p++) {
+    p = std::search(p, end, (const char*)prefix, (const char*)prefix + sizeof(prefix));
+    if ((size_t)(end - p) < fields) return -1.f;
+    int v[8];
+    float ignore_thresh;
+    memcpy(v, p, sizeof(v));
+    memcpy(&ignore_thresh, p + sizeof(v), sizeof(float));
+    if (v[3] <= 0 || v[4] <= 0 || v[4] > 8 || v[5] != net_w || v[6] != net_h || v[7] != kMaxNumOutputBbox) continue;
+    if ((size_t)(end - p) < fields + v[4] * sizeof(YoloKernel)) continue;
+    if (ignore_thresh >= 0.f && ignore_thresh <= 1.f) return ignore_thresh;
+  }
+}
+
 namespace nvinfer1 {
-YoloLayerPlugin::YoloLayerPlugin(int classCount, int netWidth, int netHeight, int maxOut, const std::vector<YoloKernel>& vYoloKernel) {
+YoloLayerPlugin::YoloLayerPlugin(int classCount, int netWidth, int netHeight, int maxOut, float ignoreThresh, const std::vector<YoloKernel>& vYoloKernel) {
   mClassCount = classCount;
   mYoloV7NetWidth = netWidth;
   mYoloV7NetHeight = netHeight;
   mMaxOutObject = maxOut;
+  mIgnoreThresh = ignoreThresh;
   mYoloKernel = vYoloKernel;
   mKernelCount = vYoloKernel.size();
 
@@ -46,12 +70,27 @@ YoloLayerPlugin::~YoloLayerPlugin() {
 YoloLayerPlugin::YoloLayerPlugin(const void* data, size_t length) {
   using namespace Tn;
   const char *d = reinterpret_cast<const char *>(data), *a = d;
+  // Architectural constants the host code was compiled with must match the engine
+  int numAnchor, detectionSize;
+  read(d, numAnchor);
+  read(d, detectionSize);
+  if (numAnchor != kNumAnchor || detectionSize != (int)sizeof(Detection)) {
+    std::cerr << "yololayer: engine was serialized with kNumAnchor=" << numAnchor << ", sizeof(Detection)=" << detectionSize
+              << " but this build has " << kNumAnchor << ", " << sizeof(Detection) << ", please re-serialize the engine" << std::endl;
+    assert(false);
+  }
   read(d, mClassCount);
   read(d, mThreadCount);
   read(d, mKernelCount);
   read(d, mYoloV7NetWidth);
   read(d, mYoloV7NetHeight);
   read(d, mMaxOutObject);
+  read(d, mIgnoreThresh);
+  if (mClassCount != kNumClass || mMaxOutObject != kMaxNumOutputBbox) {
+    std::cerr << "yololayer: engine was serialized with kNumClass=" << mClassCount << ", kMaxNumOutputBbox=" << mMaxOutObject
+              << " but this build has " << kNumClass << ", " << kMaxNumOutputBbox << ", please re-serialize the engine" << std::endl;
+    assert(false);
+  }
   mYoloKernel.resize(mKernelCount);
   auto kernelSize = mKernelCount * sizeof(YoloKernel);
   memcpy(mYoloKernel.data(), d, kernelSize);
@@ -69,12 +108,15 @@ YoloLayerPlugin::YoloLayerPlugin(const void* data, size_t length) {
 void YoloLayerPlugin::serialize(void* buffer) const TRT_NOEXCEPT {
   using namespace Tn;
   char* d = static_cast<char*>(buffer), *a = d;
+  write(d, (int)kNumAnchor);
+  write(d, (int)sizeof(Detection));
   write(d, mClassCount);
   write(d, mThreadCount);
   write(d, mKernelCount);
   write(d, mYoloV7NetWidth);
   write(d, mYoloV7NetHeight);
   write(d, mMaxOutObject);
+  write(d, mIgnoreThresh);
   auto kernelSize = mKernelCount * sizeof(YoloKernel);
   memcpy(d, mYoloKernel.data(), kernelSize);
   d += kernelSize;
@@ -83,7 +125,7 @@ void YoloLayerPlugin::serialize(void* buffer) const TRT_NOEXCEPT {
 }
 
 size_t YoloLayerPlugin::getSerializationSize() const TRT_NOEXCEPT {
-  return sizeof(mClassCount) + sizeof(mThreadCount) + sizeof(mKernelCount) + sizeof(YoloKernel) * mYoloKernel.size() + sizeof(mYoloV7NetWidth) + sizeof(mYoloV7NetHeight) + sizeof(mMaxOutObject);
+  return sizeof(int) * 2 + sizeof(mClassCount) + sizeof(mThreadCount) + sizeof(mKernelCount) + sizeof(YoloKernel) * mYoloKernel.size() + sizeof(mYoloV7NetWidth) + sizeof(mYoloV7NetHeight) + sizeof(mMaxOutObject) + sizeof(mIgnoreThresh);
 }
 
 int YoloLayerPlugin::initialize() TRT_NOEXCEPT {
@@ -142,7 +184,7 @@ void YoloLayerPlugin::destroy() TRT_NOEXCEPT {
 
 // Clone the plugin
 IPluginV2IOExt* YoloLayerPlugin::clone() const TRT_NOEXCEPT {
-  YoloLayerPlugin* p = new YoloLayerPlugin(mClassCount, mYoloV7NetWidth, mYoloV7NetHeight, mMaxOutObject, mYoloKernel);
+  YoloLayerPlugin* p = new YoloLayerPlugin(mClassCount, mYoloV7NetWidth, mYoloV7NetHeight, mMaxOutObject, mIgnoreThresh, mYoloKernel);
   p->setPluginNamespace(mPluginNamespace);
   return p;
 }
@@ -150,7 +192,7 @@ IPluginV2IOExt* YoloLayerPlugin::clone() const TRT_NOEXCEPT {
 __device__ float Logist(float data) { return 1.0f / (1.0f + expf(-data)); };
 
 __global__ void CalDetection(const float *input, float *output, int noElements,
-    const int netwidth, const int netheight, int maxoutobject, int yoloWidth, int yoloHeight, const float anchors[kNumAnchor * 2], int classes, int outputElem) {
+    const int netwidth, const int netheight, int maxoutobject, int yoloWidth, int yoloHeight, const float anchors[kNumAnchor * 2], int classes, int outputElem, float ignoreThresh) {
   int idx = threadIdx.x + blockDim.x * blockIdx.x;
   if (idx >= noElements) return;
 
@@ -162,7 +204,7 @@ __global__ void CalDetection(const float *input, float *output, int noElements,
 
   for (int k = 0; k < 3; k++) {
     float box_prob = Logist(curInput[idx + k * info_len_i * total_grid + 4 * total_grid]);
-    if (box_prob < kIgnoreThresh) continue;
+    if (box_prob < ignoreThresh) continue;
     int class_id = 0;
     float max_cls_prob = 0.0;
     for (int i = 5; i < info_len_i; ++i) {
@@ -216,7 +258,7 @@ void YoloLayerPlugin::forwardGpu(const float* const* inputs, float *output, cuda
     if (numElem < mThreadCount) mThreadCount = numElem;
 
     CalDetection<<<(numElem + mThreadCount - 1) / mThreadCount, mThreadCount, 0, stream>>>
-        (inputs[i], output, numElem, mYoloV7NetWidth, mYoloV7NetHeight, mMaxOutObject, yolo.width, yolo.height, (float*)mAnchor[i], mClassCount, outputElem);
+        (inputs[i], output, numElem, mYoloV7NetWidth, mYoloV7NetHeight, mMaxOutObject, yolo.width, yolo.height, (float*)mAnchor[i], mClassCount, outputElem, mIgnoreThresh);
   }
 }
 
@@ -246,8 +288,9 @@ const PluginFieldCollection* YoloPluginCreator::getFieldNames() TRT_NOEXCEPT {
   return &mFC;
 }
 
-IPluginV2IOExt* YoloPluginCreator::createPlugin(const char* name, const PluginFieldCollection* fc) TRT_NOEXCEPT {
-  assert(fc->nbFields == 2);
+// Shared by both creators, the dynamic plugin takes the same fields
+static YoloLayerPlugin* createYoloLayerPlugin(const PluginFieldCollection* fc) {
+  assert(fc->nbFields == 2 || fc->nbFields == 3);
   assert(strcmp(fc->fields[0].name, "netinfo") == 0);
   assert(strcmp(fc->fields[1].name, "kernels") == 0);
   int *p_netinfo = (int*)(fc->fields[0].data);
@@ -255,9 +298,18 @@ IPluginV2IOExt* YoloPluginCreator::createPlugin(const char* name, const PluginFi
   int input_w = p_netinfo[1];
   int input_h = p_netinfo[2];
   int max_output_object_count = p_netinfo[3];
+  float ignore_thresh = kIgnoreThresh;
+  if (fc->nbFields == 3) {
+    assert(strcmp(fc->fields[2].name, "ignore_thresh") == 0);
+    ignore_thresh = *(const float*)(fc->fields[2].data);
+  }
   std::vector<YoloKernel> kernels(fc->fields[1].length);
   memcpy(&kernels[0], fc->fields[1].data, kernels.size() * sizeof(YoloKernel));
-  YoloLayerPlugin* obj = new YoloLayerPlugin(class_count, input_w, input_h, max_output_object_count, kernels);
+  return new YoloLayerPlugin(class_count, input_w, input_h, max_output_object_count, ignore_thresh, kernels);
+}
+
+IPluginV2IOExt* YoloPluginCreator::createPlugin(const char* name, const PluginFieldCollection* fc) TRT_NOEXCEPT {
+  YoloLayerPlugin* obj = createYoloLayerPlugin(fc);
   obj->setPluginNamespace(mNamespace.c_str());
   return obj;
 }
@@ -269,5 +321,103 @@ IPluginV2IOExt* YoloPluginCreator::deserializePlugin(const char* name, const voi
   obj->setPluginNamespace(mNamespace.c_str());
   return obj;
 }
+
+YoloLayerDynamicPlugin::YoloLayerDynamicPlugin(YoloLayerPlugin* impl) : mImpl(impl), mPluginNamespace("") {
+  assert(mImpl);
+}
+
+YoloLayerDynamicPlugin::~YoloLayerDynamicPlugin() {
+  mImpl->destroy();
+}
+
+DimsExprs YoloLayerDynamicPlugin::getOutputDimensions(int outputIndex, const DimsExprs* inputs, int nbInputs, IExprBuilder& exprBuilder) TRT_NOEXCEPT {
+  // Same per-image layout as the implicit batch plugin, with the batch in front
+  int totalsize = kMaxNumOutputBbox * sizeof(Detection) / sizeof(float);
+  DimsExprs out;
+  out.nbDims = 4;
+  out.d[0] = inputs[0].d[0];
+  out.d[1] = exprBuilder.constant(totalsize + 1);
+  out.d[2] = exprBuilder.constant(1);
+  out.d[3] = exprBuilder.constant(1);
+  return out;
+}
+
+int YoloLayerDynamicPlugin::initialize() TRT_NOEXCEPT {
+  return mImpl->initialize();
+}
+
+int YoloLayerDynamicPlugin::enqueue(const PluginTensorDesc* inputDesc, const PluginTensorDesc* outputDesc, const void* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream) TRT_NOEXCEPT {
+  return mImpl->enqueue(inputDesc[0].dims.d[0], inputs, outputs, workspace, stream);
+}
+
+size_t YoloLayerDynamicPlugin::getSerializationSize() const TRT_NOEXCEPT {
+  return mImpl->getSerializationSize();
+}
+
+void YoloLayerDynamicPlugin::serialize(void* buffer) const TRT_NOEXCEPT {
+  mImpl->serialize(buffer);
+}
+
+const char* YoloLayerDynamicPlugin::getPluginType() const TRT_NOEXCEPT {
+  return "YoloLayerDynamic_TRT";
+}
+
+const char* YoloLayerDynamicPlugin::getPluginVersion() const TRT_NOEXCEPT {
+  return "1";
+}
+
+void YoloLayerDynamicPlugin::destroy() TRT_NOEXCEPT {
+  delete this;
+}
+
+IPluginV2DynamicExt* YoloLayerDynamicPlugin::clone() const TRT_NOEXCEPT {
+  YoloLayerDynamicPlugin* p = new YoloLayerDynamicPlugin(static_cast<YoloLayerPlugin*>(mImpl->clone()));
+  p->setPluginNamespace(mPluginNamespace);
+  return p;
+}
+
+void YoloLayerDynamicPlugin::setPluginNamespace(const char* pluginNamespace) TRT_NOEXCEPT {
+  mPluginNamespace = pluginNamespace;
+  mImpl->setPluginNamespace(pluginNamespace);
+}
+
+const char* YoloLayerDynamicPlugin::getPluginNamespace() const TRT_NOEXCEPT {
+  return mPluginNamespace;
+}
+
+DataType YoloLayerDynamicPlugin::getOutputDataType(int index, const nvinfer1::DataType* inputTypes, int nbInputs) const TRT_NOEXCEPT {
+  return DataType::kFLOAT;
+}
+
+PluginFieldCollection YoloDynamicPluginCreator::mFC{};
+
+YoloDynamicPluginCreator::YoloDynamicPluginCreator() {
+  mFC.nbFields = 0;
+  mFC.fields = nullptr;
+}
+
+const char* YoloDynamicPluginCreator::getPluginName() const TRT_NOEXCEPT {
+  return "YoloLayerDynamic_TRT";
+}
+
+const char* YoloDynamicPluginCreator::getPluginVersion() const TRT_NOEXCEPT {
+  return "1";
+}
+
+const PluginFieldCollection* YoloDynamicPluginCreator::getFieldNames() TRT_NOEXCEPT {
+  return &mFC;
+}
+
+IPluginV2DynamicExt* YoloDynamicPluginCreator::createPlugin(const char* name, const PluginFieldCollection* fc) TRT_NOEXCEPT {
+  YoloLayerDynamicPlugin* obj = new YoloLayerDynamicPlugin(createYoloLayerPlugin(fc));
+  obj->setPluginNamespace(mNamespace.c_str());
+  return obj;
+}
+
+IPluginV2DynamicExt* YoloDynamicPluginCreator::deserializePlugin(const char* name, const void* serialData, size_t serialLength) TRT_NOEXCEPT {
+  YoloLayerDynamicPlugin* obj = new YoloLayerDynamicPlugin(new YoloLayerPlugin(serialData, serialLength));
+  obj->setPluginNamespace(mNamespace.c_str());
+  return obj;
+}
 }  // namespace nvinfer1
 
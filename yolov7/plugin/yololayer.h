@@ -8,7 +8,7 @@
 namespace nvinfer1 {
 class API YoloLayerPlugin : public IPluginV2IOExt {
  public:
-  YoloLayerPlugin(int classCount, int netWidth, int netHeight, int maxOut, const std::vector<YoloKernel>& vYoloKernel);
+  YoloLayerPlugin(int classCount, int netWidth, int netHeight, int maxOut, float ignoreThresh, const std::vector<YoloKernel>& vYoloKernel);
   YoloLayerPlugin(const void* data, size_t length);
   ~YoloLayerPlugin();
 
@@ -68,6 +68,7 @@ class API YoloLayerPlugin : public IPluginV2IOExt {
   int mYoloV7NetWidth;
   int mYoloV7NetHeight;
   int mMaxOutObject;
+  float mIgnoreThresh;
   std::vector<YoloKernel> mYoloKernel;
   void** mAnchor;
 };
@@ -102,5 +103,92 @@ class API YoloPluginCreator : public IPluginCreator {
   static std::vector<PluginField> mPluginAttributes;
 };
 REGISTER_TENSORRT_PLUGIN(YoloPluginCreator);
+
+// Same layer for explicit batch networks (optimization profiles), which only
+// accept IPluginV2DynamicExt plugins. The batch size comes from the input
+// descriptors at enqueue time; all the work is delegated to a
+// YoloLayerPlugin, so both engines share parameters, serialization and kernel.
+class API YoloLayerDynamicPlugin : public IPluginV2DynamicExt {
+ public:
+  explicit YoloLayerDynamicPlugin(YoloLayerPlugin* impl);
+  ~YoloLayerDynamicPlugin();
+
+  int getNbOutputs() const TRT_NOEXCEPT override {
+    return 1;
+  }
+
+  DimsExprs getOutputDimensions(int outputIndex, const DimsExprs* inputs, int nbInputs, IExprBuilder& exprBuilder) TRT_NOEXCEPT override;
+
+  int initialize() TRT_NOEXCEPT override;
+
+  void terminate() TRT_NOEXCEPT override {}
+
+  size_t getWorkspaceSize(const PluginTensorDesc* inputs, int nbInputs, const PluginTensorDesc* outputs, int nbOutputs) const TRT_NOEXCEPT override { return 0; }
+
+  int enqueue(const PluginTensorDesc* inputDesc, const PluginTensorDesc* outputDesc, const void* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream) TRT_NOEXCEPT override;
+
+  size_t getSerializationSize() const TRT_NOEXCEPT override;
+
+  void serialize(void* buffer) const TRT_NOEXCEPT override;
+
+  bool supportsFormatCombination(int pos, const PluginTensorDesc* inOut, int nbInputs, int nbOutputs) TRT_NOEXCEPT override {
+    return inOut[pos].format == TensorFormat::kLINEAR && inOut[pos].type == DataType::kFLOAT;
+  }
+
+  const char* getPluginType() const TRT_NOEXCEPT override;
+
+  const char* getPluginVersion() const TRT_NOEXCEPT override;
+
+  void destroy() TRT_NOEXCEPT override;
+
+  IPluginV2DynamicExt* clone() const TRT_NOEXCEPT override;
+
+  void setPluginNamespace(const char* pluginNamespace) TRT_NOEXCEPT override;
+
+  const char* getPluginNamespace() const TRT_NOEXCEPT override;
+
+  DataType getOutputDataType(int index, const nvinfer1::DataType* inputTypes, int nbInputs) const TRT_NOEXCEPT override;
+
+  void configurePlugin(const DynamicPluginTensorDesc* in, int nbInputs, const DynamicPluginTensorDesc* out, int nbOutputs) TRT_NOEXCEPT override {}
+
+ private:
+  YoloLayerPlugin* mImpl;
+  const char* mPluginNamespace;
+};
+
+class API YoloDynamicPluginCreator : public IPluginCreator {
+ public:
+  YoloDynamicPluginCreator();
+
+  ~YoloDynamicPluginCreator() override = default;
+
+  const char* getPluginName() const TRT_NOEXCEPT override;
+
+  const char* getPluginVersion() const TRT_NOEXCEPT override;
+
+  const PluginFieldCollection* getFieldNames() TRT_NOEXCEPT override;
+
+  IPluginV2DynamicExt* createPlugin(const char* name, const PluginFieldCollection* fc) TRT_NOEXCEPT override;
+
+  IPluginV2DynamicExt* deserializePlugin(const char* name, const void* serialData, size_t serialLength) TRT_NOEXCEPT override;
+
+  void setPluginNamespace(const char* libNamespace) TRT_NOEXCEPT override {
+    mNamespace = libNamespace;
+  }
+
+  const char* getPluginNamespace() const TRT_NOEXCEPT override {
+    return mNamespace.c_str();
+  }
+
+ private:
+  std::string mNamespace;
+  static PluginFieldCollection mFC;
+};
+REGISTER_TENSORRT_PLUGIN(YoloDynamicPluginCreator);
 }  // namespace nvinfer1
 
+// ignore_thresh the YoloLayer of a serialized engine (plan, size bytes)
+// with a net_w x net_h input was built with, found by the plugin fields
+// stored in the plan; -1 if there is none
+extern "C" API float yolo_layer_ignore_thresh(const void* plan, size_t size, int net_w, int net_h);
+
@@ -0,0 +1,121 @@
+'''
+Per-frame latency of yoloDet.py's YoloTRT (yolov7_trt module) against the
+pycuda version in yoloDet_pycuda.py, both around the same simulated engine,
+so the difference is the host side: preprocess, copies, postprocess/NMS.
+
+  cd yolov7/build && python3 ../python/bench_detector.py --frames 300 --latency_us 10000
+
+Without CUDA/TensorRT, build just the module first (backend="mock" only):
+
+  cmake .. -DMOCK_ONLY=ON -Dpybind11_DIR=$(python3 -m pybind11 --cmakedir) && make
+
+The pycuda class runs its own PreProcessImg/PostProcess with a sleep in place
+of execute_async and no tensorrt/pycuda installed; the module runs with
+backend="mock" (CPU letterbox, same sleep, C++ NMS). Without a built
+yolov7_trt module only the pycuda class is timed and the script exits 1,
+so a missing comparison can't pass for a measured one.
+'''
+import argparse
+import os
+import sys
+import time
+import types
+import numpy as np
+
+root = os.path.abspath(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", ".."))
+sys.path.insert(0, root)
+
+
+def stub_gpu_modules():
+    trt = types.ModuleType("tensorrt")
+    trt.NetworkDefinitionCreationFlag = types.SimpleNamespace(EXPLICIT_BATCH=0)
+    pycuda = types.ModuleType("pycuda")
+    pycuda.autoinit = types.ModuleType("pycuda.autoinit")
+    pycuda.driver = types.ModuleType("pycuda.driver")
+    sys.modules.update({"tensorrt": trt, "pycuda": pycuda, "pycuda.autoinit": pycuda.autoinit,
+                        "pycuda.driver": pycuda.driver})
+
+
+def canned_output(dets, max_boxes=1000):
+    out = np.zeros(1 + max_boxes * 6, dtype=np.float32)
+    out[0] = len(dets)
+    for i, d in enumerate(dets):
+        out[1 + i * 6:1 + (i + 1) * 6] = d
+    return out
+
+
+def pycuda_class_frame(model, frame, output, latency_s):
+    input_image, image_raw, origin_h, origin_w = model.PreProcessImg(frame)
+    host_input = np.empty(input_image.size, dtype=np.float32)
+    np.copyto(host_input, input_image.ravel())
+    time.sleep(latency_s)
+    return model.PostProcess(output, origin_h, origin_w)
+
+
+def summary(name, times):
+    ms = np.array(times) * 1000.0
+    return "{:<14} mean {:7.2f}ms  p50 {:7.2f}ms  p99 {:7.2f}ms".format(
+        name, ms.mean(), np.percentile(ms, 50), np.percentile(ms, 99))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--frames", type=int, default=300)
+    parser.add_argument("--width", type=int, default=1280)
+    parser.add_argument("--height", type=int, default=720)
+    parser.add_argument("--latency_us", type=int, default=10000)
+    parser.add_argument("--boxes", type=int, default=50, help="candidates in the canned engine output")
+    args = parser.parse_args()
+
+    rng = np.random.RandomState(0)
+    frame = rng.randint(0, 256, (args.height, args.width, 3), dtype=np.uint8)
+    # cx, cy, w, h, conf, class in network input coordinates
+    dets = [(rng.uniform(40, 600), rng.uniform(40, 600), rng.uniform(10, 60), rng.uniform(10, 60),
+             rng.uniform(0.3, 1.0), 0) for _ in range(args.boxes)]
+
+    stub_gpu_modules()
+    from yoloDet_pycuda import YoloTRT as PycudaYolo
+    try:
+        from yoloDet import YoloTRT
+    except ImportError as e:
+        print("yolov7_trt not importable ({}), timing the pycuda class only".format(e))
+        YoloTRT = None
+
+    legacy = PycudaYolo.__new__(PycudaYolo)
+    legacy.CONF_THRESH = 0.5
+    legacy.IOU_THRESHOLD = 0.4
+    legacy.yolo_version = "v7"
+    legacy.categories = ["car"]
+    # kInputW x kInputH unless the module says otherwise
+    legacy.input_w, legacy.input_h = 640, 640
+    model = None
+    if YoloTRT is not None:
+        model = YoloTRT(library=None, engine="", conf=0.5, yolo_ver="v7", backend="mock",
+                        mock_latency_us=args.latency_us, mock_dets=dets)
+        legacy.input_w = model.input_w
+        legacy.input_h = model.input_h
+    output = canned_output(dets)
+
+    legacy_times, module_times = [], []
+    res = []
+    for i in range(args.frames):
+        t0 = time.perf_counter()
+        boxes, scores, classid = pycuda_class_frame(legacy, frame, output, args.latency_us / 1e6)
+        t1 = time.perf_counter()
+        if model is not None:
+            res = model.Detect(frame)
+        t2 = time.perf_counter()
+        legacy_times.append(t1 - t0)
+        module_times.append(t2 - t1)
+    print("{} frames {}x{}, {} candidates, engine {}us".format(args.frames, args.width, args.height, args.boxes, args.latency_us))
+    print(summary("pycuda class", legacy_times))
+    if model is None:
+        print("yolov7_trt     not measured")
+        return 1
+    print(summary("yolov7_trt", module_times))
+    print("detections: pycuda class {}, yolov7_trt {}".format(len(boxes), len(res)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
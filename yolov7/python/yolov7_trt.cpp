@@ -0,0 +1,262 @@
+// Python bindings of the C++ Detector for yoloDet.py / app.py:
+//
+//   import yolov7_trt
+//   det = yolov7_trt.Detector("yolov7/build/bestV2.engine", conf_thresh=0.5)
+//   dets = det.detect(frame)   # HxWx3 uint8 BGR numpy array
+//   dets["x1"], dets["conf"], dets["class_id"], ...
+//   x, y = yolov7_trt.wgs84_to_twd97(lat, lon)   # floats or arrays
+//   yolov7_trt.TelemetryWriter().write(lat, lon, alt=..., yaw=...)
+//   rec = yolov7_trt.TelemetryReader().latest()  # dict or None
+//
+// Each instance owns its backend, i.e. one execution context, its streams
+// and device buffers, created once. Frames are read in place through the
+// buffer protocol (slices of a larger frame work too) and the GIL is
+// released while the engine runs.
+//
+// Built with MOCK_ONLY (cmake -DMOCK_ONLY=ON) the module has no CUDA or
+// TensorRT code and only backend="mock" works, for bench_detector.py on a
+// machine without a GPU.
+#include "backend.h"
+#include "config.h"
+#include "detector.h"
+#include "pipeline_config.h"
+#include "telemetry.h"
+#include "tiling.h"
+#include "twd97.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#ifndef MOCK_ONLY
+#include "cuda_utils.h"
+#endif
+
+namespace py = pybind11;
+
+// Frame coordinates, clipped to the image like the old numpy postprocess
+struct PyDetection {
+  float x1, y1, x2, y2;
+  float conf;
+  int32_t class_id;
+};
+
+// Borrow the numpy array's memory as a cv::Mat, no copy
+static cv::Mat wrap_bgr(const py::array& frame) {
+  py::buffer_info info = frame.request();
+  if (info.ndim != 3 || info.shape[2] != 3 || info.format != py::format_descriptor<uint8_t>::format()) {
+    throw py::value_error("expected an HxWx3 uint8 BGR image");
+  }
+  if (info.strides[2] != 1 || info.strides[1] != 3 || info.strides[0] < info.shape[1] * 3) {
+    throw py::value_error("pixels must be packed BGR, rows may be strided");
+  }
+  return cv::Mat((int)info.shape[0], (int)info.shape[1], CV_8UC3, info.ptr, (size_t)info.strides[0]);
+}
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> DoubleArray;
+
+// Scalars in, floats out; arrays of any shape in, arrays of that shape out
+static py::tuple convert_tm2(const DoubleArray& a, const DoubleArray& b, bool forward) {
+  if (a.ndim() != b.ndim() || !std::equal(a.shape(), a.shape() + a.ndim(), b.shape())) {
+    throw py::value_error("coordinates must have the same shape");
+  }
+  std::vector<py::ssize_t> shape(a.shape(), a.shape() + a.ndim());
+  py::array_t<double> u(shape), v(shape);
+  const double* pa = a.data();
+  const double* pb = b.data();
+  double* pu = u.mutable_data();
+  double* pv = v.mutable_data();
+  size_t n = a.size();
+  {
+    py::gil_scoped_release release;
+    if (forward) {
+      wgs84_to_twd97(pa, pb, n, pu, pv);
+    } else {
+      twd97_to_wgs84(pa, pb, n, pu, pv);
+    }
+  }
+  if (a.ndim() == 0) return py::make_tuple(pu[0], pv[0]);
+  return py::make_tuple(u, v);
+}
+
+class PyDetector {
+ public:
+  PyDetector(const std::string& engine, float conf_thresh, float nms_thresh, const std::string& backend,
+             int mock_latency_us, const std::vector<std::array<float, 6>>& mock_dets, const std::string& config) {
+    if (!config.empty() && !load_pipeline_config(config, cfg_)) throw py::value_error("invalid config " + config);
+    if (conf_thresh >= 0.f) cfg_.conf_thresh = conf_thresh;
+    if (nms_thresh >= 0.f) cfg_.nms_thresh = nms_thresh;
+    if (!backend.empty()) cfg_.backend = backend;
+    if (mock_latency_us >= 0) cfg_.mock_latency_us = mock_latency_us;
+
+    if (cfg_.backend == "mock") {
+      // Canned detections in network input coordinates: cx, cy, w, h, conf, class
+      std::vector<Detection> dets;
+      for (const auto& d : mock_dets) {
+        Detection det;
+        std::copy(d.begin(), d.begin() + 4, det.bbox);
+        det.conf = d[4];
+        det.class_id = d[5];
+        dets.push_back(det);
+      }
+      detector_.reset(new Detector(std::unique_ptr<DetectorBackend>(new MockBackend(cfg_.mock_input_w, cfg_.mock_input_h, cfg_.batch_size, cfg_.mock_latency_us, dets, cfg_.infer_slots)), cfg_));
+    } else {
+#ifdef MOCK_ONLY
+      throw py::value_error("module built with MOCK_ONLY, only backend='mock' is available");
+#else
+      CUDA_CHECK(cudaSetDevice(cfg_.gpu_id));
+      detector_.reset(new Detector(engine, cfg_));
+#endif
+    }
+  }
+
+  py::array_t<PyDetection> detect(const py::array& frame) {
+    std::vector<cv::Mat> img_batch(1, wrap_bgr(frame));
+    std::vector<std::vector<Detection>> res_batch;
+    {
+      py::gil_scoped_release release;
+      res_batch = detector_->detect(img_batch);
+    }
+    return to_numpy(img_batch[0], res_batch[0]);
+  }
+
+  // Several frames through the engine as batches of up to batch_size
+  py::list detect_batch(const std::vector<py::array>& frames) {
+    std::vector<cv::Mat> img_batch;
+    for (const py::array& frame : frames) img_batch.push_back(wrap_bgr(frame));
+    std::vector<std::vector<Detection>> res_batch;
+    {
+      py::gil_scoped_release release;
+      res_batch = detector_->detect(img_batch);
+    }
+    py::list out;
+    for (size_t i = 0; i < img_batch.size(); i++) out.append(to_numpy(img_batch[i], res_batch[i]));
+    return out;
+  }
+
+  int input_w() const { return detector_->input_w(); }
+  int input_h() const { return detector_->input_h(); }
+  int batch_size() const { return detector_->max_batch_size(); }
+  float conf_thresh() const { return cfg_.conf_thresh; }
+  float nms_thresh() const { return cfg_.nms_thresh; }
+
+ private:
+  py::array_t<PyDetection> to_numpy(const cv::Mat& img, std::vector<Detection>& dets) {
+    tile_to_frame(dets, cv::Rect(0, 0, img.cols, img.rows), detector_->input_w(), detector_->input_h());
+    py::array_t<PyDetection> out(dets.size());
+    PyDetection* p = out.mutable_data();
+    for (size_t i = 0; i < dets.size(); i++) {
+      const Detection& d = dets[i];
+      p[i].x1 = std::min(std::max(d.bbox[0] - d.bbox[2] / 2.f, 0.f), img.cols - 1.f);
+      p[i].y1 = std::min(std::max(d.bbox[1] - d.bbox[3] / 2.f, 0.f), img.rows - 1.f);
+      p[i].x2 = std::min(std::max(d.bbox[0] + d.bbox[2] / 2.f, 0.f), img.cols - 1.f);
+      p[i].y2 = std::min(std::max(d.bbox[1] + d.bbox[3] / 2.f, 0.f), img.rows - 1.f);
+      p[i].conf = d.conf;
+      p[i].class_id = (int32_t)d.class_id;
+    }
+    return out;
+  }
+
+  PipelineConfig cfg_;
+  std::unique_ptr<Detector> detector_;
+};
+
+static py::object record_dict(bool ok, const TelemetryRecord& rec) {
+  if (!ok) return py::none();
+  py::dict d;
+  d["t_ns"] = rec.t_ns;
+  d["lat"] = rec.lat;
+  d["lon"] = rec.lon;
+  d["alt"] = rec.alt;
+  d["roll"] = rec.roll;
+  d["pitch"] = rec.pitch;
+  d["yaw"] = rec.yaw;
+  d["fix"] = rec.fix;
+  return d;
+}
+
+// The ring is mapped on first use, so a reader can be created before the
+// GPS process has started; until then every read returns None
+class PyTelemetryReader {
+ public:
+  explicit PyTelemetryReader(const std::string& name) : name_(name) {}
+
+  bool open() { return reader_.is_open() || reader_.open(name_); }
+  uint64_t head() { return open() ? reader_.head() : 0; }
+  py::object read(uint64_t index) {
+    TelemetryRecord rec;
+    bool ok = open() && reader_.read(index, rec);
+    return record_dict(ok, rec);
+  }
+  py::object latest() {
+    TelemetryRecord rec;
+    bool ok = open() && reader_.latest(rec);
+    return record_dict(ok, rec);
+  }
+  py::object at(int64_t t_ns) {
+    TelemetryRecord rec;
+    bool ok = open() && reader_.at(t_ns, rec);
+    return record_dict(ok, rec);
+  }
+
+ private:
+  std::string name_;
+  TelemetryReader reader_;
+};
+
+static void write_telemetry(TelemetryWriter& writer, double lat, double lon, float alt, float roll, float pitch,
+                            float yaw, uint32_t fix, const py::object& t_ns) {
+  TelemetryRecord rec = {};
+  rec.t_ns = t_ns.is_none() ? telemetry_now_ns() : t_ns.cast<int64_t>();
+  rec.lat = lat;
+  rec.lon = lon;
+  rec.alt = alt;
+  rec.roll = roll;
+  rec.pitch = pitch;
+  rec.yaw = yaw;
+  rec.fix = fix;
+  writer.write(rec);
+}
+
+PYBIND11_MODULE(yolov7_trt, m) {
+  m.doc() = "YOLOv7 TensorRT detector";
+  PYBIND11_NUMPY_DTYPE(PyDetection, x1, y1, x2, y2, conf, class_id);
+
+  py::class_<PyDetector>(m, "Detector")
+      .def(py::init<const std::string&, float, float, const std::string&, int, const std::vector<std::array<float, 6>>&, const std::string&>(),
+           py::arg("engine"), py::arg("conf_thresh") = -1.f, py::arg("nms_thresh") = -1.f, py::arg("backend") = "",
+           py::arg("mock_latency_us") = -1, py::arg("mock_dets") = std::vector<std::array<float, 6>>(), py::arg("config") = "",
+           "Load engine (ignored for backend='mock'). Thresholds < 0 keep the config file's or built-in defaults.")
+      .def("detect", &PyDetector::detect, py::arg("frame"),
+           "Detections of one BGR frame as a structured array (x1, y1, x2, y2, conf, class_id)")
+      .def("detect_batch", &PyDetector::detect_batch, py::arg("frames"))
+      .def_property_readonly("input_w", &PyDetector::input_w)
+      .def_property_readonly("input_h", &PyDetector::input_h)
+      .def_property_readonly("batch_size", &PyDetector::batch_size)
+      .def_property_readonly("conf_thresh", &PyDetector::conf_thresh)
+      .def_property_readonly("nms_thresh", &PyDetector::nms_thresh);
+
+  m.def("wgs84_to_twd97", [](const DoubleArray& lat, const DoubleArray& lon) { return convert_tm2(lat, lon, true); },
+        py::arg("lat"), py::arg("lon"), "WGS84 degrees to TWD97 TM2 zone 121 (x easting, y northing) in metres");
+  m.def("twd97_to_wgs84", [](const DoubleArray& x, const DoubleArray& y) { return convert_tm2(x, y, false); },
+        py::arg("x"), py::arg("y"), "TWD97 TM2 zone 121 metres to WGS84 (lat, lon) degrees");
+
+  // The C++ ring itself: its seqlock uses atomics and fences, which plain
+  // mmap writes from Python can't give on aarch64
+  m.def("telemetry_now_ns", &telemetry_now_ns, "CLOCK_MONOTONIC nanoseconds, the clock of t_ns");
+  py::class_<TelemetryWriter>(m, "TelemetryWriter")
+      .def(py::init<const std::string&, uint32_t>(), py::arg("name") = "yolov7_telemetry", py::arg("capacity") = 256,
+           "Create (or take over) the ring /dev/shm/<name>, capacity records deep")
+      .def("write", &write_telemetry, py::arg("lat"), py::arg("lon"), py::arg("alt") = 0.f, py::arg("roll") = 0.f,
+           py::arg("pitch") = 0.f, py::arg("yaw") = 0.f, py::arg("fix") = 3, py::arg("t_ns") = py::none(),
+           "Append a record, t_ns defaults to now")
+      .def_property_readonly("written", &TelemetryWriter::written);
+  py::class_<PyTelemetryReader>(m, "TelemetryReader")
+      .def(py::init<const std::string&>(), py::arg("name") = "yolov7_telemetry")
+      .def("open", &PyTelemetryReader::open, "Map the ring, False while no writer has created it yet")
+      .def("head", &PyTelemetryReader::head, "Records written so far")
+      .def("read", &PyTelemetryReader::read, py::arg("index"), "Record number index, None if not written yet or overwritten")
+      .def("latest", &PyTelemetryReader::latest, "Newest record as a dict, None if there is none")
+      .def("at", &PyTelemetryReader::at, py::arg("t_ns"), "Newest record with t_ns <= t_ns, None if all are newer");
+}
@@ -0,0 +1,74 @@
+#include "backend.h"
+#include "utils.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <thread>
+
+static double ms_since(const std::chrono::steady_clock::time_point& t) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+MockBackend::MockBackend(int input_w, int input_h, int max_batch_size, int latency_us, const std::vector<Detection>& dets, int num_slots,
+                         std::shared_ptr<MockDevice> device)
+    : input_w_(input_w),
+      input_h_(input_h),
+      max_batch_size_(max_batch_size),
+      latency_us_(latency_us),
+      dets_(dets),
+      ring_(num_slots),
+      device_(device ? device : std::make_shared<MockDevice>()) {
+  assert((int)dets_.size() <= kMaxNumOutputBbox);
+  for (int i = 0; i < ring_.size(); i++) {
+    ring_.at(i).input.resize(max_batch_size * 3 * input_w * input_h);
+    ring_.at(i).output.resize(max_batch_size * kOutputSize);
+  }
+}
+
+void MockBackend::submit(std::vector<cv::Mat>& img_batch) {
+  assert((int)img_batch.size() <= max_batch_size_);
+  Slot& slot = ring_.acquire();
+  auto start = std::chrono::steady_clock::now();
+
+  // Same letterbox + bgr2rgb + hwc2chw + /255 as warpaffine_kernel
+  int area = input_w_ * input_h_;
+  for (size_t b = 0; b < img_batch.size(); b++) {
+    cv::Mat pr_img = preprocess_img(img_batch[b], input_w_, input_h_);
+    float* dst = &slot.input[b * 3 * area];
+    for (int i = 0; i < area; i++) {
+      const uint8_t* px = pr_img.data + i * 3;
+      dst[i] = px[2] / 255.0f;
+      dst[i + area] = px[1] / 255.0f;
+      dst[i + 2 * area] = px[0] / 255.0f;
+    }
+  }
+  for (size_t b = 0; b < img_batch.size(); b++) {
+    float* out = &slot.output[b * kOutputSize];
+    out[0] = (float)dets_.size();
+    if (!dets_.empty()) memcpy(&out[1], dets_.data(), dets_.size() * sizeof(Detection));
+  }
+  slot.batch = img_batch.size();
+
+  // The emulated device runs one batch at a time, in submission order
+  {
+    std::lock_guard<std::mutex> lock(device_->mutex);
+    auto now = std::chrono::steady_clock::now();
+    device_->free = std::max(device_->free, now) + std::chrono::microseconds(latency_us_);
+    slot.ready = device_->free;
+  }
+  stats_.submit_ms += ms_since(start);
+  ring_.commit();
+}
+
+int MockBackend::collect(float* output) {
+  Slot& slot = ring_.front();
+  auto start = std::chrono::steady_clock::now();
+  std::this_thread::sleep_until(slot.ready);
+  stats_.wait_ms += ms_since(start);
+  stats_.device_ms += latency_us_ / 1000.0;
+  stats_.batches++;
+  int batch = slot.batch;
+  memcpy(output, slot.output.data(), batch * kOutputSize * sizeof(float));
+  ring_.release();
+  return batch;
+}
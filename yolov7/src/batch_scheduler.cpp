@@ -0,0 +1,159 @@
+#include "batch_scheduler.h"
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+
+static double ms_between(const std::chrono::steady_clock::time_point& a, const std::chrono::steady_clock::time_point& b) {
+  return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+double BatchSchedulerStats::mean_fill() const {
+  int max_batch = (int)fill.size() - 1;
+  return batches && max_batch > 0 ? (double)frames / (batches * max_batch) : 0.0;
+}
+
+BatchScheduler::BatchScheduler(Detector& detector, int num_streams, const BatchPolicy& policy, int max_pending, ResultFn on_result)
+    : detector_(detector),
+      num_streams_(num_streams),
+      policy_(policy),
+      max_pending_(max_pending),
+      on_result_(on_result),
+      pending_per_stream_(num_streams, 0),
+      next_seq_(num_streams, 0),
+      in_flight_(detector.config().infer_slots) {
+  assert(num_streams > 0 && max_pending > 0);
+  assert(policy.max_batch > 0 && policy.max_batch <= detector.max_batch_size());
+  stats_.fill.assign(policy.max_batch + 1, 0);
+  stats_.stream_frames.assign(num_streams, 0);
+}
+
+BatchScheduler::~BatchScheduler() {
+  stop();
+}
+
+void BatchScheduler::start() {
+  assert(!dispatcher_.joinable());
+  dispatcher_ = std::thread(&BatchScheduler::dispatch_loop, this);
+  collector_ = std::thread(&BatchScheduler::collect_loop, this);
+}
+
+bool BatchScheduler::push(int stream, const cv::Mat& img, std::chrono::steady_clock::time_point captured) {
+  assert(stream >= 0 && stream < num_streams_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_) return false;
+  if (pending_per_stream_[stream] >= max_pending_) {
+    // Latest frame wins, drop this stream's oldest pending frame
+    for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+      if (it->stream == stream) {
+        pending_.erase(it);
+        break;
+      }
+    }
+    pending_per_stream_[stream]--;
+    stats_.dropped++;
+  }
+  StreamFrame frame;
+  frame.stream = stream;
+  frame.seq = next_seq_[stream]++;
+  frame.img = img;
+  frame.captured = captured;
+  frame.enqueued = std::chrono::steady_clock::now();
+  pending_.push_back(frame);
+  pending_per_stream_[stream]++;
+  arrived_.notify_one();
+  return true;
+}
+
+void BatchScheduler::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    arrived_.notify_all();
+  }
+  if (dispatcher_.joinable()) dispatcher_.join();
+  if (collector_.joinable()) collector_.join();
+}
+
+void BatchScheduler::dispatch_loop() {
+  std::vector<StreamFrame> batch;
+  std::vector<cv::Mat> img_batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (pending_.empty()) {
+      if (stopping_) break;
+      arrived_.wait(lock);
+      continue;
+    }
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point wake;
+    int n = policy_.decide(pending_.size(), pending_.front().enqueued, now, wake);
+    // Nothing else is coming once stopped, flush without waiting
+    if (n == 0 && stopping_) n = std::min((int)pending_.size(), policy_.max_batch);
+    if (n == 0) {
+      arrived_.wait_until(lock, wake);
+      continue;
+    }
+
+    batch.clear();
+    img_batch.clear();
+    for (int i = 0; i < n; i++) {
+      StreamFrame& frame = pending_.front();
+      frame.dispatched = now;
+      double queue_ms = ms_between(frame.enqueued, now);
+      stats_.queue_ms += queue_ms;
+      stats_.queue_max_ms = std::max(stats_.queue_max_ms, queue_ms);
+      pending_per_stream_[frame.stream]--;
+      img_batch.push_back(frame.img);
+      batch.push_back(frame);
+      pending_.pop_front();
+    }
+    stats_.batches++;
+    stats_.frames += n;
+    stats_.fill[n]++;
+
+    // submit() may block for a free slot, let the streams keep queueing meanwhile
+    lock.unlock();
+    detector_.submit(img_batch);
+    in_flight_.push(batch);
+    lock.lock();
+  }
+  in_flight_.close();
+}
+
+void BatchScheduler::collect_loop() {
+  std::vector<StreamFrame> batch;
+  while (in_flight_.pop(batch)) {
+    std::vector<std::vector<Detection>> res_batch = detector_.collect();
+    assert(res_batch.size() == batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+      batch[i].dets.swap(res_batch[i]);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.stream_frames[batch[i].stream]++;
+      }
+      on_result_(batch[i]);
+    }
+  }
+}
+
+BatchSchedulerStats BatchScheduler::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void BatchScheduler::print_report() const {
+  BatchSchedulerStats s = stats();
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "scheduler: " << s.frames << " frames in " << s.batches << " batches"
+            << ", fill " << s.mean_fill() * 100 << "% of " << policy_.max_batch
+            << ", added queueing " << (s.frames ? s.queue_ms / s.frames : 0.0) << "ms mean / " << s.queue_max_ms << "ms max"
+            << ", dropped " << s.dropped << std::endl;
+  std::cout << "  batch sizes:";
+  for (size_t n = 1; n < s.fill.size(); n++) std::cout << " " << n << ":" << s.fill[n];
+  std::cout << std::endl << "  frames per stream:";
+  for (size_t i = 0; i < s.stream_frames.size(); i++) std::cout << " " << i << ":" << s.stream_frames[i];
+  std::cout << std::endl;
+  std::cout.unsetf(std::ios::floatfield);
+  std::cout << std::setprecision(6);
+}
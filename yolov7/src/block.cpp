@@ -49,6 +49,41 @@ std::map<std::string, Weights> loadWeights(const std::string file) {
     return weightMap;
 }
 
+INetworkDefinition* createNetwork(IBuilder* builder, bool explicit_batch) {
+    uint32_t flags = explicit_batch ? 1U << static_cast<uint32_t>(NetworkDefinitionCreationFlag::kEXPLICIT_BATCH) : 0U;
+    return builder->createNetworkV2(flags);
+}
+
+ITensor* addImageInput(INetworkDefinition* network, DataType dt, int input_w, int input_h) {
+    if (network->hasImplicitBatchDimension()) {
+        return network->addInput(kInputTensorName, dt, Dims3{ 3, input_h, input_w });
+    }
+    return network->addInput(kInputTensorName, dt, Dims4{ -1, 3, input_h, input_w });
+}
+
+void setResizeScales(IResizeLayer* layer, const float chw_scales[3]) {
+    if (layer->getInput(0)->getDimensions().nbDims == 3) {
+        layer->setScales(chw_scales, 3);
+        return;
+    }
+    float scales[] = { 1.0, chw_scales[0], chw_scales[1], chw_scales[2] };
+    layer->setScales(scales, 4);
+}
+
+void setBatchSize(IBuilder* builder, IBuilderConfig* config, INetworkDefinition* network, int maxBatchSize, int input_w, int input_h) {
+    if (network->hasImplicitBatchDimension()) {
+        builder->setMaxBatchSize(maxBatchSize);
+        return;
+    }
+    IOptimizationProfile* profile = builder->createOptimizationProfile();
+    profile->setDimensions(kInputTensorName, OptProfileSelector::kMIN, Dims4{ 1, 3, input_h, input_w });
+    profile->setDimensions(kInputTensorName, OptProfileSelector::kOPT, Dims4{ maxBatchSize, 3, input_h, input_w });
+    profile->setDimensions(kInputTensorName, OptProfileSelector::kMAX, Dims4{ maxBatchSize, 3, input_h, input_w });
+    config->addOptimizationProfile(profile);
+    // INT8 calibration runs with the same profile
+    config->setCalibrationProfile(profile);
+}
+
 static IScaleLayer* addBatchNorm2d(INetworkDefinition* network, std::map<std::string, Weights>& weightMap, ITensor& input, std::string lname, float eps) {
     float* gamma = (float*)weightMap[lname + ".weight"].values;
     float* beta = (float*)weightMap[lname + ".bias"].values;
@@ -104,10 +139,18 @@ IElementWiseLayer* convBnSilu(INetworkDefinition* network, std::map<std::string,
 }
 
 ILayer* ReOrg(INetworkDefinition* network, std::map<std::string, Weights>& weightMap, ITensor& input, int inch) {
-    ISliceLayer* s1 = network->addSlice(input, Dims3{ 0, 0, 0 }, Dims3{ inch, kInputH / 2, kInputW / 2 }, Dims3{ 1, 2, 2 });
-    ISliceLayer* s2 = network->addSlice(input, Dims3{ 0, 1, 0 }, Dims3{ inch, kInputH / 2, kInputW / 2 }, Dims3{ 1, 2, 2 });
-    ISliceLayer* s3 = network->addSlice(input, Dims3{ 0, 0, 1 }, Dims3{ inch, kInputH / 2, kInputW / 2 }, Dims3{ 1, 2, 2 });
-    ISliceLayer* s4 = network->addSlice(input, Dims3{ 0, 1, 1 }, Dims3{ inch, kInputH / 2, kInputW / 2 }, Dims3{ 1, 2, 2 });
+    // Static slices can't cover a dynamic batch dimension
+    Dims dims = input.getDimensions();
+    if (dims.nbDims != 3) {
+        std::cerr << "ReOrg needs an implicit batch network, P6 models can't be built with explicit_batch" << std::endl;
+        assert(false);
+    }
+    int h = dims.d[1];
+    int w = dims.d[2];
+    ISliceLayer* s1 = network->addSlice(input, Dims3{ 0, 0, 0 }, Dims3{ inch, h / 2, w / 2 }, Dims3{ 1, 2, 2 });
+    ISliceLayer* s2 = network->addSlice(input, Dims3{ 0, 1, 0 }, Dims3{ inch, h / 2, w / 2 }, Dims3{ 1, 2, 2 });
+    ISliceLayer* s3 = network->addSlice(input, Dims3{ 0, 0, 1 }, Dims3{ inch, h / 2, w / 2 }, Dims3{ 1, 2, 2 });
+    ISliceLayer* s4 = network->addSlice(input, Dims3{ 0, 1, 1 }, Dims3{ inch, h / 2, w / 2 }, Dims3{ 1, 2, 2 });
     ITensor* inputTensors[] = { s1->getOutput(0), s2->getOutput(0), s3->getOutput(0), s4->getOutput(0) };
     auto cat = network->addConcatenation(inputTensors, 4);
     return cat;
@@ -149,16 +192,16 @@ IElementWiseLayer* SPPCSPC(INetworkDefinition* network, std::map<std::string, We
 
     ITensor* input_tensors[] = { cv4->getOutput(0), m1->getOutput(0), m2->getOutput(0), m3->getOutput(0) };
     IConcatenationLayer* concat = network->addConcatenation(input_tensors, 4);
-    // 0U
-    concat->setAxis(0);
+    // channel axis: 0 with implicit batch, 1 with explicit batch
+    int channel_axis = input.getDimensions().nbDims - 3;
+    concat->setAxis(channel_axis);
 
     IElementWiseLayer* cv5 = convBnSilu(network, weightMap, *concat->getOutput(0), c_, 1, 1, 0, lname + ".cv5");
     IElementWiseLayer* cv6 = convBnSilu(network, weightMap, *cv5->getOutput(0), c_, 3, 1, 1, lname + ".cv6");
 
     ITensor* input_tensors2[] = { cv6->getOutput(0), cv2->getOutput(0) };
     IConcatenationLayer* concat1 = network->addConcatenation(input_tensors2, 2);
-    // 0U
-    concat1->setAxis(0);
+    concat1->setAxis(channel_axis);
 
 
     IElementWiseLayer* cv7 = convBnSilu(network, weightMap, *concat1->getOutput(0), c2, 1, 1, 0, lname + ".cv7");
@@ -217,12 +260,14 @@ static std::vector<std::vector<float>> getAnchors(std::map<std::string, Weights>
     return anchors;
 }
 
-IPluginV2Layer* addYoLoLayer(INetworkDefinition *network, std::map<std::string, Weights>& weightMap, std::string lname, std::vector<IConvolutionLayer*> dets) {
-    auto creator = getPluginRegistry()->getPluginCreator("YoloLayer_TRT", "1");
+IPluginV2Layer* addYoLoLayer(INetworkDefinition *network, std::map<std::string, Weights>& weightMap, std::string lname, std::vector<IConvolutionLayer*> dets, int input_w, int input_h, float ignore_thresh) {
+    // Explicit batch networks only take IPluginV2DynamicExt plugins
+    const char* plugin_name = network->hasImplicitBatchDimension() ? "YoloLayer_TRT" : "YoloLayerDynamic_TRT";
+    auto creator = getPluginRegistry()->getPluginCreator(plugin_name, "1");
     auto anchors = getAnchors(weightMap, lname);
 
-    PluginField plugin_fields[2];
-    int netinfo[4] = {kNumClass, kInputW, kInputH, kMaxNumOutputBbox};
+    PluginField plugin_fields[3];
+    int netinfo[4] = {kNumClass, input_w, input_h, kMaxNumOutputBbox};
     plugin_fields[0].data = netinfo;
     plugin_fields[0].length = 4;
     plugin_fields[0].name = "netinfo";
@@ -232,8 +277,8 @@ IPluginV2Layer* addYoLoLayer(INetworkDefinition *network, std::map<std::string,
     std::vector<YoloKernel> kernels;
     for (size_t i = 0; i < anchors.size(); i++) {
         YoloKernel kernel;
-        kernel.width = kInputW / scale;
-        kernel.height = kInputH / scale;
+        kernel.width = input_w / scale;
+        kernel.height = input_h / scale;
         memcpy(kernel.anchors, &anchors[i][0], anchors[i].size() * sizeof(float));
         kernels.push_back(kernel);
         scale *= 2;
@@ -242,8 +287,12 @@ IPluginV2Layer* addYoLoLayer(INetworkDefinition *network, std::map<std::string,
     plugin_fields[1].length = kernels.size();
     plugin_fields[1].name = "kernels";
     plugin_fields[1].type = PluginFieldType::kFLOAT32;
+    plugin_fields[2].data = &ignore_thresh;
+    plugin_fields[2].length = 1;
+    plugin_fields[2].name = "ignore_thresh";
+    plugin_fields[2].type = PluginFieldType::kFLOAT32;
     PluginFieldCollection plugin_data;
-    plugin_data.nbFields = 2;
+    plugin_data.nbFields = 3;
     plugin_data.fields = plugin_fields;
     IPluginV2 *plugin_obj = creator->createPlugin("yololayer", &plugin_data);
     std::vector<ITensor*> input_tensors;
@@ -0,0 +1,131 @@
+#include "capture.h"
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <iostream>
+
+VideoSource::VideoSource(const std::string& source, int width, int height, int fps) {
+  bool is_index = !source.empty();
+  for (char c : source) is_index = is_index && isdigit((unsigned char)c);
+  if (source.find('!') != std::string::npos) {
+    cap_.open(source, cv::CAP_GSTREAMER);
+  } else if (is_index || source.compare(0, 10, "/dev/video") == 0) {
+    // USB camera, same settings as app.py
+    if (is_index) {
+      cap_.open(std::stoi(source), cv::CAP_V4L2);
+    } else {
+      cap_.open(source, cv::CAP_V4L2);
+    }
+    cap_.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'));
+    cap_.set(cv::CAP_PROP_FRAME_WIDTH, width);
+    cap_.set(cv::CAP_PROP_FRAME_HEIGHT, height);
+    cap_.set(cv::CAP_PROP_FPS, fps);
+  } else {
+    cap_.open(source);
+  }
+  if (!cap_.isOpened()) std::cerr << "could not open capture source " << source << std::endl;
+}
+
+bool VideoSource::read(cv::Mat& img) {
+  return cap_.read(img) && !img.empty();
+}
+
+SyntheticSource::SyntheticSource(int width, int height, int fps)
+    : width_(width),
+      height_(height),
+      period_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / fps))),
+      next_(std::chrono::steady_clock::now()) {
+  assert(width > 0 && height > 0 && fps > 0);
+}
+
+bool SyntheticSource::read(cv::Mat& img) {
+  // Pace on absolute deadlines so the rate doesn't drift with draw time
+  std::this_thread::sleep_until(next_);
+  next_ += period_;
+
+  img.create(height_, width_, CV_8UC3);
+  img.setTo(cv::Scalar(114, 114, 114));
+  int side = std::max(16, height_ / 8);
+  int x = (int)((count_ * 8) % (uint64_t)std::max(1, width_ - side));
+  cv::rectangle(img, cv::Rect(x, (height_ - side) / 2, side, side), cv::Scalar(0, 0, 255), -1);
+  cv::putText(img, std::to_string(count_), cv::Point(10, 40), cv::FONT_HERSHEY_SIMPLEX, 1.2, cv::Scalar(255, 255, 255), 2);
+  count_++;
+  return true;
+}
+
+void LatestFrameMailbox::put(CapturedFrame& frame) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (full_) dropped_++;
+  std::swap(slot_, frame);
+  full_ = true;
+  ready_.notify_one();
+}
+
+bool LatestFrameMailbox::take(CapturedFrame& frame) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ready_.wait(lock, [this] { return closed_ || full_; });
+  if (!full_) return false;
+  // Hand the buffer over for good, the grab thread must never write into
+  // a Mat the consumer may still reference.
+  frame = slot_;
+  slot_.img = cv::Mat();
+  full_ = false;
+  return true;
+}
+
+void LatestFrameMailbox::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  closed_ = true;
+  ready_.notify_all();
+}
+
+uint64_t LatestFrameMailbox::dropped() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_;
+}
+
+LiveCapture::LiveCapture(std::unique_ptr<FrameSource> source, uint64_t max_frames)
+    : source_(std::move(source)), max_frames_(max_frames), running_(false), grabbed_(0), delivered_(0) {
+  assert(source_);
+}
+
+LiveCapture::~LiveCapture() {
+  stop();
+}
+
+void LiveCapture::start() {
+  assert(!thread_.joinable());
+  running_ = true;
+  thread_ = std::thread(&LiveCapture::grab_loop, this);
+}
+
+void LiveCapture::stop() {
+  running_ = false;
+  if (thread_.joinable()) thread_.join();
+  mailbox_.close();
+}
+
+void LiveCapture::grab_loop() {
+  CapturedFrame frame;
+  while (running_ && (max_frames_ == 0 || grabbed_ < max_frames_)) {
+    if (!source_->read(frame.img)) break;
+    frame.captured = std::chrono::steady_clock::now();
+    frame.seq = grabbed_++;
+    mailbox_.put(frame);
+  }
+  mailbox_.close();
+}
+
+bool LiveCapture::latest(CapturedFrame& frame) {
+  if (!mailbox_.take(frame)) return false;
+  delivered_++;
+  return true;
+}
+
+CaptureStats LiveCapture::stats() const {
+  CaptureStats stats;
+  stats.grabbed = grabbed_;
+  stats.dropped = mailbox_.dropped();
+  stats.delivered = delivered_;
+  return stats;
+}
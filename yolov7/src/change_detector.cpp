@@ -0,0 +1,120 @@
+#include "change_detector.h"
+#include "saliency.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+
+void downsample_gray(const cv::Mat& bgr, int factor, GrayFrame& out) {
+  assert(bgr.type() == CV_8UC3 && factor > 0);
+  out.w = bgr.cols / factor;
+  out.h = bgr.rows / factor;
+  out.px.resize((size_t)out.w * out.h);
+  std::vector<uint32_t> acc(out.w);
+  for (int y = 0; y < out.h; y++) {
+    std::fill(acc.begin(), acc.end(), 0);
+    for (int k = 0; k < factor; k++) {
+      const uint8_t* row = bgr.ptr(y * factor + k);
+      for (int x = 0; x < out.w; x++) {
+        const uint8_t* p = row + x * factor * 3;
+        uint32_t sum = 0;
+        for (int i = 0; i < factor; i++, p += 3) sum += p[0] + 2 * p[1] + p[2];
+        acc[x] += sum;
+      }
+    }
+    uint8_t* dst = &out.px[(size_t)y * out.w];
+    uint32_t norm = 4 * factor * factor;
+    for (int x = 0; x < out.w; x++) dst[x] = (uint8_t)(acc[x] / norm);
+  }
+}
+
+void estimate_shift(const GrayFrame& ref, const GrayFrame& cur, int search, int& dx, int& dy) {
+  assert(ref.w == cur.w && ref.h == cur.h);
+  dx = dy = 0;
+  int w = cur.w - 2 * search, h = cur.h - 2 * search;
+  if (search <= 0 || w <= 0 || h <= 0) return;
+  uint64_t best = std::numeric_limits<uint64_t>::max();
+  for (int sy = -search; sy <= search; sy++) {
+    for (int sx = -search; sx <= search; sx++) {
+      uint64_t sad = 0;
+      // Every other row is plenty to rank shifts
+      for (int y = search; y < search + h && sad <= best; y += 2) {
+        const uint8_t* c = &cur.px[(size_t)y * cur.w + search];
+        const uint8_t* r = &ref.px[(size_t)(y - sy) * ref.w + search - sx];
+        sad += sad_u8(c, r, w);
+      }
+      // Ties go to the smaller shift, a flat scene should not drift
+      if (sad < best || (sad == best && std::abs(sx) + std::abs(sy) < std::abs(dx) + std::abs(dy))) {
+        best = sad;
+        dx = sx;
+        dy = sy;
+      }
+    }
+  }
+}
+
+float changed_fraction(const GrayFrame& ref, const GrayFrame& cur, int dx, int dy, int block, float thresh) {
+  assert(ref.w == cur.w && ref.h == cur.h && block > 0);
+  int bw = cur.w / block, bh = cur.h / block;
+  if (bw == 0 || bh == 0) return 1.f;
+  int changed = 0, compared = 0;
+  for (int by = 0; by < bh; by++) {
+    for (int bx = 0; bx < bw; bx++) {
+      int x0 = bx * block, y0 = by * block;
+      if (x0 - dx < 0 || x0 - dx + block > ref.w || y0 - dy < 0 || y0 - dy + block > ref.h) continue;
+      compared++;
+      uint64_t sad = 0;
+      for (int y = y0; y < y0 + block; y++) {
+        sad += sad_u8(&cur.px[(size_t)y * cur.w + x0], &ref.px[(size_t)(y - dy) * ref.w + x0 - dx], block);
+      }
+      if ((float)sad / (block * block) > thresh) changed++;
+    }
+  }
+  return compared ? (float)changed / compared : 1.f;
+}
+
+ChangeDetector::ChangeDetector(const PipelineConfig& cfg)
+    : scale_(cfg.change_scale),
+      search_(cfg.change_search),
+      block_(cfg.change_block),
+      block_thresh_(cfg.change_block_thresh),
+      change_frac_(cfg.change_frac),
+      max_skip_(cfg.max_skip) {}
+
+bool ChangeDetector::reuse(const cv::Mat& frame, std::vector<Detection>& dets) {
+  auto t0 = std::chrono::steady_clock::now();
+  stats_.frames++;
+  downsample_gray(frame, scale_, cur_);
+  bool is_static = false;
+  int dx = 0, dy = 0;
+  if (have_ref_ && ref_.w == cur_.w && ref_.h == cur_.h) {
+    estimate_shift(ref_, cur_, search_, dx, dy);
+    is_static = changed_fraction(ref_, cur_, dx, dy, block_, block_thresh_) <= change_frac_;
+  }
+  if (is_static && skipped_in_row_ >= max_skip_) {
+    stats_.forced++;
+    is_static = false;
+  }
+  if (is_static) {
+    dets = ref_dets_;
+    for (Detection& det : dets) {
+      det.bbox[0] += dx * scale_;
+      det.bbox[1] += dy * scale_;
+    }
+    skipped_in_row_++;
+    stats_.skipped++;
+  }
+  stats_.cpu_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  return is_static;
+}
+
+void ChangeDetector::inferred(const std::vector<Detection>& dets) {
+  // The frame just inferred becomes the reference
+  ref_.w = cur_.w;
+  ref_.h = cur_.h;
+  ref_.px.swap(cur_.px);
+  ref_dets_ = dets;
+  have_ref_ = true;
+  skipped_in_row_ = 0;
+}
@@ -0,0 +1,268 @@
+#include "dem.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char kDemMagic[4] = {'Y', 'D', 'E', 'M'};
+static const uint32_t kDemVersion = 1;
+
+bool write_dem(const std::string& path, uint32_t cols, uint32_t rows, double x0, double y0, double cell, float nodata,
+               const float* heights) {
+  DemHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, kDemMagic, 4);
+  h.version = kDemVersion;
+  h.cols = cols;
+  h.rows = rows;
+  h.x0 = x0;
+  h.y0 = y0;
+  h.cell = cell;
+  h.nodata = nodata;
+  std::ofstream file(path, std::ios::binary);
+  file.write((const char*)&h, sizeof(h));
+  file.write((const char*)heights, (size_t)cols * rows * sizeof(float));
+  return file.good();
+}
+
+Dem::~Dem() {
+  if (map_) munmap((void*)map_, size_);
+}
+
+bool Dem::open(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "open " << path << " error!" << std::endl;
+    return false;
+  }
+  struct stat st;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(DemHeader)) {
+    map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << "map " << path << " error!" << std::endl;
+    return false;
+  }
+  const DemHeader* h = (const DemHeader*)map;
+  size_t size = st.st_size;
+  bool ok = memcmp(h->magic, kDemMagic, 4) == 0 && h->version == kDemVersion && h->cols >= 2 && h->rows >= 2 &&
+            h->cell > 0 && size == sizeof(DemHeader) + (size_t)h->cols * h->rows * sizeof(float);
+  if (!ok) {
+    std::cerr << path << " is not a DEM grid (see dem.h)" << std::endl;
+    munmap(map, size);
+    return false;
+  }
+  if (map_) munmap((void*)map_, size_);
+  map_ = (const uint8_t*)map;
+  size_ = size;
+  heights_ = (const float*)(map_ + sizeof(DemHeader));
+  cols_ = h->cols;
+  rows_ = h->rows;
+  x0_ = h->x0;
+  y0_ = h->y0;
+  cell_ = h->cell;
+  nodata_ = h->nodata;
+  // The pyramid build reads every sample once, front to back
+  madvise((void*)map_, size_, MADV_SEQUENTIAL);
+
+  // Finest level: each tile's extremes over the samples of its cells.
+  // Tiles without data get an empty range, which every ray skips.
+  levels_.clear();
+  uint32_t ncx = cols_ - 1, ncy = rows_ - 1;
+  Level base;
+  base.cols = (ncx + kDemTile - 1) / kDemTile;
+  base.rows = (ncy + kDemTile - 1) / kDemTile;
+  base.min.assign((size_t)base.cols * base.rows, FLT_MAX);
+  base.max.assign((size_t)base.cols * base.rows, -FLT_MAX);
+  for (uint32_t r = 0; r < rows_; r++) {
+    // Samples on a tile border belong to the tiles on both sides
+    uint32_t by0 = std::min(r, ncy - 1) / kDemTile;
+    uint32_t by1 = r > 0 ? (r - 1) / kDemTile : 0;
+    const float* row = heights_ + (size_t)r * cols_;
+    for (uint32_t c = 0; c < cols_; c++) {
+      float v = row[c];
+      if (v == nodata_ || std::isnan(v)) continue;
+      uint32_t bx0 = std::min(c, ncx - 1) / kDemTile;
+      uint32_t bx1 = c > 0 ? (c - 1) / kDemTile : 0;
+      for (uint32_t by = std::min(by0, by1); by <= std::max(by0, by1); by++) {
+        for (uint32_t bx = std::min(bx0, bx1); bx <= std::max(bx0, bx1); bx++) {
+          size_t i = (size_t)by * base.cols + bx;
+          base.min[i] = std::min(base.min[i], v);
+          base.max[i] = std::max(base.max[i], v);
+        }
+      }
+    }
+  }
+  levels_.push_back(base);
+  while (levels_.back().cols > 1 || levels_.back().rows > 1) {
+    const Level& fine = levels_.back();
+    Level coarse;
+    coarse.cols = (fine.cols + 1) / 2;
+    coarse.rows = (fine.rows + 1) / 2;
+    coarse.min.assign((size_t)coarse.cols * coarse.rows, FLT_MAX);
+    coarse.max.assign((size_t)coarse.cols * coarse.rows, -FLT_MAX);
+    for (uint32_t r = 0; r < fine.rows; r++) {
+      for (uint32_t c = 0; c < fine.cols; c++) {
+        size_t i = (size_t)(r / 2) * coarse.cols + c / 2;
+        coarse.min[i] = std::min(coarse.min[i], fine.min[(size_t)r * fine.cols + c]);
+        coarse.max[i] = std::max(coarse.max[i], fine.max[(size_t)r * fine.cols + c]);
+      }
+    }
+    levels_.push_back(coarse);
+  }
+  // Rays touch the grid here and there from now on
+  madvise((void*)map_, size_, MADV_RANDOM);
+  return true;
+}
+
+bool Dem::height_at(double x, double y, float& h) const {
+  double gx = (x - x0_) / cell_;
+  double gy = (y0_ - y) / cell_;
+  if (!(gx >= 0 && gy >= 0 && gx <= cols_ - 1 && gy <= rows_ - 1)) return false;
+  uint32_t cx = std::min((uint32_t)gx, cols_ - 2);
+  uint32_t cy = std::min((uint32_t)gy, rows_ - 2);
+  float h00 = sample(cx, cy), h10 = sample(cx + 1, cy);
+  float h01 = sample(cx, cy + 1), h11 = sample(cx + 1, cy + 1);
+  if (h00 == nodata_ || h10 == nodata_ || h01 == nodata_ || h11 == nodata_) return false;
+  double u = gx - cx, v = gy - cy;
+  h = (float)(h00 * (1 - u) * (1 - v) + h10 * u * (1 - v) + h01 * (1 - u) * v + h11 * u * v);
+  return !std::isnan(h);
+}
+
+bool Dem::intersect_cell(uint32_t cx, uint32_t cy, const double* o, const double* d, double t0, double t1,
+                         double& t) const {
+  float h00 = sample(cx, cy), h10 = sample(cx + 1, cy);
+  float h01 = sample(cx, cy + 1), h11 = sample(cx + 1, cy + 1);
+  if (h00 == nodata_ || h10 == nodata_ || h01 == nodata_ || h11 == nodata_) return false;
+  // Below the cell's highest corner somewhere on the segment?
+  float top = std::max(std::max(h00, h10), std::max(h01, h11));
+  if (std::min(o[2] + d[2] * t0, o[2] + d[2] * t1) > top) return false;
+
+  // Ray height minus the bilinear surface, a quadratic A t^2 + B t + C
+  double a = h10 - h00, b = h01 - h00, c = h00 - h10 - h01 + h11;
+  double u0 = o[0] - cx, v0 = o[1] - cy;
+  double A = -c * d[0] * d[1];
+  double B = d[2] - a * d[0] - b * d[1] - c * (u0 * d[1] + v0 * d[0]);
+  double C = o[2] - h00 - a * u0 - b * v0 - c * u0 * v0;
+  if (A * t0 * t0 + B * t0 + C <= 0) {
+    t = t0;
+    return true;
+  }
+  double roots[2];
+  int n = 0;
+  if (std::fabs(A) < 1e-12 * (std::fabs(B) + 1e-12)) {
+    if (B != 0) roots[n++] = -C / B;
+  } else {
+    double disc = B * B - 4 * A * C;
+    if (disc < 0) return false;
+    // Without cancellation between B and the root
+    double q = -0.5 * (B + (B >= 0 ? std::sqrt(disc) : -std::sqrt(disc)));
+    roots[n++] = q / A;
+    if (q != 0) roots[n++] = C / q;
+    if (n == 2 && roots[1] < roots[0]) std::swap(roots[0], roots[1]);
+  }
+  for (int i = 0; i < n; i++) {
+    if (roots[i] >= t0 && roots[i] <= t1) {
+      t = roots[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+// Where the ray leaves the box [lo, hi] (grid units), given it is inside
+static inline double exit_t(const double* o, const double* d, double lox, double loy, double hix, double hiy) {
+  double tx = d[0] > 0 ? (hix - o[0]) / d[0] : d[0] < 0 ? (lox - o[0]) / d[0] : DBL_MAX;
+  double ty = d[1] > 0 ? (hiy - o[1]) / d[1] : d[1] < 0 ? (loy - o[1]) / d[1] : DBL_MAX;
+  return std::min(tx, ty);
+}
+
+// Cell (or block) index along one axis of the point at t, on a border the
+// one the ray moves into
+static inline uint32_t cell_index(double p, double d, uint32_t n) {
+  double f = std::floor(p);
+  if (d < 0 && f == p) f -= 1;
+  return (uint32_t)std::min(std::max(f, 0.0), (double)(n - 1));
+}
+
+bool Dem::intersect(double x, double y, double z, double dx, double dy, double dz, double& t) const {
+  if (levels_.empty()) return false;
+  float gmin = min_height(), gmax = max_height();
+  if (gmin > gmax) return false;  // no data at all
+
+  // Grid units across, metres up; rows run south
+  double o[3] = {(x - x0_) / cell_, (y0_ - y) / cell_, z};
+  double d[3] = {dx / cell_, -dy / cell_, dz};
+  uint32_t ncx = cols_ - 1, ncy = rows_ - 1;
+
+  float here;
+  if (height_at(x, y, here) && z < here) return false;
+
+  // Clip to the grid and to the slab between the lowest and highest terrain
+  double t0 = 0, t1 = DBL_MAX;
+  for (int k = 0; k < 2; k++) {
+    double n = k == 0 ? ncx : ncy;
+    if (d[k] == 0) {
+      if (o[k] < 0 || o[k] > n) return false;
+      continue;
+    }
+    double ta = (0 - o[k]) / d[k], tb = (n - o[k]) / d[k];
+    t0 = std::max(t0, std::min(ta, tb));
+    t1 = std::min(t1, std::max(ta, tb));
+  }
+  if (d[2] < 0) {
+    // Padded, level terrain makes it a single point
+    double ta = (z - gmax) / -d[2], tb = (z - gmin) / -d[2];
+    t0 = std::max(t0, ta - 1e-9 * (1 + ta));
+    t1 = std::min(t1, tb + 1e-9 * (1 + tb));
+  } else if (z > gmax) {
+    return false;
+  }
+  if (t0 >= t1) return false;
+
+  const int top = (int)levels_.size() - 1;
+  int level = top;
+  double tc = t0;
+  while (tc < t1) {
+    double p0 = o[0] + d[0] * tc, p1 = o[1] + d[1] * tc;
+    uint32_t cx = cell_index(p0, d[0], ncx), cy = cell_index(p1, d[1], ncy);
+    const Level& lv = levels_[level];
+    uint32_t span = kDemTile << level;  // cells per block side
+    uint32_t bx = cx / span, by = cy / span;
+    double lox = (double)bx * span, loy = (double)by * span;
+    double te = std::min(exit_t(o, d, lox, loy, std::min(lox + span, (double)ncx), std::min(loy + span, (double)ncy)), t1);
+    if (te <= tc) te = tc + 1e-9 * (1 + tc);
+    float low = (float)std::min(o[2] + d[2] * tc, o[2] + d[2] * te);
+    if (low > lv.max[(size_t)by * lv.cols + bx]) {
+      // Above everything in the block
+      tc = te;
+      level = std::min(level + 1, top);
+      continue;
+    }
+    if (level > 0) {
+      level--;
+      continue;
+    }
+    // A tile the ray gets down into: walk its cells
+    double ts = tc;
+    while (ts < te) {
+      double q0 = o[0] + d[0] * ts, q1 = o[1] + d[1] * ts;
+      uint32_t ux = cell_index(q0, d[0], ncx), uy = cell_index(q1, d[1], ncy);
+      double tn = std::min(exit_t(o, d, ux, uy, ux + 1.0, uy + 1.0), te);
+      if (tn <= ts) tn = ts + 1e-9 * (1 + ts);
+      if (intersect_cell(ux, uy, o, d, ts, tn, t)) return t > 0;
+      ts = tn;
+    }
+    tc = te;
+    level = std::min(level + 1, top);
+  }
+  return false;
+}
@@ -0,0 +1,278 @@
+#include "detection_cache.h"
+#include "types.h"
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char kSegmentMagic[4] = {'Y', 'D', 'C', 'S'};
+static const uint32_t kSegmentVersion = 1;
+
+struct SegmentHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t engine_hash;
+  uint64_t config_hash;
+  uint32_t det_floats;  // floats per Detection
+  uint32_t reserved;
+};
+
+struct RecordHeader {
+  uint64_t image_hash;
+  uint32_t floats;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(SegmentHeader) == 32, "segment header layout");
+static_assert(sizeof(RecordHeader) == 16, "record header layout");
+
+static size_t padded(size_t bytes) {
+  return (bytes + 7) & ~(size_t)7;
+}
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed) {
+  const uint8_t* p = (const uint8_t*)data;
+  uint64_t h = seed;
+  for (size_t i = 0; i < size; i++) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+bool hash_file(const std::string& path, uint64_t& hash) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.good()) return false;
+  std::vector<char> buf(1 << 20);
+  hash = hash_bytes(nullptr, 0);
+  while (file) {
+    file.read(buf.data(), buf.size());
+    hash = hash_bytes(buf.data(), (size_t)file.gcount(), hash);
+  }
+  return true;
+}
+
+static std::string segment_prefix(uint64_t engine_hash, uint64_t config_hash) {
+  char name[64];
+  snprintf(name, sizeof(name), "%016" PRIx64 "-%016" PRIx64 "-", engine_hash, config_hash);
+  return name;
+}
+
+// Names of the segment files in dir, sorted
+static std::vector<std::string> list_segments(const std::string& dir) {
+  std::vector<std::string> names;
+  DIR* d = opendir(dir.c_str());
+  if (!d) return names;
+  struct dirent* e;
+  while ((e = readdir(d)) != nullptr) {
+    std::string name(e->d_name);
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".seg") == 0) names.push_back(name);
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+DetectionCache::DetectionCache(const std::string& dir, uint64_t engine_hash, uint64_t config_hash, size_t max_bytes,
+                               size_t segment_bytes)
+    : dir_(dir), engine_hash_(engine_hash), config_hash_(config_hash), max_bytes_(max_bytes), segment_bytes_(segment_bytes) {
+  assert(segment_bytes > sizeof(SegmentHeader));
+  mkdir(dir.c_str(), 0755);
+  std::string prefix = segment_prefix(engine_hash, config_hash);
+  uint32_t next = 0;
+  for (const std::string& name : list_segments(dir)) {
+    if (name.compare(0, prefix.size(), prefix) != 0) continue;
+    uint32_t seq = (uint32_t)strtoul(name.c_str() + prefix.size(), nullptr, 10);
+    if (open_segment(seq)) next = std::max(next, seq + 1);
+  }
+  // Never append to a segment of an earlier run, sealed ones stay immutable
+  start_segment(next);
+  evict();
+}
+
+DetectionCache::~DetectionCache() {
+  for (auto& it : segments_) {
+    Segment& s = it.second;
+    if (s.map) munmap((void*)s.map, s.size);
+    if (s.fd >= 0) close(s.fd);
+    // Nothing was inserted this run
+    if (writable_ && it.first == active_ && s.size == sizeof(SegmentHeader)) unlink(s.path.c_str());
+  }
+}
+
+bool DetectionCache::open_segment(uint32_t seq) {
+  Segment s;
+  s.path = dir_ + "/" + segment_prefix(engine_hash_, config_hash_);
+  char num[16];
+  snprintf(num, sizeof(num), "%08u.seg", seq);
+  s.path += num;
+  s.fd = open(s.path.c_str(), O_RDONLY);
+  if (s.fd < 0) return false;
+  struct stat st;
+  bool ok = fstat(s.fd, &st) == 0 && (size_t)st.st_size >= sizeof(SegmentHeader);
+  if (ok) {
+    s.size = st.st_size;
+    void* map = mmap(nullptr, s.size, PROT_READ, MAP_SHARED, s.fd, 0);
+    ok = map != MAP_FAILED;
+    if (ok) s.map = (const uint8_t*)map;
+  }
+  const SegmentHeader* h = ok ? (const SegmentHeader*)s.map : nullptr;
+  ok = ok && memcmp(h->magic, kSegmentMagic, 4) == 0 && h->version == kSegmentVersion &&
+       h->engine_hash == engine_hash_ && h->config_hash == config_hash_ &&
+       h->det_floats == sizeof(Detection) / sizeof(float);
+  if (!ok) {
+    std::cerr << "dropping unreadable cache segment " << s.path << std::endl;
+    if (s.map) munmap((void*)s.map, s.size);
+    close(s.fd);
+    unlink(s.path.c_str());
+    return false;
+  }
+
+  size_t offset = sizeof(SegmentHeader);
+  while (offset + sizeof(RecordHeader) <= s.size) {
+    const RecordHeader* r = (const RecordHeader*)(s.map + offset);
+    size_t end = offset + padded(sizeof(RecordHeader) + r->floats * sizeof(float));
+    if (r->floats == 0 || end > s.size) break;
+    index_[r->image_hash] = Entry{seq, offset + sizeof(RecordHeader), r->floats};
+    offset = end;
+  }
+  stats_.bytes += s.size;
+  segments_[seq] = s;
+  return true;
+}
+
+bool DetectionCache::start_segment(uint32_t seq) {
+  Segment s;
+  s.path = dir_ + "/" + segment_prefix(engine_hash_, config_hash_);
+  char num[16];
+  snprintf(num, sizeof(num), "%08u.seg", seq);
+  s.path += num;
+  s.fd = open(s.path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (s.fd < 0) {
+    std::cerr << "could not create cache segment " << s.path << ", not storing new results" << std::endl;
+    writable_ = false;
+    return false;
+  }
+  SegmentHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, kSegmentMagic, 4);
+  h.version = kSegmentVersion;
+  h.engine_hash = engine_hash_;
+  h.config_hash = config_hash_;
+  h.det_floats = sizeof(Detection) / sizeof(float);
+  if (write(s.fd, &h, sizeof(h)) != (ssize_t)sizeof(h)) std::cerr << "write " << s.path << " error!" << std::endl;
+  s.size = sizeof(h);
+  stats_.bytes += s.size;
+  segments_[seq] = s;
+  active_ = seq;
+  writable_ = true;
+  return true;
+}
+
+void DetectionCache::seal_active() {
+  Segment& s = segments_[active_];
+  void* map = mmap(nullptr, s.size, PROT_READ, MAP_SHARED, s.fd, 0);
+  if (map != MAP_FAILED) s.map = (const uint8_t*)map;
+  start_segment(active_ + 1);
+}
+
+void DetectionCache::evict() {
+  while (stats_.bytes > max_bytes_ && segments_.size() > 1) {
+    auto oldest = segments_.begin();
+    uint32_t seq = oldest->first;
+    Segment& s = oldest->second;
+    if (s.map) munmap((void*)s.map, s.size);
+    close(s.fd);
+    unlink(s.path.c_str());
+    stats_.bytes -= s.size;
+    stats_.evicted_segments++;
+    segments_.erase(oldest);
+    for (auto it = index_.begin(); it != index_.end();) {
+      it = it->second.segment == seq ? index_.erase(it) : std::next(it);
+    }
+  }
+}
+
+bool DetectionCache::lookup(uint64_t image_hash, std::vector<float>& output) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(image_hash);
+  if (it == index_.end()) {
+    stats_.misses++;
+    return false;
+  }
+  const Entry& e = it->second;
+  const Segment& s = segments_[e.segment];
+  output.resize(e.floats);
+  size_t bytes = e.floats * sizeof(float);
+  // Sealed segments are mapped, the one being appended to is read with pread()
+  if (s.map) {
+    memcpy(output.data(), s.map + e.offset, bytes);
+  } else if (pread(s.fd, output.data(), bytes, e.offset) != (ssize_t)bytes) {
+    stats_.misses++;
+    return false;
+  }
+  stats_.hits++;
+  return true;
+}
+
+void DetectionCache::insert(uint64_t image_hash, const float* output) {
+  int det_floats = sizeof(Detection) / sizeof(float);
+  int count = std::min((int)output[0], kMaxNumOutputBbox);
+  RecordHeader r;
+  r.image_hash = image_hash;
+  r.floats = 1 + count * det_floats;
+  r.reserved = 0;
+  size_t payload = r.floats * sizeof(float);
+  size_t total = padded(sizeof(r) + payload);
+  std::vector<uint8_t> record(total, 0);
+  memcpy(record.data(), &r, sizeof(r));
+  memcpy(record.data() + sizeof(r), output, payload);
+  // The count may be larger than what the output holds
+  float stored = (float)count;
+  memcpy(record.data() + sizeof(r), &stored, sizeof(float));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!writable_) return;
+  Segment& s = segments_[active_];
+  if (pwrite(s.fd, record.data(), total, s.size) != (ssize_t)total) {
+    std::cerr << "write " << s.path << " error!" << std::endl;
+    return;
+  }
+  index_[image_hash] = Entry{active_, s.size + sizeof(r), r.floats};
+  s.size += total;
+  stats_.bytes += total;
+  stats_.inserts++;
+  if (s.size >= segment_bytes_) {
+    seal_active();
+    evict();
+  }
+}
+
+DetectionCacheStats DetectionCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+bool DetectionCache::writable() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return writable_;
+}
+
+int DetectionCache::purge(const std::string& dir, uint64_t engine_hash, uint64_t config_hash) {
+  std::string prefix = segment_prefix(engine_hash, config_hash);
+  int removed = 0;
+  for (const std::string& name : list_segments(dir)) {
+    if (name.compare(0, prefix.size(), prefix) == 0) continue;
+    if (unlink((dir + "/" + name).c_str()) == 0) removed++;
+  }
+  return removed;
+}
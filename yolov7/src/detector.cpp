@@ -0,0 +1,41 @@
+#include "detector.h"
+#include "postprocess.h"
+#include <algorithm>
+#include <cassert>
+
+Detector::Detector(std::unique_ptr<DetectorBackend> backend, const PipelineConfig& cfg)
+    : backend_(std::move(backend)), cfg_(cfg) {
+  assert(backend_);
+  output_.resize(backend_->max_batch_size() * kOutputSize);
+}
+
+std::vector<std::vector<Detection>> Detector::detect(std::vector<cv::Mat>& frames) {
+  // Keep every slot busy: batch i+1 is submitted before batch i is collected
+  std::vector<std::vector<Detection>> res_batch(frames.size());
+  int max_batch = backend_->max_batch_size();
+  std::vector<cv::Mat> img_batch;
+  size_t collected = 0;
+  for (size_t i = 0; i < frames.size(); i += max_batch) {
+    if (backend_->in_flight() == backend_->num_slots()) {
+      for (auto& res : collect()) res_batch[collected++].swap(res);
+    }
+    size_t end = std::min(frames.size(), i + max_batch);
+    img_batch.assign(frames.begin() + i, frames.begin() + end);
+    submit(img_batch);
+  }
+  while (collected < frames.size()) {
+    for (auto& res : collect()) res_batch[collected++].swap(res);
+  }
+  return res_batch;
+}
+
+void Detector::submit(std::vector<cv::Mat>& img_batch) {
+  backend_->submit(img_batch);
+}
+
+std::vector<std::vector<Detection>> Detector::collect() {
+  int batch = backend_->collect(output_.data());
+  std::vector<std::vector<Detection>> res_batch;
+  batch_nms(res_batch, output_.data(), batch, kOutputSize, cfg_.conf_thresh, cfg_.nms_thresh);
+  return res_batch;
+}
@@ -0,0 +1,460 @@
+#include "ego_motion.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+static const int kLevels = 3;
+static const int kHalfWin = 4;       // 9x9 Lucas-Kanade window
+static const int kLkIters = 10;
+static const float kLkEps = 0.01f;   // pixels, iterations stop below this step
+static const double kMinEigen = 4.0; // per window pixel, flatter windows can't be followed
+static const int kBorder = 8;
+static const int kGridCols = 8;
+static const int kGridRows = 6;
+static const int kRansacIters = 64;
+static const double kInlierPx = 1.0;  // reprojection error on the level 0 grid
+static const int kMinInliers = 10;
+
+static const int kCircle[16][2] = {{0, -3}, {1, -3}, {2, -2}, {3, -1}, {3, 0},  {3, 1},  {2, 2},  {1, 3},
+                                   {0, 3},  {-1, 3}, {-2, 2}, {-3, 1}, {-3, 0}, {-3, -1}, {-2, -2}, {-1, -3}};
+
+// a = b * c for 3x3 matrices
+static void mul3(const double* b, const double* c, double* a) {
+  for (int r = 0; r < 3; r++) {
+    for (int k = 0; k < 3; k++) a[r * 3 + k] = b[r * 3] * c[k] + b[r * 3 + 1] * c[3 + k] + b[r * 3 + 2] * c[6 + k];
+  }
+}
+
+void warp_point(const GlobalMotion& m, double x, double y, double& u, double& v) {
+  const double* h = m.h;
+  double w = h[6] * x + h[7] * y + h[8];
+  u = (h[0] * x + h[1] * y + h[2]) / w;
+  v = (h[3] * x + h[4] * y + h[5]) / w;
+}
+
+GlobalMotion rescale_motion(const GlobalMotion& m, double scale, double ox, double oy) {
+  double t[9] = {scale, 0, ox, 0, scale, oy, 0, 0, 1};
+  double inv[9] = {1 / scale, 0, -ox / scale, 0, 1 / scale, -oy / scale, 0, 0, 1};
+  GlobalMotion r = m;
+  double tmp[9];
+  mul3(t, m.h, tmp);
+  mul3(tmp, inv, r.h);
+  return r;
+}
+
+// Nine set bits in a row around the circle
+static bool has_arc9(uint32_t mask) {
+  uint32_t m = mask | (mask << 16);
+  uint32_t run = m;
+  for (int k = 1; k < 9; k++) run &= m >> k;
+  return run != 0;
+}
+
+void fast_corners(const GrayFrame& img, int thresh, int border, std::vector<Corner>& corners,
+                  std::vector<int>& score_map) {
+  corners.clear();
+  int w = img.w, h = img.h;
+  border = std::max(border, 3);
+  if (w <= 2 * border || h <= 2 * border) return;
+  score_map.assign((size_t)w * h, 0);
+  int off[16];
+  for (int k = 0; k < 16; k++) off[k] = kCircle[k][1] * w + kCircle[k][0];
+  for (int y = border; y < h - border; y++) {
+    const uint8_t* row = &img.px[(size_t)y * w];
+    int* scores = &score_map[(size_t)y * w];
+    for (int x = border; x < w - border; x++) {
+      const uint8_t* p = row + x;
+      int hi = *p + thresh, lo = *p - thresh;
+      // A 9 pixel arc covers at least two of the four compass points
+      int n = p[off[0]], e = p[off[4]], s = p[off[8]], wst = p[off[12]];
+      int bright = (n > hi) + (e > hi) + (s > hi) + (wst > hi);
+      int dark = (n < lo) + (e < lo) + (s < lo) + (wst < lo);
+      if (bright < 2 && dark < 2) continue;
+      uint32_t bright_mask = 0, dark_mask = 0;
+      for (int k = 0; k < 16; k++) {
+        int v = p[off[k]];
+        bright_mask |= (uint32_t)(v > hi) << k;
+        dark_mask |= (uint32_t)(v < lo) << k;
+      }
+      // Score: how far the circle clears the threshold
+      int score = 0;
+      if (bright >= 2 && has_arc9(bright_mask)) {
+        for (int k = 0; k < 16; k++) score += (bright_mask >> k & 1) ? p[off[k]] - hi : 0;
+      } else if (dark >= 2 && has_arc9(dark_mask)) {
+        for (int k = 0; k < 16; k++) score += (dark_mask >> k & 1) ? lo - p[off[k]] : 0;
+      } else {
+        continue;
+      }
+      scores[x] = score + 1;
+      corners.push_back(Corner{(float)x, (float)y, score + 1});
+    }
+  }
+  // Local maxima, ties go to the first in raster order
+  size_t kept = 0;
+  for (size_t i = 0; i < corners.size(); i++) {
+    const Corner& c = corners[i];
+    const int* s = &score_map[(size_t)c.y * w + (size_t)c.x];
+    bool max = s[-w - 1] < c.score && s[-w] < c.score && s[-w + 1] < c.score && s[-1] < c.score &&
+               s[1] <= c.score && s[w - 1] <= c.score && s[w] <= c.score && s[w + 1] <= c.score;
+    if (max) corners[kept++] = c;
+  }
+  corners.resize(kept);
+}
+
+// A (2 * half + 1)^2 window of img centred on (x, y), bilinear; false when
+// part of it is outside
+static bool sample_window(const GrayFrame& img, float x, float y, int half, float* out) {
+  float fx = x - half, fy = y - half;
+  int x0 = (int)std::floor(fx), y0 = (int)std::floor(fy);
+  int n = 2 * half + 1;
+  if (x0 < 0 || y0 < 0 || x0 + n >= img.w || y0 + n >= img.h) return false;
+  float ax = fx - x0, ay = fy - y0;
+  float w00 = (1 - ax) * (1 - ay), w01 = ax * (1 - ay), w10 = (1 - ax) * ay, w11 = ax * ay;
+  for (int j = 0; j < n; j++) {
+    const uint8_t* r0 = &img.px[(size_t)(y0 + j) * img.w + x0];
+    const uint8_t* r1 = r0 + img.w;
+    float* dst = out + j * n;
+    for (int i = 0; i < n; i++) dst[i] = w00 * r0[i] + w01 * r0[i + 1] + w10 * r1[i] + w11 * r1[i + 1];
+  }
+  return true;
+}
+
+// Solves a x = b (n x n, row major) in place by Gaussian elimination, b
+// gets x. false when singular.
+static bool solve(double* a, double* b, int n) {
+  for (int c = 0; c < n; c++) {
+    int pivot = c;
+    for (int r = c + 1; r < n; r++) {
+      if (std::fabs(a[r * n + c]) > std::fabs(a[pivot * n + c])) pivot = r;
+    }
+    if (std::fabs(a[pivot * n + c]) < 1e-12) return false;
+    if (pivot != c) {
+      for (int k = 0; k < n; k++) std::swap(a[c * n + k], a[pivot * n + k]);
+      std::swap(b[c], b[pivot]);
+    }
+    for (int r = c + 1; r < n; r++) {
+      double f = a[r * n + c] / a[c * n + c];
+      for (int k = c; k < n; k++) a[r * n + k] -= f * a[c * n + k];
+      b[r] -= f * b[c];
+    }
+  }
+  for (int c = n - 1; c >= 0; c--) {
+    for (int k = c + 1; k < n; k++) b[c] -= a[c * n + k] * b[k];
+    b[c] /= a[c * n + c];
+  }
+  return true;
+}
+
+EgoMotion::EgoMotion(const PipelineConfig& cfg)
+    : scale_(cfg.ego_scale), budget_(cfg.ego_points), homography_(cfg.ego_model == "homography"), fast_thresh_(20),
+      rng_(0) {
+  assert(scale_ > 0 && budget_ > 0);
+  GlobalMotion identity;
+  memcpy(last_, identity.h, sizeof(last_));
+}
+
+void EgoMotion::build_pyramid(const cv::Mat& frame, Pyramid& pyr) {
+  pyr.resize(kLevels);
+  downsample_gray(frame, scale_, pyr[0]);
+  for (int l = 1; l < kLevels; l++) {
+    const GrayFrame& src = pyr[l - 1];
+    GrayFrame& dst = pyr[l];
+    dst.w = src.w / 2;
+    dst.h = src.h / 2;
+    dst.px.resize((size_t)dst.w * dst.h);
+    for (int y = 0; y < dst.h; y++) {
+      const uint8_t* r0 = &src.px[(size_t)2 * y * src.w];
+      const uint8_t* r1 = r0 + src.w;
+      uint8_t* out = &dst.px[(size_t)y * dst.w];
+      for (int x = 0; x < dst.w; x++) out[x] = (uint8_t)((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) / 4);
+    }
+  }
+}
+
+void EgoMotion::select_points() {
+  // Corners come from level 1, a quarter of the pixels to scan; level 0
+  // Lucas-Kanade doesn't need them centred on the corner exactly
+  const GrayFrame& img = cur_[1];
+  fast_corners(img, fast_thresh_, kBorder / 2, corners_, score_map_);
+  // Keep the threshold where a few times the budget come out
+  if ((int)corners_.size() < 2 * budget_) {
+    fast_thresh_ = std::max(5, fast_thresh_ * 4 / 5);
+  } else if ((int)corners_.size() > 8 * budget_) {
+    fast_thresh_ = std::min(100, fast_thresh_ * 5 / 4 + 1);
+  }
+  std::sort(corners_.begin(), corners_.end(), [](const Corner& a, const Corner& b) { return a.score > b.score; });
+  // The strongest few of each grid cell, then the strongest of the rest
+  int cells = kGridCols * kGridRows, per_cell = (budget_ + cells - 1) / cells;
+  cell_count_.assign(cells, 0);
+  points_.clear();
+  for (Corner& c : corners_) {
+    if ((int)points_.size() >= budget_) break;
+    int cx = std::min((int)c.x * kGridCols / img.w, kGridCols - 1);
+    int cy = std::min((int)c.y * kGridRows / img.h, kGridRows - 1);
+    if (cell_count_[cy * kGridCols + cx] >= per_cell) continue;
+    cell_count_[cy * kGridCols + cx]++;
+    points_.push_back(Point{2 * c.x + 0.5f, 2 * c.y + 0.5f});
+    c.score = 0;
+  }
+  for (const Corner& c : corners_) {
+    if ((int)points_.size() >= budget_) break;
+    if (c.score) points_.push_back(Point{2 * c.x + 0.5f, 2 * c.y + 0.5f});
+  }
+}
+
+void EgoMotion::track_points() {
+  src_.clear();
+  dst_.clear();
+  const int n = 2 * kHalfWin + 1, rim = n + 2;
+  patch_.resize(rim * rim + 4 * n * n);
+  float* big = patch_.data();  // previous frame's window with a 1 pixel rim for the gradient
+  float* iw = big + rim * rim;
+  float* ix = iw + n * n;
+  float* iy = ix + n * n;
+  float* jw = iy + n * n;
+  GlobalMotion last;
+  memcpy(last.h, last_, sizeof(last_));
+  for (const Point& p : points_) {
+    // Start from where the last motion would put the point
+    double gx, gy;
+    warp_point(last, p.x, p.y, gx, gy);
+    float top = (float)(1 << (kLevels - 1));
+    float dx = (float)(gx - p.x) / top, dy = (float)(gy - p.y) / top;
+    bool ok = true;
+    for (int l = kLevels - 1; l >= 0 && ok; l--) {
+      // Pixel centres of level l: x_l = (x_0 - (2^l - 1) / 2) / 2^l
+      float s = (float)(1 << l);
+      float px = (p.x - (s - 1) / 2) / s, py = (p.y - (s - 1) / 2) / s;
+      bool usable = sample_window(prev_[l], px, py, kHalfWin + 1, big);
+      double gxx = 0, gxy = 0, gyy = 0;
+      if (usable) {
+        for (int j = 0; j < n; j++) {
+          for (int i = 0; i < n; i++) {
+            const float* c = big + (j + 1) * rim + i + 1;
+            int k = j * n + i;
+            iw[k] = *c;
+            ix[k] = (c[1] - c[-1]) / 2;
+            iy[k] = (c[rim] - c[-rim]) / 2;
+            gxx += ix[k] * ix[k];
+            gxy += ix[k] * iy[k];
+            gyy += iy[k] * iy[k];
+          }
+        }
+        double half_tr = (gxx + gyy) / 2;
+        double min_eig = half_tr - std::sqrt((gxx - gyy) * (gxx - gyy) / 4 + gxy * gxy);
+        usable = min_eig >= kMinEigen * n * n;
+      }
+      if (usable) {
+        double inv_det = 1.0 / (gxx * gyy - gxy * gxy);
+        for (int it = 0; it < kLkIters; it++) {
+          if (!sample_window(cur_[l], px + dx, py + dy, kHalfWin, jw)) {
+            usable = false;
+            break;
+          }
+          double bx = 0, by = 0;
+          for (int k = 0; k < n * n; k++) {
+            float e = iw[k] - jw[k];
+            bx += e * ix[k];
+            by += e * iy[k];
+          }
+          float sx = (float)((gyy * bx - gxy * by) * inv_det), sy = (float)((gxx * by - gxy * bx) * inv_det);
+          dx += sx;
+          dy += sy;
+          if (sx * sx + sy * sy < kLkEps * kLkEps) break;
+        }
+      }
+      // A level that couldn't be used hands its guess down; level 0 must work
+      if (!usable && l == 0) ok = false;
+      if (l > 0) {
+        dx *= 2;
+        dy *= 2;
+      }
+    }
+    if (!ok) continue;
+    src_.push_back(p);
+    dst_.push_back(Point{p.x + dx, p.y + dy});
+  }
+}
+
+// Centroid to the origin, mean distance sqrt(2): (scale, cx, cy)
+template <typename P>
+static void normalisation(const std::vector<P>& pts, double out[3]) {
+  double cx = 0, cy = 0, dist = 0;
+  for (const P& p : pts) {
+    cx += p.x;
+    cy += p.y;
+  }
+  cx /= pts.size();
+  cy /= pts.size();
+  for (const P& p : pts) dist += std::hypot(p.x - cx, p.y - cy);
+  dist /= pts.size();
+  out[0] = dist > 0 ? std::sqrt(2.0) / dist : 1.0;
+  out[1] = cx;
+  out[2] = cy;
+}
+
+bool EgoMotion::fit_model(const int* idx, int n, double h[9]) const {
+  const double ss = norm_src_[0], sx = norm_src_[1], sy = norm_src_[2];
+  const double ds = norm_dst_[0], dx = norm_dst_[1], dy = norm_dst_[2];
+  double hn[9] = {0, 0, 0, 0, 0, 0, 0, 0, 1};
+  if (homography_) {
+    // u (g x + h y + 1) = a x + b y + c, likewise v: 8 unknowns, least squares
+    double ata[64] = {0}, atb[8] = {0};
+    for (int k = 0; k < n; k++) {
+      double x = (src_[idx[k]].x - sx) * ss, y = (src_[idx[k]].y - sy) * ss;
+      double u = (dst_[idx[k]].x - dx) * ds, v = (dst_[idx[k]].y - dy) * ds;
+      double r1[8] = {x, y, 1, 0, 0, 0, -u * x, -u * y};
+      double r2[8] = {0, 0, 0, x, y, 1, -v * x, -v * y};
+      for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) ata[i * 8 + j] += r1[i] * r1[j] + r2[i] * r2[j];
+        atb[i] += r1[i] * u + r2[i] * v;
+      }
+    }
+    if (!solve(ata, atb, 8)) return false;
+    memcpy(hn, atb, sizeof(atb));
+  } else {
+    double ata[9] = {0}, bu[3] = {0}, bv[3] = {0};
+    for (int k = 0; k < n; k++) {
+      double r[3] = {(src_[idx[k]].x - sx) * ss, (src_[idx[k]].y - sy) * ss, 1};
+      double u = (dst_[idx[k]].x - dx) * ds, v = (dst_[idx[k]].y - dy) * ds;
+      for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) ata[i * 3 + j] += r[i] * r[j];
+        bu[i] += r[i] * u;
+        bv[i] += r[i] * v;
+      }
+    }
+    double ata2[9];
+    memcpy(ata2, ata, sizeof(ata));
+    if (!solve(ata, bu, 3) || !solve(ata2, bv, 3)) return false;
+    memcpy(hn, bu, sizeof(bu));
+    memcpy(hn + 3, bv, sizeof(bv));
+  }
+  // Back to pixels: h = Tdst^-1 hn Tsrc
+  double tsrc[9] = {ss, 0, -ss * sx, 0, ss, -ss * sy, 0, 0, 1};
+  double tdst_inv[9] = {1 / ds, 0, dx, 0, 1 / ds, dy, 0, 0, 1};
+  double tmp[9];
+  mul3(hn, tsrc, tmp);
+  mul3(tdst_inv, tmp, h);
+  return true;
+}
+
+int EgoMotion::count_inliers(const double h[9], std::vector<uint8_t>* mask) const {
+  int count = 0;
+  if (mask) mask->assign(src_.size(), 0);
+  for (size_t i = 0; i < src_.size(); i++) {
+    double x = src_[i].x, y = src_[i].y;
+    double w = h[6] * x + h[7] * y + h[8];
+    if (w <= 0) continue;
+    double ex = (h[0] * x + h[1] * y + h[2]) / w - dst_[i].x;
+    double ey = (h[3] * x + h[4] * y + h[5]) / w - dst_[i].y;
+    if (ex * ex + ey * ey >= kInlierPx * kInlierPx) continue;
+    count++;
+    if (mask) (*mask)[i] = 1;
+  }
+  return count;
+}
+
+// Twice the area of triangle abc
+template <typename P>
+static double area2(const P& a, const P& b, const P& c) {
+  return std::fabs((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x));
+}
+
+bool EgoMotion::fit(double h[9], int& inliers) {
+  int n = (int)src_.size(), sample = homography_ ? 4 : 3;
+  if (n < std::max(kMinInliers, sample)) return false;
+  normalisation(src_, norm_src_);
+  normalisation(dst_, norm_dst_);
+  std::uniform_int_distribution<int> pick(0, n - 1);
+  int best = 0, iters = kRansacIters;
+  double best_h[9], cand[9];
+  for (int it = 0; it < iters; it++) {
+    int idx[4];
+    for (int k = 0; k < sample; k++) {
+      do {
+        idx[k] = pick(rng_);
+      } while (std::find(idx, idx + k, idx[k]) != idx + k);
+    }
+    // Nearly collinear samples give wild fits, a pixel of area is enough
+    bool degenerate = false;
+    for (int a = 0; a < sample && !degenerate; a++) {
+      for (int b = a + 1; b < sample && !degenerate; b++) {
+        for (int c = b + 1; c < sample && !degenerate; c++) {
+          degenerate = area2(src_[idx[a]], src_[idx[b]], src_[idx[c]]) < 2.0;
+        }
+      }
+    }
+    if (degenerate || !fit_model(idx, sample, cand)) continue;
+    int count = count_inliers(cand, nullptr);
+    if (count <= best) continue;
+    best = count;
+    memcpy(best_h, cand, sizeof(cand));
+    // Samples for 99% confidence of one all inlier draw at this ratio
+    double all_in = std::pow((double)best / n, sample);
+    if (all_in > 1 - 1e-9) break;
+    iters = std::min(kRansacIters, (int)std::ceil(std::log(0.01) / std::log(1 - all_in)));
+  }
+  if (best < kMinInliers) return false;
+  // Least squares on the inliers, twice as the set settles
+  for (int round = 0; round < 2; round++) {
+    count_inliers(best_h, &inlier_mask_);
+    inlier_idx_.clear();
+    for (int i = 0; i < n; i++) {
+      if (inlier_mask_[i]) inlier_idx_.push_back(i);
+    }
+    if (!fit_model(inlier_idx_.data(), (int)inlier_idx_.size(), cand)) break;
+    if (count_inliers(cand, nullptr) < (int)inlier_idx_.size() * 9 / 10) break;
+    memcpy(best_h, cand, sizeof(cand));
+  }
+  best = count_inliers(best_h, nullptr);
+  // Most of the scene has to agree, not just one large moving target
+  if (best < kMinInliers || 3 * best < n) return false;
+  memcpy(h, best_h, sizeof(best_h));
+  inliers = best;
+  return true;
+}
+
+bool EgoMotion::estimate(const cv::Mat& frame, GlobalMotion& motion) {
+  auto start = std::chrono::steady_clock::now();
+  motion = GlobalMotion();
+  GlobalMotion identity;
+  if (frame.empty()) {
+    have_prev_ = false;
+    return false;
+  }
+  std::swap(prev_, cur_);
+  build_pyramid(frame, cur_);
+  bool ok = false;
+  double h[9];
+  if (have_prev_ && prev_[0].w == cur_[0].w && prev_[0].h == cur_[0].h) {
+    track_points();
+    motion.tracked = (int)src_.size();
+    ok = fit(h, motion.inliers);
+  }
+  if (ok) {
+    memcpy(last_, h, sizeof(last_));
+    // Level 0 pixel x is frame pixel scale * x + (scale - 1) / 2
+    GlobalMotion grid;
+    memcpy(grid.h, h, sizeof(grid.h));
+    double off = (scale_ - 1) / 2.0;
+    GlobalMotion full = rescale_motion(grid, scale_, off, off);
+    memcpy(motion.h, full.h, sizeof(motion.h));
+    motion.valid = true;
+  } else {
+    motion.inliers = 0;
+    memcpy(last_, identity.h, sizeof(last_));
+  }
+  select_points();
+  have_prev_ = true;
+
+  stats_.frames++;
+  stats_.valid += ok;
+  stats_.tracked += motion.tracked;
+  stats_.inliers += motion.inliers;
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  stats_.cpu_ms += ms;
+  stats_.max_ms = std::max(stats_.max_ms, ms);
+  return ok;
+}
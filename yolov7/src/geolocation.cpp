@@ -0,0 +1,228 @@
+#include "geolocation.h"
+#include "twd97.h"
+#include "undistort.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+static const double kDegToRad = M_PI / 180.0;
+
+// WGS84
+static const double kSemiMajor = 6378137.0;
+static const double kEcc2 = 0.00669437999014;
+
+// Rays closer to the horizon than this never reach the ground in practice
+static const float kMinDown = 1e-6f;
+
+CameraIntrinsics intrinsics_from_fov(int width, int height, float hfov_deg) {
+  assert(width > 0 && height > 0 && hfov_deg > 0.f && hfov_deg < 180.f);
+  CameraIntrinsics c;
+  c.width = width;
+  c.height = height;
+  c.fx = (float)(width / 2.0 / std::tan(hfov_deg * kDegToRad / 2));
+  c.fy = c.fx;
+  c.cx = width / 2.f;
+  c.cy = height / 2.f;
+  return c;
+}
+
+void offset_to_latlon(double lat, double lon, double north, double east, double& out_lat, double& out_lon) {
+  double s = std::sin(lat * kDegToRad);
+  double w = 1 - kEcc2 * s * s;
+  double rn = kSemiMajor / std::sqrt(w);  // prime vertical
+  double rm = rn * (1 - kEcc2) / w;       // meridian
+  out_lat = lat + north / rm / kDegToRad;
+  out_lon = lon + east / (rn * std::cos(lat * kDegToRad)) / kDegToRad;
+}
+
+GroundProjector::GroundProjector(const CameraIntrinsics& camera, float tilt_deg, float ground_alt)
+    : camera_(camera), tilt_deg_(tilt_deg), ground_alt_(ground_alt) {
+  assert(camera.fx > 0.f && camera.fy > 0.f);
+}
+
+void GroundProjector::update_rotation(const FramePose& pose) {
+  if (have_rotation_ && pose.roll == roll_ && pose.pitch == pitch_ && pose.yaw == yaw_) return;
+  roll_ = pose.roll;
+  pitch_ = pose.pitch;
+  yaw_ = pose.yaw;
+  have_rotation_ = true;
+
+  double cr = std::cos(roll_ * kDegToRad), sr = std::sin(roll_ * kDegToRad);
+  double cp = std::cos(pitch_ * kDegToRad), sp = std::sin(pitch_ * kDegToRad);
+  double cy = std::cos(yaw_ * kDegToRad), sy = std::sin(yaw_ * kDegToRad);
+  // R_world_body = Rz(yaw) * Ry(pitch) * Rx(roll)
+  double wb[9] = {cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr,
+                  sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr,
+                  -sp,     cp * sr,                cp * cr};
+  // R_body_cam, columns are the camera's x (right), y (down) and z
+  // (optical axis) in body axes
+  double ct = std::cos(tilt_deg_ * kDegToRad), st = std::sin(tilt_deg_ * kDegToRad);
+  double bc[9] = {0, -st, ct,
+                  1, 0,   0,
+                  0, ct,  st};
+  double wc[9];
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      wc[r * 3 + c] = wb[r * 3] * bc[c] + wb[r * 3 + 1] * bc[3 + c] + wb[r * 3 + 2] * bc[6 + c];
+    }
+  }
+  // Times K^-1, so (u, v, 1) maps straight to a world ray
+  for (int r = 0; r < 3; r++) {
+    const double* a = wc + r * 3;
+    M_[r * 3] = (float)(a[0] / camera_.fx);
+    M_[r * 3 + 1] = (float)(a[1] / camera_.fy);
+    M_[r * 3 + 2] = (float)(a[2] - a[0] * camera_.cx / camera_.fx - a[1] * camera_.cy / camera_.fy);
+  }
+}
+
+size_t GroundProjector::project(const FramePose& pose, const float* px, const float* py, size_t n, float* north,
+                                float* east, uint8_t* hit) {
+  update_rotation(pose);
+  float h = pose.alt - ground_alt_;
+  if (h <= 0.f) {
+    // On or below the ground plane
+    for (size_t i = 0; i < n; i++) {
+      north[i] = 0.f;
+      east[i] = 0.f;
+      hit[i] = 0;
+    }
+    return 0;
+  }
+  const float m0 = M_[0], m1 = M_[1], m2 = M_[2];
+  const float m3 = M_[3], m4 = M_[4], m5 = M_[5];
+  const float m6 = M_[6], m7 = M_[7], m8 = M_[8];
+  size_t hits = 0;
+  for (size_t i = 0; i < n; i++) {
+    float dx = m0 * px[i] + m1 * py[i] + m2;
+    float dy = m3 * px[i] + m4 * py[i] + m5;
+    float dz = m6 * px[i] + m7 * py[i] + m8;
+    bool down = dz > kMinDown;
+    float t = down ? h / dz : 0.f;
+    north[i] = t * dx;
+    east[i] = t * dy;
+    hit[i] = down;
+    hits += down;
+  }
+  return hits;
+}
+
+void GroundProjector::project_dem(const FramePose& pose, size_t boxes) {
+  // Camera and its local north/east axes on the TWD97 grid
+  double lat[3] = {pose.lat, 0, 0}, lon[3] = {pose.lon, 0, 0}, gx[3], gy[3];
+  offset_to_latlon(pose.lat, pose.lon, 1, 0, lat[1], lon[1]);
+  offset_to_latlon(pose.lat, pose.lon, 0, 1, lat[2], lon[2]);
+  wgs84_to_twd97(lat, lon, 3, gx, gy);
+  double jxn = gx[1] - gx[0], jyn = gy[1] - gy[0];
+  double jxe = gx[2] - gx[0], jye = gy[2] - gy[0];
+
+  for (size_t b = 0; b < boxes; b++) {
+    double ground = 0;
+    for (size_t k = 0; k < 5; k++) {
+      size_t i = b * 5 + k;
+      double dn = M_[0] * px_[i] + M_[1] * py_[i] + M_[2];
+      double de = M_[3] * px_[i] + M_[4] * py_[i] + M_[5];
+      double dd = M_[6] * px_[i] + M_[7] * py_[i] + M_[8];
+      double t;
+      if (k == 0) {
+        stats_.dem_rays++;
+        if (!dem_->intersect(gx[0], gy[0], pose.alt, jxn * dn + jxe * de, jyn * dn + jye * de, -dd, t)) {
+          stats_.dem_misses++;
+          break;
+        }
+        ground = pose.alt - t * dd;
+      } else {
+        if (dd <= kMinDown || pose.alt <= ground) {
+          hit_[i] = 0;
+          continue;
+        }
+        t = (pose.alt - ground) / dd;
+      }
+      north_[i] = (float)(t * dn);
+      east_[i] = (float)(t * de);
+      ground_[i] = (float)ground;
+      hit_[i] = 2;  // on the terrain, see locate()
+    }
+  }
+}
+
+static float distance(float n0, float e0, float n1, float e1) {
+  return std::sqrt((n1 - n0) * (n1 - n0) + (e1 - e0) * (e1 - e0));
+}
+
+void GroundProjector::locate(const FramePose& pose, const std::vector<Detection>& dets,
+                             std::vector<GroundTarget>& targets) {
+  auto start = std::chrono::steady_clock::now();
+  // Per box: centre, then the corners clockwise from top left
+  size_t n = dets.size() * 5;
+  if (px_.size() < n) {
+    px_.resize(n);
+    py_.resize(n);
+    north_.resize(n);
+    east_.resize(n);
+    hit_.resize(n);
+    ground_.resize(n);
+    lat_.resize(dets.size());
+    lon_.resize(dets.size());
+    twd97_x_.resize(dets.size());
+    twd97_y_.resize(dets.size());
+  }
+  for (size_t i = 0; i < dets.size(); i++) {
+    const float* b = dets[i].bbox;
+    float x1 = b[0] - b[2] / 2, x2 = b[0] + b[2] / 2;
+    float y1 = b[1] - b[3] / 2, y2 = b[1] + b[3] / 2;
+    float* x = &px_[i * 5];
+    float* y = &py_[i * 5];
+    x[0] = b[0];
+    y[0] = b[1];
+    x[1] = x1;
+    y[1] = y1;
+    x[2] = x2;
+    y[2] = y1;
+    x[3] = x2;
+    y[3] = y2;
+    x[4] = x1;
+    y[4] = y2;
+  }
+  if (undistorter_) undistorter_->undistort(px_.data(), py_.data(), n, px_.data(), py_.data());
+  project(pose, px_.data(), py_.data(), n, north_.data(), east_.data(), hit_.data());
+  std::fill(ground_.begin(), ground_.begin() + n, ground_alt_);
+  if (dem_) project_dem(pose, dets.size());
+
+  targets.resize(dets.size());
+  for (size_t i = 0; i < dets.size(); i++) {
+    const float* no = &north_[i * 5];
+    const float* ea = &east_[i * 5];
+    const uint8_t* hit = &hit_[i * 5];
+    GroundTarget& t = targets[i];
+    t = GroundTarget();
+    lat_[i] = pose.lat;
+    lon_[i] = pose.lon;
+    t.valid = hit[0] && hit[1] && hit[2] && hit[3] && hit[4];
+    if (!t.valid) {
+      stats_.missed++;
+      continue;
+    }
+    t.north = no[0];
+    t.east = ea[0];
+    offset_to_latlon(pose.lat, pose.lon, t.north, t.east, t.lat, t.lon);
+    lat_[i] = t.lat;
+    lon_[i] = t.lon;
+    t.width_m = (distance(no[1], ea[1], no[2], ea[2]) + distance(no[4], ea[4], no[3], ea[3])) / 2;
+    t.height_m = (distance(no[1], ea[1], no[4], ea[4]) + distance(no[2], ea[2], no[3], ea[3])) / 2;
+    t.alt = ground_[i * 5];
+    t.on_dem = hit[0] == 2;
+    float h = pose.alt - t.alt;
+    t.range = std::sqrt(t.north * t.north + t.east * t.east + h * h);
+  }
+  // Grid coordinates of the whole frame in one call
+  wgs84_to_twd97(lat_.data(), lon_.data(), dets.size(), twd97_x_.data(), twd97_y_.data());
+  for (size_t i = 0; i < dets.size(); i++) {
+    if (!targets[i].valid) continue;
+    targets[i].twd97_x = twd97_x_[i];
+    targets[i].twd97_y = twd97_y_[i];
+  }
+  stats_.frames++;
+  stats_.boxes += dets.size();
+  stats_.cpu_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,95 @@
+#include "gps_emitter.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <ctime>
+#include <unistd.h>
+
+static const size_t kJitterBins = 10000;  // 1 us each, the last one collects the rest
+
+GpsEmitter::GpsEmitter(const std::string& telemetry, int fd, const GpsEmitterConfig& cfg)
+    : name_(telemetry), fd_(fd), cfg_(cfg), jitter_us_(kJitterBins, 0) {
+  assert(cfg.rate_hz > 0);
+  period_ns_ = (int64_t)std::llround(1e9 / cfg.rate_hz);
+}
+
+size_t GpsEmitter::pack(int64_t now_ns) {
+  GpsInput msg;
+  // time_usec, time_week and time_week_ms stay 0 (unknown) like the script
+  // sent them: the ring only has CLOCK_MONOTONIC, which is neither boot nor
+  // Unix time on the flight controller's side, and no GPS time
+  msg.ignore_flags = kGpsInputIgnoreVelHoriz | kGpsInputIgnoreVelVert | kGpsInputIgnoreSpeedAccuracy;
+  msg.hdop = cfg_.hdop;
+  msg.vdop = cfg_.vdop;
+  msg.satellites_visible = cfg_.satellites;
+  TelemetryRecord rec;
+  // The writer may come up after the emitter
+  bool have = (telemetry_.is_open() || telemetry_.open(name_)) && telemetry_.latest(rec);
+  if (have) {
+    msg.lat = (int32_t)std::llround(rec.lat * 1e7);
+    msg.lon = (int32_t)std::llround(rec.lon * 1e7);
+    msg.alt = rec.alt;
+    if (rec.fix != 0 && now_ns - rec.t_ns <= cfg_.max_age_ns) msg.fix_type = 3;
+    if (cfg_.send_yaw) {
+      float yaw = std::fmod(rec.yaw, 360.f);
+      if (yaw <= 0.f) yaw += 360.f;  // 0 means unknown, north is 36000
+      msg.yaw = (uint16_t)std::lround(yaw * 100.f);
+    }
+  }
+  if (msg.fix_type == 0) stats_.no_fix++;
+  return mavlink_pack_gps_input(msg, seq_++, cfg_.sysid, cfg_.compid, frame_);
+}
+
+void GpsEmitter::run(const std::atomic<bool>& stop, uint64_t ticks) {
+  // telemetry_now_ns() is CLOCK_MONOTONIC, the clock the deadlines sleep on
+  if (deadline_ns_ == 0) deadline_ns_ = telemetry_now_ns() + period_ns_;
+  for (uint64_t n = 0; (ticks == 0 || n < ticks) && !stop.load(std::memory_order_relaxed); n++) {
+    struct timespec ts;
+    ts.tv_sec = deadline_ns_ / 1000000000LL;
+    ts.tv_nsec = deadline_ns_ % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+      if (stop.load(std::memory_order_relaxed)) return;
+    }
+    int64_t now = telemetry_now_ns();
+    int64_t late = std::max<int64_t>(now - deadline_ns_, 0);
+    stats_.ticks++;
+    stats_.jitter_max_ns = std::max(stats_.jitter_max_ns, late);
+    stats_.jitter_sum_ns += late;
+    jitter_us_[std::min((size_t)(late / 1000), kJitterBins - 1)]++;
+
+    size_t len = pack(now);
+    ssize_t written = 0;
+    while ((size_t)written < len) {
+      ssize_t w = write(fd_, frame_ + written, len - written);
+      if (w < 0 && errno == EINTR) continue;
+      if (w <= 0) break;
+      written += w;
+    }
+    if ((size_t)written == len) {
+      stats_.sent++;
+      stats_.bytes += len;
+    } else {
+      stats_.write_errors++;
+    }
+    stats_.send_max_ns = std::max(stats_.send_max_ns, telemetry_now_ns() - now);
+
+    // Next deadline on the original schedule, whole periods overslept are dropped
+    deadline_ns_ += period_ns_;
+    if (now >= deadline_ns_) {
+      int64_t skip = (now - deadline_ns_) / period_ns_ + 1;
+      stats_.missed += skip;
+      deadline_ns_ += skip * period_ns_;
+    }
+  }
+}
+
+int64_t GpsEmitter::jitter_quantile_ns(double q) const {
+  if (stats_.ticks == 0) return 0;
+  uint64_t want = (uint64_t)std::ceil(q * stats_.ticks), seen = 0;
+  for (size_t i = 0; i < kJitterBins; i++) {
+    seen += jitter_us_[i];
+    if (seen >= want && seen > 0) return (int64_t)(i + 1) * 1000;
+  }
+  return (int64_t)kJitterBins * 1000;
+}
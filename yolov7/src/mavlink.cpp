@@ -0,0 +1,85 @@
+#include "mavlink.h"
+#include <cstring>
+
+static uint8_t* put_u8(uint8_t* p, uint8_t v) {
+  *p = v;
+  return p + 1;
+}
+
+static uint8_t* put_u16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  return p + 2;
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+  return p + 4;
+}
+
+static uint8_t* put_u64(uint8_t* p, uint64_t v) {
+  for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+  return p + 8;
+}
+
+static uint8_t* put_f32(uint8_t* p, float v) {
+  uint32_t u;
+  memcpy(&u, &v, 4);
+  return put_u32(p, u);
+}
+
+uint16_t mavlink_crc(const uint8_t* data, size_t len, uint16_t crc) {
+  for (size_t i = 0; i < len; i++) {
+    uint8_t tmp = data[i] ^ (uint8_t)(crc & 0xff);
+    tmp ^= (uint8_t)(tmp << 4);
+    crc = (crc >> 8) ^ ((uint16_t)tmp << 8) ^ ((uint16_t)tmp << 3) ^ (tmp >> 4);
+  }
+  return crc;
+}
+
+// Header, then the payload already written at buf + kMavlinkHeaderLen
+static size_t finish_frame(uint8_t* buf, size_t len, uint8_t seq, uint8_t sysid, uint8_t compid, uint32_t msgid,
+                           uint8_t crc_extra) {
+  const uint8_t* payload = buf + kMavlinkHeaderLen;
+  while (len > 1 && payload[len - 1] == 0) len--;
+  uint8_t* p = buf;
+  p = put_u8(p, kMavlinkStx);
+  p = put_u8(p, (uint8_t)len);
+  p = put_u8(p, 0);  // incompat flags, unsigned
+  p = put_u8(p, 0);  // compat flags
+  p = put_u8(p, seq);
+  p = put_u8(p, sysid);
+  p = put_u8(p, compid);
+  p = put_u8(p, (uint8_t)msgid);
+  p = put_u8(p, (uint8_t)(msgid >> 8));
+  put_u8(p, (uint8_t)(msgid >> 16));
+  uint16_t crc = mavlink_crc(buf + 1, kMavlinkHeaderLen - 1 + len);
+  crc = mavlink_crc(&crc_extra, 1, crc);
+  put_u16(buf + kMavlinkHeaderLen + len, crc);
+  return kMavlinkHeaderLen + len + 2;
+}
+
+size_t mavlink_pack_gps_input(const GpsInput& msg, uint8_t seq, uint8_t sysid, uint8_t compid, uint8_t* buf) {
+  // Wire order: fields sorted by size, largest first, then extensions
+  uint8_t* p = buf + kMavlinkHeaderLen;
+  p = put_u64(p, msg.time_usec);
+  p = put_u32(p, msg.time_week_ms);
+  p = put_u32(p, (uint32_t)msg.lat);
+  p = put_u32(p, (uint32_t)msg.lon);
+  p = put_f32(p, msg.alt);
+  p = put_f32(p, msg.hdop);
+  p = put_f32(p, msg.vdop);
+  p = put_f32(p, msg.vn);
+  p = put_f32(p, msg.ve);
+  p = put_f32(p, msg.vd);
+  p = put_f32(p, msg.speed_accuracy);
+  p = put_f32(p, msg.horiz_accuracy);
+  p = put_f32(p, msg.vert_accuracy);
+  p = put_u16(p, msg.ignore_flags);
+  p = put_u16(p, msg.time_week);
+  p = put_u8(p, msg.gps_id);
+  p = put_u8(p, msg.fix_type);
+  p = put_u8(p, msg.satellites_visible);
+  put_u16(p, msg.yaw);
+  return finish_frame(buf, kMavlinkGpsInputLen, seq, sysid, compid, kMavlinkMsgGpsInput, kMavlinkGpsInputCrcExtra);
+}
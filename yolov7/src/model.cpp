@@ -8,11 +8,11 @@
 
 using namespace nvinfer1;
 
-IHostMemory* build_engine_yolov7e6e(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path) {
+IHostMemory* build_engine_yolov7e6e(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path, int input_w, int input_h, float ignore_thresh, bool explicit_batch) {
     std::map<std::string, Weights> weightMap = loadWeights(wts_path);
 
-    INetworkDefinition* network = builder->createNetworkV2(0U);
-    ITensor* data = network->addInput(kInputTensorName, dt, Dims3{ 3, kInputH, kInputW });
+    INetworkDefinition* network = createNetwork(builder, explicit_batch);
+    ITensor* data = addImageInput(network, dt, input_w, input_h);
     assert(data);
 
     auto* conv0 = ReOrg(network, weightMap, *data, 3);
@@ -191,7 +191,7 @@ IHostMemory* build_engine_yolov7e6e(unsigned int maxBatchSize, IBuilder* builder
     float scale[] = { 1.0, 2.0, 2.0 };
     IResizeLayer* re114 = network->addResize(*conv113->getOutput(0));
     re114->setResizeMode(ResizeMode::kNEAREST);
-    re114->setScales(scale, 3);
+    setResizeScales(re114, scale);
 
     IElementWiseLayer* conv115 = convBnSilu(network, weightMap, *conv89->getOutput(0), 480, 1, 1, 0, "model.115");
     ITensor* input_tensor_116[] = { conv115->getOutput(0), re114->getOutput(0) };
@@ -230,7 +230,7 @@ IHostMemory* build_engine_yolov7e6e(unsigned int maxBatchSize, IBuilder* builder
     IElementWiseLayer* conv138 = convBnSilu(network, weightMap, *conv137->getOutput(0), 320, 1, 1, 0, "model.138");
     IResizeLayer* re139 = network->addResize(*conv138->getOutput(0));
     re139->setResizeMode(ResizeMode::kNEAREST);
-    re139->setScales(scale, 3);
+    setResizeScales(re139, scale);
     IElementWiseLayer* conv140 = convBnSilu(network, weightMap, *conv67->getOutput(0), 320, 1, 1, 0, "model.140");
     ITensor* input_tensor_141[] = { conv140->getOutput(0), re139->getOutput(0) };
     IConcatenationLayer* concat141 = network->addConcatenation(input_tensor_141, 2);
@@ -270,7 +270,7 @@ IHostMemory* build_engine_yolov7e6e(unsigned int maxBatchSize, IBuilder* builder
 
     IResizeLayer* re164 = network->addResize(*conv163->getOutput(0));
     re164->setResizeMode(ResizeMode::kNEAREST);
-    re164->setScales(scale, 3);
+    setResizeScales(re164, scale);
 
     IElementWiseLayer* conv165 = convBnSilu(network, weightMap, *conv45->getOutput(0), 160, 1, 1, 0, "model.165");
     ITensor* input_tensor_166[] = { conv165->getOutput(0), re164->getOutput(0) };
@@ -438,11 +438,11 @@ IHostMemory* build_engine_yolov7e6e(unsigned int maxBatchSize, IBuilder* builder
     cv105_3->setName("cv105.3");
 
     /*------------detect-----------*/
-    auto yolo = addYoLoLayer(network, weightMap, "model.261", std::vector<IConvolutionLayer*>{cv105_0, cv105_1, cv105_2, cv105_3});
+    auto yolo = addYoLoLayer(network, weightMap, "model.261", std::vector<IConvolutionLayer*>{cv105_0, cv105_1, cv105_2, cv105_3}, input_w, input_h, ignore_thresh);
     yolo->getOutput(0)->setName(kOutputTensorName);
     network->markOutput(*yolo->getOutput(0));
     // Build engine
-    builder->setMaxBatchSize(maxBatchSize);
+    setBatchSize(builder, config, network, maxBatchSize, input_w, input_h);
     config->setMaxWorkspaceSize(16 * (1 << 20));  // 16MB
 #if defined(USE_FP16)
     config->setFlag(BuilderFlag::kFP16);
@@ -450,7 +450,7 @@ IHostMemory* build_engine_yolov7e6e(unsigned int maxBatchSize, IBuilder* builder
     std::cout << "Your platform support int8: " << (builder->platformHasFastInt8() ? "true" : "false") << std::endl;
     assert(builder->platformHasFastInt8());
     config->setFlag(BuilderFlag::kINT8);
-    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, kInputW, kInputH, "./coco_calib/", "int8calib.table", kInputTensorName);
+    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, input_w, input_h, "./coco_calib/", "int8calib.table", kInputTensorName);
     config->setInt8Calibrator(calibrator);
 #endif
 
@@ -468,11 +468,11 @@ IHostMemory* build_engine_yolov7e6e(unsigned int maxBatchSize, IBuilder* builder
     return serialized_model;
 }
 
-IHostMemory* build_engine_yolov7d6(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path) {
+IHostMemory* build_engine_yolov7d6(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path, int input_w, int input_h, float ignore_thresh, bool explicit_batch) {
     std::map<std::string, Weights> weightMap = loadWeights(wts_path);
 
-    INetworkDefinition* network = builder->createNetworkV2(0U);
-    ITensor* data = network->addInput(kInputTensorName, dt, Dims3{ 3, kInputH, kInputW });
+    INetworkDefinition* network = createNetwork(builder, explicit_batch);
+    ITensor* data = addImageInput(network, dt, input_w, input_h);
     assert(data);
 
     /*----------------------------------yolov7d6 backbone-----------------------------------------*/
@@ -580,7 +580,7 @@ IHostMemory* build_engine_yolov7d6(unsigned int maxBatchSize, IBuilder* builder,
     float scale[] = { 1.0, 2.0, 2.0 };
     IResizeLayer* re69 = network->addResize(*conv68->getOutput(0));
     re69->setResizeMode(ResizeMode::kNEAREST);
-    re69->setScales(scale, 3);
+    setResizeScales(re69, scale);
 
     IElementWiseLayer* conv70 = convBnSilu(network, weightMap, *conv53->getOutput(0), 576, 1, 1, 0, "model.70");
     ITensor* input_tensor_71[] = { conv70->getOutput(0), re69->getOutput(0) };
@@ -606,7 +606,7 @@ IHostMemory* build_engine_yolov7d6(unsigned int maxBatchSize, IBuilder* builder,
     IElementWiseLayer* conv84 = convBnSilu(network, weightMap, *conv83->getOutput(0), 384, 1, 1, 0, "model.84");
     IResizeLayer* re85 = network->addResize(*conv84->getOutput(0));
     re85->setResizeMode(ResizeMode::kNEAREST);
-    re85->setScales(scale, 3);
+    setResizeScales(re85, scale);
     IElementWiseLayer* conv86 = convBnSilu(network, weightMap, *conv40->getOutput(0), 384, 1, 1, 0, "model.86");
     ITensor* input_tensor_87[] = { conv86->getOutput(0), re85->getOutput(0) };
     IConcatenationLayer* concat87 = network->addConcatenation(input_tensor_87, 2);
@@ -633,7 +633,7 @@ IHostMemory* build_engine_yolov7d6(unsigned int maxBatchSize, IBuilder* builder,
     IElementWiseLayer* conv100 = convBnSilu(network, weightMap, *conv99->getOutput(0), 192, 1, 1, 0, "model.100");
     IResizeLayer* re101 = network->addResize(*conv100->getOutput(0));
     re101->setResizeMode(ResizeMode::kNEAREST);
-    re101->setScales(scale, 3);
+    setResizeScales(re101, scale);
     IElementWiseLayer* conv102 = convBnSilu(network, weightMap, *conv27->getOutput(0), 192, 1, 1, 0, "model.102");
     ITensor* input_tensor_103[] = { conv102->getOutput(0), re101->getOutput(0) };
     IConcatenationLayer* concat103 = network->addConcatenation(input_tensor_103, 2);
@@ -742,11 +742,11 @@ IHostMemory* build_engine_yolov7d6(unsigned int maxBatchSize, IBuilder* builder,
     cv105_3->setName("cv105.3");
 
     /*------------detect-----------*/
-    auto yolo = addYoLoLayer(network, weightMap, "model.162", std::vector<IConvolutionLayer*>{cv105_0, cv105_1, cv105_2, cv105_3});
+    auto yolo = addYoLoLayer(network, weightMap, "model.162", std::vector<IConvolutionLayer*>{cv105_0, cv105_1, cv105_2, cv105_3}, input_w, input_h, ignore_thresh);
     yolo->getOutput(0)->setName(kOutputTensorName);
     network->markOutput(*yolo->getOutput(0));
     // Build engine
-    builder->setMaxBatchSize(maxBatchSize);
+    setBatchSize(builder, config, network, maxBatchSize, input_w, input_h);
     config->setMaxWorkspaceSize(16 * (1 << 20));  // 16MB
 #if defined(USE_FP16)
     config->setFlag(BuilderFlag::kFP16);
@@ -754,7 +754,7 @@ IHostMemory* build_engine_yolov7d6(unsigned int maxBatchSize, IBuilder* builder,
     std::cout << "Your platform support int8: " << (builder->platformHasFastInt8() ? "true" : "false") << std::endl;
     assert(builder->platformHasFastInt8());
     config->setFlag(BuilderFlag::kINT8);
-    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, kInputW, kInputH, "./coco_calib/", "int8calib.table", kInputTensorName);
+    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, input_w, input_h, "./coco_calib/", "int8calib.table", kInputTensorName);
     config->setInt8Calibrator(calibrator);
 #endif
 
@@ -772,11 +772,11 @@ IHostMemory* build_engine_yolov7d6(unsigned int maxBatchSize, IBuilder* builder,
     return serialized_model;
 }
 
-IHostMemory* build_engine_yolov7e6(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path) {
+IHostMemory* build_engine_yolov7e6(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path, int input_w, int input_h, float ignore_thresh, bool explicit_batch) {
     std::map<std::string, Weights> weightMap = loadWeights(wts_path);
 
-    INetworkDefinition* network = builder->createNetworkV2(0U);
-    ITensor* data = network->addInput(kInputTensorName, dt, Dims3{ 3, kInputH, kInputW });
+    INetworkDefinition* network = createNetwork(builder, explicit_batch);
+    ITensor* data = addImageInput(network, dt, input_w, input_h);
     assert(data);
 
     /*----------------------------------yolov7e6 backbone-----------------------------------------*/
@@ -869,7 +869,7 @@ IHostMemory* build_engine_yolov7e6(unsigned int maxBatchSize, IBuilder* builder,
     float scale[] = { 1.0, 2.0, 2.0 };
     IResizeLayer* re59 = network->addResize(*conv58->getOutput(0));
     re59->setResizeMode(ResizeMode::kNEAREST);
-    re59->setScales(scale, 3);
+    setResizeScales(re59, scale);
 
     IElementWiseLayer* conv60 = convBnSilu(network, weightMap, *conv45->getOutput(0), 480, 1, 1, 0, "model.60");
     ITensor* input_tensor_61[] = { conv60->getOutput(0), re59->getOutput(0) };
@@ -892,7 +892,7 @@ IHostMemory* build_engine_yolov7e6(unsigned int maxBatchSize, IBuilder* builder,
     IElementWiseLayer* conv72 = convBnSilu(network, weightMap, *conv71->getOutput(0), 320, 1, 1, 0, "model.72");
     IResizeLayer* re73 = network->addResize(*conv72->getOutput(0));
     re73->setResizeMode(ResizeMode::kNEAREST);
-    re73->setScales(scale, 3);
+    setResizeScales(re73, scale);
     IElementWiseLayer* conv74 = convBnSilu(network, weightMap, *conv34->getOutput(0), 320, 1, 1, 0, "model.74");
     ITensor* input_tensor_75[] = { conv74->getOutput(0), re73->getOutput(0) };
     IConcatenationLayer* concat75 = network->addConcatenation(input_tensor_75, 2);
@@ -916,7 +916,7 @@ IHostMemory* build_engine_yolov7e6(unsigned int maxBatchSize, IBuilder* builder,
     IElementWiseLayer* conv86 = convBnSilu(network, weightMap, *conv85->getOutput(0), 160, 1, 1, 0, "model.86");
     IResizeLayer* re87 = network->addResize(*conv86->getOutput(0));
     re87->setResizeMode(ResizeMode::kNEAREST);
-    re87->setScales(scale, 3);
+    setResizeScales(re87, scale);
     IElementWiseLayer* conv88 = convBnSilu(network, weightMap, *conv23->getOutput(0), 160, 1, 1, 0, "model.88");
     ITensor* input_tensor_89[] = { conv88->getOutput(0), re87->getOutput(0) };
     IConcatenationLayer* concat89 = network->addConcatenation(input_tensor_89, 2);
@@ -1013,11 +1013,11 @@ IHostMemory* build_engine_yolov7e6(unsigned int maxBatchSize, IBuilder* builder,
     cv105_3->setName("cv105.3");
 
     /*------------detect-----------*/
-    auto yolo = addYoLoLayer(network, weightMap, "model.140", std::vector<IConvolutionLayer*>{cv105_0, cv105_1, cv105_2, cv105_3});
+    auto yolo = addYoLoLayer(network, weightMap, "model.140", std::vector<IConvolutionLayer*>{cv105_0, cv105_1, cv105_2, cv105_3}, input_w, input_h, ignore_thresh);
     yolo->getOutput(0)->setName(kOutputTensorName);
     network->markOutput(*yolo->getOutput(0));
     // Build engine
-    builder->setMaxBatchSize(maxBatchSize);
+    setBatchSize(builder, config, network, maxBatchSize, input_w, input_h);
     config->setMaxWorkspaceSize(16 * (1 << 20));  // 16MB
 #if defined(USE_FP16)
     config->setFlag(BuilderFlag::kFP16);
@@ -1025,7 +1025,7 @@ IHostMemory* build_engine_yolov7e6(unsigned int maxBatchSize, IBuilder* builder,
     std::cout << "Your platform support int8: " << (builder->platformHasFastInt8() ? "true" : "false") << std::endl;
     assert(builder->platformHasFastInt8());
     config->setFlag(BuilderFlag::kINT8);
-    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, kInputW, kInputH, "./coco_calib/", "int8calib.table", kInputTensorName);
+    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, input_w, input_h, "./coco_calib/", "int8calib.table", kInputTensorName);
     config->setInt8Calibrator(calibrator);
 #endif
 
@@ -1043,11 +1043,11 @@ IHostMemory* build_engine_yolov7e6(unsigned int maxBatchSize, IBuilder* builder,
     return serialized_model;
 }
 
-IHostMemory* build_engine_yolov7w6(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path) {
+IHostMemory* build_engine_yolov7w6(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path, int input_w, int input_h, float ignore_thresh, bool explicit_batch) {
     std::map<std::string, Weights> weightMap = loadWeights(wts_path);
 
-    INetworkDefinition* network = builder->createNetworkV2(0U);
-    ITensor* data = network->addInput(kInputTensorName, dt, Dims3{ 3, kInputH, kInputW });
+    INetworkDefinition* network = createNetwork(builder, explicit_batch);
+    ITensor* data = addImageInput(network, dt, input_w, input_h);
     assert(data);
 
     /*----------------------------------yolov7w6 backbone-----------------------------------------*/
@@ -1127,7 +1127,7 @@ IHostMemory* build_engine_yolov7w6(unsigned int maxBatchSize, IBuilder* builder,
     float scale[] = { 1.0, 2.0, 2.0 };
     IResizeLayer* re49 = network->addResize(*conv48->getOutput(0));
     re49->setResizeMode(ResizeMode::kNEAREST);
-    re49->setScales(scale, 3);
+    setResizeScales(re49, scale);
 
     IElementWiseLayer* conv50 = convBnSilu(network, weightMap, *conv37->getOutput(0), 384, 1, 1, 0, "model.50");
     ITensor* input_tensor_51[] = { conv50->getOutput(0), re49->getOutput(0) };
@@ -1148,7 +1148,7 @@ IHostMemory* build_engine_yolov7w6(unsigned int maxBatchSize, IBuilder* builder,
     IElementWiseLayer* conv60 = convBnSilu(network, weightMap, *conv59->getOutput(0), 256, 1, 1, 0, "model.60");
     IResizeLayer* re61 = network->addResize(*conv60->getOutput(0));
     re61->setResizeMode(ResizeMode::kNEAREST);
-    re61->setScales(scale, 3);
+    setResizeScales(re61, scale);
     IElementWiseLayer* conv62 = convBnSilu(network, weightMap, *conv28->getOutput(0), 256, 1, 1, 0, "model.62");
     ITensor* input_tensor_63[] = { conv62->getOutput(0), re61->getOutput(0) };
     IConcatenationLayer* concat63 = network->addConcatenation(input_tensor_63, 2);
@@ -1167,7 +1167,7 @@ IHostMemory* build_engine_yolov7w6(unsigned int maxBatchSize, IBuilder* builder,
     IElementWiseLayer* conv72 = convBnSilu(network, weightMap, *conv71->getOutput(0), 128, 1, 1, 0, "model.72");
     IResizeLayer* re73 = network->addResize(*conv72->getOutput(0));
     re73->setResizeMode(ResizeMode::kNEAREST);
-    re73->setScales(scale, 3);
+    setResizeScales(re73, scale);
 
     IElementWiseLayer* conv74 = convBnSilu(network, weightMap, *conv19->getOutput(0), 128, 1, 1, 0, "model.74");
     ITensor* input_tensor_75[] = { conv74->getOutput(0), re73->getOutput(0) };
@@ -1251,11 +1251,11 @@ IHostMemory* build_engine_yolov7w6(unsigned int maxBatchSize, IBuilder* builder,
     cv105_3->setName("cv105.3");
 
     /*------------detect-----------*/
-    auto yolo = addYoLoLayer(network, weightMap, "model.118", std::vector<IConvolutionLayer*>{cv105_0, cv105_1, cv105_2, cv105_3});
+    auto yolo = addYoLoLayer(network, weightMap, "model.118", std::vector<IConvolutionLayer*>{cv105_0, cv105_1, cv105_2, cv105_3}, input_w, input_h, ignore_thresh);
     yolo->getOutput(0)->setName(kOutputTensorName);
     network->markOutput(*yolo->getOutput(0));
     // Build engine
-    builder->setMaxBatchSize(maxBatchSize);
+    setBatchSize(builder, config, network, maxBatchSize, input_w, input_h);
     config->setMaxWorkspaceSize(16 * (1 << 20));  // 16MB
 #if defined(USE_FP16)
     config->setFlag(BuilderFlag::kFP16);
@@ -1263,7 +1263,7 @@ IHostMemory* build_engine_yolov7w6(unsigned int maxBatchSize, IBuilder* builder,
     std::cout << "Your platform support int8: " << (builder->platformHasFastInt8() ? "true" : "false") << std::endl;
     assert(builder->platformHasFastInt8());
     config->setFlag(BuilderFlag::kINT8);
-    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, kInputW, kInputH, "./coco_calib/", "int8calib.table", kInputTensorName);
+    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, input_w, input_h, "./coco_calib/", "int8calib.table", kInputTensorName);
     config->setInt8Calibrator(calibrator);
 #endif
 
@@ -1281,11 +1281,11 @@ IHostMemory* build_engine_yolov7w6(unsigned int maxBatchSize, IBuilder* builder,
     return serialized_model;
 }
 
-IHostMemory* build_engine_yolov7x(unsigned int maxBatchSize,IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path) {
+IHostMemory* build_engine_yolov7x(unsigned int maxBatchSize,IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path, int input_w, int input_h, float ignore_thresh, bool explicit_batch) {
     std::map<std::string, Weights> weightMap = loadWeights(wts_path);
 
-    INetworkDefinition* network = builder->createNetworkV2(0U);
-    ITensor* data = network->addInput(kInputTensorName, dt, Dims3{ 3, kInputH, kInputW });
+    INetworkDefinition* network = createNetwork(builder, explicit_batch);
+    ITensor* data = addImageInput(network, dt, input_w, input_h);
     assert(data);
 
     /*----------------------------------yolov7x backbone-----------------------------------------*/
@@ -1404,7 +1404,7 @@ IHostMemory* build_engine_yolov7x(unsigned int maxBatchSize,IBuilder* builder, I
     float scale[] = { 1.0, 2.0, 2.0 };
     IResizeLayer* re61 = network->addResize(*conv60->getOutput(0));
     re61->setResizeMode(ResizeMode::kNEAREST);
-    re61->setScales(scale, 3);
+    setResizeScales(re61, scale);
 
     IElementWiseLayer* conv62 = convBnSilu(network, weightMap, *conv43->getOutput(0), 320, 1, 1, 0, "model.62");
 
@@ -1433,7 +1433,7 @@ IHostMemory* build_engine_yolov7x(unsigned int maxBatchSize,IBuilder* builder, I
 
     IResizeLayer* re75 = network->addResize(*conv74->getOutput(0));
     re75->setResizeMode(ResizeMode::kNEAREST);
-    re75->setScales(scale, 3);
+    setResizeScales(re75, scale);
 
 
     IElementWiseLayer* conv76 = convBnSilu(network, weightMap, *conv28->getOutput(0), 160, 1, 1, 0, "model.76");
@@ -1534,11 +1534,11 @@ IHostMemory* build_engine_yolov7x(unsigned int maxBatchSize,IBuilder* builder, I
     assert(det2);
     det2->setName("det2");
 
-    auto yolo = addYoLoLayer(network, weightMap, "model.121", std::vector<IConvolutionLayer*>{det0, det1, det2});
+    auto yolo = addYoLoLayer(network, weightMap, "model.121", std::vector<IConvolutionLayer*>{det0, det1, det2}, input_w, input_h, ignore_thresh);
     yolo->getOutput(0)->setName(kOutputTensorName);
     network->markOutput(*yolo->getOutput(0));
 
-    builder->setMaxBatchSize(maxBatchSize);
+    setBatchSize(builder, config, network, maxBatchSize, input_w, input_h);
     config->setMaxWorkspaceSize(16 * (1 << 20));
 #if defined(USE_FP16)
     config->setFlag(BuilderFlag::kFP16);
@@ -1546,7 +1546,7 @@ IHostMemory* build_engine_yolov7x(unsigned int maxBatchSize,IBuilder* builder, I
     std::cout << "Your platform support int8: " << (builder->platformHasFastInt8() ? "true" : "false") << std::endl;
     assert(builder->platformHasFastInt8());
     config->setFlag(BuilderFlag::kINT8);
-    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, kInputW, kInputH, "./coco_calib/", "int8calib.table", kInputTensorName);
+    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, input_w, input_h, "./coco_calib/", "int8calib.table", kInputTensorName);
     config->setInt8Calibrator(calibrator);
 #endif
 
@@ -1564,11 +1564,11 @@ IHostMemory* build_engine_yolov7x(unsigned int maxBatchSize,IBuilder* builder, I
     return serialized_model;
 }
 
-IHostMemory* build_engine_yolov7(unsigned int maxBatchSize,IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path) {
+IHostMemory* build_engine_yolov7(unsigned int maxBatchSize,IBuilder* builder, IBuilderConfig* config, DataType dt, const std::string& wts_path, int input_w, int input_h, float ignore_thresh, bool explicit_batch) {
     std::map<std::string, Weights> weightMap = loadWeights(wts_path);
 
-    INetworkDefinition* network = builder->createNetworkV2(0U);
-    ITensor* data = network->addInput(kInputTensorName, dt, Dims3{ 3, kInputH, kInputW });
+    INetworkDefinition* network = createNetwork(builder, explicit_batch);
+    ITensor* data = addImageInput(network, dt, input_w, input_h);
     assert(data);
     /*----------------------------------yolov7 backbone-----------------------------------------*/
     IElementWiseLayer* conv0 = convBnSilu(network, weightMap, *data, 32, 3, 1, 1, "model.0");
@@ -1650,7 +1650,7 @@ IHostMemory* build_engine_yolov7(unsigned int maxBatchSize,IBuilder* builder, IB
     float scale[] = { 1.0, 2.0, 2.0 };
     IResizeLayer* re53 = network->addResize(*conv52->getOutput(0));
     re53->setResizeMode(ResizeMode::kNEAREST);
-    re53->setScales(scale, 3);
+    setResizeScales(re53, scale);
     IElementWiseLayer* conv54 = convBnSilu(network, weightMap, *conv37->getOutput(0), 256, 1, 1, 0, "model.54");
     ITensor* input_tensor_55[] = { conv54->getOutput(0), re53->getOutput(0) };
     IConcatenationLayer* concat55 = network->addConcatenation(input_tensor_55, 2);
@@ -1670,7 +1670,7 @@ IHostMemory* build_engine_yolov7(unsigned int maxBatchSize,IBuilder* builder, IB
     IElementWiseLayer* conv64 = convBnSilu(network, weightMap, *conv63->getOutput(0), 128, 1, 1, 0, "model.64");
     IResizeLayer* re65 = network->addResize(*conv64->getOutput(0));
     re65->setResizeMode(ResizeMode::kNEAREST);
-    re65->setScales(scale, 3);
+    setResizeScales(re65, scale);
     IElementWiseLayer* conv66 = convBnSilu(network, weightMap, *conv24->getOutput(0), 128, 1, 1, 0, "model.66");
     ITensor* input_tensor_67[] = { conv66->getOutput(0), re65->getOutput(0) };
     IConcatenationLayer* concat67 = network->addConcatenation(input_tensor_67, 2);
@@ -1742,11 +1742,11 @@ IHostMemory* build_engine_yolov7(unsigned int maxBatchSize,IBuilder* builder, IB
     assert(cv105_2);
     cv105_2->setName("cv105.2");
 
-    auto yolo = addYoLoLayer(network, weightMap, "model.105", std::vector<IConvolutionLayer*>{cv105_0, cv105_1, cv105_2});
+    auto yolo = addYoLoLayer(network, weightMap, "model.105", std::vector<IConvolutionLayer*>{cv105_0, cv105_1, cv105_2}, input_w, input_h, ignore_thresh);
     yolo->getOutput(0)->setName(kOutputTensorName);
     network->markOutput(*yolo->getOutput(0));
 
-    builder->setMaxBatchSize(maxBatchSize);
+    setBatchSize(builder, config, network, maxBatchSize, input_w, input_h);
     config->setMaxWorkspaceSize(16 * (1 << 20));
 #if defined(USE_FP16)
     config->setFlag(BuilderFlag::kFP16);
@@ -1754,7 +1754,7 @@ IHostMemory* build_engine_yolov7(unsigned int maxBatchSize,IBuilder* builder, IB
     std::cout << "Your platform support int8: " << (builder->platformHasFastInt8() ? "true" : "false") << std::endl;
     assert(builder->platformHasFastInt8());
     config->setFlag(BuilderFlag::kINT8);
-    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, kInputW, kInputH, "./coco_calib/", "int8calib.table", kInputTensorName);
+    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, input_w, input_h, "./coco_calib/", "int8calib.table", kInputTensorName);
     config->setInt8Calibrator(calibrator);
 #endif
 
@@ -1772,10 +1772,10 @@ IHostMemory* build_engine_yolov7(unsigned int maxBatchSize,IBuilder* builder, IB
     return serialized_model;
 }
 
-IHostMemory* build_engine_yolov7_tiny(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, std::string& wts_name) {
-    INetworkDefinition* network = builder->createNetworkV2(0U);
+IHostMemory* build_engine_yolov7_tiny(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, std::string& wts_name, int input_w, int input_h, float ignore_thresh, bool explicit_batch) {
+    INetworkDefinition* network = createNetwork(builder, explicit_batch);
 
-    ITensor* data = network->addInput(kInputTensorName, dt, Dims3{ 3, kInputH, kInputW });
+    ITensor* data = addImageInput(network, dt, input_w, input_h);
     assert(data);
     std::map<std::string, Weights> weightMap = loadWeights(wts_name);
 
@@ -1941,7 +1941,7 @@ IHostMemory* build_engine_yolov7_tiny(unsigned int maxBatchSize, IBuilder* build
     float scale[] = { 1.0, 2.0, 2.0 };
     IResizeLayer* resize39 = network->addResize(*conv38->getOutput(0));
     resize39->setResizeMode(ResizeMode::kNEAREST);
-    resize39->setScales(scale, 3);
+    setResizeScales(resize39, scale);
 
     //    [21, 1, Conv, [128, 1, 1, None, 1, nn.LeakyReLU(0.1)]], # route backbone P4 ---->conv16
     auto conv40 = convBlockLeakRelu(network, weightMap, *conv21->getOutput(0), 128, 1, 1, 0, "model.40");
@@ -1981,7 +1981,7 @@ IHostMemory* build_engine_yolov7_tiny(unsigned int maxBatchSize, IBuilder* build
 
     IResizeLayer* resize49 = network->addResize(*conv48->getOutput(0));
     resize49->setResizeMode(ResizeMode::kNEAREST);
-    resize49->setScales(scale, 3);
+    setResizeScales(resize49, scale);
 
     // [14, 1, Conv, [64, 1, 1, None, 1, nn.LeakyReLU(0.1)]], # route backbone P3 conv11
     auto conv50 = convBlockLeakRelu(network, weightMap, *conv14->getOutput(0), 64, 1, 1, 0, "model.50");
@@ -2093,11 +2093,11 @@ IHostMemory* build_engine_yolov7_tiny(unsigned int maxBatchSize, IBuilder* build
 
     IConvolutionLayer* det2 = network->addConvolutionNd(*conv76->getOutput(0), 3 * (kNumClass + 5), DimsHW{ 1, 1 }, weightMap["model.77.m.2.weight"], weightMap["model.77.m.2.bias"]);
 
-    auto yolo = addYoLoLayer(network, weightMap, "model.77", std::vector<IConvolutionLayer*>{det0, det1, det2});
+    auto yolo = addYoLoLayer(network, weightMap, "model.77", std::vector<IConvolutionLayer*>{det0, det1, det2}, input_w, input_h, ignore_thresh);
     yolo->getOutput(0)->setName(kOutputTensorName);
     network->markOutput(*yolo->getOutput(0));
     // Build engine
-    builder->setMaxBatchSize(maxBatchSize);
+    setBatchSize(builder, config, network, maxBatchSize, input_w, input_h);
     config->setMaxWorkspaceSize(16 * (1 << 20));  // 16MB
 #if defined(USE_FP16)
     config->setFlag(BuilderFlag::kFP16);
@@ -2105,7 +2105,7 @@ IHostMemory* build_engine_yolov7_tiny(unsigned int maxBatchSize, IBuilder* build
     std::cout << "Your platform support int8: " << (builder->platformHasFastInt8() ? "true" : "false") << std::endl;
     assert(builder->platformHasFastInt8());
     config->setFlag(BuilderFlag::kINT8);
-    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, kInputW, kInputH, "./coco_calib/", "int8calib.table", kInputTensorName);
+    Int8EntropyCalibrator2* calibrator = new Int8EntropyCalibrator2(1, input_w, input_h, "./coco_calib/", "int8calib.table", kInputTensorName);
     config->setInt8Calibrator(calibrator);
 #endif
 
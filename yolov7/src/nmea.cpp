@@ -0,0 +1,247 @@
+#include "nmea.h"
+#include <cmath>
+#include <cstring>
+
+// Exactly representable, so mantissa / kPow10[n] is correctly rounded
+static const double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const float kKnotsToMs = 0.514444f;
+
+// PLSATTIT field positions, see nmea.h. Status, latitude and longitude are
+// the ones readgpstocube_5hz.py used; yaw, pitch, roll and altitude are
+// unverified guesses.
+static const int kAttStatus = 3;
+static const int kAttYaw = 4;    // unverified
+static const int kAttPitch = 5;  // unverified
+static const int kAttRoll = 6;   // unverified
+static const int kAttLat = 9;
+static const int kAttLon = 10;
+static const int kAttAlt = 11;   // unverified
+
+bool parse_decimal(const char* begin, const char* end, double& value) {
+  const char* p = begin;
+  bool neg = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    neg = *p == '-';
+    p++;
+  }
+  uint64_t mantissa = 0;
+  int digits = 0;  // significant digits in mantissa
+  int frac = 0;    // digits after the point kept in mantissa
+  int scale = 0;   // integer digits dropped beyond 18 significant ones
+  bool any = false;
+  bool dot = false;
+  for (; p < end; p++) {
+    char c = *p;
+    if (c >= '0' && c <= '9') {
+      any = true;
+      if (digits < 18) {
+        mantissa = mantissa * 10 + (c - '0');
+        if (mantissa != 0) digits++;
+        if (dot) frac++;
+      } else if (!dot) {
+        scale++;
+      }
+    } else if (c == '.' && !dot) {
+      dot = true;
+    } else {
+      return false;
+    }
+  }
+  if (!any) return false;
+  double v = (double)mantissa;
+  while (scale > 0) {
+    int n = scale > 22 ? 22 : scale;
+    v *= kPow10[n];
+    scale -= n;
+  }
+  while (frac > 0) {
+    int n = frac > 22 ? 22 : frac;
+    v /= kPow10[n];
+    frac -= n;
+  }
+  value = neg ? -v : v;
+  return true;
+}
+
+bool parse_int(const char* begin, const char* end, int& value) {
+  const char* p = begin;
+  bool neg = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    neg = *p == '-';
+    p++;
+  }
+  if (p == end || end - p > 9) return false;
+  int v = 0;
+  for (; p < end; p++) {
+    if (*p < '0' || *p > '9') return false;
+    v = v * 10 + (*p - '0');
+  }
+  value = neg ? -v : v;
+  return true;
+}
+
+bool parse_nmea_coord(const char* begin, const char* end, char hemisphere, double& degrees) {
+  double v;
+  if (!parse_decimal(begin, end, v) || v < 0) return false;
+  double deg = std::floor(v / 100.0);
+  double minutes = v - deg * 100.0;
+  if (minutes >= 60.0) return false;
+  degrees = deg + minutes / 60.0;
+  if (hemisphere == 'S' || hemisphere == 'W') {
+    degrees = -degrees;
+  } else if (hemisphere != 'N' && hemisphere != 'E') {
+    return false;
+  }
+  return true;
+}
+
+static bool parse_float(const char* begin, const char* end, float& value) {
+  double v;
+  if (!parse_decimal(begin, end, v)) return false;
+  value = (float)v;
+  return true;
+}
+
+// hhmmss.ss to seconds of day
+static bool parse_utc(const char* begin, const char* end, double& seconds) {
+  if (end - begin < 6) return false;
+  int hh, mm;
+  double ss;
+  if (!parse_int(begin, begin + 2, hh) || !parse_int(begin + 2, begin + 4, mm) || !parse_decimal(begin + 4, end, ss)) return false;
+  seconds = hh * 3600.0 + mm * 60.0 + ss;
+  return true;
+}
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+bool NmeaParser::next(const char*& data, const char* end, NmeaSentence& out) {
+  const char* start = data;
+  while (data < end) {
+    char c = *data++;
+    if (c == '$') {
+      // Also resynchronizes on a sentence that lost its line end
+      in_sentence_ = true;
+      overflow_ = false;
+      len_ = 0;
+    } else if (!in_sentence_) {
+      continue;
+    } else if (c == '\r' || c == '\n') {
+      in_sentence_ = false;
+      if (overflow_) {
+        stats_.overflows++;
+      } else if (parse_line(out)) {
+        stats_.bytes += data - start;
+        return true;
+      }
+      continue;
+    }
+    if (len_ < kMaxLine) {
+      line_[len_++] = c;
+    } else {
+      overflow_ = true;
+    }
+  }
+  stats_.bytes += data - start;
+  return false;
+}
+
+bool NmeaParser::parse_line(NmeaSentence& out) {
+  // line_ holds "$" fields ["*" hh], checksum is the XOR between $ and *
+  const char* p = line_ + 1;
+  const char* end = line_ + len_;
+  const char* star = nullptr;
+  uint8_t sum = 0;
+  for (const char* q = p; q < end; q++) {
+    if (*q == '*') {
+      star = q;
+      break;
+    }
+    sum ^= (uint8_t)*q;
+  }
+  bool checked = star != nullptr;
+  if (checked) {
+    int hi = end - star >= 3 ? hex_digit(star[1]) : -1;
+    int lo = end - star >= 3 ? hex_digit(star[2]) : -1;
+    const char* tail = star + 3;
+    while (tail < end && (*tail == ' ' || *tail == '\t')) tail++;
+    if (hi < 0 || lo < 0 || tail < end || ((hi << 4) | lo) != sum) {
+      stats_.checksum_errors++;
+      return false;
+    }
+    end = star;
+  }
+
+  const char* fb[kMaxFields];
+  const char* fe[kMaxFields];
+  int n = 0;
+  fb[0] = p;
+  for (const char* q = p; q < end && n < kMaxFields - 1; q++) {
+    if (*q == ',') {
+      fe[n++] = q;
+      fb[n] = q + 1;
+    }
+  }
+  fe[n++] = end;
+  for (int i = n; i < kMaxFields; i++) fb[i] = fe[i] = end;
+
+  size_t tag = fe[0] - fb[0];
+  NmeaSentence s;
+  memset(&s, 0, sizeof(s));
+  bool ok;
+  if (tag == 8 && memcmp(fb[0], "PLSATTIT", 8) == 0) {
+    s.type = kNmeaPlsattit;
+    ok = parse_int(fb[kAttStatus], fe[kAttStatus], s.fix_quality);
+    s.valid = ok && s.fix_quality == 3;
+    if (fb[1] != fe[1]) ok = ok && parse_utc(fb[1], fe[1], s.utc_seconds);
+    if (s.valid) {
+      ok = ok && parse_decimal(fb[kAttLat], fe[kAttLat], s.lat) && parse_decimal(fb[kAttLon], fe[kAttLon], s.lon);
+      s.has_position = ok;
+    }
+    s.has_attitude = parse_float(fb[kAttYaw], fe[kAttYaw], s.yaw) && parse_float(fb[kAttPitch], fe[kAttPitch], s.pitch) &&
+                     parse_float(fb[kAttRoll], fe[kAttRoll], s.roll);
+    s.has_alt = parse_float(fb[kAttAlt], fe[kAttAlt], s.alt);
+  } else if (tag == 5 && fb[0][0] == 'G' && memcmp(fb[0] + 2, "RMC", 3) == 0) {
+    s.type = kNmeaGnrmc;
+    ok = n >= 9 && fe[2] - fb[2] == 1;
+    s.valid = ok && fb[2][0] == 'A';
+    if (ok && fb[1] != fe[1]) ok = parse_utc(fb[1], fe[1], s.utc_seconds);
+    if (ok && s.valid) {
+      ok = fe[4] - fb[4] == 1 && fe[6] - fb[6] == 1 && parse_nmea_coord(fb[3], fe[3], fb[4][0], s.lat) &&
+           parse_nmea_coord(fb[5], fe[5], fb[6][0], s.lon);
+      s.has_position = ok;
+    }
+    if (parse_float(fb[7], fe[7], s.speed)) s.speed *= kKnotsToMs;
+    parse_float(fb[8], fe[8], s.course);
+  } else if (tag == 5 && fb[0][0] == 'G' && memcmp(fb[0] + 2, "GGA", 3) == 0) {
+    s.type = kNmeaGngga;
+    ok = n >= 10 && parse_int(fb[6], fe[6], s.fix_quality);
+    s.valid = ok && s.fix_quality > 0;
+    if (ok && fb[1] != fe[1]) ok = parse_utc(fb[1], fe[1], s.utc_seconds);
+    if (ok && s.valid) {
+      ok = fe[3] - fb[3] == 1 && fe[5] - fb[5] == 1 && parse_nmea_coord(fb[2], fe[2], fb[3][0], s.lat) &&
+           parse_nmea_coord(fb[4], fe[4], fb[5][0], s.lon);
+      s.has_position = ok;
+    }
+    parse_int(fb[7], fe[7], s.satellites);
+    parse_float(fb[8], fe[8], s.hdop);
+    s.has_alt = parse_float(fb[9], fe[9], s.alt);
+  } else {
+    stats_.ignored++;
+    return false;
+  }
+  if (!ok) {
+    stats_.malformed++;
+    return false;
+  }
+  if (!checked) stats_.unchecked++;
+  stats_.sentences++;
+  out = s;
+  return true;
+}
@@ -0,0 +1,180 @@
+#include "pipeline.h"
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <thread>
+
+static double ms_since(const std::chrono::steady_clock::time_point& t) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+Pipeline::Pipeline(int num_slots, int queue_capacity)
+    : num_slots_(num_slots), queue_capacity_(queue_capacity) {
+  assert(num_slots > 0 && queue_capacity > 0);
+}
+
+void Pipeline::add_stage(const std::string& name, int threads, int max_batch, StageFn fn, bool in_order) {
+  assert(threads > 0 && max_batch > 0);
+  assert(!in_order || threads == 1);
+  Stage stage;
+  stage.name = name;
+  stage.threads = threads;
+  stage.max_batch = max_batch;
+  stage.in_order = in_order;
+  stage.fn = fn;
+  stages_.push_back(std::move(stage));
+}
+
+void Pipeline::stage_worker(size_t index, int worker) {
+  Stage& stage = stages_[index];
+  BoundedQueue<FrameSlot*>& next = index + 1 < stages_.size() ? *stages_[index + 1].input : *done_;
+  std::vector<FrameSlot*> batch;
+  batch.reserve(stage.max_batch);
+  // in_order: slots that came in ahead of their turn. Like the sink's, it
+  // holds fewer than num_slots slots, so it can't deadlock.
+  std::map<uint64_t, FrameSlot*> early;
+  uint64_t next_seq = 0;
+  FrameSlot* slot = nullptr;
+  for (;;) {
+    batch.clear();
+    if (stage.in_order) {
+      while ((early.empty() || early.begin()->first != next_seq) && stage.input->pop(slot)) early[slot->seq] = slot;
+      while (stage.input->try_pop(slot)) early[slot->seq] = slot;
+      while ((int)batch.size() < stage.max_batch && !early.empty() && early.begin()->first == next_seq) {
+        batch.push_back(early.begin()->second);
+        early.erase(early.begin());
+        next_seq++;
+      }
+      if (batch.empty()) break;
+    } else {
+      if (!stage.input->pop(slot)) break;
+      batch.push_back(slot);
+      while ((int)batch.size() < stage.max_batch && stage.input->try_pop(slot)) batch.push_back(slot);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    stage.fn(batch, worker);
+    stage.busy_ms[worker] += ms_since(start);
+    stage.items[worker] += batch.size();
+    stage.batches[worker]++;
+
+    for (FrameSlot* s : batch) next.push(s);
+  }
+  assert(early.empty());
+}
+
+void Pipeline::run(SourceFn source, SinkFn sink) {
+  slots_.assign(num_slots_, FrameSlot());
+  free_.reset(new BoundedQueue<FrameSlot*>(num_slots_));
+  done_.reset(new BoundedQueue<FrameSlot*>(num_slots_));
+  for (auto& slot : slots_) free_->push(&slot);
+
+  std::vector<std::vector<std::thread>> workers(stages_.size());
+  for (size_t i = 0; i < stages_.size(); i++) {
+    Stage& stage = stages_[i];
+    stage.input.reset(new BoundedQueue<FrameSlot*>(queue_capacity_));
+    stage.items.assign(stage.threads, 0);
+    stage.batches.assign(stage.threads, 0);
+    stage.busy_ms.assign(stage.threads, 0.0);
+  }
+  for (size_t i = 0; i < stages_.size(); i++) {
+    for (int w = 0; w < stages_[i].threads; w++) {
+      workers[i].emplace_back(&Pipeline::stage_worker, this, i, w);
+    }
+  }
+
+  // Reorder buffer in front of the sink: hold slots until their turn comes.
+  // It can never hold more than num_slots - 1 slots, so it can't deadlock.
+  frames_ = 0;
+  std::thread sink_thread([this, &sink] {
+    std::map<uint64_t, FrameSlot*> pending;
+    uint64_t next_seq = 0;
+    FrameSlot* slot = nullptr;
+    while (done_->pop(slot)) {
+      pending[slot->seq] = slot;
+      while (!pending.empty() && pending.begin()->first == next_seq) {
+        FrameSlot* ready = pending.begin()->second;
+        pending.erase(pending.begin());
+        sink(*ready);
+        next_seq++;
+        free_->push(ready);
+      }
+    }
+    assert(pending.empty());
+    frames_ = next_seq;
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  BoundedQueue<FrameSlot*>& first = stages_.empty() ? *done_ : *stages_[0].input;
+  uint64_t seq = 0;
+  FrameSlot* slot = nullptr;
+  while (free_->pop(slot)) {
+    slot->seq = seq;
+    slot->name.clear();
+    slot->dets.clear();
+    slot->content_hash = 0;
+    slot->cached = false;
+    slot->pose = FramePose();
+    slot->targets.clear();
+    slot->track_ids.clear();
+    slot->motion = GlobalMotion();
+    slot->start = std::chrono::steady_clock::now();
+    if (!source(*slot)) {
+      free_->push(slot);
+      break;
+    }
+    seq++;
+    first.push(slot);
+  }
+
+  // Drain stage by stage so that nothing is closed while upstream still pushes
+  for (size_t i = 0; i < stages_.size(); i++) {
+    stages_[i].input->close();
+    for (auto& t : workers[i]) t.join();
+  }
+  done_->close();
+  sink_thread.join();
+  free_->close();
+  wall_ms_ = ms_since(start);
+}
+
+std::vector<StageStats> Pipeline::stats() const {
+  std::vector<StageStats> res;
+  for (const Stage& stage : stages_) {
+    StageStats s;
+    s.name = stage.name;
+    s.threads = stage.threads;
+    for (int w = 0; w < stage.threads && w < (int)stage.items.size(); w++) {
+      s.items += stage.items[w];
+      s.batches += stage.batches[w];
+      s.busy_ms += stage.busy_ms[w];
+    }
+    if (stage.input) {
+      s.queue_mean = stage.input->mean_occupancy();
+      s.queue_max = stage.input->max_occupancy();
+      s.queue_capacity = stage.input->capacity();
+    }
+    res.push_back(s);
+  }
+  return res;
+}
+
+void Pipeline::print_report() const {
+  double wall_s = wall_ms_ / 1000.0;
+  std::cout << "pipeline: " << frames_ << " frames in " << wall_ms_ << "ms, "
+            << (wall_s > 0 ? frames_ / wall_s : 0.0) << " fps" << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+  for (const StageStats& s : stats()) {
+    double util = wall_ms_ > 0 ? s.busy_ms / (wall_ms_ * s.threads) : 0.0;
+    std::cout << "  " << std::left << std::setw(12) << s.name << std::right
+              << " threads: " << s.threads
+              << "  items/s: " << (wall_s > 0 ? s.items / wall_s : 0.0)
+              << "  avg batch: " << (s.batches ? (double)s.items / s.batches : 0.0)
+              << "  ms/item: " << (s.items ? s.busy_ms / s.items : 0.0)
+              << "  busy: " << util * 100 << "%"
+              << "  queue mean/max/cap: " << s.queue_mean << "/" << s.queue_max << "/" << s.queue_capacity << std::endl;
+  }
+  std::cout.unsetf(std::ios::floatfield);
+  std::cout << std::setprecision(6);
+}
@@ -0,0 +1,294 @@
+#include "pipeline_config.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static std::string trim(const std::string& s) {
+  size_t b = s.find_first_not_of(" \t\r\n");
+  if (b == std::string::npos) return "";
+  size_t e = s.find_last_not_of(" \t\r\n");
+  return s.substr(b, e - b + 1);
+}
+
+template<typename T>
+static bool parse_value(const std::string& value, T& out) {
+  std::istringstream ss(value);
+  T v;
+  ss >> v;
+  if (ss.fail() || !ss.eof()) return false;
+  out = v;
+  return true;
+}
+
+static bool parse_value(const std::string& value, bool& out) {
+  if (value == "1" || value == "true") {
+    out = true;
+  } else if (value == "0" || value == "false") {
+    out = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool set_config_value(PipelineConfig& cfg, const std::string& key, const std::string& value) {
+  bool ok = false;
+  if (key == "conf_thresh") {
+    ok = parse_value(value, cfg.conf_thresh) && cfg.conf_thresh >= 0.f && cfg.conf_thresh <= 1.f;
+  } else if (key == "nms_thresh") {
+    ok = parse_value(value, cfg.nms_thresh) && cfg.nms_thresh >= 0.f && cfg.nms_thresh <= 1.f;
+  } else if (key == "batch_size") {
+    ok = parse_value(value, cfg.batch_size) && cfg.batch_size > 0;
+  } else if (key == "gpu_id") {
+    ok = parse_value(value, cfg.gpu_id) && cfg.gpu_id >= 0;
+  } else if (key == "max_input_image_size") {
+    ok = parse_value(value, cfg.max_input_image_size) && cfg.max_input_image_size > 0;
+  } else if (key == "ignore_thresh") {
+    ok = parse_value(value, cfg.ignore_thresh) && cfg.ignore_thresh >= 0.f && cfg.ignore_thresh <= 1.f;
+  } else if (key == "explicit_batch") {
+    ok = parse_value(value, cfg.explicit_batch);
+  } else if (key == "backend") {
+    ok = value == "trt" || value == "mock";
+    if (ok) cfg.backend = value;
+  } else if (key == "mock_latency_us") {
+    ok = parse_value(value, cfg.mock_latency_us) && cfg.mock_latency_us >= 0;
+  } else if (key == "mock_input_w") {
+    ok = parse_value(value, cfg.mock_input_w) && cfg.mock_input_w > 0 && cfg.mock_input_w % 32 == 0;
+  } else if (key == "mock_input_h") {
+    ok = parse_value(value, cfg.mock_input_h) && cfg.mock_input_h > 0 && cfg.mock_input_h % 32 == 0;
+  } else if (key == "infer_slots") {
+    ok = parse_value(value, cfg.infer_slots) && cfg.infer_slots > 0;
+  } else if (key == "infer_workers") {
+    ok = parse_value(value, cfg.infer_workers) && cfg.infer_workers > 0;
+  } else if (key == "worker_sweep") {
+    ok = parse_value(value, cfg.worker_sweep);
+  } else if (key == "pipeline_slots") {
+    ok = parse_value(value, cfg.pipeline_slots) && cfg.pipeline_slots > 0;
+  } else if (key == "capture_width") {
+    ok = parse_value(value, cfg.capture_width) && cfg.capture_width > 0;
+  } else if (key == "capture_height") {
+    ok = parse_value(value, cfg.capture_height) && cfg.capture_height > 0;
+  } else if (key == "capture_fps") {
+    ok = parse_value(value, cfg.capture_fps) && cfg.capture_fps > 0;
+  } else if (key == "capture_frames") {
+    ok = parse_value(value, cfg.capture_frames) && cfg.capture_frames >= 0;
+  } else if (key == "max_wait_us") {
+    ok = parse_value(value, cfg.max_wait_us) && cfg.max_wait_us >= 0;
+  } else if (key == "stream_pending") {
+    ok = parse_value(value, cfg.stream_pending) && cfg.stream_pending > 0;
+  } else if (key == "tile") {
+    ok = parse_value(value, cfg.tile);
+  } else if (key == "tile_overlap") {
+    ok = parse_value(value, cfg.tile_overlap) && cfg.tile_overlap >= 0.f && cfg.tile_overlap < 0.9f;
+  } else if (key == "tile_full_frame") {
+    ok = parse_value(value, cfg.tile_full_frame);
+  } else if (key == "tile_contain_thresh") {
+    ok = parse_value(value, cfg.tile_contain_thresh) && cfg.tile_contain_thresh > 0.f && cfg.tile_contain_thresh <= 1.f;
+  } else if (key == "tile_saliency_thresh") {
+    ok = parse_value(value, cfg.tile_saliency_thresh) && cfg.tile_saliency_thresh >= 0.f;
+  } else if (key == "tile_saliency_row_step") {
+    ok = parse_value(value, cfg.tile_saliency_row_step) && cfg.tile_saliency_row_step > 0;
+  } else if (key == "tile_force_scan") {
+    ok = parse_value(value, cfg.tile_force_scan) && cfg.tile_force_scan >= 0;
+  } else if (key == "roi") {
+    ok = parse_value(value, cfg.roi);
+  } else if (key == "roi_refresh") {
+    ok = parse_value(value, cfg.roi_refresh) && cfg.roi_refresh > 0;
+  } else if (key == "roi_margin") {
+    ok = parse_value(value, cfg.roi_margin) && cfg.roi_margin >= 0.f;
+  } else if (key == "roi_max_crops") {
+    ok = parse_value(value, cfg.roi_max_crops) && cfg.roi_max_crops > 0;
+  } else if (key == "roi_max_misses") {
+    ok = parse_value(value, cfg.roi_max_misses) && cfg.roi_max_misses >= 0;
+  } else if (key == "track") {
+    ok = parse_value(value, cfg.track);
+  } else if (key == "track_high_thresh") {
+    ok = parse_value(value, cfg.track_high_thresh) && cfg.track_high_thresh >= 0.f && cfg.track_high_thresh <= 1.f;
+  } else if (key == "track_low_thresh") {
+    ok = parse_value(value, cfg.track_low_thresh) && cfg.track_low_thresh >= 0.f && cfg.track_low_thresh <= 1.f;
+  } else if (key == "track_new_thresh") {
+    ok = parse_value(value, cfg.track_new_thresh) && cfg.track_new_thresh >= 0.f && cfg.track_new_thresh <= 1.f;
+  } else if (key == "track_max_misses") {
+    ok = parse_value(value, cfg.track_max_misses) && cfg.track_max_misses >= 0;
+  } else if (key == "ego_motion") {
+    ok = parse_value(value, cfg.ego_motion);
+  } else if (key == "ego_scale") {
+    ok = parse_value(value, cfg.ego_scale) && cfg.ego_scale > 0;
+  } else if (key == "ego_points") {
+    ok = parse_value(value, cfg.ego_points) && cfg.ego_points >= 16;
+  } else if (key == "ego_model") {
+    ok = value == "homography" || value == "affine";
+    if (ok) cfg.ego_model = value;
+  } else if (key == "skip_static") {
+    ok = parse_value(value, cfg.skip_static);
+  } else if (key == "change_scale") {
+    ok = parse_value(value, cfg.change_scale) && cfg.change_scale > 0;
+  } else if (key == "change_search") {
+    ok = parse_value(value, cfg.change_search) && cfg.change_search >= 0;
+  } else if (key == "change_block") {
+    ok = parse_value(value, cfg.change_block) && cfg.change_block > 0;
+  } else if (key == "change_block_thresh") {
+    ok = parse_value(value, cfg.change_block_thresh) && cfg.change_block_thresh >= 0.f;
+  } else if (key == "change_frac") {
+    ok = parse_value(value, cfg.change_frac) && cfg.change_frac >= 0.f && cfg.change_frac <= 1.f;
+  } else if (key == "max_skip") {
+    ok = parse_value(value, cfg.max_skip) && cfg.max_skip >= 0;
+  } else if (key == "cache_dir") {
+    // "none" turns the cache off
+    ok = true;
+    cfg.cache_dir = value == "none" ? "" : value;
+  } else if (key == "cache_max_mb") {
+    ok = parse_value(value, cfg.cache_max_mb) && cfg.cache_max_mb > 0;
+  } else if (key == "cache_purge") {
+    ok = parse_value(value, cfg.cache_purge);
+  } else if (key == "write_output") {
+    ok = parse_value(value, cfg.write_output);
+  } else if (key == "telemetry") {
+    // "none" turns pose tagging off
+    ok = true;
+    cfg.telemetry = value == "none" ? "" : value;
+  } else if (key == "telemetry_history") {
+    ok = parse_value(value, cfg.telemetry_history) && cfg.telemetry_history >= 2;
+  } else if (key == "telemetry_max_extrap_ms") {
+    ok = parse_value(value, cfg.telemetry_max_extrap_ms) && cfg.telemetry_max_extrap_ms >= 0;
+  } else if (key == "telemetry_max_gap_ms") {
+    ok = parse_value(value, cfg.telemetry_max_gap_ms) && cfg.telemetry_max_gap_ms > 0;
+  } else if (key == "camera_hfov_deg") {
+    ok = parse_value(value, cfg.camera_hfov_deg) && cfg.camera_hfov_deg > 0.f && cfg.camera_hfov_deg < 180.f;
+  } else if (key == "camera_calib") {
+    ok = true;
+    cfg.camera_calib = value == "none" ? "" : value;
+  } else if (key == "camera_tilt_deg") {
+    ok = parse_value(value, cfg.camera_tilt_deg) && cfg.camera_tilt_deg >= 0.f && cfg.camera_tilt_deg <= 90.f;
+  } else if (key == "ground_alt") {
+    ok = parse_value(value, cfg.ground_alt);
+  } else if (key == "geo_log") {
+    ok = true;
+    cfg.geo_log = value == "none" ? "" : value;
+  } else if (key == "dem") {
+    ok = true;
+    cfg.dem = value == "none" ? "" : value;
+  } else if (key == "dedup_log") {
+    ok = true;
+    cfg.dedup_log = value == "none" ? "" : value;
+  } else if (key == "dedup_sigma_m") {
+    ok = parse_value(value, cfg.dedup_sigma_m) && cfg.dedup_sigma_m > 0.f;
+  } else if (key == "dedup_sigma_deg") {
+    ok = parse_value(value, cfg.dedup_sigma_deg) && cfg.dedup_sigma_deg >= 0.f;
+  } else if (key == "dedup_gate") {
+    ok = parse_value(value, cfg.dedup_gate) && cfg.dedup_gate > 0.f;
+  } else if (key == "dedup_max_sigma_m") {
+    ok = parse_value(value, cfg.dedup_max_sigma_m) && cfg.dedup_max_sigma_m > 0.f;
+  } else if (key == "dedup_cell_m") {
+    ok = parse_value(value, cfg.dedup_cell_m) && cfg.dedup_cell_m > 0.f;
+  } else if (key == "dedup_min_obs") {
+    ok = parse_value(value, cfg.dedup_min_obs) && cfg.dedup_min_obs > 0;
+  } else {
+    std::cerr << "unknown config key: " << key << std::endl;
+    return false;
+  }
+  if (!ok) std::cerr << "invalid value for " << key << ": " << value << std::endl;
+  return ok;
+}
+
+bool load_pipeline_config(const std::string& path, PipelineConfig& cfg) {
+  std::ifstream file(path);
+  if (!file.good()) {
+    std::cerr << "read " << path << " error!" << std::endl;
+    return false;
+  }
+  std::string line;
+  int line_no = 0;
+  while (std::getline(file, line)) {
+    line_no++;
+    line = trim(line.substr(0, line.find('#')));
+    if (line.empty()) continue;
+    size_t eq = line.find('=');
+    if (eq == std::string::npos) {
+      std::cerr << path << ":" << line_no << ": expected key = value" << std::endl;
+      return false;
+    }
+    if (!set_config_value(cfg, trim(line.substr(0, eq)), trim(line.substr(eq + 1)))) {
+      std::cerr << path << ":" << line_no << ": bad config line" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool parse_pipeline_config(int argc, char** argv, int begin, PipelineConfig& cfg) {
+  if ((argc - begin) % 2 != 0) return false;
+  for (int i = begin; i < argc; i += 2) {
+    if (std::string(argv[i]) == "--config" && !load_pipeline_config(argv[i + 1], cfg)) return false;
+  }
+  for (int i = begin; i < argc; i += 2) {
+    std::string key(argv[i]);
+    if (key.compare(0, 2, "--") != 0) return false;
+    if (key == "--config") continue;
+    if (!set_config_value(cfg, key.substr(2), argv[i + 1])) return false;
+  }
+  return true;
+}
+
+void print_pipeline_config(const PipelineConfig& cfg) {
+  std::cout << "conf_thresh: " << cfg.conf_thresh
+            << ", nms_thresh: " << cfg.nms_thresh
+            << ", batch_size: " << cfg.batch_size
+            << ", gpu_id: " << cfg.gpu_id
+            << ", max_input_image_size: " << cfg.max_input_image_size
+            << ", ignore_thresh: " << cfg.ignore_thresh
+            << ", explicit_batch: " << cfg.explicit_batch
+            << ", backend: " << cfg.backend;
+  if (cfg.backend == "mock") std::cout << " (" << cfg.mock_input_w << "x" << cfg.mock_input_h << ")";
+  std::cout
+            << ", infer_slots: " << cfg.infer_slots
+            << ", infer_workers: " << cfg.infer_workers
+            << ", pipeline_slots: " << cfg.pipeline_slots
+            << ", capture: " << cfg.capture_width << "x" << cfg.capture_height << "@" << cfg.capture_fps
+            << ", max_wait_us: " << cfg.max_wait_us
+            << ", stream_pending: " << cfg.stream_pending
+            << ", tile: " << cfg.tile;
+  if (cfg.tile) {
+    std::cout << " (overlap " << cfg.tile_overlap << ", full_frame " << cfg.tile_full_frame
+              << ", contain_thresh " << cfg.tile_contain_thresh
+              << ", saliency_thresh " << cfg.tile_saliency_thresh << ")";
+  }
+  std::cout << ", roi: " << cfg.roi;
+  if (cfg.roi) {
+    std::cout << " (refresh " << cfg.roi_refresh << ", margin " << cfg.roi_margin
+              << ", max_crops " << cfg.roi_max_crops << ")";
+  }
+  std::cout << ", track: " << cfg.track;
+  if (cfg.track) {
+    std::cout << " (high " << cfg.track_high_thresh << ", low " << cfg.track_low_thresh << ", new "
+              << cfg.track_new_thresh << ", max_misses " << cfg.track_max_misses << ")";
+  }
+  std::cout << ", ego_motion: " << cfg.ego_motion;
+  if (cfg.ego_motion) {
+    std::cout << " (scale " << cfg.ego_scale << ", points " << cfg.ego_points << ", " << cfg.ego_model << ")";
+  }
+  std::cout << ", skip_static: " << cfg.skip_static;
+  if (cfg.skip_static) {
+    std::cout << " (block_thresh " << cfg.change_block_thresh << ", frac " << cfg.change_frac
+              << ", max_skip " << cfg.max_skip << ")";
+  }
+  std::cout << ", cache: " << (cfg.cache_dir.empty() ? "off" : cfg.cache_dir);
+  if (!cfg.cache_dir.empty()) std::cout << " (" << cfg.cache_max_mb << "MB)";
+  std::cout << ", write_output: " << cfg.write_output;
+  std::cout << ", telemetry: " << (cfg.telemetry.empty() ? "off" : cfg.telemetry);
+  if (!cfg.telemetry.empty()) {
+    std::cout << " (history " << cfg.telemetry_history << ", max_extrap " << cfg.telemetry_max_extrap_ms
+              << "ms, max_gap " << cfg.telemetry_max_gap_ms << "ms)";
+    std::cout << ", camera: hfov " << cfg.camera_hfov_deg << ", tilt " << cfg.camera_tilt_deg << ", calib "
+              << (cfg.camera_calib.empty() ? "off" : cfg.camera_calib)
+              << ", ground_alt " << cfg.ground_alt << ", dem: " << (cfg.dem.empty() ? "off" : cfg.dem)
+              << ", geo_log: " << (cfg.geo_log.empty() ? "off" : cfg.geo_log);
+    std::cout << ", dedup_log: " << (cfg.dedup_log.empty() ? "off" : cfg.dedup_log);
+    if (!cfg.dedup_log.empty()) {
+      std::cout << " (sigma " << cfg.dedup_sigma_m << "m + " << cfg.dedup_sigma_deg << "deg, gate " << cfg.dedup_gate
+                << ", max_sigma " << cfg.dedup_max_sigma_m << "m, cell " << cfg.dedup_cell_m << "m, min_obs "
+                << cfg.dedup_min_obs << ")";
+    }
+  }
+  std::cout << std::endl;
+}
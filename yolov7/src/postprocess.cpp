@@ -1,21 +1,25 @@
 #include "postprocess.h"
 
-cv::Rect get_rect(cv::Mat& img, float bbox[4]) {
+cv::Rect get_rect(cv::Mat& img, float bbox[4], int input_w, int input_h) {
+  return get_rect(img.cols, img.rows, bbox, input_w, input_h);
+}
+
+cv::Rect get_rect(int img_w, int img_h, const float bbox[4], int input_w, int input_h) {
   float l, r, t, b;
-  float r_w = kInputW / (img.cols * 1.0);
-  float r_h = kInputH / (img.rows * 1.0);
+  float r_w = input_w / (img_w * 1.0);
+  float r_h = input_h / (img_h * 1.0);
   if (r_h > r_w) {
     l = bbox[0] - bbox[2] / 2.f;
     r = bbox[0] + bbox[2] / 2.f;
-    t = bbox[1] - bbox[3] / 2.f - (kInputH - r_w * img.rows) / 2;
-    b = bbox[1] + bbox[3] / 2.f - (kInputH - r_w * img.rows) / 2;
+    t = bbox[1] - bbox[3] / 2.f - (input_h - r_w * img_h) / 2;
+    b = bbox[1] + bbox[3] / 2.f - (input_h - r_w * img_h) / 2;
     l = l / r_w;
     r = r / r_w;
     t = t / r_w;
     b = b / r_w;
   } else {
-    l = bbox[0] - bbox[2] / 2.f - (kInputW - r_h * img.cols) / 2;
-    r = bbox[0] + bbox[2] / 2.f - (kInputW - r_h * img.cols) / 2;
+    l = bbox[0] - bbox[2] / 2.f - (input_w - r_h * img_w) / 2;
+    r = bbox[0] + bbox[2] / 2.f - (input_w - r_h * img_w) / 2;
     t = bbox[1] - bbox[3] / 2.f;
     b = bbox[1] + bbox[3] / 2.f;
     l = l / r_h;
@@ -26,7 +30,7 @@ cv::Rect get_rect(cv::Mat& img, float bbox[4]) {
   return cv::Rect(round(l), round(t), round(r - l), round(b - t));
 }
 
-static float iou(float lbox[4], float rbox[4]) {
+float iou(const float lbox[4], const float rbox[4]) {
   float interBox[] = {
     (std::max)(lbox[0] - lbox[2] / 2.f , rbox[0] - rbox[2] / 2.f), //left
     (std::min)(lbox[0] + lbox[2] / 2.f , rbox[0] + rbox[2] / 2.f), //right
@@ -45,7 +49,7 @@ static bool cmp(const Detection& a, const Detection& b) {
   return a.conf > b.conf;
 }
 
-void nms(std::vector<Detection>& res, float *output, float conf_thresh, float nms_thresh) {
+void nms(std::vector<Detection>& res, const float *output, float conf_thresh, float nms_thresh) {
   int det_size = sizeof(Detection) / sizeof(float);
   std::map<float, std::vector<Detection>> m;
   for (int i = 0; i < output[0] && i < kMaxNumOutputBbox; i++) {
@@ -78,12 +82,12 @@ void batch_nms(std::vector<std::vector<Detection>>& res_batch, float *output, in
   }
 }
 
-void draw_bbox(std::vector<cv::Mat>& img_batch, std::vector<std::vector<Detection>>& res_batch) {
+void draw_bbox(std::vector<cv::Mat>& img_batch, std::vector<std::vector<Detection>>& res_batch, int input_w, int input_h) {
   for (size_t i = 0; i < img_batch.size(); i++) {
     auto& res = res_batch[i];
     cv::Mat img = img_batch[i];
     for (size_t j = 0; j < res.size(); j++) {
-      cv::Rect r = get_rect(img, res[j].bbox);
+      cv::Rect r = get_rect(img, res[j].bbox, input_w, input_h);
       cv::rectangle(img, r, cv::Scalar(0x27, 0xC1, 0x36), 2);
       cv::putText(img, std::to_string((int)res[j].class_id), cv::Point(r.x, r.y - 1), cv::FONT_HERSHEY_PLAIN, 1.2, cv::Scalar(0xFF, 0xFF, 0xFF), 2);
     }
@@ -1,9 +1,6 @@
 #include "preprocess.h"
 #include "cuda_utils.h"
 
-static uint8_t* img_buffer_host = nullptr;
-static uint8_t* img_buffer_device = nullptr;
-
 struct AffineMatrix{
   float value[6];
 };
@@ -92,15 +89,26 @@ __global__ void warpaffine_kernel(
   *pdst_c2 = c2;
 }
 
-void cuda_preprocess(
-    uint8_t* src, int src_width, int src_height,
+// Stage the image at `offset` bytes into the buffer. The caller makes sure
+// that region is not still being copied to the device by earlier work.
+// src_step is the row pitch, e.g. of a tile cut out of a larger frame.
+static void cuda_preprocess_at(
+    PreprocessBuffer& buffer, size_t offset,
+    const uint8_t* src, size_t src_step, int src_width, int src_height,
     float* dst, int dst_width, int dst_height,
     cudaStream_t stream) {
-  int img_size = src_width * src_height * 3;
-  // copy data to pinned memory
-  memcpy(img_buffer_host, src, img_size);
+  size_t img_size = (size_t)src_width * src_height * 3;
+  uint8_t* host = buffer.host + offset;
+  uint8_t* device = buffer.device + offset;
+  // copy data to pinned memory, packing the rows if src is a view
+  size_t row_size = (size_t)src_width * 3;
+  if (src_step == row_size) {
+    memcpy(host, src, img_size);
+  } else {
+    for (int y = 0; y < src_height; y++) memcpy(host + y * row_size, src + y * src_step, row_size);
+  }
   // copy data to device memory
-  CUDA_CHECK(cudaMemcpyAsync(img_buffer_device, img_buffer_host, img_size, cudaMemcpyHostToDevice, stream));
+  CUDA_CHECK(cudaMemcpyAsync(device, host, img_size, cudaMemcpyHostToDevice, stream));
 
   AffineMatrix s2d, d2s;
   float scale = std::min(dst_height / (float)src_height, dst_width / (float)src_width);
@@ -121,31 +129,63 @@ void cuda_preprocess(
   int threads = 256;
   int blocks = ceil(jobs / (float)threads);
   warpaffine_kernel<<<blocks, threads, 0, stream>>>(
-      img_buffer_device, src_width * 3, src_width,
+      device, src_width * 3, src_width,
       src_height, dst, dst_width,
       dst_height, 128, d2s, jobs);
 }
 
 
-void cuda_batch_preprocess(std::vector<cv::Mat>& img_batch,
+static void check_image_size(PreprocessBuffer& buffer, int src_width, int src_height) {
+  if (src_width * src_height > buffer.max_image_size) {
+    std::cerr << "image " << src_width << "x" << src_height << " is larger than max_input_image_size " << buffer.max_image_size << std::endl;
+    assert(false);
+  }
+}
+
+void cuda_preprocess(
+    PreprocessBuffer& buffer,
+    uint8_t* src, int src_width, int src_height,
+    float* dst, int dst_width, int dst_height,
+    cudaStream_t stream) {
+  check_image_size(buffer, src_width, src_height);
+  cuda_preprocess_at(buffer, 0, src, (size_t)src_width * 3, src_width, src_height, dst, dst_width, dst_height, stream);
+}
+
+void cuda_batch_preprocess(PreprocessBuffer& buffer,
+                           std::vector<cv::Mat>& img_batch,
                            float* dst, int dst_width, int dst_height,
                            cudaStream_t stream) {
   int dst_size = dst_width * dst_height * 3;
+  // Pack the batch back to back into the staging buffer so that the images
+  // don't overwrite each other while their uploads are pending. Only wait
+  // for the stream when the buffer is full and has to be reused.
+  size_t capacity = (size_t)buffer.max_image_size * 3;
+  size_t offset = 0;
   for (size_t i = 0; i < img_batch.size(); i++) {
-    cuda_preprocess(img_batch[i].ptr(), img_batch[i].cols, img_batch[i].rows, &dst[dst_size * i], dst_width, dst_height, stream);
-    CUDA_CHECK(cudaStreamSynchronize(stream));
+    check_image_size(buffer, img_batch[i].cols, img_batch[i].rows);
+    size_t img_size = (size_t)img_batch[i].cols * img_batch[i].rows * 3;
+    if (offset + img_size > capacity) {
+      CUDA_CHECK(cudaStreamSynchronize(stream));
+      offset = 0;
+    }
+    cuda_preprocess_at(buffer, offset, img_batch[i].ptr(), img_batch[i].step, img_batch[i].cols, img_batch[i].rows, &dst[dst_size * i], dst_width, dst_height, stream);
+    offset += img_size;
   }
 }
 
-void cuda_preprocess_init(int max_image_size) {
+void cuda_preprocess_init(PreprocessBuffer& buffer, int max_image_size) {
+  buffer.max_image_size = max_image_size;
   // prepare input data in pinned memory
-  CUDA_CHECK(cudaMallocHost((void**)&img_buffer_host, max_image_size * 3));
+  CUDA_CHECK(cudaMallocHost((void**)&buffer.host, max_image_size * 3));
   // prepare input data in device memory
-  CUDA_CHECK(cudaMalloc((void**)&img_buffer_device, max_image_size * 3));
+  CUDA_CHECK(cudaMalloc((void**)&buffer.device, max_image_size * 3));
 }
 
-void cuda_preprocess_destroy() {
-  CUDA_CHECK(cudaFree(img_buffer_device));
-  CUDA_CHECK(cudaFreeHost(img_buffer_host));
+void cuda_preprocess_destroy(PreprocessBuffer& buffer) {
+  CUDA_CHECK(cudaFree(buffer.device));
+  CUDA_CHECK(cudaFreeHost(buffer.host));
+  buffer.device = nullptr;
+  buffer.host = nullptr;
+  buffer.max_image_size = 0;
 }
 
@@ -0,0 +1,147 @@
+#include "roi.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+struct Region {
+  float l, t, r, b;
+};
+
+std::vector<cv::Rect> plan_crops(const std::vector<Detection>& boxes, int frame_w, int frame_h,
+                                 int crop_w, int crop_h, float margin) {
+  assert(frame_w > 0 && frame_h > 0 && crop_w > 0 && crop_h > 0 && margin >= 0.f);
+  std::vector<Region> regions;
+  for (const Detection& det : boxes) {
+    float mw = det.bbox[2] * (0.5f + margin), mh = det.bbox[3] * (0.5f + margin);
+    Region g = {det.bbox[0] - mw, det.bbox[1] - mh, det.bbox[0] + mw, det.bbox[1] + mh};
+    // Predictions may have drifted off the frame
+    g.l = std::max(g.l, 0.f);
+    g.t = std::max(g.t, 0.f);
+    g.r = std::min(g.r, (float)frame_w);
+    g.b = std::min(g.b, (float)frame_h);
+    if (g.r > g.l && g.b > g.t) regions.push_back(g);
+  }
+
+  // Group regions whose union still fits in one crop, until nothing changes
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t i = 0; i < regions.size() && !merged; i++) {
+      for (size_t j = i + 1; j < regions.size() && !merged; j++) {
+        Region u = {std::min(regions[i].l, regions[j].l), std::min(regions[i].t, regions[j].t),
+                    std::max(regions[i].r, regions[j].r), std::max(regions[i].b, regions[j].b)};
+        if (u.r - u.l <= crop_w && u.b - u.t <= crop_h) {
+          regions[i] = u;
+          regions.erase(regions.begin() + j);
+          merged = true;
+        }
+      }
+    }
+  }
+
+  std::vector<cv::Rect> crops;
+  for (const Region& g : regions) {
+    int w = std::min(frame_w, std::max(crop_w, (int)std::ceil(g.r - g.l)));
+    int h = std::min(frame_h, std::max(crop_h, (int)std::ceil(g.b - g.t)));
+    int x = (int)std::round((g.l + g.r) / 2.f - w / 2.f);
+    int y = (int)std::round((g.t + g.b) / 2.f - h / 2.f);
+    x = std::max(0, std::min(x, frame_w - w));
+    y = std::max(0, std::min(y, frame_h - h));
+    crops.push_back(cv::Rect(x, y, w, h));
+  }
+  std::sort(crops.begin(), crops.end(), [](const cv::Rect& a, const cv::Rect& b) {
+    return a.y != b.y ? a.y < b.y : a.x < b.x;
+  });
+  return crops;
+}
+
+bool RoiScheduler::full_frame(size_t num_tracks, size_t num_crops) {
+  bool full = first_ || num_tracks == 0 || num_crops == 0 || (int)num_crops > max_crops_ ||
+              since_refresh_ + 1 >= refresh_;
+  first_ = false;
+  since_refresh_ = full ? 0 : since_refresh_ + 1;
+  return full;
+}
+
+RoiStats& RoiStats::operator+=(const RoiStats& o) {
+  frames += o.frames;
+  refreshes += o.refreshes;
+  crops += o.crops;
+  passes += o.passes;
+  refresh_passes += o.refresh_passes;
+  src_mpix += o.src_mpix;
+  frame_mpix += o.frame_mpix;
+  return *this;
+}
+
+// Any detection the full frame turns up is worth a crop in the next one
+static TrackerConfig roi_tracker_config(const PipelineConfig& cfg) {
+  TrackerConfig tc = tracker_config(cfg);
+  tc.new_track_thresh = tc.high_thresh;
+  tc.min_hits = 1;
+  tc.max_misses = cfg.roi_max_misses;
+  return tc;
+}
+
+RoiDetector::RoiDetector(Detector& detector, const PipelineConfig& cfg)
+    : detector_(detector),
+      margin_(cfg.roi_margin),
+      nms_thresh_(cfg.nms_thresh),
+      contain_thresh_(cfg.tile_contain_thresh),
+      tracker_(roi_tracker_config(cfg)),
+      scheduler_(cfg.roi_refresh, cfg.roi_max_crops) {
+  if (cfg.tile) tiled_.reset(new TiledDetector(detector, cfg));
+  if (cfg.ego_motion) ego_.reset(new EgoMotion(cfg));
+}
+
+std::vector<Detection> RoiDetector::detect_full(const cv::Mat& frame) {
+  if (tiled_) {
+    uint64_t before = tiled_->stats().passes;
+    std::vector<Detection> dets = tiled_->detect(frame);
+    last_refresh_passes_ = tiled_->stats().passes - before;
+    return dets;
+  }
+  views_.assign(1, frame);
+  std::vector<std::vector<Detection>> res_batch = detector_.detect(views_);
+  views_.clear();
+  tile_to_frame(res_batch[0], cv::Rect(0, 0, frame.cols, frame.rows), detector_.input_w(), detector_.input_h());
+  last_refresh_passes_ = 1;
+  return res_batch[0];
+}
+
+std::vector<Detection> RoiDetector::detect(const cv::Mat& frame) {
+  if (ego_ && ego_->estimate(frame, motion_)) tracker_.warp(motion_.h);
+  tracker_.predict_boxes(predicted_);
+  std::vector<cv::Rect> crops = plan_crops(predicted_, frame.cols, frame.rows,
+                                           detector_.input_w(), detector_.input_h(), margin_);
+  double frame_mpix = frame.cols * (double)frame.rows / 1e6;
+  stats_.frames++;
+  stats_.frame_mpix += frame_mpix;
+
+  std::vector<Detection> dets;
+  if (scheduler_.full_frame(tracker_.size(), crops.size())) {
+    dets = detect_full(frame);
+    stats_.refreshes++;
+    stats_.passes += last_refresh_passes_;
+    stats_.src_mpix += frame_mpix;
+  } else {
+    views_.clear();
+    for (const cv::Rect& crop : crops) {
+      views_.push_back(frame(crop));
+      stats_.src_mpix += crop.area() / 1e6;
+    }
+    std::vector<std::vector<Detection>> res_batch = detector_.detect(views_);
+    views_.clear();
+    for (size_t i = 0; i < crops.size(); i++) {
+      tile_to_frame(res_batch[i], crops[i], detector_.input_w(), detector_.input_h());
+      dets.insert(dets.end(), res_batch[i].begin(), res_batch[i].end());
+    }
+    // Neighbouring crops may overlap on a target
+    merge_detections(dets, nms_thresh_, contain_thresh_, true);
+    stats_.crops += crops.size();
+    stats_.passes += crops.size();
+  }
+  stats_.refresh_passes += last_refresh_passes_;
+  tracker_.update(dets, track_ids_);
+  return dets;
+}
@@ -0,0 +1,69 @@
+#include "saliency.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SALIENCY_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SALIENCY_SSE2 1
+#endif
+
+uint64_t sad_u8_scalar(const uint8_t* a, const uint8_t* b, size_t n) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < n; i++) sum += (uint64_t)std::abs((int)a[i] - (int)b[i]);
+  return sum;
+}
+
+uint64_t sad_u8(const uint8_t* a, const uint8_t* b, size_t n) {
+  size_t i = 0;
+  uint64_t sum = 0;
+#if defined(SALIENCY_NEON)
+  // 16 bit lanes of at most 2 * 255 per step, widened every 128 steps
+  while (i + 16 <= n) {
+    uint16x8_t acc16 = vdupq_n_u16(0);
+    for (int k = 0; k < 128 && i + 16 <= n; k++, i += 16) {
+      acc16 = vpadalq_u8(acc16, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+    uint64x2_t acc64 = vpaddlq_u32(vpaddlq_u16(acc16));
+    sum += vgetq_lane_u64(acc64, 0) + vgetq_lane_u64(acc64, 1);
+  }
+#elif defined(SALIENCY_SSE2)
+  __m128i acc = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+  }
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i*)lanes, acc);
+  sum = lanes[0] + lanes[1];
+#endif
+  return sum + sad_u8_scalar(a + i, b + i, n - i);
+}
+
+float tile_saliency(const cv::Mat& tile, int step) {
+  assert(tile.type() == CV_8UC3 && step > 0);
+  if (tile.cols < 2 || tile.rows < 1) return 0.f;
+  uint64_t sum = 0;
+  uint64_t count = 0;
+  for (int y = 0; y < tile.rows; y += step) {
+    const uint8_t* row = tile.ptr(y);
+    const uint8_t* next = y + step < tile.rows ? tile.ptr(y + step) : nullptr;
+    for (int x = 0; x < tile.cols; x += step * kSaliencyRun) {
+      int run = std::min(kSaliencyRun, tile.cols - x);
+      // Each byte against the same channel of the next pixel, the last
+      // pixel of the row has none
+      size_t horizontal = (size_t)std::min(run, tile.cols - 1 - x) * 3;
+      sum += sad_u8(row + x * 3, row + x * 3 + 3, horizontal);
+      count += horizontal;
+      if (next) {
+        sum += sad_u8(row + x * 3, next + x * 3, (size_t)run * 3);
+        count += (size_t)run * 3;
+      }
+    }
+  }
+  return count ? (float)sum / count : 0.f;
+}
@@ -0,0 +1,260 @@
+#include "target_map.h"
+#include "pipeline_config.h"
+#include "twd97.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+static const double kDegToRad = 3.14159265358979323846 / 180.0;
+
+TargetMapConfig target_map_config(const PipelineConfig& cfg) {
+  TargetMapConfig tc;
+  tc.sigma_m = cfg.dedup_sigma_m;
+  tc.sigma_deg = cfg.dedup_sigma_deg;
+  tc.gate = cfg.dedup_gate;
+  tc.max_sigma_m = cfg.dedup_max_sigma_m;
+  tc.cell_m = cfg.dedup_cell_m;
+  return tc;
+}
+
+void observation_covariance(const GroundTarget& t, float sigma_m, float sigma_rad, float cov[3]) {
+  double d = std::hypot(t.north, t.east);
+  // Sine of the depression angle, floored at about 6 degrees where the
+  // along range error stops being meaningful anyway
+  double sin_dep = t.range > 0 ? std::sqrt(std::max(0.0, (double)t.range * t.range - d * d)) / t.range : 1.0;
+  sin_dep = std::max(sin_dep, 0.1);
+  double cross = (double)sigma_m * sigma_m + std::pow(t.range * sigma_rad, 2);
+  double along = (double)sigma_m * sigma_m + std::pow(t.range * sigma_rad / sin_dep, 2);
+  double ue = d > 1e-3 ? t.east / d : 0, un = d > 1e-3 ? t.north / d : 0;
+  cov[0] = (float)(cross + (along - cross) * ue * ue);
+  cov[1] = (float)((along - cross) * ue * un);
+  cov[2] = (float)(cross + (along - cross) * un * un);
+}
+
+// Larger eigenvalue of a 2x2 covariance
+static float max_eigen(const float cov[3]) {
+  float half_tr = (cov[0] + cov[2]) / 2, diff = (cov[0] - cov[2]) / 2;
+  return half_tr + std::sqrt(diff * diff + cov[1] * cov[1]);
+}
+
+// Spreads the low 32 bits of v to the even bits
+static uint64_t spread_bits(uint64_t v) {
+  v &= 0xffffffffULL;
+  v = (v | v << 16) & 0x0000ffff0000ffffULL;
+  v = (v | v << 8) & 0x00ff00ff00ff00ffULL;
+  v = (v | v << 4) & 0x0f0f0f0f0f0f0f0fULL;
+  v = (v | v << 2) & 0x3333333333333333ULL;
+  v = (v | v << 1) & 0x5555555555555555ULL;
+  return v;
+}
+
+// Interleaves the bits of the cell coordinates, offset to be positive
+static uint64_t cell_key(int64_t ix, int64_t iy) {
+  return spread_bits((uint64_t)(ix + (1LL << 31))) | spread_bits((uint64_t)(iy + (1LL << 31))) << 1;
+}
+
+TargetMap::TargetMap(const TargetMapConfig& cfg) : cfg_(cfg), inv_cell_(1.0 / cfg.cell_m) {
+  assert(cfg.cell_m > 0 && cfg.gate > 0 && cfg.max_sigma_m > 0);
+}
+
+void TargetMap::insert(int id) {
+  const MappedTarget& t = targets_[id];
+  uint64_t key = cell_key((int64_t)std::floor(t.x * inv_cell_), (int64_t)std::floor(t.y * inv_cell_));
+  Cell& cell = cells_[key];
+  cell.ids.push_back(id);
+  cell.max_var = std::max(cell.max_var, max_eigen(t.cov));
+  target_cell_[id] = key;
+}
+
+void TargetMap::erase(int id, uint64_t key) {
+  std::vector<int>& ids = cells_[key].ids;
+  auto it = std::find(ids.begin(), ids.end(), id);
+  assert(it != ids.end());
+  *it = ids.back();
+  ids.pop_back();
+}
+
+int TargetMap::add(const GroundTarget& t, const Detection& det, int track_id, int64_t t_ns) {
+  float cov[3];
+  observation_covariance(t, cfg_.sigma_m, (float)(cfg_.sigma_deg * kDegToRad), cov);
+  return add(t.twd97_x, t.twd97_y, cov, (int)det.class_id, det.conf, t.width_m, t.height_m, track_id, t_ns);
+}
+
+int TargetMap::find(double x, double y, const float cov[3], int class_id, int skip) {
+  // Of the same class targets within the gate, the most likely one: the
+  // Mahalanobis distance alone would favour a target seen once, whose wide
+  // covariance makes everything look close, over a well established one.
+  // Targets are gated as no more certain than sigma_m: GPS and DEM errors
+  // are shared by a whole pass and don't average down like the rest.
+  // Nothing beyond sqrt(gate * (var + target var)) can be within the gate,
+  // and each cell bounds its targets' variance.
+  float floor = cfg_.sigma_m * cfg_.sigma_m;
+  float var = max_eigen(cov) + floor;
+  int best = -1;
+  double best_cost = 0;
+  double radius = std::sqrt(cfg_.gate * (var + max_var_));
+  int64_t x0 = (int64_t)std::floor((x - radius) * inv_cell_), x1 = (int64_t)std::floor((x + radius) * inv_cell_);
+  int64_t y0 = (int64_t)std::floor((y - radius) * inv_cell_), y1 = (int64_t)std::floor((y + radius) * inv_cell_);
+  for (int64_t iy = y0; iy <= y1; iy++) {
+    for (int64_t ix = x0; ix <= x1; ix++) {
+      auto found = cells_.find(cell_key(ix, iy));
+      if (found == cells_.end() || found->second.ids.empty()) continue;
+      const Cell& cell = found->second;
+      // Distance from (x, y) to the cell's square
+      double dx = std::max(0.0, std::max(ix * cfg_.cell_m - x, x - (ix + 1) * cfg_.cell_m));
+      double dy = std::max(0.0, std::max(iy * cfg_.cell_m - y, y - (iy + 1) * cfg_.cell_m));
+      if (dx * dx + dy * dy > cfg_.gate * (var + cell.max_var)) continue;
+      for (int id : cell.ids) {
+        const MappedTarget& t = targets_[id];
+        if (t.class_id != class_id || id == skip) continue;
+        stats_.candidates++;
+        double s0 = t.cov[0] + cov[0] + floor, s1 = t.cov[1] + cov[1], s2 = t.cov[2] + cov[2] + floor;
+        double ex = x - t.x, ey = y - t.y;
+        double det = s0 * s2 - s1 * s1;
+        double d2 = (s2 * ex * ex - 2 * s1 * ex * ey + s0 * ey * ey) / det;
+        if (d2 > cfg_.gate) continue;
+        double cost = d2 + std::log(det);
+        if (best < 0 || cost < best_cost) {
+          best_cost = cost;
+          best = id;
+        }
+      }
+    }
+  }
+  return best;
+}
+
+void TargetMap::fuse(int id, double x, double y, const float cov[3]) {
+  // Information form: P = (Pt^-1 + R^-1)^-1, x = P (Pt^-1 xt + R^-1 z)
+  MappedTarget& t = targets_[id];
+  double det_t = (double)t.cov[0] * t.cov[2] - (double)t.cov[1] * t.cov[1];
+  double det_r = (double)cov[0] * cov[2] - (double)cov[1] * cov[1];
+  double it0 = t.cov[2] / det_t, it1 = -t.cov[1] / det_t, it2 = t.cov[0] / det_t;
+  double ir0 = cov[2] / det_r, ir1 = -cov[1] / det_r, ir2 = cov[0] / det_r;
+  double i0 = it0 + ir0, i1 = it1 + ir1, i2 = it2 + ir2;
+  double bx = it0 * t.x + it1 * t.y + ir0 * x + ir1 * y;
+  double by = it1 * t.x + it2 * t.y + ir1 * x + ir2 * y;
+  double det = i0 * i2 - i1 * i1;
+  t.x = (i2 * bx - i1 * by) / det;
+  t.y = (i0 * by - i1 * bx) / det;
+  t.cov[0] = (float)(i2 / det);
+  t.cov[1] = (float)(-i1 / det);
+  t.cov[2] = (float)(i0 / det);
+  if (cell_key((int64_t)std::floor(t.x * inv_cell_), (int64_t)std::floor(t.y * inv_cell_)) != target_cell_[id]) {
+    erase(id, target_cell_[id]);
+    insert(id);
+  }
+}
+
+int TargetMap::add(double x, double y, const float cov[3], int class_id, float conf, float width_m, float height_m,
+                   int track_id, int64_t t_ns) {
+  auto start = std::chrono::steady_clock::now();
+  stats_.observations++;
+  float var = max_eigen(cov);
+  if (var > cfg_.max_sigma_m * cfg_.max_sigma_m) {
+    stats_.uncertain++;
+    return -1;
+  }
+
+  int best = find(x, y, cov, class_id, -1);
+  if (best < 0) {
+    best = (int)targets_.size();
+    MappedTarget t;
+    t.id = best;
+    t.class_id = class_id;
+    t.x = x;
+    t.y = y;
+    std::copy(cov, cov + 3, t.cov);
+    t.conf = conf;
+    t.width_m = width_m;
+    t.height_m = height_m;
+    t.observations = 1;
+    t.track_id = track_id;
+    t.first_ns = t.last_ns = t_ns;
+    t.merged_into = -1;
+    targets_.push_back(t);
+    target_cell_.push_back(0);
+    insert(best);
+    max_var_ = std::max(max_var_, var);
+  } else {
+    fuse(best, x, y, cov);
+    MappedTarget& t = targets_[best];
+    t.observations++;
+    t.conf = std::max(t.conf, conf);
+    t.width_m += (width_m - t.width_m) / t.observations;
+    t.height_m += (height_m - t.height_m) / t.observations;
+    if (track_id >= 0) t.track_id = track_id;
+    t.first_ns = std::min(t.first_ns, t_ns);
+    t.last_ns = std::max(t.last_ns, t_ns);
+    stats_.merged++;
+
+    // A target the update brought within the gate is the same one, both
+    // with the floor
+    float floored[3] = {t.cov[0] + cfg_.sigma_m * cfg_.sigma_m, t.cov[1], t.cov[2] + cfg_.sigma_m * cfg_.sigma_m};
+    int other = find(t.x, t.y, floored, class_id, best);
+    if (other >= 0) {
+      int keep = std::min(best, other), drop = std::max(best, other);
+      MappedTarget& k = targets_[keep];
+      MappedTarget& d = targets_[drop];
+      fuse(keep, d.x, d.y, d.cov);
+      uint32_t n = k.observations + d.observations;
+      k.width_m = (k.width_m * k.observations + d.width_m * d.observations) / n;
+      k.height_m = (k.height_m * k.observations + d.height_m * d.observations) / n;
+      k.observations = n;
+      k.conf = std::max(k.conf, d.conf);
+      if (d.last_ns > k.last_ns && d.track_id >= 0) k.track_id = d.track_id;
+      k.first_ns = std::min(k.first_ns, d.first_ns);
+      k.last_ns = std::max(k.last_ns, d.last_ns);
+      erase(drop, target_cell_[drop]);
+      d.merged_into = keep;
+      stats_.fused++;
+      best = keep;
+    }
+  }
+  stats_.cpu_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return best;
+}
+
+int TargetMap::resolve(int id) const {
+  while (id >= 0 && targets_[id].merged_into >= 0) id = targets_[id].merged_into;
+  return id;
+}
+
+void TargetMap::query(double x, double y, double radius, std::vector<int>& ids) const {
+  ids.clear();
+  int64_t x0 = (int64_t)std::floor((x - radius) * inv_cell_), x1 = (int64_t)std::floor((x + radius) * inv_cell_);
+  int64_t y0 = (int64_t)std::floor((y - radius) * inv_cell_), y1 = (int64_t)std::floor((y + radius) * inv_cell_);
+  for (int64_t iy = y0; iy <= y1; iy++) {
+    for (int64_t ix = x0; ix <= x1; ix++) {
+      auto found = cells_.find(cell_key(ix, iy));
+      if (found == cells_.end()) continue;
+      for (int id : found->second.ids) {
+        const MappedTarget& t = targets_[id];
+        if ((t.x - x) * (t.x - x) + (t.y - y) * (t.y - y) <= radius * radius) ids.push_back(id);
+      }
+    }
+  }
+}
+
+void TargetMap::snapshot(std::vector<UniqueTarget>& out, uint32_t min_observations) const {
+  out.clear();
+  for (const MappedTarget& t : targets_) {
+    if (t.merged_into >= 0 || t.observations < min_observations) continue;
+    UniqueTarget u;
+    u.target = t;
+    u.sigma_m = std::sqrt(max_eigen(t.cov));
+    out.push_back(u);
+  }
+  // Back to WGS84 in one batch
+  std::vector<double> x(out.size()), y(out.size()), lat(out.size()), lon(out.size());
+  for (size_t i = 0; i < out.size(); i++) {
+    x[i] = out[i].target.x;
+    y[i] = out[i].target.y;
+  }
+  twd97_to_wgs84(x.data(), y.data(), out.size(), lat.data(), lon.data());
+  for (size_t i = 0; i < out.size(); i++) {
+    out[i].lat = lat[i];
+    out[i].lon = lon[i];
+  }
+}
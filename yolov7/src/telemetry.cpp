@@ -0,0 +1,209 @@
+#include "telemetry.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char kRingMagic[4] = {'Y', 'T', 'L', 'M'};
+static const uint32_t kRingVersion = 1;
+
+struct RingHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t slot_size;
+  std::atomic<uint64_t> head;
+  uint8_t reserved[40];
+};
+
+struct RingSlot {
+  std::atomic<uint64_t> seq;
+  TelemetryRecord rec;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the ring needs lock free 64 bit atomics");
+static_assert(sizeof(RingHeader) == 64, "ring header layout");
+static_assert(sizeof(RingSlot) == 64, "ring slot layout");
+
+static std::string shm_path(const std::string& name) {
+  return name[0] == '/' ? name : "/" + name;
+}
+
+static RingSlot* slot_at(const uint8_t* map, uint32_t capacity, uint64_t index) {
+  return (RingSlot*)(map + sizeof(RingHeader) + (index % capacity) * sizeof(RingSlot));
+}
+
+int64_t telemetry_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TelemetryWriter::TelemetryWriter(const std::string& name, uint32_t capacity) : name_(shm_path(name)) {
+  assert(capacity > 0);
+  int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    std::cerr << "could not create shared memory " << name_ << std::endl;
+    assert(false);
+  }
+  size_ = sizeof(RingHeader) + (size_t)capacity * sizeof(RingSlot);
+  struct stat st;
+  bool reuse = fstat(fd, &st) == 0 && (size_t)st.st_size == size_;
+  if (!reuse && ftruncate(fd, size_) != 0) {
+    std::cerr << "could not size shared memory " << name_ << std::endl;
+    assert(false);
+  }
+  void* map = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << "could not map shared memory " << name_ << std::endl;
+    assert(false);
+  }
+  map_ = (uint8_t*)map;
+
+  // A restarted writer continues the ring so readers keep their mapping
+  RingHeader* h = (RingHeader*)map_;
+  reuse = reuse && memcmp(h->magic, kRingMagic, 4) == 0 && h->version == kRingVersion &&
+          h->capacity == capacity && h->slot_size == sizeof(RingSlot);
+  if (!reuse) {
+    memset(map_, 0, size_);
+    h->version = kRingVersion;
+    h->capacity = capacity;
+    h->slot_size = sizeof(RingSlot);
+    h->head.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(h->magic, kRingMagic, 4);
+  }
+}
+
+TelemetryWriter::~TelemetryWriter() {
+  // The segment outlives the writer, readers may still have it mapped
+  if (map_) munmap(map_, size_);
+}
+
+void TelemetryWriter::write(const TelemetryRecord& rec) {
+  RingHeader* h = (RingHeader*)map_;
+  uint64_t index = h->head.load(std::memory_order_relaxed);
+  RingSlot* slot = slot_at(map_, h->capacity, index);
+  slot->seq.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&slot->rec, &rec, sizeof(rec));
+  slot->seq.store(2 * index + 2, std::memory_order_release);
+  h->head.store(index + 1, std::memory_order_release);
+}
+
+uint64_t TelemetryWriter::written() const {
+  return ((const RingHeader*)map_)->head.load(std::memory_order_relaxed);
+}
+
+TelemetryReader::~TelemetryReader() {
+  if (map_) munmap((void*)map_, size_);
+}
+
+bool TelemetryReader::open(const std::string& name) {
+  if (map_) {
+    munmap((void*)map_, size_);
+    map_ = nullptr;
+  }
+  std::string path = shm_path(name);
+  int fd = shm_open(path.c_str(), O_RDONLY, 0);
+  if (fd < 0) return false;
+  struct stat st;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(RingHeader)) {
+    map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) return false;
+
+  const RingHeader* h = (const RingHeader*)map;
+  size_t size = st.st_size;
+  bool ok = memcmp(h->magic, kRingMagic, 4) == 0 && h->version == kRingVersion && h->slot_size == sizeof(RingSlot) &&
+            h->capacity > 0 && size == sizeof(RingHeader) + (size_t)h->capacity * sizeof(RingSlot);
+  if (!ok) {
+    munmap(map, size);
+    return false;
+  }
+  map_ = (const uint8_t*)map;
+  size_ = size;
+  capacity_ = h->capacity;
+  return true;
+}
+
+uint64_t TelemetryReader::head() const {
+  return ((const RingHeader*)map_)->head.load(std::memory_order_acquire);
+}
+
+bool TelemetryReader::read(uint64_t index, TelemetryRecord& rec) const {
+  const RingSlot* slot = slot_at(map_, capacity_, index);
+  uint64_t seq = slot->seq.load(std::memory_order_acquire);
+  if (seq != 2 * index + 2) return false;
+  memcpy(&rec, &slot->rec, sizeof(rec));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot->seq.load(std::memory_order_relaxed) == seq;
+}
+
+bool TelemetryReader::latest(TelemetryRecord& rec) const {
+  // The writer can lap the slot between head() and read(), try again then
+  for (int attempt = 0; attempt < 4; attempt++) {
+    uint64_t h = head();
+    if (h == 0) return false;
+    if (read(h - 1, rec)) return true;
+  }
+  return false;
+}
+
+bool TelemetryReader::at(int64_t t_ns, TelemetryRecord& rec) const {
+  for (int attempt = 0; attempt < 4; attempt++) {
+    uint64_t h = head();
+    if (h == 0) return false;
+    // Leave the slot the writer fills next alone
+    uint64_t lo = h > capacity_ ? h - capacity_ + 1 : 0;
+    uint64_t hi = h - 1;
+    TelemetryRecord lo_rec, hi_rec;
+    if (!read(hi, hi_rec)) continue;
+    if (hi_rec.t_ns <= t_ns) {
+      rec = hi_rec;
+      return true;
+    }
+    if (!read(lo, lo_rec)) continue;
+    if (lo_rec.t_ns > t_ns) return false;
+
+    // lo_rec.t_ns <= t_ns < hi_rec.t_ns. Probe where the mean interval puts
+    // t_ns, then its neighbour towards t_ns, which brackets t_ns at a steady
+    // rate; every third probe bisects so an irregular rate stays O(log n).
+    bool ok = true;
+    bool moved_lo = true;
+    for (int step = 0; ok && hi - lo > 1; step++) {
+      uint64_t mid;
+      if (step % 3 == 0) {
+        double f = (double)(t_ns - lo_rec.t_ns) / (double)(hi_rec.t_ns - lo_rec.t_ns);
+        mid = lo + (uint64_t)(f * (hi - lo));
+      } else if (step % 3 == 1) {
+        mid = moved_lo ? lo + 1 : hi - 1;
+      } else {
+        mid = lo + (hi - lo) / 2;
+      }
+      mid = std::min(std::max(mid, lo + 1), hi - 1);
+      TelemetryRecord mid_rec;
+      ok = read(mid, mid_rec);
+      if (!ok) break;
+      moved_lo = mid_rec.t_ns <= t_ns;
+      if (moved_lo) {
+        lo = mid;
+        lo_rec = mid_rec;
+      } else {
+        hi = mid;
+        hi_rec = mid_rec;
+      }
+    }
+    if (ok) {
+      rec = lo_rec;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,174 @@
+#include "telemetry_fusion.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+static const double kDegToRad = M_PI / 180.0;
+
+struct Quat {
+  double w, x, y, z;
+};
+
+// Aerospace Z-Y-X order: yaw, then pitch, then roll
+static Quat euler_to_quat(double roll, double pitch, double yaw) {
+  double cr = std::cos(roll * kDegToRad / 2), sr = std::sin(roll * kDegToRad / 2);
+  double cp = std::cos(pitch * kDegToRad / 2), sp = std::sin(pitch * kDegToRad / 2);
+  double cy = std::cos(yaw * kDegToRad / 2), sy = std::sin(yaw * kDegToRad / 2);
+  Quat q;
+  q.w = cr * cp * cy + sr * sp * sy;
+  q.x = sr * cp * cy - cr * sp * sy;
+  q.y = cr * sp * cy + sr * cp * sy;
+  q.z = cr * cp * sy - sr * sp * cy;
+  return q;
+}
+
+static void quat_to_euler(const Quat& q, float& roll, float& pitch, float& yaw) {
+  double sinp = std::max(-1.0, std::min(1.0, 2 * (q.w * q.y - q.z * q.x)));
+  roll = (float)(std::atan2(2 * (q.w * q.x + q.y * q.z), 1 - 2 * (q.x * q.x + q.y * q.y)) / kDegToRad);
+  pitch = (float)(std::asin(sinp) / kDegToRad);
+  double y = std::atan2(2 * (q.w * q.z + q.x * q.y), 1 - 2 * (q.y * q.y + q.z * q.z)) / kDegToRad;
+  if (y < 0) y += 360.0;
+  yaw = y >= 360.0 ? 0.f : (float)y;
+}
+
+// Shortest arc, u outside [0, 1] continues along the same great circle
+static Quat slerp(const Quat& a, Quat b, double u) {
+  double dot = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+  if (dot < 0) {
+    b.w = -b.w;
+    b.x = -b.x;
+    b.y = -b.y;
+    b.z = -b.z;
+    dot = -dot;
+  }
+  double ka, kb;
+  if (dot > 0.9995) {
+    // Nearly the same orientation, lerp and renormalize
+    ka = 1 - u;
+    kb = u;
+  } else {
+    double theta = std::acos(dot);
+    double s = std::sin(theta);
+    ka = std::sin((1 - u) * theta) / s;
+    kb = std::sin(u * theta) / s;
+  }
+  Quat q;
+  q.w = ka * a.w + kb * b.w;
+  q.x = ka * a.x + kb * b.x;
+  q.y = ka * a.y + kb * b.y;
+  q.z = ka * a.z + kb * b.z;
+  double n = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+  q.w /= n;
+  q.x /= n;
+  q.y /= n;
+  q.z /= n;
+  return q;
+}
+
+void interpolate_pose(const TelemetryRecord& a, const TelemetryRecord& b, double u, FramePose& pose) {
+  pose.lat = a.lat + (b.lat - a.lat) * u;
+  pose.lon = a.lon + (b.lon - a.lon) * u;
+  pose.alt = (float)(a.alt + (b.alt - a.alt) * u);
+  Quat q = slerp(euler_to_quat(a.roll, a.pitch, a.yaw), euler_to_quat(b.roll, b.pitch, b.yaw), u);
+  quat_to_euler(q, pose.roll, pose.pitch, pose.yaw);
+}
+
+TelemetryFusion::TelemetryFusion(size_t capacity, int64_t max_extrapolation_ns, int64_t max_gap_ns)
+    : history_(capacity), max_extrapolation_ns_(max_extrapolation_ns), max_gap_ns_(max_gap_ns) {
+  assert(capacity >= 2);
+}
+
+void TelemetryFusion::push(const TelemetryRecord& rec) {
+  if (rec.fix == 0) return;
+  if (count_ > 0 && rec.t_ns <= sample(count_ - 1).t_ns) {
+    stats_.dropped++;
+    return;
+  }
+  if (count_ == history_.size()) {
+    start_ = (start_ + 1) % history_.size();
+    count_--;
+  }
+  history_[(start_ + count_) % history_.size()] = rec;
+  count_++;
+}
+
+int TelemetryFusion::poll(const TelemetryReader& reader) {
+  uint64_t head = reader.head();
+  // A writer that re-created the ring starts counting again
+  if (head < next_index_) next_index_ = 0;
+  uint64_t first = head > reader.capacity() ? head - reader.capacity() + 1 : 0;
+  next_index_ = std::max(next_index_, first);
+  int n = 0;
+  TelemetryRecord rec;
+  for (; next_index_ < head; next_index_++) {
+    if (!reader.read(next_index_, rec)) continue;
+    push(rec);
+    n++;
+  }
+  return n;
+}
+
+bool TelemetryFusion::pose_at(int64_t t_ns, FramePose& pose) {
+  stats_.queries++;
+  pose = FramePose();
+  pose.t_ns = t_ns;
+  if (count_ == 0) {
+    stats_.missing++;
+    return false;
+  }
+  pose.valid = true;
+
+  const TelemetryRecord& oldest = sample(0);
+  const TelemetryRecord& newest = sample(count_ - 1);
+  size_t i = 0;  // interpolate between samples i and i + 1
+  int64_t t = t_ns;
+  if (count_ == 1 || t_ns >= newest.t_ns || t_ns < oldest.t_ns) {
+    // Outside the history: follow the outermost pair for a bounded time
+    bool after = t_ns >= newest.t_ns;
+    int64_t edge = after ? newest.t_ns : oldest.t_ns;
+    int64_t age = after ? t_ns - edge : edge - t_ns;
+    pose.extrapolated = age > 0;
+    pose.age_ms = age / 1e6f;
+    pose.stale = age > max_extrapolation_ns_;
+    if (count_ == 1) {
+      const TelemetryRecord& s = sample(0);
+      pose.lat = s.lat;
+      pose.lon = s.lon;
+      pose.alt = s.alt;
+      pose.roll = s.roll;
+      pose.pitch = s.pitch;
+      pose.yaw = s.yaw;
+    } else {
+      int64_t bound = std::min(age, max_extrapolation_ns_);
+      t = after ? edge + bound : edge - bound;
+      i = after ? count_ - 2 : 0;
+    }
+  } else {
+    // Last sample at or before t_ns
+    size_t lo = 0, hi = count_ - 1;
+    while (hi - lo > 1) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (sample(mid).t_ns <= t_ns) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    i = lo;
+    pose.age_ms = std::min(t_ns - sample(lo).t_ns, sample(hi).t_ns - t_ns) / 1e6f;
+  }
+  if (count_ > 1) {
+    const TelemetryRecord& a = sample(i);
+    const TelemetryRecord& b = sample(i + 1);
+    interpolate_pose(a, b, (double)(t - a.t_ns) / (double)(b.t_ns - a.t_ns), pose);
+    if (b.t_ns - a.t_ns > max_gap_ns_) pose.stale = true;
+  }
+
+  if (pose.extrapolated) {
+    stats_.extrapolated++;
+  } else {
+    stats_.interpolated++;
+  }
+  if (pose.stale) stats_.stale++;
+  return true;
+}
@@ -0,0 +1,208 @@
+#include "tiling.h"
+#include "postprocess.h"
+#include "saliency.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+// Tile origins along one axis
+static std::vector<int> tile_starts(int len, int tile, float overlap) {
+  std::vector<int> starts;
+  if (len <= tile) {
+    starts.push_back(0);
+    return starts;
+  }
+  int stride = std::max(1, (int)(tile * (1.f - overlap)));
+  int n = (len - tile + stride - 1) / stride + 1;
+  // Spread evenly, which only ever increases the overlap
+  for (int i = 0; i < n; i++) {
+    starts.push_back((int)((int64_t)i * (len - tile) / (n - 1)));
+  }
+  return starts;
+}
+
+TileGrid make_tile_grid(int frame_w, int frame_h, int tile_w, int tile_h, float overlap, bool full_frame) {
+  assert(frame_w > 0 && frame_h > 0 && tile_w > 0 && tile_h > 0);
+  assert(overlap >= 0.f && overlap < 1.f);
+  TileGrid grid;
+  grid.frame_w = frame_w;
+  grid.frame_h = frame_h;
+  std::vector<int> xs = tile_starts(frame_w, tile_w, overlap);
+  std::vector<int> ys = tile_starts(frame_h, tile_h, overlap);
+  int w = std::min(tile_w, frame_w);
+  int h = std::min(tile_h, frame_h);
+  for (int y : ys) {
+    for (int x : xs) grid.tiles.push_back(cv::Rect(x, y, w, h));
+  }
+  grid.full_frame = full_frame && grid.tiles.size() > 1;
+  return grid;
+}
+
+void tile_to_frame(std::vector<Detection>& dets, const cv::Rect& roi, int input_w, int input_h) {
+  for (Detection& det : dets) {
+    cv::Rect r = get_rect(roi.width, roi.height, det.bbox, input_w, input_h);
+    det.bbox[0] = roi.x + r.x + r.width / 2.f;
+    det.bbox[1] = roi.y + r.y + r.height / 2.f;
+    det.bbox[2] = (float)r.width;
+    det.bbox[3] = (float)r.height;
+  }
+}
+
+struct Box {
+  float l, t, r, b;
+  float area() const { return std::max(0.f, r - l) * std::max(0.f, b - t); }
+};
+
+static Box to_box(const Detection& det) {
+  Box box;
+  box.l = det.bbox[0] - det.bbox[2] / 2.f;
+  box.t = det.bbox[1] - det.bbox[3] / 2.f;
+  box.r = det.bbox[0] + det.bbox[2] / 2.f;
+  box.b = det.bbox[1] + det.bbox[3] / 2.f;
+  return box;
+}
+
+static float intersection(const Box& a, const Box& b) {
+  Box i;
+  i.l = std::max(a.l, b.l);
+  i.t = std::max(a.t, b.t);
+  i.r = std::min(a.r, b.r);
+  i.b = std::min(a.b, b.b);
+  return i.area();
+}
+
+void merge_detections(std::vector<Detection>& dets, float nms_thresh, float contain_thresh, bool fuse) {
+  std::stable_sort(dets.begin(), dets.end(), [](const Detection& a, const Detection& b) { return a.conf > b.conf; });
+  std::vector<Box> boxes(dets.size());
+  for (size_t i = 0; i < dets.size(); i++) boxes[i] = to_box(dets[i]);
+  std::vector<bool> removed(dets.size(), false);
+  std::vector<Detection> merged;
+  for (size_t i = 0; i < dets.size(); i++) {
+    if (removed[i]) continue;
+    // Confidence weighted sum of the duplicates, union of the pieces
+    Box sum = {boxes[i].l * dets[i].conf, boxes[i].t * dets[i].conf, boxes[i].r * dets[i].conf, boxes[i].b * dets[i].conf};
+    float weight = dets[i].conf;
+    Box pieces = boxes[i];
+    bool has_pieces = false;
+    for (size_t j = i + 1; j < dets.size(); j++) {
+      if (removed[j] || dets[j].class_id != dets[i].class_id) continue;
+      float inter = intersection(boxes[i], boxes[j]);
+      if (inter <= 0.f) continue;
+      float area_i = boxes[i].area(), area_j = boxes[j].area();
+      float iou = inter / (area_i + area_j - inter);
+      float ios = inter / std::max(1e-6f, std::min(area_i, area_j));
+      if (iou > nms_thresh) {
+        removed[j] = true;
+        float c = dets[j].conf;
+        sum.l += boxes[j].l * c;
+        sum.t += boxes[j].t * c;
+        sum.r += boxes[j].r * c;
+        sum.b += boxes[j].b * c;
+        weight += c;
+      } else if (ios > contain_thresh) {
+        removed[j] = true;
+        pieces.l = std::min(pieces.l, boxes[j].l);
+        pieces.t = std::min(pieces.t, boxes[j].t);
+        pieces.r = std::max(pieces.r, boxes[j].r);
+        pieces.b = std::max(pieces.b, boxes[j].b);
+        has_pieces = true;
+      }
+    }
+    Detection det = dets[i];
+    if (fuse) {
+      Box box = {sum.l / weight, sum.t / weight, sum.r / weight, sum.b / weight};
+      if (has_pieces) {
+        box.l = std::min(box.l, pieces.l);
+        box.t = std::min(box.t, pieces.t);
+        box.r = std::max(box.r, pieces.r);
+        box.b = std::max(box.b, pieces.b);
+      }
+      det.bbox[0] = (box.l + box.r) / 2.f;
+      det.bbox[1] = (box.t + box.b) / 2.f;
+      det.bbox[2] = box.r - box.l;
+      det.bbox[3] = box.b - box.t;
+    }
+    merged.push_back(det);
+  }
+  dets.swap(merged);
+}
+
+TilingStats& TilingStats::operator+=(const TilingStats& o) {
+  frames += o.frames;
+  tiles += o.tiles;
+  skipped += o.skipped;
+  forced += o.forced;
+  forced_hits += o.forced_hits;
+  passes += o.passes;
+  filter_ms += o.filter_ms;
+  infer_ms += o.infer_ms;
+  return *this;
+}
+
+TiledDetector::TiledDetector(Detector& detector, const PipelineConfig& cfg)
+    : detector_(detector),
+      overlap_(cfg.tile_overlap),
+      full_frame_(cfg.tile_full_frame),
+      nms_thresh_(cfg.nms_thresh),
+      contain_thresh_(cfg.tile_contain_thresh),
+      saliency_thresh_(cfg.tile_saliency_thresh),
+      saliency_row_step_(cfg.tile_saliency_row_step),
+      force_scan_(cfg.tile_force_scan) {}
+
+const TileGrid& TiledDetector::grid(int frame_w, int frame_h) {
+  std::pair<int, int> key(frame_w, frame_h);
+  auto it = grids_.find(key);
+  if (it == grids_.end()) {
+    it = grids_.insert(std::make_pair(key, make_tile_grid(frame_w, frame_h, detector_.input_w(), detector_.input_h(),
+                                                          overlap_, full_frame_))).first;
+  }
+  return it->second;
+}
+
+std::vector<Detection> TiledDetector::detect(const cv::Mat& frame) {
+  const TileGrid& g = grid(frame.cols, frame.rows);
+  bool force = force_scan_ > 0 && stats_.frames % force_scan_ == 0;
+  stats_.frames++;
+  stats_.tiles += g.tiles.size();
+
+  // Views into the frame, preprocessing copies them row by row
+  auto t0 = std::chrono::steady_clock::now();
+  views_.clear();
+  rois_.clear();
+  forced_.clear();
+  for (const cv::Rect& tile : g.tiles) {
+    cv::Mat view = frame(tile);
+    bool rejected = saliency_thresh_ > 0.f && tile_saliency(view, saliency_row_step_) < saliency_thresh_;
+    if (rejected && !force) {
+      stats_.skipped++;
+      continue;
+    }
+    if (rejected) stats_.forced++;
+    views_.push_back(view);
+    rois_.push_back(tile);
+    forced_.push_back(rejected);
+  }
+  if (g.full_frame) {
+    views_.push_back(frame);
+    rois_.push_back(cv::Rect(0, 0, frame.cols, frame.rows));
+    forced_.push_back(false);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+
+  std::vector<std::vector<Detection>> res_batch = detector_.detect(views_);
+  auto t2 = std::chrono::steady_clock::now();
+  stats_.filter_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+  stats_.infer_ms += std::chrono::duration<double, std::milli>(t2 - t1).count();
+  stats_.passes += views_.size();
+
+  std::vector<Detection> dets;
+  for (size_t i = 0; i < res_batch.size(); i++) {
+    if (forced_[i] && !res_batch[i].empty()) stats_.forced_hits++;
+    tile_to_frame(res_batch[i], rois_[i], detector_.input_w(), detector_.input_h());
+    dets.insert(dets.end(), res_batch[i].begin(), res_batch[i].end());
+  }
+  views_.clear();
+  merge_detections(dets, nms_thresh_, contain_thresh_, true);
+  return dets;
+}
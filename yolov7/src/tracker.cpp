@@ -0,0 +1,494 @@
+#include "tracker.h"
+#include "pipeline_config.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+enum TrackState : uint8_t { kTentative, kTracked, kLost };
+
+// Standard deviations per frame relative to the box size (BoT-SORT)
+static const float kStdPos = 1.f / 20;
+static const float kStdVel = 1.f / 160;
+// Detections per block of the IoU loop
+static const int kLanes = 8;
+// Stands in for infeasible pairs, far above any real cost
+static const double kBigCost = 1e6;
+
+// IoU of two center x/y, w/h boxes
+static float box_iou(const float* a, const float* b) {
+  float w = std::min(a[0] + a[2] / 2, b[0] + b[2] / 2) - std::max(a[0] - a[2] / 2, b[0] - b[2] / 2);
+  float h = std::min(a[1] + a[3] / 2, b[1] + b[3] / 2) - std::max(a[1] - a[3] / 2, b[1] - b[3] / 2);
+  if (w <= 0.f || h <= 0.f) return 0.f;
+  float inter = w * h;
+  return inter / std::max(a[2] * a[3] + b[2] * b[3] - inter, 1e-6f);
+}
+
+static int find_root(std::vector<int>& parent, int i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+// One component: rows r[0..nr) against columns c[0..nc) plus a private
+// dummy column per row at cost limit, so every row can be assigned
+static void solve_component(const float* cost, int stride, const int* r, int nr, const int* c, int nc, float limit,
+                            int* row_match) {
+  int m = nc + nr;
+  std::vector<double> a((size_t)nr * m, kBigCost);
+  for (int i = 0; i < nr; i++) {
+    const float* src = cost + (size_t)r[i] * stride;
+    double* dst = &a[(size_t)i * m];
+    for (int j = 0; j < nc; j++) {
+      if (src[c[j]] <= limit) dst[j] = src[c[j]];
+    }
+    dst[nc + i] = limit;
+  }
+  // 1-based: column 0 and p[0] hold the row being inserted
+  std::vector<double> u(nr + 1, 0.0), v(m + 1, 0.0), minv(m + 1);
+  std::vector<int> p(m + 1, 0), way(m + 1, 0);
+  std::vector<char> used(m + 1);
+  for (int i = 1; i <= nr; i++) {
+    p[0] = i;
+    int j0 = 0;
+    std::fill(minv.begin(), minv.end(), 2 * kBigCost);
+    std::fill(used.begin(), used.end(), 0);
+    do {
+      // Dijkstra step: settle the closest column under the reduced costs
+      used[j0] = 1;
+      int i0 = p[j0], j1 = 0;
+      double delta = 2 * kBigCost;
+      const double* row = &a[(size_t)(i0 - 1) * m];
+      for (int j = 1; j <= m; j++) {
+        if (used[j]) continue;
+        double cur = row[j - 1] - u[i0] - v[j];
+        if (cur < minv[j]) {
+          minv[j] = cur;
+          way[j] = j0;
+        }
+        if (minv[j] < delta) {
+          delta = minv[j];
+          j1 = j;
+        }
+      }
+      for (int j = 0; j <= m; j++) {
+        if (used[j]) {
+          u[p[j]] += delta;
+          v[j] -= delta;
+        } else {
+          minv[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (p[j0] != 0);
+    // Flip the augmenting path
+    do {
+      int j1 = way[j0];
+      p[j0] = p[j1];
+      j0 = j1;
+    } while (j0);
+  }
+  for (int j = 1; j <= nc; j++) {
+    if (p[j]) row_match[r[p[j] - 1]] = c[j - 1];
+  }
+}
+
+int linear_assignment(const float* cost, int rows, int cols, float limit, int* row_match) {
+  std::fill(row_match, row_match + rows, -1);
+  if (rows == 0 || cols == 0) return 0;
+  // Rows are nodes [0, rows), columns [rows, rows + cols)
+  std::vector<int> parent(rows + cols);
+  std::iota(parent.begin(), parent.end(), 0);
+  for (int i = 0; i < rows; i++) {
+    const float* row = cost + (size_t)i * cols;
+    for (int j = 0; j < cols; j++) {
+      if (row[j] > limit) continue;
+      int a = find_root(parent, i), b = find_root(parent, rows + j);
+      if (a != b) parent[a] = b;
+    }
+  }
+  // Bucket the rows and columns by component
+  std::vector<int> label(rows + cols, -1), count(rows + cols + 1, 0), comp(rows + cols);
+  int components = 0;
+  for (int i = 0; i < rows + cols; i++) {
+    int root = find_root(parent, i);
+    if (label[root] < 0) label[root] = components++;
+    comp[i] = label[root];
+    count[comp[i] + 1]++;
+  }
+  for (int k = 0; k < components; k++) count[k + 1] += count[k];
+  std::vector<int> order(rows + cols), fill(count.begin(), count.end() - 1);
+  for (int i = 0; i < rows + cols; i++) order[fill[comp[i]]++] = i;
+
+  std::vector<int> r, c;
+  for (int k = 0; k < components; k++) {
+    r.clear();
+    c.clear();
+    for (int n = count[k]; n < count[k + 1]; n++) {
+      if (order[n] < rows) {
+        r.push_back(order[n]);
+      } else {
+        c.push_back(order[n] - rows);
+      }
+    }
+    if (r.empty() || c.empty()) continue;
+    if (r.size() == 1 && c.size() == 1) {
+      // Connected, so the one pair is feasible
+      row_match[r[0]] = c[0];
+      continue;
+    }
+    solve_component(cost, cols, r.data(), (int)r.size(), c.data(), (int)c.size(), limit, row_match);
+  }
+  int matched = 0;
+  for (int i = 0; i < rows; i++) matched += row_match[i] >= 0;
+  return matched;
+}
+
+TrackerConfig tracker_config(const PipelineConfig& cfg) {
+  TrackerConfig tc;
+  tc.high_thresh = cfg.track_high_thresh;
+  tc.low_thresh = std::min(cfg.track_low_thresh, cfg.track_high_thresh);
+  tc.new_track_thresh = cfg.track_new_thresh;
+  tc.max_misses = cfg.track_max_misses;
+  return tc;
+}
+
+ByteTracker::ByteTracker(const TrackerConfig& cfg) : cfg_(cfg) {
+  assert(cfg.low_thresh <= cfg.high_thresh && cfg.min_hits >= 1 && cfg.max_misses >= 0);
+}
+
+void ByteTracker::predict() {
+  size_t n = id_.size();
+  for (int d = 0; d < 4; d++) {
+    float* x = x_[d].data();
+    float* v = v_[d].data();
+    float* pxx = pxx_[d].data();
+    float* pxv = pxv_[d].data();
+    float* pvv = pvv_[d].data();
+    // Noise scales with the width for x and w, the height for y and h.
+    // Component 2 and 3 read their own value before it moves.
+    const float* size = x_[2 + (d & 1)].data();
+    for (size_t i = 0; i < n; i++) {
+      float s = size[i];
+      float qp = kStdPos * s, qv = kStdVel * s;
+      x[i] += v[i];
+      pxx[i] += 2.f * pxv[i] + pvv[i] + qp * qp;
+      pxv[i] += pvv[i];
+      pvv[i] += qv * qv;
+    }
+  }
+}
+
+void ByteTracker::correct() {
+  // Every track goes through the same arithmetic, the ones without a
+  // detection this frame with zero gain and z = x
+  size_t n = id_.size();
+  for (int d = 0; d < 4; d++) {
+    float* x = x_[d].data();
+    float* v = v_[d].data();
+    float* pxx = pxx_[d].data();
+    float* pxv = pxv_[d].data();
+    float* pvv = pvv_[d].data();
+    const float* z = z_[d].data();
+    const float* g = gain_.data();
+    const float* size = x_[2 + (d & 1)].data();
+    for (size_t i = 0; i < n; i++) {
+      float r = kStdPos * size[i];
+      float s = pxx[i] + r * r;
+      float kx = g[i] * pxx[i] / s, kv = g[i] * pxv[i] / s;
+      float e = z[i] - x[i];
+      x[i] += kx * e;
+      v[i] += kv * e;
+      pvv[i] -= kv * pxv[i];
+      pxv[i] -= kx * pxv[i];
+      pxx[i] -= kx * pxx[i];
+    }
+  }
+}
+
+void ByteTracker::associate(const std::vector<int>& rows, const std::vector<int>& cols, float min_iou) {
+  int nr = (int)rows.size(), nc = (int)cols.size();
+  if (nr == 0 || nc == 0) return;
+  // Track boxes of this stage, the detection boxes are gathered once per frame
+  for (int k = 0; k < 5; k++) row_box_[k].resize(nr);
+  for (int i = 0; i < nr; i++) {
+    int t = rows[i];
+    float w = std::max(x_[2][t], 0.f), h = std::max(x_[3][t], 0.f);
+    row_box_[0][i] = x_[0][t] - w / 2;
+    row_box_[1][i] = x_[1][t] - h / 2;
+    row_box_[2][i] = x_[0][t] + w / 2;
+    row_box_[3][i] = x_[1][t] + h / 2;
+    row_box_[4][i] = w * h;
+  }
+  // Columns padded to whole blocks of kLanes with empty boxes of no class,
+  // so the inner loop has a fixed trip count and vectorises at -O2
+  int padded = (nc + kLanes - 1) / kLanes * kLanes;
+  for (int k = 0; k < 6; k++) col_box_[k].assign(padded, 0.f);
+  for (int j = 0; j < nc; j++) {
+    for (int k = 0; k < 5; k++) col_box_[k][j] = det_box_[k][cols[j]];
+    col_box_[5][j] = (*dets_)[cols[j]].class_id;
+  }
+  for (int j = nc; j < padded; j++) col_box_[5][j] = -1.f;
+  cost_.resize((size_t)nr * padded);
+  for (int i = 0; i < nr; i++) {
+    float x1 = row_box_[0][i], y1 = row_box_[1][i], x2 = row_box_[2][i], y2 = row_box_[3][i], area = row_box_[4][i];
+    float cls = class_[rows[i]];
+    for (int jb = 0; jb < padded; jb += kLanes) {
+      const float* cx1 = &col_box_[0][jb];
+      const float* cy1 = &col_box_[1][jb];
+      const float* cx2 = &col_box_[2][jb];
+      const float* cy2 = &col_box_[3][jb];
+      const float* carea = &col_box_[4][jb];
+      const float* ccls = &col_box_[5][jb];
+      float block[kLanes];
+      for (int j = 0; j < kLanes; j++) {
+        float iw = std::max(std::min(x2, cx2[j]) - std::max(x1, cx1[j]), 0.f);
+        float ih = std::max(std::min(y2, cy2[j]) - std::max(y1, cy1[j]), 0.f);
+        float inter = iw * ih;
+        float iou = inter / std::max(area + carea[j] - inter, 1e-6f);
+        // Past any limit across classes
+        block[j] = 1.f - iou + 2.f * (float)(cls != ccls[j]);
+      }
+      std::copy(block, block + kLanes, &cost_[(size_t)i * padded + jb]);
+    }
+  }
+  row_match_.resize(nr);
+  linear_assignment(cost_.data(), nr, padded, 1.f - min_iou, row_match_.data());
+  for (int i = 0; i < nr; i++) {
+    if (row_match_[i] < 0) continue;
+    track_det_[rows[i]] = cols[row_match_[i]];
+    det_track_[cols[row_match_[i]]] = rows[i];
+  }
+}
+
+void ByteTracker::add_track(const Detection& det) {
+  for (int d = 0; d < 4; d++) {
+    float s = det.bbox[2 + (d & 1)];
+    x_[d].push_back(det.bbox[d]);
+    v_[d].push_back(0.f);
+    pxx_[d].push_back((2 * kStdPos * s) * (2 * kStdPos * s));
+    pxv_[d].push_back(0.f);
+    pvv_[d].push_back((10 * kStdVel * s) * (10 * kStdVel * s));
+  }
+  class_.push_back(det.class_id);
+  score_.push_back(det.conf);
+  hits_.push_back(1);
+  misses_.push_back(0);
+  if (cfg_.min_hits <= 1) {
+    id_.push_back(next_id_++);
+    state_.push_back(kTracked);
+    stats_.confirmed++;
+  } else {
+    id_.push_back(0);
+    state_.push_back(kTentative);
+  }
+}
+
+void ByteTracker::remove_tracks() {
+  // Stable, the survivors keep their order
+  size_t n = id_.size(), k = 0;
+  for (size_t i = 0; i < n; i++) {
+    bool keep = state_[i] == kLost ? misses_[i] <= cfg_.max_misses : misses_[i] == 0;
+    if (!keep) continue;
+    if (k != i) {
+      for (int d = 0; d < 4; d++) {
+        x_[d][k] = x_[d][i];
+        v_[d][k] = v_[d][i];
+        pxx_[d][k] = pxx_[d][i];
+        pxv_[d][k] = pxv_[d][i];
+        pvv_[d][k] = pvv_[d][i];
+      }
+      id_[k] = id_[i];
+      class_[k] = class_[i];
+      score_[k] = score_[i];
+      hits_[k] = hits_[i];
+      misses_[k] = misses_[i];
+      state_[k] = state_[i];
+    }
+    k++;
+  }
+  for (int d = 0; d < 4; d++) {
+    x_[d].resize(k);
+    v_[d].resize(k);
+    pxx_[d].resize(k);
+    pxv_[d].resize(k);
+    pvv_[d].resize(k);
+  }
+  id_.resize(k);
+  class_.resize(k);
+  score_.resize(k);
+  hits_.resize(k);
+  misses_.resize(k);
+  state_.resize(k);
+}
+
+void ByteTracker::update(const std::vector<Detection>& dets, std::vector<int>& ids) {
+  auto start = std::chrono::steady_clock::now();
+  size_t n = id_.size(), m = dets.size();
+  dets_ = &dets;
+  predict();
+
+  std::vector<int> high, low;
+  for (int k = 0; k < 5; k++) det_box_[k].resize(m);
+  for (size_t j = 0; j < m; j++) {
+    const float* b = dets[j].bbox;
+    det_box_[0][j] = b[0] - b[2] / 2;
+    det_box_[1][j] = b[1] - b[3] / 2;
+    det_box_[2][j] = b[0] + b[2] / 2;
+    det_box_[3][j] = b[1] + b[3] / 2;
+    det_box_[4][j] = b[2] * b[3];
+    if (dets[j].conf >= cfg_.high_thresh) {
+      high.push_back((int)j);
+    } else if (dets[j].conf >= cfg_.low_thresh) {
+      low.push_back((int)j);
+    }
+  }
+  track_det_.assign(n, -1);
+  det_track_.assign(m, -1);
+
+  std::vector<int> rows, cols;
+  for (size_t i = 0; i < n; i++) {
+    if (state_[i] != kTentative) rows.push_back((int)i);
+  }
+  associate(rows, high, cfg_.match_iou);
+  // Only targets seen last frame may continue on a low score detection
+  std::vector<int> rest;
+  for (int i : rows) {
+    if (track_det_[i] < 0 && state_[i] == kTracked) rest.push_back(i);
+  }
+  associate(rest, low, cfg_.low_match_iou);
+  rows.clear();
+  for (size_t i = 0; i < n; i++) {
+    if (state_[i] == kTentative) rows.push_back((int)i);
+  }
+  for (int j : high) {
+    if (det_track_[j] < 0) cols.push_back(j);
+  }
+  associate(rows, cols, cfg_.tentative_match_iou);
+
+  gain_.assign(n, 0.f);
+  for (int d = 0; d < 4; d++) z_[d].assign(x_[d].begin(), x_[d].end());
+  for (size_t i = 0; i < n; i++) {
+    int j = track_det_[i];
+    if (j < 0) continue;
+    gain_[i] = 1.f;
+    for (int d = 0; d < 4; d++) z_[d][i] = dets[j].bbox[d];
+  }
+  correct();
+
+  ids.assign(m, -1);
+  for (size_t i = 0; i < n; i++) {
+    int j = track_det_[i];
+    if (j < 0) {
+      misses_[i]++;
+      if (state_[i] == kTracked) {
+        // Coast at constant size until found again
+        state_[i] = kLost;
+        v_[2][i] = v_[3][i] = 0.f;
+      }
+      continue;
+    }
+    if (dets[j].conf < cfg_.high_thresh) stats_.matched_low++;
+    if (state_[i] == kLost) stats_.recovered++;
+    score_[i] = dets[j].conf;
+    hits_[i]++;
+    misses_[i] = 0;
+    if (state_[i] == kTentative && hits_[i] >= cfg_.min_hits) {
+      id_[i] = next_id_++;
+      stats_.confirmed++;
+    }
+    if (id_[i]) {
+      state_[i] = kTracked;
+      ids[j] = id_[i];
+    }
+  }
+  remove_tracks();
+  for (int j : high) {
+    if (det_track_[j] >= 0 || dets[j].conf < cfg_.new_track_thresh) continue;
+    add_track(dets[j]);
+    if (id_.back()) ids[j] = id_.back();
+  }
+  dets_ = nullptr;
+
+  stats_.frames++;
+  stats_.detections += m;
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  stats_.cpu_ms += ms;
+  stats_.max_ms = std::max(stats_.max_ms, ms);
+}
+
+void ByteTracker::warp(const double* h) {
+  size_t n = id_.size();
+  for (size_t i = 0; i < n; i++) {
+    double x = x_[0][i], y = x_[1][i];
+    double w = h[6] * x + h[7] * y + h[8];
+    double u = (h[0] * x + h[1] * y + h[2]) / w, v = (h[3] * x + h[4] * y + h[5]) / w;
+    // Jacobian of the warp at the center
+    double j00 = (h[0] - u * h[6]) / w, j01 = (h[1] - u * h[7]) / w;
+    double j10 = (h[3] - v * h[6]) / w, j11 = (h[4] - v * h[7]) / w;
+    float sx = (float)std::sqrt(j00 * j00 + j10 * j10), sy = (float)std::sqrt(j01 * j01 + j11 * j11);
+    float vx = v_[0][i], vy = v_[1][i];
+    x_[0][i] = (float)u;
+    x_[1][i] = (float)v;
+    v_[0][i] = (float)(j00 * vx + j01 * vy);
+    v_[1][i] = (float)(j10 * vx + j11 * vy);
+    for (int d = 0; d < 4; d++) {
+      float s = d & 1 ? sy : sx;
+      if (d >= 2) {
+        x_[d][i] *= s;
+        v_[d][i] *= s;
+      }
+      pxx_[d][i] *= s * s;
+      pxv_[d][i] *= s * s;
+      pvv_[d][i] *= s * s;
+    }
+  }
+}
+
+void ByteTracker::predict_boxes(std::vector<Detection>& boxes) const {
+  boxes.resize(id_.size());
+  for (size_t i = 0; i < id_.size(); i++) {
+    Detection& det = boxes[i];
+    for (int d = 0; d < 4; d++) det.bbox[d] = x_[d][i] + v_[d][i];
+    det.bbox[2] = std::max(det.bbox[2], 0.f);
+    det.bbox[3] = std::max(det.bbox[3], 0.f);
+    det.conf = score_[i];
+    det.class_id = class_[i];
+  }
+}
+
+void ByteTracker::propagate(std::vector<Detection>& dets) const {
+  std::vector<Detection> boxes;
+  predict_boxes(boxes);
+  for (Detection& det : dets) {
+    int best = -1;
+    float best_iou = cfg_.match_iou;
+    for (size_t i = 0; i < boxes.size(); i++) {
+      if (boxes[i].class_id != det.class_id) continue;
+      float overlap = box_iou(det.bbox, boxes[i].bbox);
+      if (overlap >= best_iou) {
+        best_iou = overlap;
+        best = (int)i;
+      }
+    }
+    if (best >= 0) std::copy(boxes[best].bbox, boxes[best].bbox + 4, det.bbox);
+  }
+}
+
+void ByteTracker::tracked(std::vector<Track>& tracks) const {
+  tracks.clear();
+  for (size_t i = 0; i < id_.size(); i++) {
+    if (state_[i] != kTracked || misses_[i] != 0) continue;
+    Track t;
+    t.id = id_[i];
+    for (int d = 0; d < 4; d++) t.det.bbox[d] = x_[d][i];
+    t.det.conf = score_[i];
+    t.det.class_id = class_[i];
+    t.hits = hits_[i];
+    t.misses = misses_[i];
+    tracks.push_back(t);
+  }
+}
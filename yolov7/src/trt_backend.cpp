@@ -0,0 +1,182 @@
+#include "trt_backend.h"
+#include "cuda_utils.h"
+#include "detector.h"
+#include "yololayer.h"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace nvinfer1;
+
+static double ms_since(const std::chrono::steady_clock::time_point& t) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+std::shared_ptr<TrtEngine> load_trt_engine(const std::string& engine_path) {
+  std::ifstream file(engine_path, std::ios::binary);
+  if (!file.good()) {
+    std::cerr << "read " << engine_path << " error!" << std::endl;
+    assert(false);
+  }
+  file.seekg(0, file.end);
+  size_t size = file.tellg();
+  file.seekg(0, file.beg);
+  std::vector<char> serialized_engine(size);
+  file.read(serialized_engine.data(), size);
+  file.close();
+
+  std::shared_ptr<TrtEngine> res(new TrtEngine());
+  res->runtime.reset(createInferRuntime(res->logger));
+  assert(res->runtime);
+  res->engine.reset(res->runtime->deserializeCudaEngine(serialized_engine.data(), size));
+  assert(res->engine);
+  // Read back from this engine's own plan, the YoloLayer sits behind TensorRT
+  int b = res->engine->hasImplicitBatchDimension() ? 0 : 1;
+  Dims in_dims = res->engine->getBindingDimensions(0);
+  if (in_dims.nbDims == 3 + b) {
+    res->ignore_thresh = yolo_layer_ignore_thresh(serialized_engine.data(), size, in_dims.d[b + 2], in_dims.d[b + 1]);
+  }
+  return res;
+}
+
+// Defined here rather than in detector.cpp, so the mock-only Python module
+// links detector.cpp without TensorRT
+Detector::Detector(const std::string& engine_path, const PipelineConfig& cfg)
+    : Detector(std::unique_ptr<DetectorBackend>(new TrtBackend(engine_path, cfg)), cfg) {}
+
+TrtBackend::TrtBackend(const std::string& engine_path, const PipelineConfig& cfg)
+    : TrtBackend(load_trt_engine(engine_path), cfg) {}
+
+TrtBackend::TrtBackend(std::shared_ptr<TrtEngine> engine, const PipelineConfig& cfg)
+    : shared_(engine), ring_(cfg.infer_slots) {
+  assert(shared_ && shared_->engine);
+  engine_ = shared_->engine.get();
+  context_.reset(engine_->createExecutionContext());
+  assert(context_);
+  shared_->contexts++;
+  if (!check_engine(cfg)) assert(false);
+
+  batch_size_ = cfg.batch_size;
+  CUDA_CHECK(cudaStreamCreate(&copy_stream_));
+  CUDA_CHECK(cudaStreamCreate(&infer_stream_));
+  for (int i = 0; i < ring_.size(); i++) {
+    Slot& slot = ring_.at(i);
+    CUDA_CHECK(cudaMalloc((void**)&slot.input_device, batch_size_ * 3 * input_h_ * input_w_ * sizeof(float)));
+    CUDA_CHECK(cudaMalloc((void**)&slot.output_device, batch_size_ * kOutputSize * sizeof(float)));
+    CUDA_CHECK(cudaMallocHost((void**)&slot.output_host, batch_size_ * kOutputSize * sizeof(float)));
+    cuda_preprocess_init(slot.staging, cfg.max_input_image_size);
+    CUDA_CHECK(cudaEventCreate(&slot.start));
+    CUDA_CHECK(cudaEventCreateWithFlags(&slot.uploaded, cudaEventDisableTiming));
+    CUDA_CHECK(cudaEventCreate(&slot.done));
+  }
+}
+
+TrtBackend::~TrtBackend() {
+  if (copy_stream_) CUDA_CHECK(cudaStreamSynchronize(copy_stream_));
+  if (infer_stream_) CUDA_CHECK(cudaStreamSynchronize(infer_stream_));
+  for (int i = 0; i < ring_.size(); i++) {
+    Slot& slot = ring_.at(i);
+    cuda_preprocess_destroy(slot.staging);
+    CUDA_CHECK(cudaFree(slot.input_device));
+    CUDA_CHECK(cudaFree(slot.output_device));
+    CUDA_CHECK(cudaFreeHost(slot.output_host));
+    if (slot.start) CUDA_CHECK(cudaEventDestroy(slot.start));
+    if (slot.uploaded) CUDA_CHECK(cudaEventDestroy(slot.uploaded));
+    if (slot.done) CUDA_CHECK(cudaEventDestroy(slot.done));
+  }
+  if (copy_stream_) CUDA_CHECK(cudaStreamDestroy(copy_stream_));
+  if (infer_stream_) CUDA_CHECK(cudaStreamDestroy(infer_stream_));
+  // The context must go before the engine, which is released with shared_
+  context_.reset();
+  shared_->contexts--;
+}
+
+bool TrtBackend::check_engine(const PipelineConfig& cfg) {
+  // The engine records the shapes it was built with, make sure they agree
+  // with the architectural constants this binary was compiled with.
+  if (engine_->getNbBindings() != 2 || engine_->getBindingIndex(kInputTensorName) != 0 || engine_->getBindingIndex(kOutputTensorName) != 1) {
+    std::cerr << "engine bindings don't match " << kInputTensorName << "/" << kOutputTensorName << std::endl;
+    return false;
+  }
+  // Explicit batch engines carry a leading (dynamic) batch dimension and
+  // bound it with an optimization profile instead of getMaxBatchSize().
+  explicit_batch_ = !engine_->hasImplicitBatchDimension();
+  if (explicit_batch_ && shared_->contexts > engine_->getNbOptimizationProfiles()) {
+    std::cerr << "explicit batch engine has " << engine_->getNbOptimizationProfiles() << " optimization profile(s), one per execution context;"
+              << " use an implicit batch engine for more infer_workers" << std::endl;
+    return false;
+  }
+  int b = explicit_batch_ ? 1 : 0;
+  Dims in_dims = engine_->getBindingDimensions(0);
+  Dims out_dims = engine_->getBindingDimensions(1);
+  if (in_dims.nbDims != 3 + b || in_dims.d[b] != 3) {
+    std::cerr << "engine input is not a 3 channel image" << std::endl;
+    return false;
+  }
+  if (out_dims.d[b] != kOutputSize) {
+    std::cerr << "engine output size " << out_dims.d[b] << " != " << kOutputSize << ", was kMaxNumOutputBbox changed? please re-serialize the engine" << std::endl;
+    return false;
+  }
+  int max_batch = explicit_batch_ ? engine_->getProfileDimensions(0, 0, OptProfileSelector::kMAX).d[0] : engine_->getMaxBatchSize();
+  if (cfg.batch_size > max_batch) {
+    std::cerr << "batch_size " << cfg.batch_size << " exceeds the engine's max batch size " << max_batch << std::endl;
+    return false;
+  }
+  // ignore_thresh can't change without re-serializing; say so once per engine
+  if (shared_->contexts == 1 && shared_->ignore_thresh >= 0.f && std::fabs(cfg.ignore_thresh - shared_->ignore_thresh) > 1e-6f) {
+    std::cerr << "warning: ignore_thresh " << cfg.ignore_thresh << " has no effect, the engine was serialized with "
+              << shared_->ignore_thresh << "; re-serialize (-s) to change it" << std::endl;
+  }
+  // The engine is built for one input shape, read it back instead of assuming kInputW x kInputH
+  input_h_ = in_dims.d[b + 1];
+  input_w_ = in_dims.d[b + 2];
+  return true;
+}
+
+void TrtBackend::submit(std::vector<cv::Mat>& img_batch) {
+  assert((int)img_batch.size() <= batch_size_);
+  // A free slot's previous batch has been collected, i.e. its done event
+  // has completed, so its staging and tensors can be overwritten.
+  Slot& slot = ring_.acquire();
+  auto start = std::chrono::steady_clock::now();
+  slot.batch = img_batch.size();
+
+  // Upload + preprocess on the copy stream, overlapping the previous
+  // slot's inference and download on the infer stream
+  CUDA_CHECK(cudaEventRecord(slot.start, copy_stream_));
+  cuda_batch_preprocess(slot.staging, img_batch, slot.input_device, input_w_, input_h_, copy_stream_);
+  CUDA_CHECK(cudaEventRecord(slot.uploaded, copy_stream_));
+
+  // infer on the batch asynchronously, and DMA output back to host
+  CUDA_CHECK(cudaStreamWaitEvent(infer_stream_, slot.uploaded, 0));
+  void* bindings[2] = {slot.input_device, slot.output_device};
+  if (explicit_batch_) {
+    context_->setBindingDimensions(0, Dims4{slot.batch, 3, input_h_, input_w_});
+    context_->enqueueV2(bindings, infer_stream_, nullptr);
+  } else {
+    context_->enqueue(slot.batch, bindings, infer_stream_, nullptr);
+  }
+  CUDA_CHECK(cudaMemcpyAsync(slot.output_host, slot.output_device, slot.batch * kOutputSize * sizeof(float), cudaMemcpyDeviceToHost, infer_stream_));
+  CUDA_CHECK(cudaEventRecord(slot.done, infer_stream_));
+  stats_.submit_ms += ms_since(start);
+  ring_.commit();
+}
+
+int TrtBackend::collect(float* output) {
+  Slot& slot = ring_.front();
+  auto start = std::chrono::steady_clock::now();
+  CUDA_CHECK(cudaEventSynchronize(slot.done));
+  stats_.wait_ms += ms_since(start);
+  float device_ms = 0;
+  CUDA_CHECK(cudaEventElapsedTime(&device_ms, slot.start, slot.done));
+  stats_.device_ms += device_ms;
+  stats_.batches++;
+  int batch = slot.batch;
+  memcpy(output, slot.output_host, batch * kOutputSize * sizeof(float));
+  ring_.release();
+  return batch;
+}
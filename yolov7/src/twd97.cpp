@@ -0,0 +1,107 @@
+#include "twd97.h"
+#include <cassert>
+#include <cmath>
+
+static const double kDegToRad = M_PI / 180.0;
+
+// Newton steps from tau' to tau, two already reach double precision
+static const int kInverseIterations = 2;
+
+TransverseMercator::TransverseMercator(double a, double f, double lon0_deg, double k0, double false_easting,
+                                       double false_northing)
+    : lon0_(lon0_deg * kDegToRad), x0_(false_easting), y0_(false_northing) {
+  assert(a > 0 && f > 0 && f < 1 && k0 > 0);
+  double e2 = f * (2 - f);
+  e_ = std::sqrt(e2);
+  e2m_ = 1 - e2;
+  double n = f / (2 - f);
+  double n2 = n * n, n3 = n2 * n, n4 = n3 * n, n5 = n4 * n, n6 = n5 * n;
+  scale_ = k0 * a / (1 + n) * (1 + n2 / 4 + n4 / 64 + n6 / 256);
+
+  alpha_[0] = n / 2 - 2 * n2 / 3 + 5 * n3 / 16 + 41 * n4 / 180 - 127 * n5 / 288 + 7891 * n6 / 37800;
+  alpha_[1] = 13 * n2 / 48 - 3 * n3 / 5 + 557 * n4 / 1440 + 281 * n5 / 630 - 1983433 * n6 / 1935360;
+  alpha_[2] = 61 * n3 / 240 - 103 * n4 / 140 + 15061 * n5 / 26880 + 167603 * n6 / 181440;
+  alpha_[3] = 49561 * n4 / 161280 - 179 * n5 / 168 + 6601661 * n6 / 7257600;
+  alpha_[4] = 34729 * n5 / 80640 - 3418889 * n6 / 1995840;
+  alpha_[5] = 212378941 * n6 / 319334400;
+
+  beta_[0] = n / 2 - 2 * n2 / 3 + 37 * n3 / 96 - n4 / 360 - 81 * n5 / 512 + 96199 * n6 / 604800;
+  beta_[1] = n2 / 48 + n3 / 15 - 437 * n4 / 1440 + 46 * n5 / 105 - 1118711 * n6 / 3870720;
+  beta_[2] = 17 * n3 / 480 - 37 * n4 / 840 - 209 * n5 / 4480 + 5569 * n6 / 90720;
+  beta_[3] = 4397 * n4 / 161280 - 11 * n5 / 504 - 830251 * n6 / 7257600;
+  beta_[4] = 4583 * n5 / 161280 - 108847 * n6 / 3991680;
+  beta_[5] = 20648693 * n6 / 638668800;
+}
+
+// sum c[j] sin(2(j+1)u) cosh(2(j+1)v) and sum c[j] cos(2(j+1)u) sinh(2(j+1)v),
+// the multiples built up from the first by angle addition
+static inline void krueger_sum(const double* c, double u, double v, double& su, double& sv) {
+  double s1 = std::sin(2 * u), c1 = std::cos(2 * u);
+  double e = std::exp(2 * v);
+  double sh1 = (e - 1 / e) / 2, ch1 = (e + 1 / e) / 2;
+  double s = s1, co = c1, sh = sh1, ch = ch1;
+  su = 0;
+  sv = 0;
+  for (int j = 0; j < 6; j++) {
+    su += c[j] * s * ch;
+    sv += c[j] * co * sh;
+    double s_next = s * c1 + co * s1;
+    double c_next = co * c1 - s * s1;
+    double sh_next = sh * ch1 + ch * sh1;
+    double ch_next = ch * ch1 + sh * sh1;
+    s = s_next;
+    co = c_next;
+    sh = sh_next;
+    ch = ch_next;
+  }
+}
+
+// Conformal latitude's tangent from the geographic one
+static inline double tau_prime(double tau, double e) {
+  double t1 = std::sqrt(1 + tau * tau);
+  double sig = std::sinh(e * std::atanh(e * tau / t1));
+  return tau * std::sqrt(1 + sig * sig) - sig * t1;
+}
+
+void TransverseMercator::forward(const double* lat, const double* lon, size_t n, double* x, double* y) const {
+  for (size_t i = 0; i < n; i++) {
+    double lam = lon[i] * kDegToRad - lon0_;
+    double taup = tau_prime(std::tan(lat[i] * kDegToRad), e_);
+    double cl = std::cos(lam);
+    double xip = std::atan2(taup, cl);
+    double etap = std::asinh(std::sin(lam) / std::sqrt(taup * taup + cl * cl));
+    double su, sv;
+    krueger_sum(alpha_, xip, etap, su, sv);
+    x[i] = x0_ + scale_ * (etap + sv);
+    y[i] = y0_ + scale_ * (xip + su);
+  }
+}
+
+void TransverseMercator::inverse(const double* x, const double* y, size_t n, double* lat, double* lon) const {
+  for (size_t i = 0; i < n; i++) {
+    double xi = (y[i] - y0_) / scale_;
+    double eta = (x[i] - x0_) / scale_;
+    double su, sv;
+    krueger_sum(beta_, xi, eta, su, sv);
+    double xip = xi - su;
+    double etap = eta - sv;
+    double she = std::sinh(etap);
+    double cx = std::cos(xip);
+    double taup = std::sin(xip) / std::sqrt(she * she + cx * cx);
+    // Newton on tau_prime(tau) = taup
+    double tau = taup / e2m_;
+    for (int k = 0; k < kInverseIterations; k++) {
+      double tp = tau_prime(tau, e_);
+      double dtau = (taup - tp) / std::sqrt(1 + tp * tp) * (1 + e2m_ * tau * tau) / (e2m_ * std::sqrt(1 + tau * tau));
+      tau += dtau;
+    }
+    lat[i] = std::atan(tau) / kDegToRad;
+    lon[i] = (lon0_ + std::atan2(she, cx)) / kDegToRad;
+  }
+}
+
+const TransverseMercator& twd97_tm2() {
+  // GRS80
+  static const TransverseMercator tm(6378137.0, 1 / 298.257222101, 121.0, 0.9999, 250000.0, 0.0);
+  return tm;
+}
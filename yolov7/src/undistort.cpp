@@ -0,0 +1,155 @@
+#include "undistort.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+
+// Nodes beyond each frame edge, for boxes reaching out of the frame
+static const int kMarginCells = 4;
+
+bool load_calibration(const std::string& path, CameraIntrinsics& camera, std::vector<double>& dist) {
+  cv::FileStorage fs(path, cv::FileStorage::READ);
+  if (!fs.isOpened()) {
+    std::cerr << "read " << path << " error!" << std::endl;
+    return false;
+  }
+  cv::Mat K, D;
+  int width = 0, height = 0;
+  fs["camera_matrix"] >> K;
+  fs["distortion_coefficients"] >> D;
+  fs["image_width"] >> width;
+  fs["image_height"] >> height;
+  if (K.rows != 3 || K.cols != 3 || width <= 0 || height <= 0) {
+    std::cerr << path << ": missing camera_matrix, image_width or image_height" << std::endl;
+    return false;
+  }
+  size_t n = D.total();
+  if (n != 4 && n != 5 && n != 8) {
+    std::cerr << path << ": " << n << " distortion coefficients, expected k1, k2, p1, p2[, k3[, k4, k5, k6]]"
+              << std::endl;
+    return false;
+  }
+  K.convertTo(K, CV_64F);
+  D.convertTo(D, CV_64F);
+  camera.width = width;
+  camera.height = height;
+  camera.fx = (float)K.at<double>(0, 0);
+  camera.fy = (float)K.at<double>(1, 1);
+  camera.cx = (float)K.at<double>(0, 2);
+  camera.cy = (float)K.at<double>(1, 2);
+  dist.assign(D.ptr<double>(), D.ptr<double>() + n);
+  return true;
+}
+
+CameraIntrinsics scale_intrinsics(const CameraIntrinsics& camera, int width, int height) {
+  float sx = (float)width / camera.width, sy = (float)height / camera.height;
+  CameraIntrinsics c = camera;
+  c.width = width;
+  c.height = height;
+  c.fx *= sx;
+  c.cx *= sx;
+  c.fy *= sy;
+  c.cy *= sy;
+  return c;
+}
+
+PointUndistorter::PointUndistorter(const CameraIntrinsics& camera, const std::vector<double>& dist, int step)
+    : camera_(camera), step_(step) {
+  assert(camera.fx > 0.f && camera.fy > 0.f && step > 0 && dist.size() <= 8);
+  std::fill(k_, k_ + 8, 0.0);
+  std::copy(dist.begin(), dist.end(), k_);
+
+  cols_ = (camera.width - 1 + step - 1) / step + 1 + 2 * kMarginCells;
+  rows_ = (camera.height - 1 + step - 1) / step + 1 + 2 * kMarginCells;
+  grid_.resize((size_t)cols_ * rows_ * 2);
+  for (int r = 0; r < rows_; r++) {
+    for (int c = 0; c < cols_; c++) {
+      double u = (c - kMarginCells) * step, v = (r - kMarginCells) * step, ux, uy;
+      undistort_exact(u, v, ux, uy);
+      float* g = &grid_[((size_t)r * cols_ + c) * 2];
+      g[0] = (float)(ux - u);
+      g[1] = (float)(uy - v);
+    }
+  }
+
+  // Blends are worst halfway between nodes
+  for (int r = kMarginCells; r + 1 < rows_; r++) {
+    for (int c = kMarginCells; c + 1 < cols_; c++) {
+      double u = (c - kMarginCells + 0.5) * step, v = (r - kMarginCells + 0.5) * step, ux, uy;
+      if (u > camera.width - 1 || v > camera.height - 1) continue;
+      undistort_exact(u, v, ux, uy);
+      float pu = (float)u, pv = (float)v;
+      undistort(&pu, &pv, 1, &pu, &pv);
+      max_error_ = std::max(max_error_, (float)std::hypot(pu - ux, pv - uy));
+    }
+  }
+}
+
+void PointUndistorter::distort(double x, double y, double& xd, double& yd) const {
+  double r2 = x * x + y * y;
+  double radial = (1 + ((k_[4] * r2 + k_[1]) * r2 + k_[0]) * r2) / (1 + ((k_[7] * r2 + k_[6]) * r2 + k_[5]) * r2);
+  xd = x * radial + 2 * k_[2] * x * y + k_[3] * (r2 + 2 * x * x);
+  yd = y * radial + k_[2] * (r2 + 2 * y * y) + 2 * k_[3] * x * y;
+}
+
+void PointUndistorter::undistort_exact(double u, double v, double& ux, double& uy) const {
+  // Newton's method on distort(x, y) = (xd, yd) from the distorted point,
+  // halving steps that don't reduce the residual
+  double xd = (u - camera_.cx) / camera_.fx, yd = (v - camera_.cy) / camera_.fy;
+  double x = xd, y = yd, ex, ey;
+  distort(x, y, ex, ey);
+  ex -= xd;
+  ey -= yd;
+  double err = ex * ex + ey * ey;
+  const double h = 1e-7;
+  for (int i = 0; i < 50 && err > 1e-26; i++) {
+    double ax, ay, bx, by, cx, cy, dx, dy;
+    distort(x + h, y, ax, ay);
+    distort(x - h, y, bx, by);
+    distort(x, y + h, cx, cy);
+    distort(x, y - h, dx, dy);
+    double j00 = (ax - bx) / (2 * h), j10 = (ay - by) / (2 * h);
+    double j01 = (cx - dx) / (2 * h), j11 = (cy - dy) / (2 * h);
+    double det = j00 * j11 - j01 * j10;
+    if (det == 0) break;
+    double sx = (j11 * ex - j01 * ey) / det, sy = (j00 * ey - j10 * ex) / det;
+    bool better = false;
+    for (double s = 1; s > 1e-3 && !better; s /= 2) {
+      double nx = x - s * sx, ny = y - s * sy, fx, fy;
+      distort(nx, ny, fx, fy);
+      fx -= xd;
+      fy -= yd;
+      if (fx * fx + fy * fy < err) {
+        x = nx;
+        y = ny;
+        ex = fx;
+        ey = fy;
+        err = fx * fx + fy * fy;
+        better = true;
+      }
+    }
+    if (!better) break;
+  }
+  ux = x * camera_.fx + camera_.cx;
+  uy = y * camera_.fy + camera_.cy;
+}
+
+void PointUndistorter::undistort(const float* px, const float* py, size_t n, float* ux, float* uy) const {
+  const float inv = 1.f / step_;
+  const float max_c = cols_ - 2.f, max_r = rows_ - 2.f;
+  for (size_t i = 0; i < n; i++) {
+    float u = px[i], v = py[i];
+    // Beyond the grid the edge cells extrapolate
+    float gx = u * inv + kMarginCells, gy = v * inv + kMarginCells;
+    int c = (int)std::min(std::max(gx, 0.f), max_c);
+    int r = (int)std::min(std::max(gy, 0.f), max_r);
+    float fx = gx - c, fy = gy - r;
+    const float* a = &grid_[((size_t)r * cols_ + c) * 2];
+    const float* b = a + cols_ * 2;
+    float top_u = a[0] + fx * (a[2] - a[0]), top_v = a[1] + fx * (a[3] - a[1]);
+    float bottom_u = b[0] + fx * (b[2] - b[0]), bottom_v = b[1] + fx * (b[3] - b[1]);
+    ux[i] = u + top_u + fy * (bottom_u - top_u);
+    uy[i] = v + top_v + fy * (bottom_v - top_v);
+  }
+}
@@ -0,0 +1,181 @@
+// Checks the micro-batching policy (BatchPolicy::decide) against a table of
+// queue depths, waits and batch limits, then replays camera arrival traces
+// through it the way BatchScheduler's dispatch thread does:
+//
+//   ./batch_policy_bench                       // checks, then 3 streams at 30 fps
+//   ./batch_policy_bench --streams 2 --fps 60 --max_batch 4 --max_wait_us 8000
+//
+// The replay runs on made up time points, no threads and no GPU: every
+// frame has to go out within max_wait of arriving, no batch may exceed
+// max_batch, and streams in step have to fill their batches. Exits non-zero
+// when a check fails.
+#include "batch_scheduler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+typedef std::chrono::microseconds Us;
+
+static int failures = 0;
+
+static void check(const std::string& what, bool ok, double value) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << value << std::endl;
+}
+
+struct PolicyCase {
+  const char* what;
+  int max_batch;
+  int max_wait_us;
+  size_t pending;
+  int age_us;      // of the oldest pending frame
+  int dispatch;    // expected
+  int wake_us;     // expected wake after the oldest frame, -1 = left alone
+};
+
+static void check_table() {
+  const PolicyCase cases[] = {
+    {"nothing pending", 4, 5000, 0, 0, 0, -1},
+    {"nothing pending, long past the wait", 4, 5000, 0, 100000, 0, -1},
+    {"full batch goes at once", 4, 5000, 4, 0, 4, -1},
+    {"deeper queue than a batch, max_batch", 4, 5000, 9, 0, 4, -1},
+    {"deeper queue after the wait, still max_batch", 4, 5000, 9, 20000, 4, -1},
+    {"partial batch waits", 4, 5000, 3, 0, 0, 5000},
+    {"partial batch just before the deadline", 4, 5000, 3, 4999, 0, 5000},
+    {"partial batch at the deadline", 4, 5000, 3, 5000, 3, 5000},
+    {"partial batch past the deadline", 4, 5000, 1, 12000, 1, 5000},
+    {"no wait dispatches anything", 4, 0, 1, 0, 1, 0},
+    {"batch of one never waits", 1, 5000, 1, 0, 1, -1},
+  };
+  TimePoint oldest = TimePoint() + std::chrono::seconds(10);
+  for (const PolicyCase& c : cases) {
+    BatchPolicy policy;
+    policy.max_batch = c.max_batch;
+    policy.max_wait = Us(c.max_wait_us);
+    TimePoint untouched = TimePoint();
+    TimePoint wake = untouched;
+    int n = policy.decide(c.pending, oldest, oldest + Us(c.age_us), wake);
+    bool wake_ok = c.wake_us < 0 ? wake == untouched : wake == oldest + Us(c.wake_us);
+    check(c.what, n == c.dispatch && wake_ok, n);
+  }
+}
+
+struct Replay {
+  std::vector<uint64_t> fill;  // fill[n]: batches of n frames
+  uint64_t oversized = 0;      // batches over max_batch
+  double mean_fill = 0;        // frames per batch over max_batch
+  double max_wait_us = 0;
+  double mean_wait_us = 0;
+};
+
+// Frames of each stream arrive every period with jitter, streams offset by
+// phase_us from each other. Dispatch happens on arrivals and at wake times,
+// like the scheduler's condition variable wait_until.
+static Replay replay(const BatchPolicy& policy, int streams, double fps, int frames, int phase_us, int jitter_us,
+                     unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> jitter(-jitter_us, jitter_us);
+  std::vector<TimePoint> arrivals;
+  TimePoint t0 = TimePoint() + std::chrono::seconds(1);
+  for (int s = 0; s < streams; s++) {
+    for (int i = 0; i < frames; i++) {
+      arrivals.push_back(t0 + Us((int64_t)(i * 1e6 / fps) + s * phase_us + jitter(rng)));
+    }
+  }
+  std::sort(arrivals.begin(), arrivals.end());
+
+  Replay r;
+  r.fill.assign(policy.max_batch + 1, 0);
+  std::deque<TimePoint> pending;
+  size_t next = 0;
+  uint64_t batches = 0, sent = 0;
+  double wait_sum = 0;
+  TimePoint wake = TimePoint::max();
+  while (next < arrivals.size() || !pending.empty()) {
+    TimePoint now = next < arrivals.size() ? std::min(arrivals[next], wake) : wake;
+    while (next < arrivals.size() && arrivals[next] <= now) pending.push_back(arrivals[next++]);
+    wake = TimePoint::max();
+    for (;;) {
+      int n = pending.empty() ? 0 : policy.decide(pending.size(), pending.front(), now, wake);
+      if (n == 0) break;
+      for (int i = 0; i < n; i++) {
+        double wait = std::chrono::duration<double, std::micro>(now - pending.front()).count();
+        r.max_wait_us = std::max(r.max_wait_us, wait);
+        wait_sum += wait;
+        pending.pop_front();
+      }
+      if (n > policy.max_batch) {
+        r.oversized++;
+      } else {
+        r.fill[n]++;
+      }
+      batches++;
+      sent += n;
+      wake = TimePoint::max();
+    }
+  }
+  r.mean_fill = batches ? (double)sent / (batches * policy.max_batch) : 0;
+  r.mean_wait_us = sent ? wait_sum / sent : 0;
+  return r;
+}
+
+static void check_replay(int streams, double fps, int max_batch, int max_wait_us) {
+  BatchPolicy policy;
+  policy.max_batch = max_batch;
+  policy.max_wait = Us(max_wait_us);
+  std::cout << streams << " streams at " << fps << " fps, max_batch " << max_batch << ", max_wait " << max_wait_us
+            << "us:" << std::endl;
+  // Cameras in step (1 ms apart): batches fill before the wait runs out
+  Replay in_step = replay(policy, streams, fps, 3000, 1000, 200, 1);
+  check("in step, no frame waits past max_wait (us)", in_step.max_wait_us <= max_wait_us, in_step.max_wait_us);
+  check("in step, batches over max_batch", in_step.oversized == 0, (double)in_step.oversized);
+  if (streams <= max_batch && (streams - 1) * 1000 + 400 < max_wait_us) {
+    check("in step, mean fill over streams/max_batch", in_step.mean_fill >= 0.99 * streams / max_batch,
+          in_step.mean_fill * max_batch / streams);
+  }
+  // Cameras out of step (half a period apart): the wait bounds the latency
+  int half = (int)(0.5e6 / fps / std::max(1, streams - 1));
+  Replay skewed = replay(policy, streams, fps, 3000, half, 2000, 2);
+  check("out of step, no frame waits past max_wait (us)", skewed.max_wait_us <= max_wait_us, skewed.max_wait_us);
+  check("out of step, batches over max_batch", skewed.oversized == 0, (double)skewed.oversized);
+  for (const Replay* r : {&in_step, &skewed}) {
+    std::cout << "  " << (r == &in_step ? "in step:     " : "out of step: ") << "fill";
+    for (int n = 1; n <= max_batch; n++) std::cout << " " << n << ":" << r->fill[n];
+    std::cout << ", mean fill " << r->mean_fill << ", wait mean " << r->mean_wait_us << "us max " << r->max_wait_us
+              << "us" << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  int streams = 3, max_batch = 4, max_wait_us = 8000;
+  double fps = 30;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--streams") {
+      streams = atoi(argv[i + 1]);
+    } else if (key == "--fps") {
+      fps = atof(argv[i + 1]);
+    } else if (key == "--max_batch") {
+      max_batch = atoi(argv[i + 1]);
+    } else if (key == "--max_wait_us") {
+      max_wait_us = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./batch_policy_bench [--streams 3] [--fps 30] [--max_batch 4] [--max_wait_us 8000]" << std::endl;
+      return -1;
+    }
+  }
+  std::cout << "decide():" << std::endl;
+  check_table();
+  check_replay(2, 30, 2, 5000);
+  check_replay(streams, fps, max_batch, max_wait_us);
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
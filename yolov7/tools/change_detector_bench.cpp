@@ -0,0 +1,238 @@
+// Checks the static scene gate (ChangeDetector and its parts) on synthetic
+// frames cut from one textured ground image, then measures it:
+//
+//   ./change_detector_bench                  // checks, then 1920x1080 frames
+//   ./change_detector_bench --width 3840 --height 2160 --scale 8
+//
+// downsample_gray has to return block means of (B + 2G + R) / 4, and
+// estimate_shift every shift within the search range exactly. An unchanged
+// frame and a frame shifted by the camera reuse the reference detections
+// (moved by the shift), a moving object makes the frame infer, and
+// max_skip reused frames in a row force the next one through. With a
+// tracker, a reused detection of a moving target is moved along its track
+// (ByteTracker::propagate). Exits non-zero when a check fails.
+#include "change_detector.h"
+#include "tracker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const std::string& what, bool ok, double got) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << std::endl;
+}
+
+// Gray ground texture: value noise on a 16 pixel lattice, bilinear between
+// the lattice points, so every shift looks different
+static cv::Mat make_ground(int w, int h, unsigned seed) {
+  const int cell = 16;
+  int gw = w / cell + 2, gh = h / cell + 2;
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> level(20, 235);
+  std::vector<int> lattice((size_t)gw * gh);
+  for (int& v : lattice) v = level(rng);
+  cv::Mat img(h, w, CV_8UC3);
+  for (int y = 0; y < h; y++) {
+    uint8_t* row = img.ptr(y);
+    int gy = y / cell;
+    float fy = (y % cell) / (float)cell;
+    for (int x = 0; x < w; x++) {
+      int gx = x / cell;
+      float fx = (x % cell) / (float)cell;
+      float top = lattice[gy * gw + gx] * (1 - fx) + lattice[gy * gw + gx + 1] * fx;
+      float bottom = lattice[(gy + 1) * gw + gx] * (1 - fx) + lattice[(gy + 1) * gw + gx + 1] * fx;
+      uint8_t v = (uint8_t)(top * (1 - fy) + bottom * fy);
+      row[x * 3] = row[x * 3 + 1] = row[x * 3 + 2] = v;
+    }
+  }
+  return img;
+}
+
+static cv::Mat crop(const cv::Mat& ground, int x, int y, int w, int h) {
+  cv::Mat frame(h, w, CV_8UC3);
+  ground(cv::Rect(x, y, w, h)).copyTo(frame);
+  return frame;
+}
+
+static void fill_square(cv::Mat& frame, int x0, int y0, int size, uint8_t v) {
+  for (int y = y0; y < y0 + size; y++) {
+    uint8_t* row = frame.ptr(y);
+    for (int x = x0 * 3; x < (x0 + size) * 3; x++) row[x] = v;
+  }
+}
+
+static Detection make_det(float cx, float cy, float w, float h, float class_id = 0.f) {
+  Detection d;
+  d.bbox[0] = cx;
+  d.bbox[1] = cy;
+  d.bbox[2] = w;
+  d.bbox[3] = h;
+  d.conf = 0.9f;
+  d.class_id = class_id;
+  return d;
+}
+
+static void check_parts() {
+  // B 10, G 100, R 30: (10 + 200 + 30) / 4 = 60, on a size that doesn't divide
+  cv::Mat solid(481, 643, CV_8UC3);
+  for (int y = 0; y < solid.rows; y++) {
+    uint8_t* row = solid.ptr(y);
+    for (int x = 0; x < solid.cols; x++) {
+      row[x * 3] = 10;
+      row[x * 3 + 1] = 100;
+      row[x * 3 + 2] = 30;
+    }
+  }
+  GrayFrame gray;
+  downsample_gray(solid, 4, gray);
+  bool all_60 = std::all_of(gray.px.begin(), gray.px.end(), [](uint8_t v) { return v == 60; });
+  check("downsample_gray: 643x481 / 4 is 160x120", gray.w == 160 && gray.h == 120, gray.w * 1000 + gray.h);
+  check("downsample_gray: (B + 2G + R) / 4", all_60 && gray.px.size() == 160 * 120, gray.px.empty() ? -1 : gray.px[0]);
+  // Left half of each 4x4 block 0, right half 200: mean 100
+  cv::Mat halves(8, 8, CV_8UC3);
+  for (int y = 0; y < 8; y++) {
+    for (int x = 0; x < 8; x++) std::fill_n(halves.ptr(y) + x * 3, 3, (uint8_t)(x % 4 < 2 ? 0 : 200));
+  }
+  downsample_gray(halves, 4, gray);
+  check("downsample_gray averages the block", gray.px.size() == 4 && gray.px[0] == 100 && gray.px[3] == 100, gray.px[0]);
+
+  // cur(x, y) = ref(x - dx, y - dy) for every shift in +-search
+  cv::Mat ground = make_ground(800, 600, 1);
+  int scale = 4, search = 4;
+  GrayFrame ref, cur;
+  downsample_gray(crop(ground, 80, 60, 640, 480), scale, ref);
+  int wrong = 0, shifts = 0;
+  for (int dy = -search; dy <= search; dy++) {
+    for (int dx = -search; dx <= search; dx++) {
+      downsample_gray(crop(ground, 80 - dx * scale, 60 - dy * scale, 640, 480), scale, cur);
+      int ex = 99, ey = 99;
+      estimate_shift(ref, cur, search, ex, ey);
+      shifts++;
+      if (ex != dx || ey != dy) wrong++;
+    }
+  }
+  check("estimate_shift recovers all " + std::to_string(shifts) + " shifts in +-4", wrong == 0, wrong);
+  check("changed_fraction of the same frame is 0", changed_fraction(ref, ref, 0, 0, 8, 6.f) == 0.f,
+        changed_fraction(ref, ref, 0, 0, 8, 6.f));
+  // A 64 pixel square is 16 downsampled pixels, 2 x 2 aligned blocks of 8
+  cv::Mat moved = crop(ground, 80, 60, 640, 480);
+  fill_square(moved, 128, 128, 64, 255);
+  downsample_gray(moved, scale, cur);
+  float frac = changed_fraction(ref, cur, 0, 0, 8, 6.f);
+  check("changed_fraction counts the blocks under an object", std::fabs(frac - 4.f / 300) < 1e-6, frac * 300);
+}
+
+static void check_gate() {
+  cv::Mat ground = make_ground(800, 600, 2);
+  PipelineConfig cfg;
+  cfg.max_skip = 3;
+  ChangeDetector gate(cfg);
+  std::vector<Detection> ref_dets(1, make_det(300, 200, 40, 30));
+  std::vector<Detection> dets;
+
+  cv::Mat first = crop(ground, 80, 60, 640, 480);
+  bool first_reused = gate.reuse(first, dets);
+  check("first frame is inferred", !first_reused, first_reused);
+  gate.inferred(ref_dets);
+
+  bool reused = gate.reuse(crop(ground, 80, 60, 640, 480), dets);
+  check("unchanged frame is reused", reused, reused);
+  check("reused detections are the reference ones", dets.size() == 1 && dets[0].bbox[0] == 300.f && dets[0].bbox[1] == 200.f,
+        dets.empty() ? -1 : dets[0].bbox[0]);
+
+  // Camera moved 8 pixels left and 4 down: the scene moves 8 right, 4 up
+  reused = gate.reuse(crop(ground, 72, 64, 640, 480), dets);
+  check("shifted frame is reused", reused, reused);
+  check("reused detections move with the shift (+8, -4)",
+        dets.size() == 1 && dets[0].bbox[0] == 308.f && dets[0].bbox[1] == 196.f, dets.empty() ? -1 : dets[0].bbox[0]);
+
+  // An object the size of 16 of the 300 blocks, over change_frac 0.02
+  cv::Mat object = crop(ground, 80, 60, 640, 480);
+  fill_square(object, 320, 224, 128, 250);
+  reused = gate.reuse(object, dets);
+  check("moving object makes the frame infer", !reused, reused);
+  gate.inferred(ref_dets);
+  ChangeStats s = gate.stats();
+  check("no static frame forced yet", s.forced == 0 && s.skipped == 2, s.skipped);
+
+  // The object frame is the reference now; max_skip 3 reuses, then infers
+  int reuses = 0;
+  while (reuses < 10 && gate.reuse(object, dets)) reuses++;
+  check("max_skip reused frames in a row, then one is inferred", reuses == 3, reuses);
+  check("the inferred static frame counts as forced", gate.stats().forced == 1, gate.stats().forced);
+  gate.inferred(ref_dets);
+  check("reuse resumes after the forced frame", gate.reuse(object, dets), gate.stats().skipped);
+}
+
+static void check_propagate() {
+  // A target moving 6 pixels a frame to the right, tracked for 10 frames
+  ByteTracker tracker((TrackerConfig()));
+  std::vector<int> ids;
+  for (int f = 0; f < 10; f++) tracker.update(std::vector<Detection>(1, make_det(100 + 6 * f, 200, 40, 30)), ids);
+  // The next frames reuse the detections of frame 9 unmoved (static ground)
+  std::vector<Detection> dets;
+  dets.push_back(make_det(154, 200, 40, 30));
+  dets.push_back(make_det(154, 200, 40, 30, 1.f));
+  dets.push_back(make_det(500, 400, 40, 30));
+  float x = 154, worst = 0;
+  for (int f = 10; f < 13; f++) {
+    tracker.propagate(dets);
+    x += 6;
+    worst = std::max(worst, std::max(std::fabs(dets[0].bbox[0] - x), std::fabs(dets[0].bbox[1] - 200)));
+    tracker.update(dets, ids);
+  }
+  // The global shift would leave it 18 px behind after 3 frames
+  check("reused detection follows its track within 2 px", worst < 2.f, worst);
+  check("other class at the same place keeps its box", dets[1].bbox[0] == 154.f, dets[1].bbox[0]);
+  check("detection without a track keeps its box", dets[2].bbox[0] == 500.f && dets[2].bbox[1] == 400.f, dets[2].bbox[0]);
+  check("the track keeps its id", ids.size() == 3 && ids[0] > 0, ids.empty() ? -1 : ids[0]);
+}
+
+int main(int argc, char** argv) {
+  int width = 1920, height = 1080;
+  PipelineConfig cfg;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--width") {
+      width = atoi(argv[i + 1]);
+    } else if (key == "--height") {
+      height = atoi(argv[i + 1]);
+    } else if (key == "--scale") {
+      cfg.change_scale = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./change_detector_bench [--width 1920] [--height 1080] [--scale 4]" << std::endl;
+      return -1;
+    }
+  }
+  check_parts();
+  check_gate();
+  check_propagate();
+
+  // Hovering: the frame drifts by whole downsampled pixels, max_skip off
+  cfg.max_skip = 1 << 30;
+  int margin = 4 * cfg.change_scale;
+  cv::Mat ground = make_ground(width + 2 * margin, height + 2 * margin, 3);
+  std::vector<cv::Mat> frames;
+  for (int i = 0; i < 8; i++) frames.push_back(crop(ground, margin + i % 3 * cfg.change_scale, margin + i % 2 * cfg.change_scale, width, height));
+  ChangeDetector gate(cfg);
+  std::vector<Detection> dets;
+  gate.reuse(frames[0], dets);
+  gate.inferred(dets);
+  const int runs = 100;
+  for (int i = 0; i < runs; i++) gate.reuse(frames[i % frames.size()], dets);
+  const ChangeStats& s = gate.stats();
+  std::cout << width << "x" << height << " at 1/" << cfg.change_scale << ": " << s.cpu_ms / s.frames << "ms per frame, "
+            << s.skipped << " of " << runs << " reused" << std::endl;
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
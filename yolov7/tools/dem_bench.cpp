@@ -0,0 +1,231 @@
+// Checks the elevation model ray march on synthetic terrain, then measures
+// rays per second on rolling hills:
+//
+//   ./dem_bench                          // checks, then 200 boxes per frame
+//   ./dem_bench --boxes 1000 --frames 500
+//
+// The terrain is written to a temporary grid file and memory mapped like
+// a real one. Exits non-zero when a check fails.
+#include "dem.h"
+#include "geolocation.h"
+#include "twd97.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const char* what, double got, double want, double tol) {
+  bool ok = std::fabs(got - want) <= tol;
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << " (want " << want << ")" << std::endl;
+}
+
+// A grid of cols x rows samples, cell metres apart, centred on TWD97 (cx, cy)
+static bool make_dem(Dem& dem, const std::string& path, uint32_t cols, uint32_t rows, double cell, double cx, double cy,
+                     std::function<float(double, double)> height) {
+  double x0 = cx - (cols - 1) * cell / 2, y0 = cy + (rows - 1) * cell / 2;
+  std::vector<float> h((size_t)cols * rows);
+  for (uint32_t r = 0; r < rows; r++) {
+    for (uint32_t c = 0; c < cols; c++) h[(size_t)r * cols + c] = height(x0 + c * cell, y0 - r * cell);
+  }
+  return write_dem(path, cols, rows, x0, y0, cell, -9999.f, h.data()) && dem.open(path);
+}
+
+// Fine fixed steps, then bisection, on the bilinear heights
+static bool reference_hit(const Dem& dem, double x, double y, double z, double dx, double dy, double dz, double step,
+                          double& t) {
+  float h;
+  if (dem.height_at(x, y, h) && z < h) return false;  // starts underground
+  double prev = 0;
+  for (double s = step;; s += step) {
+    if (!dem.height_at(x + dx * s, y + dy * s, h)) return false;
+    if (z + dz * s <= h) {
+      double lo = prev, hi = s;
+      for (int i = 0; i < 60; i++) {
+        double mid = (lo + hi) / 2;
+        dem.height_at(x + dx * mid, y + dy * mid, h);
+        (z + dz * mid <= h ? hi : lo) = mid;
+      }
+      t = hi;
+      return true;
+    }
+    prev = s;
+  }
+}
+
+static FramePose pose_at(double lat, double lon, float alt, float pitch, float yaw) {
+  FramePose p;
+  p.lat = lat;
+  p.lon = lon;
+  p.alt = alt;
+  p.pitch = pitch;
+  p.yaw = yaw;
+  p.valid = true;
+  return p;
+}
+
+static float hills(double x, double y) {
+  // Rolling ridges plus a few sharp peaks, 0..~400 m
+  double h = 150 + 80 * std::sin(x / 900.0) * std::cos(y / 700.0) + 40 * std::sin((x + y) / 230.0);
+  h += 120 * std::exp(-((x - 250900) * (x - 250900) + (y - 2655300) * (y - 2655300)) / (2 * 150.0 * 150.0));
+  h += 90 * std::exp(-((x - 249300) * (x - 249300) + (y - 2654400) * (y - 2654400)) / (2 * 60.0 * 60.0));
+  return (float)h;
+}
+
+static void run_checks(const std::string& path) {
+  double lat = 24.0, lon = 121.0, cx, cy;
+  wgs84_to_twd97(&lat, &lon, 1, &cx, &cy);
+
+  std::cout << "level terrain equals the flat plane" << std::endl;
+  Dem flat;
+  if (!make_dem(flat, path, 401, 401, 20, cx, cy, [](double, double) { return 40.f; })) {
+    failures++;
+    return;
+  }
+  CameraIntrinsics cam = intrinsics_from_fov(1280, 720, 90.f);
+  GroundProjector plane(cam, 45.f, 40.f), terrain(cam, 45.f, 0.f);
+  terrain.set_dem(&flat);
+  std::vector<Detection> dets;
+  for (int i = 0; i < 20; i++) {
+    Detection d = Detection();
+    d.bbox[0] = 64.f * i;
+    d.bbox[1] = 36.f * i;
+    d.bbox[2] = d.bbox[3] = 30.f;
+    dets.push_back(d);
+  }
+  std::vector<GroundTarget> a, b;
+  FramePose pose = pose_at(lat, lon, 300.f, -5.f, 33.f);
+  plane.locate(pose, dets, a);
+  terrain.locate(pose, dets, b);
+  double worst = 0;
+  int on_dem = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    worst = std::max(worst, (double)std::hypot(a[i].north - b[i].north, a[i].east - b[i].east));
+    on_dem += b[i].on_dem;
+  }
+  check("worst offset, m", worst, 0, 1e-2);
+  check("targets on the model", on_dem, (double)a.size(), 0);
+
+  std::cout << "inclined plane, closed form" << std::endl;
+  // h = 100 + 0.2 * (x - cx): a ray from (cx, cy, z) going east and down
+  // meets it at z - s * t = 100 + 0.2 * t * ex
+  Dem slope;
+  make_dem(slope, path, 401, 401, 20, cx, cy, [cx](double x, double) { return (float)(100 + 0.2 * (x - cx)); });
+  double t;
+  bool hit = slope.intersect(cx, cy, 500, 1, 0, -0.5, t);
+  check("east, 0.5 down: t", hit ? t : -1, 400 / 0.7, 1e-6);
+  hit = slope.intersect(cx, cy, 500, -0.6, 0.8, -0.3, t);
+  check("north-west, 0.3 down: t", hit ? t : -1, 400 / (0.3 - 0.12), 1e-6);
+  hit = slope.intersect(cx + 10, cy - 10, 500, 0, 0, -1, t);
+  check("straight down: t", hit ? t : -1, 398, 1e-6);
+  hit = slope.intersect(cx, cy, 500, -1, 0, 0.1, t);
+  check("climbing away misses", hit, 0, 0);
+  hit = slope.intersect(cx, cy, 50, 1, 0, -1, t);
+  check("below the surface misses", hit, 0, 0);
+  hit = slope.intersect(cx, cy, 2000, 0, 1, -0.01, t);
+  check("leaving the grid misses", hit, 0, 0);
+
+  std::cout << "hills against a fine fixed step march" << std::endl;
+  Dem dem;
+  make_dem(dem, path, 301, 301, 20, cx, cy, hills);
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> u(-1, 1);
+  int rays = 0, agree = 0, both_miss = 0;
+  double err = 0;
+  for (int i = 0; i < 2000; i++) {
+    double ox = cx + 1500 * u(rng), oy = cy + 1500 * u(rng), oz = 450 + 200 * u(rng);
+    double dx = u(rng), dy = u(rng), dz = -0.02 - 0.5 * (u(rng) + 1);
+    double tr = 0, tm = 0;
+    bool ref = reference_hit(dem, ox, oy, oz, dx, dy, dz, 0.02, tr);
+    bool got = dem.intersect(ox, oy, oz, dx, dy, dz, tm);
+    rays++;
+    if (ref && got) {
+      agree++;
+      err = std::max(err, std::fabs(tr - tm) * std::sqrt(dx * dx + dy * dy + dz * dz));
+    } else if (!ref && !got) {
+      both_miss++;
+    }
+  }
+  check("rays with the same outcome", agree + both_miss, rays, 0);
+  check("worst distance along the ray, m", err, 0, 0.05);
+
+  std::cout << "oblique view of a hillside" << std::endl;
+  // Flat ground at the camera's foot puts a target on the slope far off
+  float foot;
+  dem.height_at(cx, cy, foot);
+  GroundProjector flat_view(cam, 20.f, foot), hill_view(cam, 20.f, 0.f);
+  hill_view.set_dem(&dem);
+  std::vector<Detection> one(1, dets[10]);
+  one[0].bbox[0] = 640;
+  one[0].bbox[1] = 360;
+  FramePose look = pose_at(lat, lon, foot + 250.f, 0.f, 45.f);
+  flat_view.locate(look, one, a);
+  hill_view.locate(look, one, b);
+  float h;
+  double tx, ty, tlat = b[0].lat, tlon = b[0].lon;
+  wgs84_to_twd97(&tlat, &tlon, 1, &tx, &ty);
+  dem.height_at(tx, ty, h);
+  check("target altitude against the terrain there, m", b[0].alt, h, 0.5);
+  std::cout << "  flat ground would be off by " << std::hypot(a[0].north - b[0].north, a[0].east - b[0].east) << "m"
+            << std::endl;
+}
+
+int main(int argc, char** argv) {
+  int boxes = 200;
+  int frames = 1000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--boxes") {
+      boxes = atoi(argv[i + 1]);
+    } else if (key == "--frames") {
+      frames = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./dem_bench [--boxes 200] [--frames 1000]" << std::endl;
+      return -1;
+    }
+  }
+  std::string path = "/tmp/dem_bench_" + std::to_string(getpid()) + ".dem";
+  run_checks(path);
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    remove(path.c_str());
+    return 1;
+  }
+
+  // 40 x 40 km of hills at 20 m, a camera looking ahead 30 degrees down
+  double lat = 24.0, lon = 121.0, cx, cy;
+  wgs84_to_twd97(&lat, &lon, 1, &cx, &cy);
+  Dem dem;
+  auto start = std::chrono::steady_clock::now();
+  make_dem(dem, path, 2001, 2001, 20, cx, cy, hills);
+  double build = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  GroundProjector projector(intrinsics_from_fov(1280, 720, 90.f), 30.f, 0.f);
+  projector.set_dem(&dem);
+  std::mt19937 rng(4);
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  std::vector<Detection> dets(boxes);
+  for (Detection& d : dets) {
+    d.bbox[0] = u(rng) * 1280;
+    d.bbox[1] = u(rng) * 720;
+    d.bbox[2] = d.bbox[3] = 20 + 40 * u(rng);
+  }
+  std::vector<GroundTarget> targets;
+  for (int f = 0; f < frames; f++) {
+    projector.locate(pose_at(lat + 0.02 * u(rng) - 0.01, lon + 0.02 * u(rng) - 0.01, 600.f, 0.f, 360 * u(rng)), dets, targets);
+  }
+  const GeolocationStats& gs = projector.stats();
+  std::cout << "grid 2001x2001 written and mapped in " << build << "ms; " << gs.dem_rays << " rays marched, "
+            << 100.0 * gs.dem_misses / gs.dem_rays << "% left the grid: " << gs.boxes / gs.cpu_ms / 1000.0
+            << " M boxes/s, " << gs.cpu_ms / gs.frames << "ms per frame of " << dets.size() << " boxes" << std::endl;
+  remove(path.c_str());
+  return 0;
+}
@@ -0,0 +1,76 @@
+// Converts an ESRI ASCII grid in TWD97 TM2 metres (e.g. a DTM exported with
+// gdal_translate -of AAIGrid dem.tif dem.asc) to the raw grid Dem maps:
+//
+//   ./dem_convert dem.asc dem.grid
+//
+// Samples are taken as points at the cell centres.
+#include "dem.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "./dem_convert [.asc] [output grid]" << std::endl;
+    return -1;
+  }
+  std::ifstream in(argv[1]);
+  if (!in.good()) {
+    std::cerr << "read " << argv[1] << " error!" << std::endl;
+    return -1;
+  }
+  // ncols, nrows, xll/yll as corner or centre, cellsize, optional NODATA_value
+  long cols = 0, rows = 0;
+  double xll = 0, yll = 0, cell = 0, nodata = -9999;
+  bool center = false;
+  std::string key;
+  while (in >> key) {
+    for (char& c : key) c = (char)tolower(c);
+    if (key == "ncols") {
+      in >> cols;
+    } else if (key == "nrows") {
+      in >> rows;
+    } else if (key == "xllcorner" || key == "xllcenter") {
+      in >> xll;
+      center = key == "xllcenter";
+    } else if (key == "yllcorner" || key == "yllcenter") {
+      in >> yll;
+    } else if (key == "cellsize") {
+      in >> cell;
+    } else if (key == "nodata_value") {
+      in >> nodata;
+    } else {
+      // First height
+      break;
+    }
+  }
+  if (cols < 2 || rows < 2 || cell <= 0) {
+    std::cerr << argv[1] << ": missing or invalid ncols/nrows/cellsize" << std::endl;
+    return -1;
+  }
+  std::vector<float> heights((size_t)cols * rows);
+  size_t n = 0;
+  heights[n++] = (float)atof(key.c_str());
+  double v;
+  while (n < heights.size() && in >> v) heights[n++] = (float)v;
+  if (n != heights.size()) {
+    std::cerr << argv[1] << ": " << n << " heights, expected " << heights.size() << std::endl;
+    return -1;
+  }
+  if (!center) {
+    xll += cell / 2;
+    yll += cell / 2;
+  }
+  // Row 0 is the northernmost in both
+  double y0 = yll + (rows - 1) * cell;
+  if (!write_dem(argv[2], (uint32_t)cols, (uint32_t)rows, xll, y0, cell, (float)nodata, heights.data())) {
+    std::cerr << "write " << argv[2] << " error!" << std::endl;
+    return -1;
+  }
+  std::cout << std::fixed << std::setprecision(1) << cols << "x" << rows << " samples, " << cell << "m apart, from (" << xll << ", " << y0 << ")" << std::endl;
+  return 0;
+}
@@ -0,0 +1,297 @@
+// Checks the persistent result cache (DetectionCache) in a temporary
+// directory, then measures lookups:
+//
+//   ./detection_cache_bench                  // checks, then 2000 entries
+//   ./detection_cache_bench --entries 20000 --candidates 100
+//
+// Every stored frame has to come back with the same floats, from the
+// segment being appended to (pread) and from sealed, mapped ones, and
+// again after the cache is reopened. Past max_bytes the oldest segments go
+// first; another engine or config hash sees nothing and purge() removes
+// exactly the other segments. A segment cut short by a crash keeps the
+// records before the cut, one with a bad header is dropped, and a cache
+// whose directory can't be written still serves lookups without storing.
+// Exits non-zero when a check fails.
+#include "detection_cache.h"
+#include "types.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static const uint64_t kEngine = 0x1111;
+static const uint64_t kConfig = 0x2222;
+// 20 candidates: 16 byte record header + 121 floats, padded to 504 bytes
+static const int kCandidates = 20;
+static const size_t kSegmentBytes = 4096;
+
+static int failures = 0;
+
+static void check(const std::string& what, bool ok, double got) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << std::endl;
+}
+
+// One frame of yololayer output with count candidates derived from key
+static std::vector<float> make_output(uint64_t key, int count) {
+  std::vector<float> out(kOutputSize, -1.f);
+  out[0] = (float)count;
+  for (int i = 0; i < count && i < kMaxNumOutputBbox; i++) {
+    float* d = &out[1 + i * sizeof(Detection) / sizeof(float)];
+    d[0] = (float)(key % 1000) + i;
+    d[1] = (float)(key / 1000 % 1000) + 0.5f * i;
+    d[2] = 10.f + i;
+    d[3] = 20.f + i;
+    d[4] = 0.01f * (i % 100);
+    d[5] = 0.f;
+  }
+  return out;
+}
+
+// The cached output has to be the count (clamped) and its candidates
+static bool same_output(const std::vector<float>& cached, uint64_t key, int count) {
+  std::vector<float> want = make_output(key, count);
+  int stored = std::min(count, kMaxNumOutputBbox);
+  size_t floats = 1 + stored * sizeof(Detection) / sizeof(float);
+  return cached.size() == floats && cached[0] == (float)stored &&
+         memcmp(cached.data() + 1, want.data() + 1, (floats - 1) * sizeof(float)) == 0;
+}
+
+// Of keys [first, last), how many hit with the right content
+static int count_hits(DetectionCache& cache, uint64_t first, uint64_t last) {
+  int hits = 0;
+  std::vector<float> out;
+  for (uint64_t k = first; k < last; k++) {
+    if (cache.lookup(k, out) && same_output(out, k, kCandidates)) hits++;
+  }
+  return hits;
+}
+
+static std::vector<std::string> segment_files(const std::string& dir) {
+  std::vector<std::string> names;
+  DIR* d = opendir(dir.c_str());
+  if (!d) return names;
+  struct dirent* e;
+  while ((e = readdir(d)) != nullptr) {
+    std::string name(e->d_name);
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".seg") == 0) names.push_back(dir + "/" + name);
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+static size_t file_bytes(const std::vector<std::string>& paths) {
+  size_t total = 0;
+  struct stat st;
+  for (const std::string& p : paths) {
+    if (stat(p.c_str(), &st) == 0) total += st.st_size;
+  }
+  return total;
+}
+
+static void remove_dir(const std::string& dir) {
+  for (const std::string& p : segment_files(dir)) unlink(p.c_str());
+  rmdir(dir.c_str());
+}
+
+static std::string make_dir(const std::string& base, const char* name) {
+  std::string dir = base + "/" + name;
+  mkdir(dir.c_str(), 0755);
+  return dir;
+}
+
+static void check_hit_miss(const std::string& dir) {
+  DetectionCache cache(dir, kEngine, kConfig, 1 << 30, kSegmentBytes);
+  std::vector<float> out;
+  check("empty cache misses", !cache.lookup(1, out), 0);
+  cache.insert(1, make_output(1, kCandidates).data());
+  cache.insert(2, make_output(2, 0).data());
+  cache.insert(3, make_output(3, kMaxNumOutputBbox + 500).data());
+  check("stored frame hits with the same candidates", cache.lookup(1, out) && same_output(out, 1, kCandidates), out.size());
+  check("frame without candidates hits with count 0", cache.lookup(2, out) && same_output(out, 2, 0), out.size());
+  check("count over kMaxNumOutputBbox is clamped", cache.lookup(3, out) && same_output(out, 3, kMaxNumOutputBbox),
+        out.empty() ? -1 : out[0]);
+  check("unknown image misses", !cache.lookup(4, out), 0);
+  cache.insert(1, make_output(7, kCandidates).data());
+  check("reinserted image returns the newest output", cache.lookup(1, out) && same_output(out, 7, kCandidates), 0);
+  DetectionCacheStats s = cache.stats();
+  check("stats count hits, misses, inserts", s.hits == 4 && s.misses == 2 && s.inserts == 4,
+        (double)(s.hits * 100 + s.misses * 10 + s.inserts));
+  check("cache is writable", cache.writable(), 1);
+}
+
+static void check_seal_reopen(const std::string& dir) {
+  size_t files = 0;
+  {
+    DetectionCache cache(dir, kEngine, kConfig, 1 << 30, kSegmentBytes);
+    for (uint64_t k = 0; k < 40; k++) cache.insert(k, make_output(k, kCandidates).data());
+    files = segment_files(dir).size();
+    check("full segments are sealed, new ones started", files >= 5, files);
+    // The first entries live in sealed, mapped segments, the last in the
+    // active one read with pread()
+    check("all entries hit, sealed and active", count_hits(cache, 0, 40) == 40, count_hits(cache, 0, 40));
+    check("bytes on disk match stats", file_bytes(segment_files(dir)) == cache.stats().bytes, cache.stats().bytes);
+  }
+  {
+    DetectionCache cache(dir, kEngine, kConfig, 1 << 30, kSegmentBytes);
+    check("reopened cache hits every entry of the earlier run", count_hits(cache, 0, 40) == 40, count_hits(cache, 0, 40));
+    check("reopened cache counts the segments it read", cache.stats().bytes == file_bytes(segment_files(dir)),
+          cache.stats().bytes);
+  }
+  check("run without inserts leaves no empty segment", segment_files(dir).size() == files, segment_files(dir).size());
+  {
+    DetectionCache cache(dir, kEngine, kConfig, 1 << 30, kSegmentBytes);
+    cache.insert(100, make_output(100, kCandidates).data());
+    check("new run appends to a new segment", segment_files(dir).size() == files + 1, segment_files(dir).size());
+  }
+  {
+    DetectionCache cache(dir, kEngine, kConfig, 1 << 30, kSegmentBytes);
+    check("entries of both runs hit", count_hits(cache, 0, 40) == 40 && count_hits(cache, 100, 101) == 1,
+          count_hits(cache, 0, 40) + count_hits(cache, 100, 101));
+  }
+}
+
+static void check_eviction(const std::string& dir) {
+  size_t max_bytes = 3 * kSegmentBytes;
+  DetectionCache cache(dir, kEngine, kConfig, max_bytes, kSegmentBytes);
+  for (uint64_t k = 0; k < 100; k++) cache.insert(k, make_output(k, kCandidates).data());
+  DetectionCacheStats s = cache.stats();
+  check("oldest segments evicted past max_bytes", s.evicted_segments > 0, s.evicted_segments);
+  check("bytes stay within max_bytes and one segment", s.bytes <= max_bytes + kSegmentBytes, s.bytes);
+  check("bytes on disk match stats after eviction", file_bytes(segment_files(dir)) == s.bytes, file_bytes(segment_files(dir)));
+  check("oldest entries miss", count_hits(cache, 0, 10) == 0, count_hits(cache, 0, 10));
+  check("newest entries hit", count_hits(cache, 90, 100) == 10, count_hits(cache, 90, 100));
+}
+
+static void check_invalidation(const std::string& dir) {
+  {
+    DetectionCache cache(dir, kEngine, kConfig, 1 << 30, kSegmentBytes);
+    for (uint64_t k = 0; k < 20; k++) cache.insert(k, make_output(k, kCandidates).data());
+  }
+  size_t own = segment_files(dir).size();
+  {
+    DetectionCache engine(dir, kEngine + 1, kConfig, 1 << 30, kSegmentBytes);
+    check("another engine sees none of the entries", count_hits(engine, 0, 20) == 0, count_hits(engine, 0, 20));
+    engine.insert(0, make_output(1000, kCandidates).data());
+    DetectionCache config(dir, kEngine, kConfig + 1, 1 << 30, kSegmentBytes);
+    check("another config sees none of the entries", count_hits(config, 0, 20) == 0, count_hits(config, 0, 20));
+    config.insert(0, make_output(2000, kCandidates).data());
+  }
+  {
+    DetectionCache cache(dir, kEngine, kConfig, 1 << 30, kSegmentBytes);
+    check("other engines' entries don't replace ours", count_hits(cache, 0, 20) == 20, count_hits(cache, 0, 20));
+  }
+  int removed = DetectionCache::purge(dir, kEngine, kConfig);
+  check("purge removes the other engine and config segments", removed == 2, removed);
+  check("purge keeps this engine's segments", segment_files(dir).size() == own, segment_files(dir).size());
+  DetectionCache cache(dir, kEngine, kConfig, 1 << 30, kSegmentBytes);
+  check("entries hit after purge", count_hits(cache, 0, 20) == 20, count_hits(cache, 0, 20));
+}
+
+static void check_damaged(const std::string& dir) {
+  {
+    DetectionCache cache(dir, kEngine, kConfig, 1 << 30, kSegmentBytes);
+    for (uint64_t k = 0; k < 30; k++) cache.insert(k, make_output(k, kCandidates).data());
+  }
+  std::vector<std::string> files = segment_files(dir);
+  // A segment is sealed by the record that takes it past 4096 bytes, 9
+  // records of 504 bytes after the 32 byte header: keys 0-8, 9-17, 18-26,
+  // then 27-29 in the last one
+  check("segments hold 9 records each", files.size() == 4, files.size());
+  if (files.size() != 4) return;
+  // Cut the last record of the unsealed segment in half
+  struct stat st;
+  stat(files[3].c_str(), &st);
+  if (truncate(files[3].c_str(), st.st_size - 250) != 0) std::cerr << "truncate " << files[3] << " error!" << std::endl;
+  // Break the magic of the second segment
+  int fd = open(files[1].c_str(), O_WRONLY);
+  if (pwrite(fd, "XXXX", 4, 0) != 4) std::cerr << "write " << files[1] << " error!" << std::endl;
+  close(fd);
+  // A segment shorter than its header
+  if (truncate(files[2].c_str(), 10) != 0) std::cerr << "truncate " << files[2] << " error!" << std::endl;
+
+  DetectionCache cache(dir, kEngine, kConfig, 1 << 30, kSegmentBytes);
+  check("intact segment still hits", count_hits(cache, 0, 9) == 9, count_hits(cache, 0, 9));
+  check("records before the cut hit", count_hits(cache, 27, 29) == 2, count_hits(cache, 27, 29));
+  check("cut record misses", count_hits(cache, 29, 30) == 0, count_hits(cache, 29, 30));
+  check("segment with a bad header misses", count_hits(cache, 9, 18) == 0, count_hits(cache, 9, 18));
+  check("segment shorter than a header misses", count_hits(cache, 18, 27) == 0, count_hits(cache, 18, 27));
+  struct stat gone;
+  check("bad segments are deleted", stat(files[1].c_str(), &gone) != 0 && stat(files[2].c_str(), &gone) != 0, 0);
+  cache.insert(29, make_output(29, kCandidates).data());
+  check("cut record can be stored again", count_hits(cache, 29, 30) == 1, count_hits(cache, 29, 30));
+}
+
+static void check_unwritable(const std::string& base) {
+  // A regular file where the directory should be
+  std::string path = base + "/not_a_dir";
+  FILE* f = fopen(path.c_str(), "w");
+  if (f) fclose(f);
+  DetectionCache cache(path, kEngine, kConfig, 1 << 30, kSegmentBytes);
+  check("cache without a directory is not writable", !cache.writable(), cache.writable());
+  for (uint64_t k = 0; k < 20; k++) cache.insert(k, make_output(k, kCandidates).data());
+  std::vector<float> out;
+  check("inserts are dropped, lookups miss", cache.stats().inserts == 0 && !cache.lookup(0, out), cache.stats().inserts);
+  unlink(path.c_str());
+}
+
+int main(int argc, char** argv) {
+  int entries = 2000;
+  int candidates = 50;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--entries") {
+      entries = atoi(argv[i + 1]);
+    } else if (key == "--candidates") {
+      candidates = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./detection_cache_bench [--entries 2000] [--candidates 50]" << std::endl;
+      return -1;
+    }
+  }
+  char base_template[] = "/tmp/detection_cache_bench.XXXXXX";
+  if (!mkdtemp(base_template)) {
+    std::cerr << "mkdtemp error!" << std::endl;
+    return -1;
+  }
+  std::string base = base_template;
+  const char* names[] = {"hit_miss", "seal", "evict", "invalidate", "damaged", "timing"};
+  std::vector<std::string> dirs;
+  for (const char* name : names) dirs.push_back(make_dir(base, name));
+
+  check_hit_miss(dirs[0]);
+  check_seal_reopen(dirs[1]);
+  check_eviction(dirs[2]);
+  check_invalidation(dirs[3]);
+  check_damaged(dirs[4]);
+  check_unwritable(base);
+
+  {
+    DetectionCache cache(dirs[5], kEngine, kConfig, (size_t)1 << 30);
+    auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < entries; k++) cache.insert(k, make_output(k, candidates).data());
+    double insert_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / entries;
+    std::vector<float> out;
+    start = std::chrono::steady_clock::now();
+    for (int k = 0; k < entries; k++) cache.lookup(k, out);
+    double lookup_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / entries;
+    std::cout << entries << " frames, " << candidates << " candidates: insert " << insert_us << "us, lookup " << lookup_us
+              << "us per frame" << std::endl;
+  }
+  for (const std::string& dir : dirs) remove_dir(dir);
+  rmdir(base.c_str());
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
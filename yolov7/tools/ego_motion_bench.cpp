@@ -0,0 +1,426 @@
+// Checks the camera motion estimate on synthetic sequences with known
+// motion and measures its time per frame:
+//
+//   ./ego_motion_bench                         // checks, then 1080p timing
+//   ./ego_motion_bench --width 3840 --height 2160 --frames 300 --points 150 --scale 2
+//
+// Frames are rendered from a textured ground plane through a moving
+// camera (a homography per frame), so the motion between any two frames
+// is known exactly. The error is how far the estimated motion puts a grid
+// of points from where the true one does, in frame pixels. The tracker
+// check runs the same static targets through a swinging camera with and
+// without compensation. Exits non-zero when a check fails.
+#include "ego_motion.h"
+#include "tracker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const char* what, bool ok, double got) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << std::endl;
+}
+
+static const double kPi = 3.14159265358979323846;
+
+struct Mat3 {
+  double m[9];
+};
+
+static Mat3 mul(const Mat3& a, const Mat3& b) {
+  Mat3 c;
+  for (int r = 0; r < 3; r++) {
+    for (int k = 0; k < 3; k++) c.m[r * 3 + k] = a.m[r * 3] * b.m[k] + a.m[r * 3 + 1] * b.m[3 + k] + a.m[r * 3 + 2] * b.m[6 + k];
+  }
+  return c;
+}
+
+static Mat3 inverse(const Mat3& a) {
+  const double* m = a.m;
+  double det = m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * m[7] - m[4] * m[6]);
+  Mat3 r = {{(m[4] * m[8] - m[5] * m[7]) / det, (m[2] * m[7] - m[1] * m[8]) / det, (m[1] * m[5] - m[2] * m[4]) / det,
+             (m[5] * m[6] - m[3] * m[8]) / det, (m[0] * m[8] - m[2] * m[6]) / det, (m[2] * m[3] - m[0] * m[5]) / det,
+             (m[3] * m[7] - m[4] * m[6]) / det, (m[1] * m[6] - m[0] * m[7]) / det, (m[0] * m[4] - m[1] * m[3]) / det}};
+  return r;
+}
+
+static void apply(const Mat3& a, double x, double y, double& u, double& v) {
+  double w = a.m[6] * x + a.m[7] * y + a.m[8];
+  u = (a.m[0] * x + a.m[1] * y + a.m[2]) / w;
+  v = (a.m[3] * x + a.m[4] * y + a.m[5]) / w;
+}
+
+// Where the camera looks: frame pixels to ground pixels
+struct Camera {
+  double x, y;    // ground point at the frame center
+  double yaw;     // radians
+  double zoom;    // frame pixels per ground pixel
+  double tilt_x;  // perspective, per frame pixel from the center
+  double tilt_y;
+};
+
+static Camera camera(double x, double y, double yaw = 0, double zoom = 1, double tilt_x = 0, double tilt_y = 0) {
+  Camera c = {x, y, yaw, zoom, tilt_x, tilt_y};
+  return c;
+}
+
+static Mat3 frame_to_ground(const Camera& c, int width, int height) {
+  Mat3 center = {{1, 0, -width / 2.0, 0, 1, -height / 2.0, 0, 0, 1}};
+  Mat3 tilt = {{1, 0, 0, 0, 1, 0, c.tilt_x, c.tilt_y, 1}};
+  double s = 1 / c.zoom, cs = std::cos(c.yaw) * s, sn = std::sin(c.yaw) * s;
+  Mat3 place = {{cs, -sn, c.x, sn, cs, c.y, 0, 0, 1}};
+  return mul(place, mul(tilt, center));
+}
+
+// Ground texture: smooth shading plus scattered blocks of random gray
+// (roofs, fields, vehicles) for corners
+struct Ground {
+  int size;
+  std::vector<uint8_t> px;
+};
+
+static Ground make_ground(int size, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  Ground g;
+  g.size = size;
+  std::vector<float> acc((size_t)size * size, 0.f);
+  // Value noise, two octaves
+  for (int cell : {128, 32}) {
+    int n = size / cell + 2;
+    std::vector<float> lattice((size_t)n * n);
+    for (float& v : lattice) v = u(rng) * (cell == 128 ? 60.f : 30.f);
+    for (int y = 0; y < size; y++) {
+      int cy = y / cell;
+      float fy = (float)(y % cell) / cell;
+      for (int x = 0; x < size; x++) {
+        int cx = x / cell;
+        float fx = (float)(x % cell) / cell;
+        const float* l = &lattice[(size_t)cy * n + cx];
+        acc[(size_t)y * size + x] += (l[0] * (1 - fx) + l[1] * fx) * (1 - fy) + (l[n] * (1 - fx) + l[n + 1] * fx) * fy;
+      }
+    }
+  }
+  int blocks = size * size / 1500;
+  for (int k = 0; k < blocks; k++) {
+    int w = 6 + (int)(u(rng) * 50), h = 6 + (int)(u(rng) * 50);
+    int x0 = (int)(u(rng) * (size - w)), y0 = (int)(u(rng) * (size - h));
+    float gray = 40 + u(rng) * 120;
+    for (int y = y0; y < y0 + h; y++) {
+      for (int x = x0; x < x0 + w; x++) acc[(size_t)y * size + x] = gray + 0.3f * acc[(size_t)y * size + x];
+    }
+  }
+  g.px.resize(acc.size());
+  for (size_t i = 0; i < acc.size(); i++) g.px[i] = (uint8_t)std::min(255.f, acc[i] + 20.f);
+  return g;
+}
+
+// Bilinear ground texture through the camera, gray BGR
+static void render(const Ground& g, const Mat3& to_ground, cv::Mat& frame) {
+  for (int y = 0; y < frame.rows; y++) {
+    uint8_t* row = frame.ptr(y);
+    for (int x = 0; x < frame.cols; x++) {
+      double gx, gy;
+      apply(to_ground, x, y, gx, gy);
+      uint8_t v = 0;
+      if (gx >= 0 && gy >= 0 && gx < g.size - 1 && gy < g.size - 1) {
+        int ix = (int)gx, iy = (int)gy;
+        float ax = (float)(gx - ix), ay = (float)(gy - iy);
+        const uint8_t* p = &g.px[(size_t)iy * g.size + ix];
+        v = (uint8_t)((p[0] * (1 - ax) + p[1] * ax) * (1 - ay) + (p[g.size] * (1 - ax) + p[g.size + 1] * ax) * ay + 0.5f);
+      }
+      row[3 * x] = row[3 * x + 1] = row[3 * x + 2] = v;
+    }
+  }
+}
+
+// Checkered squares moving on their own across the frame
+struct Mover {
+  double x, y, vx, vy;
+  int size;
+};
+
+static void draw_movers(std::vector<Mover>& movers, cv::Mat& frame) {
+  for (Mover& m : movers) {
+    m.x += m.vx;
+    m.y += m.vy;
+    if (m.x < 0 || m.x + m.size > frame.cols) m.vx = -m.vx;
+    if (m.y < 0 || m.y + m.size > frame.rows) m.vy = -m.vy;
+    int x0 = std::max(0, (int)m.x), y0 = std::max(0, (int)m.y);
+    for (int y = y0; y < std::min(frame.rows, y0 + m.size); y++) {
+      uint8_t* row = frame.ptr(y);
+      for (int x = x0; x < std::min(frame.cols, x0 + m.size); x++) {
+        uint8_t v = ((x - x0) / 8 + (y - y0) / 8) % 2 ? 230 : 25;
+        row[3 * x] = row[3 * x + 1] = row[3 * x + 2] = v;
+      }
+    }
+  }
+}
+
+struct Sequence {
+  const char* name;
+  int frames = 60;
+  Camera start = camera(2048, 2048);
+  Camera step = camera(0, 0);  // added every frame, zoom multiplies
+  double swing = 0;  // amplitude of an extra sinusoidal pan, ground pixels
+  int movers = 0;
+  bool flat = false;
+};
+
+struct Result {
+  int frames = 0;
+  int valid = 0;
+  double mean_err = 0;  // over valid frames
+  double max_err = 0;
+};
+
+static Camera camera_at(const Sequence& s, int f) {
+  Camera c = s.start;
+  c.x += s.step.x * f + s.swing * std::sin(2 * kPi * f / 50);
+  c.y += s.step.y * f + 0.5 * s.swing * std::sin(2 * kPi * f / 35);
+  c.yaw += s.step.yaw * f;
+  c.zoom *= std::pow(s.step.zoom, f);
+  c.tilt_x += s.step.tilt_x * f;
+  c.tilt_y += s.step.tilt_y * f;
+  return c;
+}
+
+// Mean distance between where m and the true motion put a grid of points
+static double motion_error(const GlobalMotion& m, const Mat3& truth, int width, int height) {
+  double sum = 0;
+  int n = 0;
+  for (int j = 1; j < 10; j++) {
+    for (int i = 1; i < 16; i++) {
+      double x = width * i / 16.0, y = height * j / 10.0, u, v, tu, tv;
+      warp_point(m, x, y, u, v);
+      apply(truth, x, y, tu, tv);
+      sum += std::hypot(u - tu, v - tv);
+      n++;
+    }
+  }
+  return sum / n;
+}
+
+static Result run_sequence(const Ground& g, const Sequence& s, const PipelineConfig& cfg, int width, int height) {
+  EgoMotion ego(cfg);
+  cv::Mat frame(height, width, CV_8UC3);
+  std::vector<Mover> movers;
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> u(0, 1);
+  for (int k = 0; k < s.movers; k++) {
+    movers.push_back(Mover{u(rng) * (width - 100), u(rng) * (height - 100), -12 + 24 * u(rng), -12 + 24 * u(rng), 64});
+  }
+  Result r;
+  Mat3 last;
+  for (int f = 0; f < s.frames; f++) {
+    Mat3 to_ground = frame_to_ground(camera_at(s, f), width, height);
+    if (s.flat) {
+      for (int y = 0; y < height; y++) std::fill(frame.ptr(y), frame.ptr(y) + 3 * width, (uint8_t)128);
+    } else {
+      render(g, to_ground, frame);
+    }
+    draw_movers(movers, frame);
+    GlobalMotion m;
+    bool ok = ego.estimate(frame, m);
+    if (f > 0) {
+      r.frames++;
+      if (ok) {
+        double err = motion_error(m, mul(inverse(to_ground), last), width, height);
+        r.valid++;
+        r.mean_err += err;
+        r.max_err = std::max(r.max_err, err);
+      }
+    }
+    last = to_ground;
+  }
+  if (r.valid) r.mean_err /= r.valid;
+  std::cout << "  " << s.name << ": " << r.valid << "/" << r.frames << " valid, error mean " << r.mean_err << "px, max "
+            << r.max_err << "px" << std::endl;
+  return r;
+}
+
+static void check_sequences(const Ground& g) {
+  std::cout << "motion on 1280x720, scale 2:" << std::endl;
+  const int width = 1280, height = 720;
+  PipelineConfig cfg;
+  Sequence pan;
+  pan.name = "pan";
+  pan.step = camera(18, -7, 0.002);
+  Result r = run_sequence(g, pan, cfg, width, height);
+  check("pan valid frames", r.valid == r.frames, r.valid);
+  check("pan mean error px", r.mean_err < 0.3, r.mean_err);
+  check("pan max error px", r.max_err < 1.0, r.max_err);
+
+  Sequence turn = pan;
+  turn.name = "turn, zoom and tilt";
+  turn.step = camera(10, 6, 0.02, 1.01, 1e-6, -5e-7);
+  turn.start.tilt_y = 2e-4;
+  r = run_sequence(g, turn, cfg, width, height);
+  check("turn valid frames", r.valid == r.frames, r.valid);
+  check("turn mean error px", r.mean_err < 0.3, r.mean_err);
+  check("turn max error px", r.max_err < 1.0, r.max_err);
+
+  PipelineConfig affine = cfg;
+  affine.ego_model = "affine";
+  Sequence flat_turn = turn;
+  flat_turn.name = "turn and zoom, affine";
+  flat_turn.start.tilt_y = 0;
+  flat_turn.step.tilt_x = flat_turn.step.tilt_y = 0;
+  r = run_sequence(g, flat_turn, affine, width, height);
+  check("affine valid frames", r.valid == r.frames, r.valid);
+  check("affine mean error px", r.mean_err < 0.3, r.mean_err);
+
+  Sequence busy = pan;
+  busy.name = "pan with 12 moving targets";
+  busy.movers = 12;
+  r = run_sequence(g, busy, cfg, width, height);
+  check("moving targets valid frames", r.valid >= r.frames * 95 / 100, r.valid);
+  check("moving targets mean error px", r.mean_err < 0.3, r.mean_err);
+
+  Sequence flat = pan;
+  flat.name = "flat gray";
+  flat.flat = true;
+  flat.frames = 10;
+  r = run_sequence(g, flat, cfg, width, height);
+  check("flat frames valid", r.valid == 0, r.valid);
+}
+
+// Static ground targets under a camera swinging back and forth: the image
+// velocity of every target reverses every 25 frames
+static void check_tracking(const Ground& g) {
+  std::cout << "tracking static targets under a swinging camera:" << std::endl;
+  const int width = 1280, height = 720, frames = 300;
+  Sequence s;
+  s.name = "swing";
+  s.swing = 300;  // up to 38 pixels per frame
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<double> u(0, 1);
+  std::normal_distribution<float> noise(0.f, 1.f);
+  std::vector<double> gx(60), gy(60);
+  for (size_t i = 0; i < gx.size(); i++) {
+    gx[i] = 2048 - 900 + u(rng) * 1800;
+    gy[i] = 2048 - 600 + u(rng) * 1200;
+  }
+  PipelineConfig cfg;
+  double mota[2];
+  for (int compensate = 0; compensate < 2; compensate++) {
+    EgoMotion ego(cfg);
+    ByteTracker tracker((TrackerConfig()));
+    cv::Mat frame(height, width, CV_8UC3);
+    std::vector<Detection> dets;
+    std::vector<int> truth, ids, last_id(gx.size(), -1), last_seen(gx.size(), 0);
+    uint64_t boxes = 0, misses = 0, switches = 0;
+    for (int f = 0; f < frames; f++) {
+      Mat3 to_frame = inverse(frame_to_ground(camera_at(s, f), width, height));
+      dets.clear();
+      truth.clear();
+      for (size_t i = 0; i < gx.size(); i++) {
+        double x, y;
+        apply(to_frame, gx[i], gy[i], x, y);
+        if (x < 20 || y < 20 || x > width - 20 || y > height - 20) continue;
+        Detection d;
+        d.bbox[0] = (float)x + noise(rng);
+        d.bbox[1] = (float)y + noise(rng);
+        d.bbox[2] = 32 + noise(rng);
+        d.bbox[3] = 32 + noise(rng);
+        d.conf = 0.9f;
+        d.class_id = 0;
+        dets.push_back(d);
+        truth.push_back((int)i);
+      }
+      if (compensate) {
+        render(g, inverse(to_frame), frame);
+        GlobalMotion m;
+        if (ego.estimate(frame, m)) tracker.warp(m.h);
+      }
+      tracker.update(dets, ids);
+      if (f < 5) continue;  // tracks being confirmed
+      for (size_t k = 0; k < dets.size(); k++) {
+        int t = truth[k];
+        boxes++;
+        if (ids[k] < 0) {
+          misses++;
+        } else {
+          // Targets swung out of view for longer than max_misses come back
+          // as new tracks, which is no switch
+          bool kept = f - last_seen[t] <= tracker.config().max_misses;
+          if (last_id[t] >= 0 && last_id[t] != ids[k] && kept) switches++;
+          last_id[t] = ids[k];
+          last_seen[t] = f;
+        }
+      }
+    }
+    mota[compensate] = 1.0 - (double)(misses + switches) / boxes;
+    std::cout << "  " << (compensate ? "compensated" : "uncompensated") << ": MOTA " << mota[compensate] << ", "
+              << misses << " misses, " << switches << " switches in " << boxes << " boxes" << std::endl;
+    if (compensate) check("compensated switches", switches == 0, switches);
+  }
+  check("compensated MOTA", mota[1] > 0.98, mota[1]);
+  check("compensation gain in MOTA", mota[1] > mota[0] + 0.5, mota[1] - mota[0]);
+}
+
+int main(int argc, char** argv) {
+  int width = 1920;
+  int height = 1080;
+  int frames = 300;
+  PipelineConfig cfg;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--width") {
+      width = atoi(argv[i + 1]);
+    } else if (key == "--height") {
+      height = atoi(argv[i + 1]);
+    } else if (key == "--frames") {
+      frames = atoi(argv[i + 1]);
+    } else if (key == "--points") {
+      cfg.ego_points = atoi(argv[i + 1]);
+    } else if (key == "--scale") {
+      cfg.ego_scale = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./ego_motion_bench [--width 1920] [--height 1080] [--frames 300] [--points 150] [--scale 2]"
+                << std::endl;
+      return -1;
+    }
+  }
+  Ground g = make_ground(4096, 3);
+  check_sequences(g);
+  check_tracking(g);
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+
+  // Time per frame on a turning, swinging camera
+  Sequence s;
+  s.name = "timing";
+  s.step = camera(0, 0, 0.01);
+  s.swing = 200;
+  s.start.zoom = std::max(1.0, width / 2500.0);
+  EgoMotion ego(cfg);
+  cv::Mat frame(height, width, CV_8UC3);
+  std::vector<double> times;
+  for (int f = 0; f < frames; f++) {
+    render(g, frame_to_ground(camera_at(s, f), width, height), frame);
+    GlobalMotion m;
+    auto start = std::chrono::steady_clock::now();
+    ego.estimate(frame, m);
+    times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  std::sort(times.begin(), times.end());
+  double sum = 0;
+  for (double t : times) sum += t;
+  const EgoMotionStats& st = ego.stats();
+  std::cout << width << "x" << height << ", scale " << cfg.ego_scale << ", " << cfg.ego_points << " points: "
+            << st.valid << "/" << st.frames << " valid, " << (double)st.tracked / st.frames << " tracked, "
+            << (double)st.inliers / st.frames << " inliers per frame; estimate mean " << sum / times.size()
+            << "ms, p50 " << times[times.size() / 2] << "ms, p99 " << times[times.size() * 99 / 100] << "ms, max "
+            << times.back() << "ms" << std::endl;
+  return 0;
+}
@@ -0,0 +1,142 @@
+// Checks GroundProjector against cases with a closed form answer, then
+// measures how many boxes per second it locates:
+//
+//   ./geolocation_bench                  // checks, then 200 boxes per frame
+//   ./geolocation_bench --boxes 50 --frames 20000
+//
+// Exits non-zero when a check fails.
+#include "geolocation.h"
+#include "twd97.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+static const double kDegToRad = M_PI / 180.0;
+
+static int failures = 0;
+
+static void check(const char* what, double got, double want, double tol) {
+  bool ok = std::fabs(got - want) <= tol;
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << " (want " << want << ")" << std::endl;
+}
+
+static Detection box(float cx, float cy, float w, float h) {
+  Detection d = Detection();
+  d.bbox[0] = cx;
+  d.bbox[1] = cy;
+  d.bbox[2] = w;
+  d.bbox[3] = h;
+  return d;
+}
+
+static FramePose pose_at(float alt, float roll, float pitch, float yaw) {
+  FramePose p;
+  p.lat = 24.0;
+  p.lon = 121.0;
+  p.alt = alt;
+  p.roll = roll;
+  p.pitch = pitch;
+  p.yaw = yaw;
+  p.valid = true;
+  return p;
+}
+
+static void run_checks() {
+  const float h = 100.f;
+  CameraIntrinsics cam = intrinsics_from_fov(1000, 800, 90.f);
+  std::vector<GroundTarget> t;
+
+  std::cout << "nadir, level, heading north" << std::endl;
+  GroundProjector nadir(cam, 90.f, 0.f);
+  // At 90 degrees hfov the right edge is 45 degrees off nadir: h to the east.
+  // The image top looks towards the nose.
+  nadir.locate(pose_at(h, 0, 0, 0), {box(500, 400, 100, 100), box(1000, 400, 0, 0), box(500, 0, 0, 0)}, t);
+  check("centre north", t[0].north, 0, 1e-3);
+  check("centre east", t[0].east, 0, 1e-3);
+  check("footprint (100 px at 0.2 m/px)", t[0].width_m, 20, 1e-3);
+  check("footprint height", t[0].height_m, 20, 1e-3);
+  check("range", t[0].range, h, 1e-3);
+  check("right edge east", t[1].east, h, 1e-3);
+  check("right edge north", t[1].north, 0, 1e-3);
+  check("top edge north", t[2].north, h * 400 / 500, 1e-3);
+
+  std::cout << "nadir, heading east" << std::endl;
+  nadir.locate(pose_at(h, 0, 0, 90), {box(500, 0, 0, 0), box(1000, 400, 0, 0)}, t);
+  check("image top east", t[0].east, h * 400 / 500, 1e-3);
+  check("right edge south", t[1].north, -h, 1e-3);
+
+  std::cout << "nadir, rolled 30 degrees right" << std::endl;
+  // The camera swings to look left of track
+  nadir.locate(pose_at(h, 30, 0, 0), {box(500, 400, 0, 0)}, t);
+  check("centre east", t[0].east, -h * std::tan(30 * kDegToRad), 1e-3);
+  check("range", t[0].range, h / std::cos(30 * kDegToRad), 1e-3);
+
+  std::cout << "forward camera tilted 30 degrees down, pitched 10 degrees up" << std::endl;
+  GroundProjector oblique(cam, 30.f, 0.f);
+  // Net 20 degrees below the horizon
+  oblique.locate(pose_at(h, 0, 10, 0), {box(500, 400, 0, 0), box(500, 0, 0, 0)}, t);
+  check("centre north", t[0].north, h / std::tan(20 * kDegToRad), 1e-2);
+  check("centre east", t[0].east, 0, 1e-3);
+  check("above the horizon misses", t[1].valid, 0, 0);
+
+  std::cout << "ground above sea level, lat/lon of the offset" << std::endl;
+  GroundProjector raised(cam, 90.f, 40.f);
+  raised.locate(pose_at(h, 0, 0, 0), {box(1000, 400, 0, 0)}, t);
+  check("right edge east", t[0].east, h - 40, 1e-3);
+  // One degree of longitude at 24N is ~101.8 km on the ellipsoid
+  double m_per_deg = 6378137.0 * std::cos(24 * kDegToRad) * kDegToRad /
+                     std::sqrt(1 - 0.00669437999014 * std::pow(std::sin(24 * kDegToRad), 2));
+  check("longitude", t[0].lon, 121.0 + 60 / m_per_deg, 1e-9);
+  check("latitude", t[0].lat, 24.0, 1e-9);
+  double x, y;
+  wgs84_to_twd97(&t[0].lat, &t[0].lon, 1, &x, &y);
+  check("TWD97 easting", t[0].twd97_x, x, 1e-9);
+  check("TWD97 northing", t[0].twd97_y, y, 1e-9);
+  FramePose below = pose_at(30, 0, 0, 0);
+  raised.locate(below, {box(500, 400, 0, 0)}, t);
+  check("below the ground misses", t[0].valid, 0, 0);
+}
+
+int main(int argc, char** argv) {
+  int boxes = 200;
+  int frames = 10000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--boxes") {
+      boxes = atoi(argv[i + 1]);
+    } else if (key == "--frames") {
+      frames = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./geolocation_bench [--boxes 200] [--frames 10000]" << std::endl;
+      return -1;
+    }
+  }
+
+  run_checks();
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+
+  // A new attitude every frame, so the rotation is rebuilt each time
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  std::vector<Detection> dets;
+  for (int i = 0; i < boxes; i++) dets.push_back(box(u(rng) * 1280, u(rng) * 720, 10 + u(rng) * 100, 10 + u(rng) * 100));
+  GroundProjector projector(intrinsics_from_fov(1280, 720, 90.f), 90.f, 0.f);
+  std::vector<GroundTarget> targets;
+  size_t valid = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++) {
+    projector.locate(pose_at(100.f, f % 20 - 10.f, f % 10 - 5.f, (float)(f % 360)), dets, targets);
+    valid += targets[f % boxes].valid;
+  }
+  double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << frames << " frames x " << boxes << " boxes: " << frames * (double)boxes / sec / 1e6 << " M boxes/s, "
+            << sec * 1e6 / frames << "us per frame (" << valid << " sampled hits)" << std::endl;
+  return 0;
+}
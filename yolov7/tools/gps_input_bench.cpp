@@ -0,0 +1,297 @@
+// Checks the GPS_INPUT encoder and emitter without a flight controller:
+// frames are decoded and checked field by field, then the emitter runs
+// into a pty (read back from the master side like a flight controller
+// would) and into a plain file, and its timing is measured:
+//
+//   ./gps_input_bench                    // 100 frames at 50 Hz
+//   ./gps_input_bench --rate 5 --frames 50
+//
+// Exits non-zero when a check fails.
+#include "gps_emitter.h"
+#include "mavlink.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/mman.h>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const char* what, double got, double want, double tol) {
+  bool ok = std::fabs(got - want) <= tol;
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << " (want " << want << ")" << std::endl;
+}
+
+static uint32_t get_u32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+
+static float get_f32(const uint8_t* p) {
+  uint32_t u = get_u32(p);
+  float f;
+  memcpy(&f, &u, 4);
+  return f;
+}
+
+struct Decoded {
+  uint8_t seq, sysid, compid;
+  uint32_t msgid;
+  size_t len;
+  uint8_t payload[255];  // zero filled past len
+};
+
+// Pull complete frames off the front of a byte stream, dropping frames
+// with a bad checksum (counted) and garbage before a start byte
+static void decode_stream(std::vector<uint8_t>& stream, std::vector<Decoded>& out, int& bad_crc) {
+  size_t i = 0;
+  while (i < stream.size()) {
+    if (stream[i] != kMavlinkStx) {
+      i++;
+      continue;
+    }
+    if (stream.size() - i < kMavlinkHeaderLen) break;
+    size_t len = stream[i + 1];
+    size_t total = kMavlinkHeaderLen + len + 2;
+    if (stream.size() - i < total) break;
+    const uint8_t* f = &stream[i];
+    uint32_t msgid = f[7] | f[8] << 8 | f[9] << 16;
+    uint8_t extra = msgid == kMavlinkMsgGpsInput ? kMavlinkGpsInputCrcExtra : 0;
+    uint16_t crc = mavlink_crc(&extra, 1, mavlink_crc(f + 1, kMavlinkHeaderLen - 1 + len));
+    if (crc != (f[total - 2] | f[total - 1] << 8)) {
+      bad_crc++;
+      i++;
+      continue;
+    }
+    Decoded d = Decoded();
+    d.seq = f[4];
+    d.sysid = f[5];
+    d.compid = f[6];
+    d.msgid = msgid;
+    d.len = len;
+    memcpy(d.payload, f + kMavlinkHeaderLen, len);
+    out.push_back(d);
+    i += total;
+  }
+  stream.erase(stream.begin(), stream.begin() + i);
+}
+
+static void check_encoding() {
+  std::cout << "CRC-16/MCRF4XX check value" << std::endl;
+  const char* digits = "123456789";
+  check("crc(\"123456789\")", mavlink_crc((const uint8_t*)digits, 9), 0x6F91, 0);
+
+  std::cout << "GPS_INPUT round trip" << std::endl;
+  GpsInput m;
+  m.time_usec = 0x0102030405060708ULL;
+  m.gps_id = 1;
+  m.ignore_flags = kGpsInputIgnoreVelHoriz | kGpsInputIgnoreVelVert;
+  m.time_week_ms = 123456789;
+  m.time_week = 2300;
+  m.fix_type = 3;
+  m.lat = 247853210;
+  m.lon = -1210123456;
+  m.alt = 123.25f;
+  m.hdop = 0.7f;
+  m.vdop = 0.9f;
+  m.vn = 1.5f;
+  m.ve = -2.5f;
+  m.vd = 0.25f;
+  m.speed_accuracy = 0.1f;
+  m.horiz_accuracy = 0.2f;
+  m.vert_accuracy = 0.3f;
+  m.satellites_visible = 12;
+  m.yaw = 9000;
+  uint8_t buf[kMavlinkMaxFrame];
+  size_t n = mavlink_pack_gps_input(m, 42, 7, 220, buf);
+  std::vector<uint8_t> stream(buf, buf + n);
+  std::vector<Decoded> frames;
+  int bad = 0;
+  decode_stream(stream, frames, bad);
+  check("frames decoded", frames.size(), 1, 0);
+  if (frames.size() != 1) return;
+  const Decoded& d = frames[0];
+  const uint8_t* p = d.payload;
+  check("frame length", n, kMavlinkHeaderLen + 65 + 2, 0);
+  check("seq", d.seq, 42, 0);
+  check("sysid", d.sysid, 7, 0);
+  check("compid", d.compid, 220, 0);
+  check("msgid", d.msgid, 232, 0);
+  // Offsets from common.xml, fields sorted by size
+  check("time_usec low", get_u32(p), 0x05060708, 0);
+  check("time_usec high", get_u32(p + 4), 0x01020304, 0);
+  check("time_week_ms", get_u32(p + 8), 123456789, 0);
+  check("lat", (int32_t)get_u32(p + 12), 247853210, 0);
+  check("lon", (int32_t)get_u32(p + 16), -1210123456, 0);
+  check("alt", get_f32(p + 20), 123.25, 0);
+  check("hdop", get_f32(p + 24), 0.7f, 0);
+  check("vdop", get_f32(p + 28), 0.9f, 0);
+  check("vn", get_f32(p + 32), 1.5, 0);
+  check("ve", get_f32(p + 36), -2.5, 0);
+  check("vd", get_f32(p + 40), 0.25, 0);
+  check("speed_accuracy", get_f32(p + 44), 0.1f, 0);
+  check("horiz_accuracy", get_f32(p + 48), 0.2f, 0);
+  check("vert_accuracy", get_f32(p + 52), 0.3f, 0);
+  check("ignore_flags", p[56] | p[57] << 8, 24, 0);
+  check("time_week", p[58] | p[59] << 8, 2300, 0);
+  check("gps_id", p[60], 1, 0);
+  check("fix_type", p[61], 3, 0);
+  check("satellites_visible", p[62], 12, 0);
+  check("yaw", p[63] | p[64] << 8, 9000, 0);
+
+  std::cout << "trailing zeros left out" << std::endl;
+  m.yaw = 0;
+  check("without yaw, payload bytes", mavlink_pack_gps_input(m, 0, 1, 1, buf) - kMavlinkHeaderLen - 2, 63, 0);
+  check("empty message, payload bytes", mavlink_pack_gps_input(GpsInput(), 0, 1, 1, buf) - kMavlinkHeaderLen - 2, 1, 0);
+
+  std::cout << "a corrupted byte is caught" << std::endl;
+  n = mavlink_pack_gps_input(m, 1, 1, 1, buf);
+  buf[20] ^= 0x10;
+  stream.assign(buf, buf + n);
+  frames.clear();
+  decode_stream(stream, frames, bad);
+  check("frames accepted", frames.size(), 0, 0);
+}
+
+int main(int argc, char** argv) {
+  double rate = 50;
+  int count = 100;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--rate") {
+      rate = atof(argv[i + 1]);
+    } else if (key == "--frames") {
+      count = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./gps_input_bench [--rate 50] [--frames 100]" << std::endl;
+      return -1;
+    }
+  }
+  check_encoding();
+
+  std::cout << "emitter into a pty, " << count << " frames at " << rate << " Hz" << std::endl;
+  std::string ring = "gps_input_bench_" + std::to_string(getpid());
+  TelemetryWriter writer(ring, 16);
+  TelemetryRecord rec = TelemetryRecord();
+  rec.t_ns = telemetry_now_ns();
+  rec.lat = 24.7853210;
+  rec.lon = 121.0123456;
+  rec.alt = 88.5f;
+  rec.yaw = 270.f;
+  rec.fix = 3;
+  writer.write(rec);
+
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    std::cerr << "could not open a pty" << std::endl;
+    return -1;
+  }
+  int slave = open(ptsname(master), O_WRONLY | O_NOCTTY);
+  struct termios tio;
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+
+  GpsEmitterConfig cfg;
+  cfg.rate_hz = rate;
+  cfg.max_age_ns = 60 * 1000000000LL;
+  cfg.send_yaw = true;
+  GpsEmitter emitter(ring, slave, cfg);
+  std::atomic<bool> stop(false);
+  std::thread sender([&]() { emitter.run(stop, count); });
+
+  // Read like a flight controller, time stamping frames as they arrive
+  std::vector<uint8_t> stream;
+  std::vector<Decoded> frames;
+  std::vector<int64_t> arrival;
+  int bad = 0;
+  int64_t deadline = telemetry_now_ns() + (int64_t)((count + 20) / rate * 1e9);
+  while ((int)frames.size() < count && telemetry_now_ns() < deadline) {
+    struct pollfd pfd = {master, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0) continue;
+    uint8_t buf[512];
+    ssize_t n = read(master, buf, sizeof(buf));
+    if (n <= 0) break;
+    int64_t now = telemetry_now_ns();
+    stream.insert(stream.end(), buf, buf + n);
+    decode_stream(stream, frames, bad);
+    arrival.resize(frames.size(), now);
+  }
+  sender.join();
+  close(slave);
+  close(master);
+
+  check("frames received", frames.size(), count, 0);
+  check("bad checksums", bad, 0, 0);
+  int gaps = 0, wrong = 0, timed = 0;
+  for (size_t i = 0; i < frames.size(); i++) {
+    const uint8_t* p = frames[i].payload;
+    if (i > 0 && frames[i].seq != (uint8_t)(frames[i - 1].seq + 1)) gaps++;
+    if ((int32_t)get_u32(p + 12) != 247853210 || (int32_t)get_u32(p + 16) != 1210123456 || p[61] != 3 ||
+        get_f32(p + 20) != 88.5f || (p[63] | p[64] << 8) != 27000) {
+      wrong++;
+    }
+    // No GPS time or shared clock to send, all three stay unknown
+    if (get_u32(p) != 0 || get_u32(p + 4) != 0 || get_u32(p + 8) != 0 || (p[58] | p[59] << 8) != 0) timed++;
+  }
+  check("sequence gaps", gaps, 0, 0);
+  check("frames not matching the ring", wrong, 0, 0);
+  check("frames with a time set", timed, 0, 0);
+  if (frames.size() > 1) {
+    // Absolute deadlines: the last frame is (count - 1) periods after the
+    // first, however long each send took
+    double span = (arrival.back() - arrival.front()) / 1e9, want = (frames.size() - 1) / rate;
+    check("first to last frame, s", span, want, 0.5 / rate);
+  }
+  const GpsEmitterStats& st = emitter.stats();
+  std::cout << "  wake-up late by mean " << st.jitter_sum_ns / std::max<uint64_t>(st.ticks, 1) / 1000.0 << "us, p50 "
+            << emitter.jitter_quantile_ns(0.5) / 1000 << "us, p99 " << emitter.jitter_quantile_ns(0.99) / 1000
+            << "us, max " << st.jitter_max_ns / 1000.0 << "us; " << st.missed << " missed, send max "
+            << st.send_max_ns / 1000.0 << "us" << std::endl;
+
+  std::cout << "emitter into a file, no telemetry" << std::endl;
+  std::string path = "/tmp/gps_input_bench_" + std::to_string(getpid()) + ".bin";
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  GpsEmitter offline(ring + "_missing", fd, cfg);
+  offline.run(stop, 5);
+  close(fd);
+  FILE* f = fopen(path.c_str(), "rb");
+  stream.clear();
+  int c;
+  while (f && (c = fgetc(f)) != EOF) stream.push_back((uint8_t)c);
+  if (f) fclose(f);
+  remove(path.c_str());
+  shm_unlink(("/" + ring).c_str());
+  frames.clear();
+  decode_stream(stream, frames, bad);
+  check("frames in the file", frames.size(), 5, 0);
+  check("sent without a fix", offline.stats().no_fix, 5, 0);
+  if (!frames.empty()) check("fix_type", frames[0].payload[61], 0, 0);
+
+  uint8_t buf[kMavlinkMaxFrame];
+  GpsInput m;
+  m.lat = 247853210;
+  m.fix_type = 3;
+  const int packs = 10000000;
+  volatile size_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < packs; i++) {
+    m.time_usec = i;
+    sink = mavlink_pack_gps_input(m, (uint8_t)i, 1, 1, buf);
+  }
+  double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "packed " << packs / sec / 1e6 << " M frames/s, " << sec / packs * 1e9 << "ns per frame of " << sink
+            << " bytes" << std::endl;
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
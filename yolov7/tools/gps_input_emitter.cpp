@@ -0,0 +1,135 @@
+// Sends the telemetry ring's position to the flight controller as MAVLink
+// GPS_INPUT at a fixed rate, the MAVLink half of readgpstocube_5hz.py
+// (telemetry_replay is the NMEA half):
+//
+//   ./telemetry_replay /dev/ttyUSB1 &
+//   ./gps_input_emitter /dev/ttyUSB0 --baud 115200 --rate 5
+//   ./gps_input_emitter gps_input.bin --rate 50      // plain file, for testing
+//
+// A character device (serial port, pty) is put in raw mode at --baud, any
+// other path is appended to. Jitter statistics are printed every --report
+// seconds and on Ctrl-C.
+#include "gps_emitter.h"
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+static std::atomic<bool> stop_flag(false);
+
+static void on_signal(int) { stop_flag.store(true); }
+
+static speed_t baud_constant(int baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return B0;
+  }
+}
+
+static int open_sink(const std::string& path, int baud) {
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0 && S_ISCHR(st.st_mode)) {
+    int fd = open(path.c_str(), O_WRONLY | O_NOCTTY);
+    if (fd < 0) return -1;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+      cfmakeraw(&tio);
+      cfsetospeed(&tio, baud_constant(baud));
+      tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+  }
+  return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+}
+
+static void print_stats(const GpsEmitter& emitter) {
+  const GpsEmitterStats& st = emitter.stats();
+  std::cout << st.sent << " frames (" << st.no_fix << " without a fix), " << st.missed << " deadlines missed, "
+            << st.write_errors << " write errors; wake-up late by mean "
+            << (st.ticks ? st.jitter_sum_ns / st.ticks / 1000.0 : 0.0) << "us, p50 "
+            << emitter.jitter_quantile_ns(0.5) / 1000 << "us, p99 " << emitter.jitter_quantile_ns(0.99) / 1000
+            << "us, max " << st.jitter_max_ns / 1000.0 << "us; send max " << st.send_max_ns / 1000.0 << "us"
+            << std::endl;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc % 2 != 0) {
+    std::cerr << "./gps_input_emitter [serial device|file] [--name yolov7_telemetry] [--baud 115200] [--rate 5]" << std::endl;
+    std::cerr << "                    [--sysid 255] [--compid 0] [--max_age_ms 1000] [--yaw 0] [--priority 0] [--report 10]" << std::endl;
+    return -1;
+  }
+  std::string sink = argv[1];
+  std::string name = "yolov7_telemetry";
+  int baud = 115200;
+  int priority = 0;
+  double report = 10;
+  GpsEmitterConfig cfg;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    std::string value = argv[i + 1];
+    if (key == "--name") {
+      name = value;
+    } else if (key == "--baud") {
+      baud = atoi(value.c_str());
+    } else if (key == "--rate") {
+      cfg.rate_hz = atof(value.c_str());
+    } else if (key == "--sysid") {
+      cfg.sysid = (uint8_t)atoi(value.c_str());
+    } else if (key == "--compid") {
+      cfg.compid = (uint8_t)atoi(value.c_str());
+    } else if (key == "--max_age_ms") {
+      cfg.max_age_ns = atoi(value.c_str()) * 1000000LL;
+    } else if (key == "--yaw") {
+      cfg.send_yaw = atoi(value.c_str()) != 0;
+    } else if (key == "--priority") {
+      priority = atoi(value.c_str());
+    } else if (key == "--report") {
+      report = atof(value.c_str());
+    } else {
+      std::cerr << "unknown option " << key << std::endl;
+      return -1;
+    }
+  }
+  if (cfg.rate_hz <= 0 || report <= 0 || baud_constant(baud) == B0) {
+    std::cerr << "rate and report must be positive and the baud rate a standard one" << std::endl;
+    return -1;
+  }
+  int fd = open_sink(sink, baud);
+  if (fd < 0) {
+    std::cerr << "open " << sink << " error!" << std::endl;
+    return -1;
+  }
+  if (priority > 0) {
+    // Real time scheduling and no page faults, needs CAP_SYS_NICE
+    struct sched_param sp;
+    sp.sched_priority = priority;
+    if (sched_setscheduler(0, SCHED_FIFO, &sp) != 0 || mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      std::cerr << "could not set SCHED_FIFO priority " << priority << ", running with normal scheduling" << std::endl;
+    }
+  }
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  GpsEmitter emitter(name, fd, cfg);
+  std::cout << "sending GPS_INPUT from /dev/shm/" << name << " to " << sink << " at " << cfg.rate_hz << " Hz" << std::endl;
+  uint64_t ticks = std::max<uint64_t>(1, (uint64_t)(report * cfg.rate_hz));
+  while (!stop_flag.load()) {
+    emitter.run(stop_flag, ticks);
+    print_stats(emitter);
+  }
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,156 @@
+// Checks the CPU letterbox (preprocess_img) and its inverse (get_rect) at
+// every kInputShapes entry, then measures preprocess_img per shape:
+//
+//   ./input_shape_bench                     // checks, then timing at 1920x1080
+//   ./input_shape_bench --width 4000 --height 3000 --rounds 50
+//
+// For landscape, portrait and square sources the letterboxed image has the
+// shape's size, grey (128) padding exactly where the scale says, and a
+// black box drawn on a white source comes back through get_rect within a
+// source pixel per input pixel of resampling. Boxes placed analytically in
+// the input go back within a pixel. select_input_shape is checked on the
+// usual stream resolutions. Exits non-zero when a check fails.
+#include "config.h"
+#include "postprocess.h"
+#include "utils.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+static int failures = 0;
+
+static void check(const char* what, int input_w, int input_h, int src_w, int src_h, double err, double tol) {
+  bool ok = err <= tol;
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << input_w << "x" << input_h << " from " << src_w << "x" << src_h
+            << ", " << what << ": " << err << " (max " << tol << ")" << std::endl;
+}
+
+// Letterbox scale and offsets of a src_w x src_h image in the input
+static void letterbox(int src_w, int src_h, int input_w, int input_h, double& r, double& dx, double& dy) {
+  r = std::min(input_w / (double)src_w, input_h / (double)src_h);
+  dx = (input_w - r * src_w) / 2;
+  dy = (input_h - r * src_h) / 2;
+}
+
+// White src_w x src_h image with a black box at rect
+static cv::Mat box_image(int src_w, int src_h, const cv::Rect& rect) {
+  cv::Mat img(src_h, src_w, CV_8UC3);
+  for (int y = 0; y < src_h; y++) {
+    uint8_t* row = img.ptr(y);
+    for (int x = 0; x < src_w; x++) {
+      uint8_t v = rect.contains(cv::Point(x, y)) ? 0 : 255;
+      row[3 * x] = row[3 * x + 1] = row[3 * x + 2] = v;
+    }
+  }
+  return img;
+}
+
+static void check_shape(int input_w, int input_h, int src_w, int src_h) {
+  double r, dx, dy;
+  letterbox(src_w, src_h, input_w, input_h, r, dx, dy);
+  cv::Rect rect(src_w / 3, src_h / 4, src_w / 5, src_h / 3);
+  cv::Mat img = box_image(src_w, src_h, rect);
+  cv::Mat out = preprocess_img(img, input_w, input_h);
+  check("letterbox size", input_w, input_h, src_w, src_h,
+        std::abs(out.cols - input_w) + std::abs(out.rows - input_h), 0);
+
+  // Padding is grey, the image (white or black) starts within a pixel of
+  // where the scale puts it
+  int pad_errors = 0;
+  int x0 = input_w, x1 = -1, y0 = input_h, y1 = -1;
+  int bx0 = input_w, bx1 = -1, by0 = input_h, by1 = -1;
+  for (int y = 0; y < input_h; y++) {
+    const uint8_t* row = out.ptr(y);
+    for (int x = 0; x < input_w; x++) {
+      bool inside = x >= dx - 1 && x < input_w - dx + 1 && y >= dy - 1 && y < input_h - dy + 1;
+      if (row[3 * x] != 128) {
+        pad_errors += !inside;
+        x0 = std::min(x0, x), x1 = std::max(x1, x), y0 = std::min(y0, y), y1 = std::max(y1, y);
+      }
+      if (row[3 * x] < 64) {
+        bx0 = std::min(bx0, x), bx1 = std::max(bx1, x), by0 = std::min(by0, y), by1 = std::max(by1, y);
+      }
+    }
+  }
+  check("image pixels in the padding", input_w, input_h, src_w, src_h, pad_errors, 0);
+  double edge = std::max(std::max(std::fabs(x0 - dx), std::fabs(x1 + 1 - (input_w - dx))),
+                         std::max(std::fabs(y0 - dy), std::fabs(y1 + 1 - (input_h - dy))));
+  check("image edge px", input_w, input_h, src_w, src_h, edge, 1);
+
+  // The box found in the input, back through get_rect
+  float bbox[4] = {(bx0 + bx1 + 1) / 2.f, (by0 + by1 + 1) / 2.f, (float)(bx1 + 1 - bx0), (float)(by1 + 1 - by0)};
+  cv::Rect back = get_rect(src_w, src_h, bbox, input_w, input_h);
+  double err = std::max(std::max(std::abs(back.x - rect.x), std::abs(back.y - rect.y)),
+                        std::max(std::abs(back.x + back.width - rect.x - rect.width),
+                                 std::abs(back.y + back.height - rect.y - rect.height)));
+  check("drawn box back in source px", input_w, input_h, src_w, src_h, err, 1 / r + 1);
+
+  // Boxes placed in the input by the scale and offsets go back exactly
+  std::mt19937 rng(input_w * 7 + input_h + src_w);
+  std::uniform_real_distribution<double> u(0, 1);
+  double worst = 0;
+  for (int i = 0; i < 1000; i++) {
+    double l = u(rng) * src_w * 0.8, t = u(rng) * src_h * 0.8;
+    double w = 2 + u(rng) * (src_w - l - 2), h = 2 + u(rng) * (src_h - t - 2);
+    float b[4] = {(float)(r * (l + w / 2) + dx), (float)(r * (t + h / 2) + dy), (float)(r * w), (float)(r * h)};
+    cv::Rect g = get_rect(src_w, src_h, b, input_w, input_h);
+    worst = std::max(worst, std::max(std::max(std::fabs(g.x - l), std::fabs(g.y - t)),
+                                      std::max(std::fabs(g.x + g.width - l - w), std::fabs(g.y + g.height - t - h))));
+  }
+  check("analytic boxes back in source px", input_w, input_h, src_w, src_h, worst, 1);
+}
+
+static void check_select(int src_w, int src_h, int want_w, int want_h) {
+  int w, h;
+  select_input_shape(src_w, src_h, w, h);
+  check("selected for the stream", want_w, want_h, src_w, src_h, w != want_w || h != want_h, 0);
+}
+
+int main(int argc, char** argv) {
+  int width = 1920, height = 1080, rounds = 20;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--width") {
+      width = atoi(argv[i + 1]);
+    } else if (key == "--height") {
+      height = atoi(argv[i + 1]);
+    } else if (key == "--rounds") {
+      rounds = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./input_shape_bench [--width 1920] [--height 1080] [--rounds 20]" << std::endl;
+      return -1;
+    }
+  }
+
+  const int sources[][2] = {{1920, 1080}, {1280, 720}, {720, 1280}, {640, 640}, {4000, 3000}, {300, 200}};
+  for (int i = 0; i < kNumInputShapes; i++) {
+    int input_w = kInputShapes[i][0], input_h = kInputShapes[i][1];
+    // Every shape has to suit the P6 models too
+    check("divisible by 64", input_w, input_h, input_w, input_h, input_w % 64 + input_h % 64, 0);
+    for (const auto& s : sources) check_shape(input_w, input_h, s[0], s[1]);
+  }
+  check_select(1280, 720, 640, 384);
+  check_select(1920, 1080, 640, 384);
+  check_select(640, 640, 640, 640);
+  check_select(720, 1280, 384, 640);
+  check_select(1280, 1024, 640, 512);
+
+  cv::Mat img = box_image(width, height, cv::Rect(width / 3, height / 3, width / 4, height / 4));
+  std::cout << "preprocess_img from " << width << "x" << height << ":";
+  for (int i = 0; i < kNumInputShapes; i++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < rounds; k++) preprocess_img(img, kInputShapes[i][0], kInputShapes[i][1]);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << " " << kInputShapes[i][0] << "x" << kInputShapes[i][1] << " " << ms / rounds << "ms";
+  }
+  std::cout << std::endl;
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
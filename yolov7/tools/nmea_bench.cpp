@@ -0,0 +1,275 @@
+// Checks the NMEA parser on hand written sentences and on corrupted, cut and
+// random input, then measures it:
+//
+//   ./nmea_bench                          // checks, then 200000 sentences
+//   ./nmea_bench --sentences 1000000 --fuzz 20000
+//
+// Known sentences have to decode to their fields whether the stream comes
+// in one chunk, byte by byte or in random chunks, and every kind of bad
+// line has to land in its counter. A sentence with one byte changed must
+// never decode to another position, nor one cut inside its checksum. A cut
+// before the "*" looks like a sentence without a checksum, which nmea.h
+// accepts and counts; PLSATTIT cut inside its longitude then decodes with
+// fewer digits, which is reported rather than failed.
+// Random bytes, and valid sentences spliced into them, must not crash the
+// parser or lose the sentences. Exits non-zero when a check fails.
+#include "nmea.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const std::string& what, bool ok, double got) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << std::endl;
+}
+
+// "$" body "*" checksum CR LF
+static std::string sentence(const std::string& body) {
+  unsigned sum = 0;
+  for (char c : body) sum ^= (unsigned char)c;
+  char tail[8];
+  snprintf(tail, sizeof(tail), "*%02X\r\n", sum);
+  return "$" + body + tail;
+}
+
+// Every sentence in stream, fed in chunks of chunk bytes (0 = all at once,
+// -1 = random sizes)
+static std::vector<NmeaSentence> parse(const std::string& stream, int chunk, NmeaStats* stats = nullptr,
+                                       unsigned seed = 1) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> size(1, 64);
+  NmeaParser parser;
+  std::vector<NmeaSentence> out;
+  NmeaSentence s;
+  size_t pos = 0;
+  while (pos < stream.size()) {
+    size_t n = chunk == 0 ? stream.size() : chunk > 0 ? (size_t)chunk : (size_t)size(rng);
+    n = std::min(n, stream.size() - pos);
+    const char* p = stream.data() + pos;
+    const char* end = p + n;
+    while (parser.next(p, end, s)) out.push_back(s);
+    pos += n;
+  }
+  if (stats) *stats = parser.stats();
+  return out;
+}
+
+static bool near(double a, double b, double tol = 1e-6) { return std::fabs(a - b) <= tol; }
+
+static const std::string kAtt = "PLSATTIT,123519.50,,3,271.5,-2.25,0.75,,,24.1234567,121.7654321,88.25";
+static const std::string kRmc = "GNRMC,123519.00,A,2407.4074,N,12045.9259,E,10.0,45.0,181026,,,A";
+static const std::string kGga = "GNGGA,123519.00,2407.4074,S,12045.9259,W,4,12,0.8,55.5,M,17.0,M,,";
+
+static void check_fields() {
+  std::cout << "known sentences:" << std::endl;
+  std::string stream = sentence(kAtt) + sentence(kRmc) + sentence(kGga) +
+                       sentence("PLSATTIT,123520.00,,0,,,,,,,,") + sentence("GPRMC,123520.00,V,,,,,,,181026,,,N");
+  std::vector<NmeaSentence> out = parse(stream, 0);
+  check("decoded", out.size() == 5, (double)out.size());
+  if (out.size() != 5) return;
+
+  const NmeaSentence& a = out[0];
+  check("PLSATTIT position and fix", a.type == kNmeaPlsattit && a.valid && a.has_position && a.fix_quality == 3 &&
+                                         near(a.lat, 24.1234567) && near(a.lon, 121.7654321),
+        a.lat);
+  check("PLSATTIT attitude and altitude (unverified field positions)",
+        a.has_attitude && a.has_alt && near(a.yaw, 271.5) && near(a.pitch, -2.25) && near(a.roll, 0.75) &&
+            near(a.alt, 88.25),
+        a.yaw);
+  check("PLSATTIT utc seconds of day", near(a.utc_seconds, 12 * 3600 + 35 * 60 + 19.5), a.utc_seconds);
+  const NmeaSentence& r = out[1];
+  check("GNRMC position, speed and course", r.type == kNmeaGnrmc && r.valid && r.has_position &&
+                                               near(r.lat, 24 + 7.4074 / 60) && near(r.lon, 120 + 45.9259 / 60) &&
+                                               near(r.speed, 10 * 0.514444, 1e-4) && near(r.course, 45),
+        r.lat);
+  const NmeaSentence& g = out[2];
+  check("GNGGA south west, fix, satellites, altitude",
+        g.type == kNmeaGngga && g.valid && g.has_position && near(g.lat, -(24 + 7.4074 / 60)) &&
+            near(g.lon, -(120 + 45.9259 / 60)) && g.fix_quality == 4 && g.satellites == 12 && near(g.hdop, 0.8, 1e-6) &&
+            g.has_alt && near(g.alt, 55.5),
+        g.lat);
+  check("PLSATTIT without a fix, no position", !out[3].valid && !out[3].has_position && !out[3].has_attitude, 0);
+  check("GPRMC void, no position", out[4].type == kNmeaGnrmc && !out[4].valid && !out[4].has_position, 0);
+
+  int differ = 0;
+  for (int chunk : {1, 7, -1}) {
+    std::vector<NmeaSentence> again = parse(stream, chunk);
+    differ += again.size() != out.size();
+    for (size_t i = 0; i < again.size() && i < out.size(); i++) {
+      differ += again[i].type != out[i].type || again[i].lat != out[i].lat || again[i].lon != out[i].lon ||
+                again[i].alt != out[i].alt || again[i].yaw != out[i].yaw;
+    }
+  }
+  check("byte by byte and random chunks, sentences differing", differ == 0, differ);
+}
+
+struct BadLine {
+  const char* what;
+  std::string line;
+  int decoded;  // expected
+  uint64_t NmeaStats::*counter;
+};
+
+static void check_bad_lines() {
+  std::cout << "bad lines, each followed by a good one:" << std::endl;
+  std::string att = sentence(kAtt);
+  std::string wrong_sum = att;
+  wrong_sum[wrong_sum.size() - 3] = wrong_sum[wrong_sum.size() - 3] == '0' ? '1' : '0';
+  std::string lower = sentence(kRmc);
+  for (size_t i = lower.size() - 4; i < lower.size() - 2; i++) lower[i] = (char)tolower(lower[i]);
+  std::string many_fields = "PLSATTIT,123519.00,,3";
+  for (int i = 0; i < 60; i++) many_fields += ",3";
+  const BadLine lines[] = {
+    {"wrong checksum", wrong_sum, 0, &NmeaStats::checksum_errors},
+    {"one checksum digit", "$" + kAtt + "*5\r\n", 0, &NmeaStats::checksum_errors},
+    {"junk after the checksum", att.substr(0, att.size() - 2) + "x\r\n", 0, &NmeaStats::checksum_errors},
+    {"lowercase checksum accepted", lower, 1, &NmeaStats::sentences},
+    {"no checksum, accepted and counted", "$" + kGga + "\r\n", 1, &NmeaStats::unchecked},
+    {"unknown type", sentence("GPGSV,3,1,11,03,03,111,00"), 0, &NmeaStats::ignored},
+    {"empty sentence", "$\r\n", 0, &NmeaStats::ignored},
+    {"RMC with a broken latitude", sentence("GNRMC,123519.00,A,24x7.4074,N,12045.9259,E,,,,,,A"), 0,
+     &NmeaStats::malformed},
+    {"RMC minutes past 60", sentence("GNRMC,123519.00,A,2467.0000,N,12045.9259,E,,,,,,A"), 0, &NmeaStats::malformed},
+    {"PLSATTIT cut to two fields", sentence("PLSATTIT,1,2"), 0, &NmeaStats::malformed},
+    {"more fields than kMaxFields", sentence(many_fields), 1, &NmeaStats::sentences},
+    {"longer than kMaxLine", sentence(kAtt + std::string(400, '0')), 0, &NmeaStats::overflows},
+    {"line end lost, next $ resyncs", "$" + kRmc.substr(0, 30), 0, &NmeaStats::sentences},
+    {"noise without a $", "\r\n\r\n12,34*56\r\n", 0, &NmeaStats::sentences},
+  };
+  for (const BadLine& b : lines) {
+    NmeaStats stats;
+    std::vector<NmeaSentence> out = parse(b.line + sentence(kRmc), 0, &stats);
+    // The good sentence after it has to come through in every case
+    bool good = !out.empty() && out.back().type == kNmeaGnrmc && near(out.back().lat, 24 + 7.4074 / 60);
+    int decoded = (int)out.size() - 1;
+    uint64_t expect_counter = b.counter == &NmeaStats::sentences ? (uint64_t)(b.decoded + 1) : 1;
+    check(b.what, good && decoded == b.decoded && stats.*b.counter == expect_counter, decoded);
+  }
+}
+
+// Every one byte change and every cut of the three known sentences
+static void check_corruption() {
+  std::cout << "changed and cut sentences:" << std::endl;
+  int wrong = 0, decoded_changes = 0, cut_in_checksum = 0, uncounted = 0, shortened = 0, cuts = 0;
+  for (const std::string& body : {kAtt, kRmc, kGga}) {
+    std::string good = sentence(body);
+    std::vector<NmeaSentence> want = parse(good, 0);
+    const std::string values = "0123456789.,-*ANSEWMx";
+    for (size_t i = 1; i + 2 < good.size(); i++) {
+      for (char v : values) {
+        if (v == good[i]) continue;
+        std::string bad = good;
+        bad[i] = v;
+        for (const NmeaSentence& s : parse(bad, 0)) {
+          decoded_changes++;
+          wrong += s.has_position && (s.lat != want[0].lat || s.lon != want[0].lon);
+        }
+      }
+    }
+    size_t star = good.find('*');
+    for (size_t n = 1; n + 2 < good.size(); n++) {
+      NmeaStats stats;
+      std::vector<NmeaSentence> out = parse(good.substr(0, n) + "\r\n", 0, &stats);
+      cuts++;
+      if (n > star) cut_in_checksum += !out.empty();
+      uncounted += out.size() != stats.unchecked;
+      for (const NmeaSentence& s : out) {
+        bool moved = s.has_position && (s.lat != want[0].lat || s.lon != want[0].lon);
+        // PLSATTIT ends on plain decimals, a cut there only shortens a number
+        if (body == kAtt) {
+          shortened += moved;
+        } else {
+          wrong += moved;
+        }
+      }
+    }
+  }
+  check("one byte changes decoded to another position", wrong == 0, wrong);
+  std::cout << "         (" << decoded_changes << " changed sentences still decoded, all through a lost \"*\")"
+            << std::endl;
+  check("cuts inside the checksum decoded", cut_in_checksum == 0, cut_in_checksum);
+  check("decoded cuts not counted as unchecked", uncounted == 0, uncounted);
+  std::cout << "         (" << cuts << " cuts, " << shortened
+            << " PLSATTIT cuts in the longitude decoded with fewer digits, as a sentence without a checksum)"
+            << std::endl;
+}
+
+static void check_fuzz(int rounds) {
+  std::cout << "random input, " << rounds << " rounds:" << std::endl;
+  std::mt19937 rng(5);
+  // Mostly NMEA-like bytes so lines get as far as field parsing
+  const std::string alphabet = "$$**,,,,\r\n0123456789.-+ABCDEFGLMNPRSTVIWx";
+  std::uniform_int_distribution<int> any_byte(0, 255), pick(0, (int)alphabet.size() - 1), len(0, 600);
+  uint64_t bytes = 0, wrong_bytes = 0, sentences = 0, not_finite = 0;
+  for (int i = 0; i < rounds; i++) {
+    std::string junk(len(rng), '\0');
+    for (char& c : junk) c = i % 2 ? (char)any_byte(rng) : alphabet[pick(rng)];
+    NmeaStats stats;
+    std::vector<NmeaSentence> out = parse(junk, i % 3 == 0 ? 1 : -1, &stats, i);
+    bytes += junk.size();
+    wrong_bytes += stats.bytes != junk.size();
+    sentences += out.size();
+    for (const NmeaSentence& s : out) {
+      not_finite += !std::isfinite(s.lat) || !std::isfinite(s.lon) || !std::isfinite(s.alt) || !std::isfinite(s.yaw);
+    }
+  }
+  check("rounds where stats.bytes missed input", wrong_bytes == 0, (double)wrong_bytes);
+  check("decoded values not finite", not_finite == 0, (double)not_finite);
+  std::cout << "         (" << bytes << " bytes, " << sentences << " sentences decoded out of junk)" << std::endl;
+
+  // Good sentences behind random junk: the $ of each resyncs the parser
+  std::string stream;
+  int spliced = 0;
+  for (int i = 0; i < rounds; i++) {
+    std::string junk(len(rng) / 4, '\0');
+    for (char& c : junk) c = alphabet[pick(rng)];
+    stream += junk;
+    stream += sentence("GNRMC,123519.00,A,2407.4074,N,12045.9259,E,,,,,,A");
+    spliced++;
+  }
+  int found = 0;
+  for (const NmeaSentence& s : parse(stream, -1)) {
+    found += s.type == kNmeaGnrmc && s.valid && near(s.lat, 24 + 7.4074 / 60) && near(s.lon, 120 + 45.9259 / 60);
+  }
+  check("spliced sentences lost in junk", found >= spliced, spliced - found);
+}
+
+int main(int argc, char** argv) {
+  int sentences = 200000, fuzz = 5000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--sentences") {
+      sentences = atoi(argv[i + 1]);
+    } else if (key == "--fuzz") {
+      fuzz = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./nmea_bench [--sentences 200000] [--fuzz 5000]" << std::endl;
+      return -1;
+    }
+  }
+  check_fields();
+  check_bad_lines();
+  check_corruption();
+  check_fuzz(fuzz);
+
+  std::string log;
+  const std::string kinds[] = {sentence(kAtt), sentence(kRmc), sentence(kGga)};
+  for (int i = 0; i < sentences; i++) log += kinds[i % 3];
+  auto start = std::chrono::steady_clock::now();
+  size_t parsed = parse(log, 4096).size();
+  double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "parsed " << parsed << " sentences, " << log.size() / sec / 1e6 << " MB/s, " << parsed / sec / 1e6
+            << " M sentences/s" << std::endl;
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,249 @@
+// Checks the ROI crop planning (plan_crops), the full frame schedule
+// (RoiScheduler) and the merging of crop detections on fixed boxes and
+// frame indices, then measures plan_crops:
+//
+//   ./roi_bench                          // checks, then 20 targets
+//   ./roi_bench --targets 100 --rounds 10000
+//
+// Everything runs on the CPU without an engine: the crops of hand placed
+// boxes (clamped at the frame border, grouped while the union fits in a
+// crop, oversized groups, boxes off the frame) are compared with the
+// expected rectangles, the scheduler with the expected full frames over a
+// scripted run, targets crossing the frame have to stay inside a crop
+// between refreshes, and the same target seen by two overlapping crops has
+// to come out once. Exits non-zero when a check fails.
+#include "roi.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const std::string& what, bool ok, double got) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << std::endl;
+}
+
+static Detection box(float x, float y, float w, float h, float conf = 0.9f, float class_id = 0) {
+  Detection det;
+  det.bbox[0] = x;
+  det.bbox[1] = y;
+  det.bbox[2] = w;
+  det.bbox[3] = h;
+  det.conf = conf;
+  det.class_id = class_id;
+  return det;
+}
+
+struct CropCase {
+  const char* what;
+  int frame_w, frame_h;
+  float margin;
+  std::vector<Detection> boxes;
+  std::vector<cv::Rect> crops;  // expected, in plan order
+};
+
+static void check_plans() {
+  std::cout << "plan_crops, 640x640 crops:" << std::endl;
+  const CropCase cases[] = {
+    {"nothing tracked", 1920, 1080, 0.25f, {}, {}},
+    {"one box, centered on it", 1920, 1080, 0.25f, {box(960, 540, 40, 40)}, {cv::Rect(640, 220, 640, 640)}},
+    {"top left corner, clamped", 1920, 1080, 0.25f, {box(10, 10, 40, 40)}, {cv::Rect(0, 0, 640, 640)}},
+    {"bottom right corner, clamped", 1920, 1080, 0.25f, {box(1910, 1075, 40, 40)}, {cv::Rect(1280, 440, 640, 640)}},
+    {"drifted off the frame, dropped", 1920, 1080, 0.25f, {box(-100, -100, 40, 40)}, {}},
+    {"two close boxes share a crop", 1920, 1080, 0.25f, {box(500, 500, 40, 40), box(800, 500, 40, 40)},
+     {cv::Rect(330, 180, 640, 640)}},
+    {"two far boxes, top one first", 1920, 1080, 0.25f, {box(1600, 800, 40, 40), box(200, 300, 40, 40)},
+     {cv::Rect(0, 0, 640, 640), cv::Rect(1280, 440, 640, 640)}},
+    {"union exactly a crop wide, grouped", 1920, 1080, 0.f, {box(500, 500, 40, 40), box(1100, 500, 40, 40)},
+     {cv::Rect(480, 180, 640, 640)}},
+    {"margin pushes the union past a crop", 1920, 1080, 0.25f, {box(500, 500, 40, 40), box(1100, 500, 40, 40)},
+     {cv::Rect(180, 180, 640, 640), cv::Rect(780, 180, 640, 640)}},
+    {"chain: a group stops growing at a crop", 1920, 1080, 0.25f,
+     {box(100, 500, 20, 20), box(500, 500, 20, 20), box(900, 500, 20, 20)},
+     {cv::Rect(0, 180, 640, 640), cv::Rect(580, 180, 640, 640)}},
+    {"box larger than a crop gets its own size", 1920, 1080, 0.25f, {box(960, 540, 800, 200)},
+     {cv::Rect(360, 220, 1200, 640)}},
+    {"frame smaller than a crop", 500, 300, 0.25f, {box(250, 150, 40, 40)}, {cv::Rect(0, 0, 500, 300)}},
+  };
+  for (const CropCase& c : cases) {
+    std::vector<cv::Rect> crops = plan_crops(c.boxes, c.frame_w, c.frame_h, 640, 640, c.margin);
+    bool ok = crops == c.crops;
+    check(c.what, ok, (double)crops.size());
+    if (!ok) {
+      for (const cv::Rect& r : crops) std::cout << "         got " << r << std::endl;
+      for (const cv::Rect& r : c.crops) std::cout << "         want " << r << std::endl;
+    }
+  }
+
+  // Where the grouping is unambiguous, the plan doesn't depend on the order
+  // the tracker lists its targets in
+  std::vector<Detection> boxes = {box(200, 300, 40, 40), box(1700, 800, 40, 40), box(1000, 900, 30, 30),
+                                  box(1050, 850, 30, 30)};
+  std::vector<cv::Rect> first = plan_crops(boxes, 1920, 1080, 640, 640, 0.25f);
+  int differ = 0;
+  std::sort(boxes.begin(), boxes.end(), [](const Detection& a, const Detection& b) { return a.bbox[0] < b.bbox[0]; });
+  do {
+    differ += plan_crops(boxes, 1920, 1080, 640, 640, 0.25f) != first;
+  } while (std::next_permutation(boxes.begin(), boxes.end(), [](const Detection& a, const Detection& b) {
+    return a.bbox[0] < b.bbox[0];
+  }));
+  check("orders of 4 boxes giving another plan", differ == 0, differ);
+}
+
+struct ScheduleStep {
+  size_t tracks;
+  size_t crops;
+  bool full;  // expected
+};
+
+static void check_schedule() {
+  std::cout << "RoiScheduler, refresh 5, max_crops 3:" << std::endl;
+  const ScheduleStep steps[] = {
+    {2, 2, true},   // 0: first frame
+    {2, 2, false},  // 1
+    {2, 2, false},  // 2
+    {2, 2, false},  // 3
+    {2, 2, false},  // 4
+    {2, 2, true},   // 5: refresh
+    {0, 0, true},   // 6: nothing tracked
+    {2, 2, false},  // 7
+    {2, 0, true},   // 8: every track drifted off the frame
+    {2, 3, false},  // 9: max_crops still fits
+    {5, 4, true},   // 10: more crops than max_crops
+    {2, 2, false},  // 11
+    {2, 2, false},  // 12
+    {2, 2, false},  // 13
+    {2, 2, false},  // 14
+    {2, 2, true},   // 15: refresh, counted from frame 10
+  };
+  RoiScheduler scheduler(5, 3);
+  int wrong = 0;
+  for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+    bool full = scheduler.full_frame(steps[i].tracks, steps[i].crops);
+    if (full != steps[i].full) {
+      wrong++;
+      std::cout << "         frame " << i << ": " << (full ? "full frame" : "crops") << std::endl;
+    }
+  }
+  check("frames scheduled wrong", wrong == 0, wrong);
+
+  RoiScheduler every(1, 3);
+  int crops = 0;
+  for (int i = 0; i < 10; i++) crops += !every.full_frame(2, 2);
+  check("refresh 1, frames run on crops", crops == 0, crops);
+}
+
+// Targets crossing the frame at constant velocity: with the boxes of frame
+// i as the prediction, every target has to be whole inside a crop, and the
+// full frame runs exactly every refresh frames.
+static void check_crossing(int refresh) {
+  const int frame_w = 1920, frame_h = 1080, frames = 60;
+  struct Target {
+    float x, y, vx, vy, w, h;
+  };
+  const Target targets[] = {{100, 200, 12, 3, 30, 20}, {1800, 900, -15, -5, 50, 40}, {960, 100, 0, 14, 24, 24},
+                            {300, 1000, 25, -8, 80, 30}};
+  RoiScheduler scheduler(refresh, 4);
+  int outside = 0, wrong_refresh = 0, max_crops = 0;
+  for (int i = 0; i < frames; i++) {
+    std::vector<Detection> boxes;
+    for (const Target& t : targets) boxes.push_back(box(t.x + t.vx * i, t.y + t.vy * i, t.w, t.h));
+    std::vector<cv::Rect> crops = plan_crops(boxes, frame_w, frame_h, 640, 384, 0.25f);
+    max_crops = std::max(max_crops, (int)crops.size());
+    bool full = scheduler.full_frame(boxes.size(), crops.size());
+    wrong_refresh += full != (i % refresh == 0);
+    if (full) continue;
+    for (const Detection& b : boxes) {
+      cv::Rect r(cv::Point((int)std::floor(b.bbox[0] - b.bbox[2] / 2), (int)std::floor(b.bbox[1] - b.bbox[3] / 2)),
+                 cv::Point((int)std::ceil(b.bbox[0] + b.bbox[2] / 2), (int)std::ceil(b.bbox[1] + b.bbox[3] / 2)));
+      r &= cv::Rect(0, 0, frame_w, frame_h);
+      bool inside = false;
+      for (const cv::Rect& c : crops) inside |= (r & c) == r;
+      outside += !inside;
+    }
+  }
+  std::cout << "4 targets crossing 1920x1080, 640x384 crops, refresh " << refresh << ":" << std::endl;
+  check("targets outside every crop", outside == 0, outside);
+  check("frames off the refresh schedule", wrong_refresh == 0, wrong_refresh);
+  check("most crops in a frame", max_crops <= 4, max_crops);
+}
+
+// Detections of the crops in network input coordinates, mapped back to
+// the frame and merged the way RoiDetector does
+static void check_merge() {
+  std::cout << "crop detections back in the frame:" << std::endl;
+  const float nms_thresh = 0.45f, contain_thresh = 0.8f;
+  cv::Rect left(0, 180, 640, 640), right(580, 180, 640, 640);
+  // One target at (610, 500) where the crops overlap, seen by both
+  std::vector<Detection> dets, a = {box(610, 320, 20, 20, 0.9f)}, b = {box(30, 321, 22, 20, 0.7f)};
+  tile_to_frame(a, left, 640, 640);
+  tile_to_frame(b, right, 640, 640);
+  dets.insert(dets.end(), a.begin(), a.end());
+  dets.insert(dets.end(), b.begin(), b.end());
+  merge_detections(dets, nms_thresh, contain_thresh, true);
+  check("one target seen by two crops, detections", dets.size() == 1, (double)dets.size());
+  if (dets.size() == 1) {
+    double err = std::max(std::fabs(dets[0].bbox[0] - 610), std::fabs(dets[0].bbox[1] - 500));
+    check("  its center off by px", err <= 1.5, err);
+  }
+
+  // Two targets next to each other in the overlap, and another class on top
+  dets.clear();
+  a = {box(600, 320, 20, 20, 0.9f), box(625, 320, 20, 20, 0.8f), box(600, 320, 20, 20, 0.6f, 2)};
+  b = {box(20, 320, 20, 20, 0.85f), box(45, 320, 20, 20, 0.75f), box(20, 320, 20, 20, 0.5f, 2)};
+  tile_to_frame(a, left, 640, 640);
+  tile_to_frame(b, right, 640, 640);
+  dets.insert(dets.end(), a.begin(), a.end());
+  dets.insert(dets.end(), b.begin(), b.end());
+  merge_detections(dets, nms_thresh, contain_thresh, true);
+  check("two neighbours and another class, detections", dets.size() == 3, (double)dets.size());
+
+  // An oversized crop is letterboxed: the input's center is the crop's
+  std::vector<Detection> big = {box(320, 320, 64, 64)};
+  tile_to_frame(big, cv::Rect(360, 220, 1200, 640), 640, 640);
+  double err = std::max(std::fabs(big[0].bbox[0] - 960), std::fabs(big[0].bbox[1] - 540));
+  check("oversized crop, center off by px", err <= 1, err);
+  check("oversized crop, box scaled up to px", std::fabs(big[0].bbox[2] - 120) <= 2, big[0].bbox[2]);
+}
+
+int main(int argc, char** argv) {
+  int targets = 20, rounds = 2000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--targets") {
+      targets = atoi(argv[i + 1]);
+    } else if (key == "--rounds") {
+      rounds = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./roi_bench [--targets 20] [--rounds 2000]" << std::endl;
+      return -1;
+    }
+  }
+  check_plans();
+  check_schedule();
+  check_crossing(10);
+  check_crossing(3);
+  check_merge();
+
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> ux(0, 1920), uy(0, 1080), us(10, 80);
+  std::vector<Detection> boxes;
+  for (int i = 0; i < targets; i++) boxes.push_back(box(ux(rng), uy(rng), us(rng), us(rng)));
+  size_t crops = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int k = 0; k < rounds; k++) crops += plan_crops(boxes, 1920, 1080, 640, 640, 0.25f).size();
+  double us_per = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+  std::cout << "plan_crops, " << targets << " targets on 1920x1080: " << us_per << "us, "
+            << (double)crops / rounds << " crops" << std::endl;
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
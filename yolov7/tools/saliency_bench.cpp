@@ -0,0 +1,205 @@
+// Checks the SIMD byte SAD against its scalar reference and the tile
+// saliency score on synthetic tiles, then measures both:
+//
+//   ./saliency_bench                    // checks, then 640x640 tiles
+//   ./saliency_bench --tile 1280 --step 4
+//
+// sad_u8 has to equal sad_u8_scalar for every length from 0 to a few
+// hundred bytes at every alignment of either pointer, and on long runs of
+// maximal differences (the NEON path widens its 16 bit lanes in blocks).
+// tile_saliency has to match a plain per pixel evaluation of its sampling
+// grid, read every pixel at step 1, give the same score on a view into a
+// larger frame as on a copy, and rank flat, noisy and textured tiles the
+// way tile_saliency_thresh expects. Exits non-zero when a check fails.
+#include "saliency.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const std::string& what, bool ok, double got) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << std::endl;
+}
+
+static void check_sad() {
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<int> byte(0, 255);
+  const size_t max_len = 300, max_offset = 16;
+  std::vector<uint8_t> a(max_len + max_offset), b(max_len + max_offset);
+  for (size_t i = 0; i < a.size(); i++) {
+    a[i] = (uint8_t)byte(rng);
+    b[i] = (uint8_t)byte(rng);
+  }
+  int cases = 0, mismatches = 0;
+  for (size_t n = 0; n <= max_len; n++) {
+    for (size_t oa = 0; oa < max_offset; oa++) {
+      for (size_t ob = 0; ob < max_offset; ob += 5) {
+        cases++;
+        if (sad_u8(&a[oa], &b[ob], n) != sad_u8_scalar(&a[oa], &b[ob], n)) mismatches++;
+      }
+    }
+  }
+  std::cout << cases << " lengths x alignments" << std::endl;
+  check("sad_u8 equals sad_u8_scalar, lengths 0-300, every alignment", mismatches == 0, mismatches);
+
+  // 255 per byte past the point where 16 bit lanes would overflow
+  const size_t lengths[] = {16 * 128, 16 * 128 + 1, 16 * 129, 100000 + 7};
+  bool exact = true;
+  uint64_t last = 0;
+  for (size_t n : lengths) {
+    std::vector<uint8_t> zeros(n + 1, 0), full(n + 1, 255);
+    last = sad_u8(&zeros[1], &full[0], n);
+    exact = exact && last == 255 * (uint64_t)n && sad_u8(&full[0], &zeros[0], n) == last;
+  }
+  check("long runs of maximal differences don't overflow", exact, last);
+}
+
+// Solid tile with noise of +-noise per byte
+static cv::Mat make_tile(int rows, int cols, int base, int noise, std::mt19937& rng) {
+  cv::Mat tile(rows, cols, CV_8UC3);
+  std::uniform_int_distribution<int> d(-noise, noise);
+  for (int y = 0; y < rows; y++) {
+    uint8_t* p = tile.ptr(y);
+    for (int i = 0; i < cols * 3; i++) p[i] = (uint8_t)std::min(255, std::max(0, base + (noise ? d(rng) : 0)));
+  }
+  return tile;
+}
+
+static int px(const cv::Mat& m, int y, int x, int c) {
+  return m.ptr(y)[x * 3 + c];
+}
+
+// tile_saliency's sampling grid evaluated pixel by pixel
+static double reference_saliency(const cv::Mat& tile, int step) {
+  double sum = 0, count = 0;
+  for (int y = 0; y < tile.rows; y += step) {
+    for (int x0 = 0; x0 < tile.cols; x0 += step * kSaliencyRun) {
+      for (int x = x0; x < std::min(tile.cols, x0 + kSaliencyRun); x++) {
+        for (int c = 0; c < 3; c++) {
+          if (x + 1 < tile.cols) {
+            sum += std::abs(px(tile, y, x, c) - px(tile, y, x + 1, c));
+            count++;
+          }
+          if (y + step < tile.rows) {
+            sum += std::abs(px(tile, y, x, c) - px(tile, y + step, x, c));
+            count++;
+          }
+        }
+      }
+    }
+  }
+  return count ? sum / count : 0.0;
+}
+
+// Mean gradient over every pixel, independent of the sampling
+static double full_gradient(const cv::Mat& tile) {
+  double sum = 0, count = 0;
+  for (int y = 0; y < tile.rows; y++) {
+    for (int x = 0; x < tile.cols; x++) {
+      for (int c = 0; c < 3; c++) {
+        if (x + 1 < tile.cols) sum += std::abs(px(tile, y, x, c) - px(tile, y, x + 1, c)), count++;
+        if (y + 1 < tile.rows) sum += std::abs(px(tile, y, x, c) - px(tile, y + 1, x, c)), count++;
+      }
+    }
+  }
+  return count ? sum / count : 0.0;
+}
+
+static void check_saliency() {
+  std::mt19937 rng(5);
+  cv::Mat flat = make_tile(640, 640, 120, 0, rng);
+  check("flat tile scores 0", tile_saliency(flat, 4) == 0.f, tile_saliency(flat, 4));
+  cv::Mat sky = make_tile(640, 640, 180, 2, rng);
+  cv::Mat texture = make_tile(640, 640, 128, 60, rng);
+  float sky_score = tile_saliency(sky, 4), texture_score = tile_saliency(texture, 4);
+  check("noisy sky (+-2) scores under 4", sky_score < 4.f, sky_score);
+  check("textured tile scores well above sky", texture_score > 10.f * sky_score, texture_score);
+
+  // Vertical edges every 8 pixels: only the columns at an edge differ
+  cv::Mat stripes(640, 640, CV_8UC3);
+  for (int y = 0; y < stripes.rows; y++) {
+    for (int x = 0; x < stripes.cols; x++) {
+      for (int c = 0; c < 3; c++) stripes.ptr(y)[x * 3 + c] = (x / 8) % 2 ? 200 : 40;
+    }
+  }
+  float stripes_score = tile_saliency(stripes, 4);
+  check("stripes match the per pixel sampling", std::fabs(stripes_score - reference_saliency(stripes, 4)) < 1e-3,
+        stripes_score);
+  check("stripes score above the sky range", stripes_score > 4.f, stripes_score);
+
+  // Odd sizes leave partial runs at the right border and rows past the last step
+  const int sizes[][2] = {{640, 640}, {637, 641}, {100, 33}, {7, 70}, {2, 2}, {1, 40}, {33, 1000}};
+  const int steps[] = {1, 2, 3, 4, 8};
+  double worst = 0;
+  for (const auto& size : sizes) {
+    cv::Mat tile = make_tile(size[0], size[1], 128, 40, rng);
+    for (int step : steps) worst = std::max(worst, std::fabs(tile_saliency(tile, step) - reference_saliency(tile, step)));
+  }
+  check("tile_saliency matches the per pixel sampling, odd sizes and steps", worst < 1e-3, worst);
+  cv::Mat column = make_tile(50, 1, 128, 40, rng);
+  check("single column tile scores 0", tile_saliency(column, 1) == 0.f, tile_saliency(column, 1));
+  double full = full_gradient(texture);
+  check("step 1 reads every pixel", std::fabs(tile_saliency(texture, 1) - full) < 1e-3, tile_saliency(texture, 1));
+  check("step 4 samples close to the full gradient", std::fabs(texture_score - full) < 0.02 * full, texture_score - full);
+
+  // A view into a larger frame (row stride wider than the tile)
+  cv::Mat frame = make_tile(1080, 1920, 128, 40, rng);
+  cv::Rect roi(853, 440, 640, 640);
+  cv::Mat copy(640, 640, CV_8UC3);
+  frame(roi).copyTo(copy);
+  check("view scores the same as a copy", tile_saliency(frame(roi), 4) == tile_saliency(copy, 4), tile_saliency(frame(roi), 4));
+}
+
+int main(int argc, char** argv) {
+  int tile_size = 640;
+  int step = 4;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--tile") {
+      tile_size = atoi(argv[i + 1]);
+    } else if (key == "--step") {
+      step = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./saliency_bench [--tile 640] [--step 4]" << std::endl;
+      return -1;
+    }
+  }
+  check_sad();
+  check_saliency();
+
+  std::mt19937 rng(9);
+  cv::Mat tile = make_tile(tile_size, tile_size, 128, 40, rng);
+  const int runs = 200;
+  volatile float sink = 0;
+  const int steps[] = {1, step};
+  for (int s : steps) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) sink = sink + tile_saliency(tile, s);
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+    std::cout << "tile_saliency " << tile_size << "x" << tile_size << ", step " << s << ": " << us << "us per tile" << std::endl;
+  }
+  size_t bytes = (size_t)tile_size * tile_size * 3;
+  double ns[2];
+  for (int simd = 0; simd < 2; simd++) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t total = 0;
+    for (int i = 0; i < runs; i++) {
+      total += simd ? sad_u8(tile.ptr(0), tile.ptr(0) + 3, bytes - 3) : sad_u8_scalar(tile.ptr(0), tile.ptr(0) + 3, bytes - 3);
+    }
+    sink = sink + (float)total;
+    ns[simd] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs / bytes;
+  }
+  std::cout << "sad_u8 " << ns[1] << "ns per byte, scalar " << ns[0] << "ns per byte" << std::endl;
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
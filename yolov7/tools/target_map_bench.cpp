@@ -0,0 +1,304 @@
+// Checks the ground target deduplication on simulated surveys and
+// measures it at 10^5 and 10^6 observations:
+//
+//   ./target_map_bench                     // checks, then timing
+//   ./target_map_bench --observations 1000000 --spacing 40
+//
+// Targets sit on the TWD97 plane; every observation sees one of them from
+// a random camera position 120 m up and up to 400 m away, displaced by
+// noise drawn from its own viewing geometry covariance, with 1% false
+// positives anywhere. Each distinct target the map reports is matched to
+// the true target most of its observations came from: two reported
+// targets for one true target are a duplicate, observations from other
+// true targets make it impure. Position error is compared against fusing
+// exactly each true target's observations, the best any association can
+// do. Exits non-zero when a check fails.
+#include "target_map.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const char* what, bool ok, double got) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << std::endl;
+}
+
+static const double kX0 = 250000, kY0 = 2650000;  // TWD97, central Taiwan
+
+struct Truth {
+  double x, y;
+  int cls;
+};
+
+// Targets on a jittered grid of the given spacing over a side x side area
+static std::vector<Truth> make_truth(std::mt19937& rng, double side, double spacing) {
+  std::uniform_real_distribution<double> u(0, 1);
+  std::vector<Truth> truth;
+  int n = (int)(side / spacing);
+  for (int j = 0; j < n; j++) {
+    for (int i = 0; i < n; i++) {
+      Truth t;
+      t.x = kX0 + (i + 0.3 + 0.4 * u(rng)) * spacing;
+      t.y = kY0 + (j + 0.3 + 0.4 * u(rng)) * spacing;
+      t.cls = (int)(u(rng) * 3);
+      truth.push_back(t);
+    }
+  }
+  return truth;
+}
+
+struct Observation {
+  GroundTarget t;
+  Detection det;
+  int truth;  // -1 for a false positive
+};
+
+static void observe(std::mt19937& rng, const std::vector<Truth>& truth, const TargetMapConfig& cfg, double side,
+                    Observation& o) {
+  std::uniform_real_distribution<double> u(0, 1);
+  std::normal_distribution<double> n01(0, 1);
+  bool false_pos = u(rng) < 0.01;
+  o.truth = false_pos ? -1 : (int)(u(rng) * truth.size());
+  double x = false_pos ? kX0 + u(rng) * side : truth[o.truth].x;
+  double y = false_pos ? kY0 + u(rng) * side : truth[o.truth].y;
+  // Camera 120 m up, up to 400 m away in any direction
+  double d = 400 * std::sqrt(u(rng)), a = 2 * 3.14159265358979323846 * u(rng);
+  o.t = GroundTarget();
+  o.t.north = (float)(d * std::cos(a));
+  o.t.east = (float)(d * std::sin(a));
+  o.t.range = (float)std::hypot(d, 120.0);
+  o.t.width_m = o.t.height_m = 4.5f;
+  o.t.valid = true;
+  float cov[3];
+  observation_covariance(o.t, cfg.sigma_m, cfg.sigma_deg * 3.14159265358979323846f / 180, cov);
+  // Noise from the covariance through its Cholesky factor
+  double l0 = std::sqrt(cov[0]), l1 = cov[1] / l0, l2 = std::sqrt(std::max(0.0, cov[2] - l1 * l1));
+  double z0 = n01(rng), z1 = n01(rng);
+  o.t.twd97_x = x + l0 * z0;
+  o.t.twd97_y = y + l1 * z0 + l2 * z1;
+  o.det = Detection();
+  o.det.conf = 0.5f + 0.5f * (float)u(rng);
+  o.det.class_id = (float)(false_pos ? (int)(u(rng) * 3) : truth[o.truth].cls);
+}
+
+struct Score {
+  size_t reported = 0;
+  size_t duplicates = 0;  // reported targets beyond the first for a true target
+  size_t missed = 0;      // true targets without a reported one
+  double purity = 0;      // observations of reported targets from their true target
+  double mean_err = 0;    // metres, reported position to its true target
+  double ideal_err = 0;   // the same fusing exactly each true target's observations
+};
+
+static Score score(const TargetMap& map, const std::vector<Truth>& truth, const std::vector<Observation>& obs,
+                   const std::vector<int>& assigned, uint32_t min_obs) {
+  const TargetMapConfig& cfg = map.config();
+  // Per reported target, the observations of each true target: sort
+  // (target, truth) pairs and count runs
+  std::vector<std::pair<int, int>> pairs;
+  for (size_t i = 0; i < obs.size(); i++) {
+    if (assigned[i] >= 0) pairs.push_back(std::make_pair(map.resolve(assigned[i]), obs[i].truth));
+  }
+  std::sort(pairs.begin(), pairs.end());
+  std::vector<UniqueTarget> snap;
+  map.snapshot(snap, min_obs);
+  std::vector<int> majority(map.ids(), -2);
+  std::vector<uint32_t> total(map.ids(), 0), best(map.ids(), 0);
+  for (size_t i = 0; i < pairs.size();) {
+    size_t j = i;
+    while (j < pairs.size() && pairs[j] == pairs[i]) j++;
+    int id = pairs[i].first;
+    total[id] += (uint32_t)(j - i);
+    if (j - i > best[id]) {
+      best[id] = (uint32_t)(j - i);
+      majority[id] = pairs[i].second;
+    }
+    i = j;
+  }
+  Score s;
+  std::vector<int> claimed(truth.size(), 0);
+  uint64_t pure = 0, all = 0;
+  for (const UniqueTarget& u : snap) {
+    int id = u.target.id;
+    s.reported++;
+    pure += best[id];
+    all += total[id];
+    if (majority[id] < 0) continue;  // false positives seen often enough
+    if (claimed[majority[id]]++) s.duplicates++;
+    const Truth& t = truth[majority[id]];
+    s.mean_err += std::hypot(u.target.x - t.x, u.target.y - t.y);
+  }
+  for (int c : claimed) s.missed += c == 0;
+  s.purity = all ? (double)pure / all : 1.0;
+  if (s.reported) s.mean_err /= s.reported;
+  // Information form per true target: sum of inverse covariances and of
+  // inverse covariance times position
+  std::vector<double> info(truth.size() * 5, 0.0);
+  std::vector<uint32_t> count(truth.size(), 0);
+  for (const Observation& o : obs) {
+    if (o.truth < 0) continue;
+    float cov[3];
+    observation_covariance(o.t, cfg.sigma_m, cfg.sigma_deg * 3.14159265358979323846f / 180, cov);
+    double det = (double)cov[0] * cov[2] - (double)cov[1] * cov[1];
+    double i0 = cov[2] / det, i1 = -cov[1] / det, i2 = cov[0] / det;
+    double ex = o.t.twd97_x - truth[o.truth].x, ey = o.t.twd97_y - truth[o.truth].y;
+    double* f = &info[o.truth * 5];
+    f[0] += i0, f[1] += i1, f[2] += i2, f[3] += i0 * ex + i1 * ey, f[4] += i1 * ex + i2 * ey;
+    count[o.truth]++;
+  }
+  size_t seen = 0;
+  for (size_t i = 0; i < truth.size(); i++) {
+    if (count[i] < min_obs) continue;
+    const double* f = &info[i * 5];
+    double det = f[0] * f[2] - f[1] * f[1];
+    s.ideal_err += std::hypot((f[2] * f[3] - f[1] * f[4]) / det, (f[0] * f[4] - f[1] * f[3]) / det);
+    seen++;
+  }
+  if (seen) s.ideal_err /= seen;
+  return s;
+}
+
+static void check_query() {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> u(0, 1);
+  TargetMapConfig cfg;
+  TargetMap map(cfg);
+  float cov[3] = {4, 0, 4};
+  for (int i = 0; i < 20000; i++) {
+    // Far enough apart in class that nothing merges
+    map.add(kX0 + u(rng) * 2000, kY0 + u(rng) * 2000, cov, i, 1.f, 1.f, 1.f, -1, 0);
+  }
+  std::vector<int> ids;
+  int wrong = 0;
+  for (int q = 0; q < 2000; q++) {
+    double x = kX0 - 100 + u(rng) * 2200, y = kY0 - 100 + u(rng) * 2200, r = u(rng) * 80;
+    map.query(x, y, r, ids);
+    std::sort(ids.begin(), ids.end());
+    std::vector<int> brute;
+    for (size_t i = 0; i < map.ids(); i++) {
+      const MappedTarget& t = map.target((int)i);
+      if (t.merged_into < 0 && (t.x - x) * (t.x - x) + (t.y - y) * (t.y - y) <= r * r) brute.push_back((int)i);
+    }
+    wrong += ids != brute;
+  }
+  check("query against brute force, wrong", wrong == 0, wrong);
+}
+
+// Observations of the same target (noise well inside their stated 2 m)
+// merge and average down; one just outside the gate stays apart
+static void check_merge() {
+  TargetMapConfig cfg;
+  TargetMap map(cfg);
+  float cov[3] = {4, 0, 4};
+  std::mt19937 rng(2);
+  std::normal_distribution<double> n1(0, 1);
+  int first = -1;
+  bool same = true;
+  for (int i = 0; i < 400; i++) {
+    int id = map.add(kX0 + n1(rng), kY0 + n1(rng), cov, 0, 1.f, 4.f, 2.f, i / 100, i);
+    if (first < 0) first = id;
+    same = same && id == first;
+  }
+  const MappedTarget& t = map.target(first);
+  check("400 observations of one target, targets", same && map.size() == 1, (double)map.size());
+  check("fused error m", std::hypot(t.x - kX0, t.y - kY0) < 0.5, std::hypot(t.x - kX0, t.y - kY0));
+  check("fused sigma m", std::fabs(std::sqrt(t.cov[0]) - 0.1) < 0.01, std::sqrt(t.cov[0]));
+  // Gate sqrt(9.21 * (0.01 + 4 + 4)) = 8.6 m with the target's floor
+  int apart = map.add(kX0 + 9, kY0, cov, 0, 1.f, 4.f, 2.f, -1, 0);
+  check("observation outside the gate starts a target", apart != first, apart);
+  int other = map.add(kX0 + 1, kY0, cov, 1, 1.f, 4.f, 2.f, -1, 0);
+  check("other class starts a target", other != first && other != apart, other);
+}
+
+static void check_survey(double spacing, int observations, double max_dup, double min_purity, bool strict) {
+  std::mt19937 rng(3);
+  // About 20 observations per target
+  double side = spacing * std::sqrt(observations / 20.0);
+  std::vector<Truth> truth = make_truth(rng, side, spacing);
+  TargetMapConfig cfg;
+  TargetMap map(cfg);
+  std::vector<Observation> obs(observations);
+  std::vector<int> assigned(observations);
+  for (int i = 0; i < observations; i++) {
+    observe(rng, truth, cfg, side, obs[i]);
+    assigned[i] = map.add(obs[i].t, obs[i].det, -1, i);
+  }
+  Score s = score(map, truth, obs, assigned, 3);
+  std::cout << "  " << truth.size() << " targets " << spacing << "m apart, " << observations << " observations: "
+            << map.size() << " in the map, " << s.reported << " reported, " << s.duplicates << " duplicates, "
+            << s.missed << " missed, purity " << s.purity << ", error " << s.mean_err << "m (" << s.ideal_err
+            << "m with perfect association)" << std::endl;
+  if (!strict) return;
+  check("duplicates per true target", (double)s.duplicates / truth.size() < max_dup,
+        (double)s.duplicates / truth.size());
+  check("missed per true target", (double)s.missed / truth.size() < 0.01, (double)s.missed / truth.size());
+  check("purity", s.purity > min_purity, s.purity);
+  check("mean error over perfect association", s.mean_err < 1.25 * s.ideal_err, s.mean_err / s.ideal_err);
+}
+
+int main(int argc, char** argv) {
+  int observations = 1000000;
+  double spacing = 40;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--observations") {
+      observations = atoi(argv[i + 1]);
+    } else if (key == "--spacing") {
+      spacing = atof(argv[i + 1]);
+    } else {
+      std::cerr << "./target_map_bench [--observations 1000000] [--spacing 40]" << std::endl;
+      return -1;
+    }
+  }
+  check_query();
+  check_merge();
+  std::cout << "surveys, 20 observations per target:" << std::endl;
+  check_survey(40, 200000, 0.01, 0.99, true);
+  // A parking lot: neighbours closer than the observation noise
+  check_survey(8, 200000, 0, 0, false);
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+
+  // Insert rate at 10^5 and the requested size, a map growing over a wider
+  // area so the candidates per observation show whether the cost grows
+  TargetMapConfig cfg;
+  for (int n : {100000, observations}) {
+    std::mt19937 rng(4);
+    double side = std::sqrt(n / 100000.0) * 10000;
+    std::vector<Truth> truth = make_truth(rng, side, spacing);
+    std::vector<Observation> obs(n);
+    for (Observation& o : obs) observe(rng, truth, cfg, side, o);
+    TargetMap map(cfg);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) map.add(obs[i].t, obs[i].det, -1, i);
+    double add_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::vector<int> ids;
+    std::uniform_real_distribution<double> u(0, 1);
+    size_t found = 0;
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < 100000; q++) {
+      map.query(kX0 + u(rng) * side, kY0 + u(rng) * side, 20, ids);
+      found += ids.size();
+    }
+    double query_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::vector<UniqueTarget> snap;
+    start = std::chrono::steady_clock::now();
+    map.snapshot(snap, 3);
+    double snap_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const TargetMapStats& st = map.stats();
+    std::cout << n << " observations of " << truth.size() << " targets: " << map.size() << " in the map, "
+              << map.cells() << " cells, " << (double)st.candidates / st.observations << " candidates per observation; add "
+              << add_ms * 1e6 / n << "ns, query (20m) " << query_ms * 1e6 / 100000 << "ns with "
+              << (double)found / 100000 << " found, snapshot of " << snap.size() << " " << snap_ms << "ms" << std::endl;
+  }
+  return 0;
+}
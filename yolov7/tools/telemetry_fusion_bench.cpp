@@ -0,0 +1,288 @@
+// Checks the frame pose fusion (TelemetryFusion, interpolate_pose) on
+// synthetic trajectories with known poses at every instant, then measures
+// pose_at:
+//
+//   ./telemetry_fusion_bench                    // checks, then 256 samples
+//   ./telemetry_fusion_bench --history 1024 --queries 1000000
+//
+// A 5 Hz track moving at constant velocity and turning at a constant rate
+// through north has to come back exactly at 30 Hz frame times between the
+// samples; slerp has to take the short way round and turn at a constant
+// rate between arbitrary attitudes; past the newest sample the motion goes
+// on for max_extrapolation and stops there, stale; a telemetry gap longer
+// than max_gap makes the poses inside it stale. The ring path (poll) runs
+// through a real shared memory ring. Exits non-zero when a check fails.
+#include "telemetry_fusion.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static const double kDegToRad = M_PI / 180.0;
+static const int64_t kMs = 1000000;
+
+static int failures = 0;
+
+static void check(const std::string& what, bool ok, double got) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << std::endl;
+}
+
+// Ground truth: about 10 m/s north, 4 m/s east, climbing 1 m/s, heading
+// from 340 degrees turning right at 20 degrees/s, level (roll and pitch are
+// covered by the slerp checks)
+struct Track {
+  double lat(int64_t t) const { return 24.0 + 9e-5 * sec(t); }
+  double lon(int64_t t) const { return 121.0 + 4e-5 * sec(t); }
+  double alt(int64_t t) const { return 100.0 + sec(t); }
+  double yaw(int64_t t) const { return std::fmod(340.0 + 20.0 * sec(t) + 360.0, 360.0); }
+  static double sec(int64_t t) { return t / 1e9; }
+
+  TelemetryRecord at(int64_t t) const {
+    TelemetryRecord rec = TelemetryRecord();
+    rec.t_ns = t;
+    rec.lat = lat(t);
+    rec.lon = lon(t);
+    rec.alt = (float)alt(t);
+    rec.yaw = (float)yaw(t);
+    rec.fix = 3;
+    return rec;
+  }
+};
+
+static double yaw_error(double a, double b) {
+  double d = std::fabs(a - b);
+  return std::min(d, 360.0 - d);
+}
+
+static void check_interpolation() {
+  std::cout << "5 Hz track, 30 Hz frames:" << std::endl;
+  Track track;
+  TelemetryFusion fusion(64, 100 * kMs, 500 * kMs);
+  for (int i = 0; i <= 25; i++) fusion.push(track.at(i * 200 * kMs));
+  double pos = 0, alt = 0, yaw = 0, age = 0;
+  int flagged = 0, frames = 0;
+  // Frames between the first and last sample, offset from the samples
+  for (int64_t t = 7 * kMs; t < 5000 * kMs; t += 33333333) {
+    FramePose pose;
+    if (!fusion.pose_at(t, pose)) continue;
+    frames++;
+    pos = std::max(pos, std::max(std::fabs(pose.lat - track.lat(t)), std::fabs(pose.lon - track.lon(t))));
+    alt = std::max(alt, std::fabs(pose.alt - track.alt(t)));
+    yaw = std::max(yaw, yaw_error(pose.yaw, track.yaw(t)));
+    age = std::max(age, (double)pose.age_ms);
+    flagged += !pose.valid || pose.extrapolated || pose.stale;
+  }
+  check("frames posed", frames == 150, frames);
+  check("position off by deg", pos < 1e-9, pos);
+  check("altitude off by m", alt < 1e-3, alt);
+  check("heading off by deg (through north)", yaw < 1e-3, yaw);
+  check("farthest sample ms", age <= 100, age);
+  check("frames extrapolated or stale", flagged == 0, flagged);
+}
+
+struct Quat {
+  double w, x, y, z;
+};
+
+// Same Z-Y-X convention as telemetry_fusion.cpp, kept separate on purpose
+static Quat quat(double roll, double pitch, double yaw) {
+  double cr = std::cos(roll * kDegToRad / 2), sr = std::sin(roll * kDegToRad / 2);
+  double cp = std::cos(pitch * kDegToRad / 2), sp = std::sin(pitch * kDegToRad / 2);
+  double cy = std::cos(yaw * kDegToRad / 2), sy = std::sin(yaw * kDegToRad / 2);
+  return Quat{cr * cp * cy + sr * sp * sy, sr * cp * cy - cr * sp * sy, cr * sp * cy + sr * cp * sy,
+              cr * cp * sy - sr * sp * cy};
+}
+
+// Rotation angle between two attitudes, degrees
+static double angle(const Quat& a, const Quat& b) {
+  double dot = std::fabs(a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z);
+  return 2 * std::acos(std::min(1.0, dot)) / kDegToRad;
+}
+
+static TelemetryRecord attitude(float roll, float pitch, float yaw) {
+  TelemetryRecord rec = TelemetryRecord();
+  rec.roll = roll;
+  rec.pitch = pitch;
+  rec.yaw = yaw;
+  rec.fix = 3;
+  return rec;
+}
+
+static void check_slerp() {
+  std::cout << "slerp:" << std::endl;
+  FramePose pose;
+  interpolate_pose(attitude(0, 0, 350), attitude(0, 0, 10), 0.5, pose);
+  check("350 to 10 deg heading, halfway", yaw_error(pose.yaw, 0) < 1e-3, pose.yaw);
+  interpolate_pose(attitude(0, 0, 10), attitude(0, 0, 350), 0.25, pose);
+  check("10 to 350 deg heading, a quarter", yaw_error(pose.yaw, 5) < 1e-3, pose.yaw);
+  interpolate_pose(attitude(0, 0, 100), attitude(0, 0, 100.01f), 0.5, pose);
+  check("nearly equal attitudes, halfway", yaw_error(pose.yaw, 100.005) < 1e-3, pose.yaw);
+
+  // Between arbitrary attitudes: the ends come back, and the rotation from
+  // the start grows linearly (constant angular rate)
+  const float pairs[][6] = {{30, 10, 45, -20, 5, 120},
+                            {60, 40, 300, -20, -10, 30},
+                            {-45, 70, 180, 45, -70, 0},
+                            {5, -5, 359, -5, 5, 1}};
+  double ends = 0, rate = 0;
+  for (const auto& p : pairs) {
+    Quat a = quat(p[0], p[1], p[2]), b = quat(p[3], p[4], p[5]);
+    double theta = angle(a, b);
+    for (int k = 0; k <= 10; k++) {
+      double u = k / 10.0;
+      interpolate_pose(attitude(p[0], p[1], p[2]), attitude(p[3], p[4], p[5]), u, pose);
+      Quat q = quat(pose.roll, pose.pitch, pose.yaw);
+      if (k == 0) ends = std::max(ends, angle(q, a));
+      if (k == 10) ends = std::max(ends, angle(q, b));
+      rate = std::max(rate, std::fabs(angle(a, q) - u * theta));
+      // And it stays on the arc: the rest of the way is the rest of the angle
+      rate = std::max(rate, std::fabs(angle(q, b) - (1 - u) * theta));
+    }
+  }
+  check("ends off by deg", ends < 1e-3, ends);
+  check("off the constant rate arc by deg", rate < 1e-3, rate);
+}
+
+static void check_extrapolation() {
+  std::cout << "past the samples, max_extrapolation 100 ms:" << std::endl;
+  Track track;
+  TelemetryFusion fusion(64, 100 * kMs, 500 * kMs);
+  for (int i = 0; i <= 5; i++) fusion.push(track.at(i * 200 * kMs));
+  const int64_t last = 1000 * kMs;
+  FramePose pose;
+  fusion.pose_at(last + 50 * kMs, pose);
+  check("50 ms past, extrapolated and not stale", pose.extrapolated && !pose.stale, pose.age_ms);
+  check("  position off by deg", std::fabs(pose.lat - track.lat(last + 50 * kMs)) < 1e-9,
+        std::fabs(pose.lat - track.lat(last + 50 * kMs)));
+  double yaw = yaw_error(pose.yaw, track.yaw(last + 50 * kMs));
+  check("  heading off by deg", yaw < 1e-3, yaw);
+
+  fusion.pose_at(last + 300 * kMs, pose);
+  check("300 ms past, stale", pose.extrapolated && pose.stale && std::fabs(pose.age_ms - 300) < 1e-3, pose.age_ms);
+  double held = std::fabs(pose.lat - track.lat(last + 100 * kMs));
+  check("  held at the 100 ms limit, off by deg", held < 1e-9, held);
+  yaw = yaw_error(pose.yaw, track.yaw(last + 100 * kMs));
+  check("  heading held too, off by deg", yaw < 1e-3, yaw);
+
+  fusion.pose_at(-60 * kMs, pose);
+  check("60 ms before the oldest, extrapolated back", pose.extrapolated && !pose.stale &&
+                                                         std::fabs(pose.lat - track.lat(-60 * kMs)) < 1e-9,
+        pose.age_ms);
+  fusion.pose_at(last, pose);
+  check("at the newest sample, exact and not extrapolated",
+        !pose.extrapolated && !pose.stale && pose.lat == track.lat(last), pose.age_ms);
+
+  // Only one sample: held, extrapolated, stale past the limit
+  TelemetryFusion single(8, 100 * kMs, 500 * kMs);
+  single.push(track.at(0));
+  single.pose_at(150 * kMs, pose);
+  check("one sample, 150 ms later: held and stale",
+        pose.valid && pose.extrapolated && pose.stale && pose.lat == track.lat(0), pose.age_ms);
+  TelemetryFusion empty(8, 100 * kMs, 500 * kMs);
+  bool any = empty.pose_at(0, pose);
+  check("no samples, no pose", !any && !pose.valid && empty.stats().missing == 1, any);
+}
+
+static void check_gap() {
+  std::cout << "telemetry gap, max_gap 500 ms:" << std::endl;
+  Track track;
+  TelemetryFusion fusion(64, 100 * kMs, 500 * kMs);
+  for (int64_t t : {0, 200, 400, 1400, 1600}) fusion.push(track.at(t * kMs));
+  FramePose pose;
+  fusion.pose_at(900 * kMs, pose);
+  check("inside a 1 s gap, stale", pose.stale && !pose.extrapolated, pose.age_ms);
+  check("  still on the track, off by deg", std::fabs(pose.lat - track.lat(900 * kMs)) < 1e-9,
+        std::fabs(pose.lat - track.lat(900 * kMs)));
+  check("  500 ms to the nearest sample", std::fabs(pose.age_ms - 500) < 1e-3, pose.age_ms);
+  fusion.pose_at(300 * kMs, pose);
+  check("before the gap, not stale", !pose.stale, pose.age_ms);
+  fusion.pose_at(1500 * kMs, pose);
+  check("after the gap, not stale", !pose.stale, pose.age_ms);
+
+  // Samples out of order and without a fix don't enter the history
+  TelemetryRecord old = track.at(1000 * kMs), nofix = track.at(1800 * kMs);
+  nofix.fix = 0;
+  fusion.push(old);
+  fusion.push(nofix);
+  check("out of order dropped, no fix ignored", fusion.stats().dropped == 1 && fusion.size() == 5,
+        (double)fusion.size());
+
+  // A full history forgets the oldest samples
+  TelemetryFusion small(4, 100 * kMs, 500 * kMs);
+  for (int i = 0; i < 10; i++) small.push(track.at(i * 200 * kMs));
+  small.pose_at(500 * kMs, pose);
+  check("history of 4 after 10 samples, 500 ms is before the oldest",
+        small.size() == 4 && pose.extrapolated && pose.stale, pose.age_ms);
+}
+
+static void check_ring() {
+  std::cout << "through the shared memory ring:" << std::endl;
+  Track track;
+  std::string ring = "telemetry_fusion_bench_" + std::to_string(getpid());
+  {
+    TelemetryWriter writer(ring, 8);
+    TelemetryReader reader;
+    bool opened = reader.open(ring);
+    TelemetryFusion fusion(64, 100 * kMs, 500 * kMs);
+    for (int i = 0; i < 5; i++) writer.write(track.at(i * 200 * kMs));
+    int first = opened ? fusion.poll(reader) : 0;
+    int again = opened ? fusion.poll(reader) : 0;
+    check("first poll, records", first == 5 && again == 0, first);
+    // Lapped: poll takes the last capacity - 1 records, the oldest slot may
+    // be the one being written
+    for (int i = 5; i < 25; i++) writer.write(track.at(i * 200 * kMs));
+    int lapped = opened ? fusion.poll(reader) : 0;
+    check("poll after 20 writes into 8 slots, records", lapped == 7, lapped);
+    FramePose pose;
+    fusion.pose_at(4700 * kMs, pose);
+    check("pose between polled records, off by deg",
+          !pose.stale && std::fabs(pose.lat - track.lat(4700 * kMs)) < 1e-9,
+          std::fabs(pose.lat - track.lat(4700 * kMs)));
+    // The samples lost to the lap are a gap in the history
+    fusion.pose_at(2000 * kMs, pose);
+    check("pose across the lapped records, stale", pose.stale, pose.age_ms);
+  }
+  shm_unlink(("/" + ring).c_str());
+}
+
+int main(int argc, char** argv) {
+  int history = 256, queries = 200000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--history") {
+      history = atoi(argv[i + 1]);
+    } else if (key == "--queries") {
+      queries = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./telemetry_fusion_bench [--history 256] [--queries 200000]" << std::endl;
+      return -1;
+    }
+  }
+  check_interpolation();
+  check_slerp();
+  check_extrapolation();
+  check_gap();
+  check_ring();
+
+  Track track;
+  TelemetryFusion fusion(history, 100 * kMs, 500 * kMs);
+  for (int i = 0; i < history; i++) fusion.push(track.at(i * 200 * kMs));
+  int64_t span = (history - 1) * 200 * kMs;
+  FramePose pose;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < queries; i++) {
+    fusion.pose_at((int64_t)i * 33333333 % span, pose);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / queries;
+  std::cout << "pose_at, " << history << " samples: " << ns << "ns per frame" << std::endl;
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
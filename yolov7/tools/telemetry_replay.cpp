@@ -0,0 +1,207 @@
+// Feeds NMEA telemetry into the shared memory ring. From a serial receiver
+// records are written as sentences arrive, in place of readgpstocube_5hz.py's
+// parsing; a recorded log is parsed up front (reporting parser throughput)
+// and replayed at a fixed rate for testing without a receiver:
+//
+//   ./telemetry_replay /dev/ttyUSB1 --baud 115200
+//   ./telemetry_replay ../../gps.log --rate 5 --loop 1
+//   ./telemetry_replay ../../gps.log --bench 100      // parse only
+//
+// Every sentence updates the current state (position, altitude, attitude,
+// fix); a record is written for each valid sentence of the --sentence type,
+// $PLSATTIT by default like readgpstocube_5hz.py, "all" for any position.
+#include "nmea.h"
+#include "telemetry.h"
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <sys/stat.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Fold a sentence into rec, true if it should be written out
+static bool apply_sentence(const NmeaSentence& s, int sentence, TelemetryRecord& rec) {
+  if (s.has_position) {
+    rec.lat = s.lat;
+    rec.lon = s.lon;
+  }
+  if (s.has_alt) rec.alt = s.alt;
+  if (s.has_attitude) {
+    rec.roll = s.roll;
+    rec.pitch = s.pitch;
+    rec.yaw = s.yaw;
+  }
+  if (s.type != kNmeaGnrmc) rec.fix = s.valid ? (uint32_t)s.fix_quality : 0;
+  return s.valid && s.has_position && (sentence < 0 || sentence == s.type);
+}
+
+static speed_t baud_constant(int baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return B0;
+  }
+}
+
+static int open_serial(const std::string& path, int baud) {
+  int fd = open(path.c_str(), O_RDONLY | O_NOCTTY);
+  if (fd < 0) return -1;
+  struct termios tio;
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baud_constant(baud));
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  return fd;
+}
+
+static void print_stats(const NmeaStats& st) {
+  std::cout << st.sentences << " sentences (" << st.unchecked << " without checksum), " << st.checksum_errors
+            << " checksum errors, " << st.malformed << " malformed, " << st.ignored << " other, " << st.overflows
+            << " overlong" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc % 2 != 0) {
+    std::cerr << "./telemetry_replay [serial device|log] [--name yolov7_telemetry] [--baud 115200] [--rate 5] [--loop 0]" << std::endl;
+    std::cerr << "                   [--sentence PLSATTIT/GNGGA/GNRMC/all] [--capacity 256] [--bench 0]" << std::endl;
+    return -1;
+  }
+  std::string source = argv[1];
+  std::string name = "yolov7_telemetry";
+  int baud = 115200;
+  double rate = 5;
+  bool loop = false;
+  int sentence = kNmeaPlsattit;
+  int capacity = 256;
+  int bench = 0;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    std::string value = argv[i + 1];
+    if (key == "--name") {
+      name = value;
+    } else if (key == "--baud") {
+      baud = atoi(value.c_str());
+    } else if (key == "--rate") {
+      rate = atof(value.c_str());
+    } else if (key == "--loop") {
+      loop = atoi(value.c_str()) != 0;
+    } else if (key == "--sentence") {
+      if (value == "PLSATTIT") {
+        sentence = kNmeaPlsattit;
+      } else if (value == "GNGGA") {
+        sentence = kNmeaGngga;
+      } else if (value == "GNRMC") {
+        sentence = kNmeaGnrmc;
+      } else if (value == "all") {
+        sentence = -1;
+      } else {
+        std::cerr << "unknown sentence " << value << std::endl;
+        return -1;
+      }
+    } else if (key == "--capacity") {
+      capacity = atoi(value.c_str());
+    } else if (key == "--bench") {
+      bench = atoi(value.c_str());
+    } else {
+      std::cerr << "unknown option " << key << std::endl;
+      return -1;
+    }
+  }
+  if (rate <= 0 || capacity <= 0) {
+    std::cerr << "rate and capacity must be positive" << std::endl;
+    return -1;
+  }
+
+  NmeaParser parser;
+  NmeaSentence s;
+  TelemetryRecord rec = TelemetryRecord();
+  struct stat st;
+  if (stat(source.c_str(), &st) == 0 && S_ISCHR(st.st_mode)) {
+    if (baud_constant(baud) == B0) {
+      std::cerr << "unsupported baud rate " << baud << std::endl;
+      return -1;
+    }
+    int fd = open_serial(source, baud);
+    if (fd < 0) {
+      std::cerr << "open " << source << " error!" << std::endl;
+      return -1;
+    }
+    TelemetryWriter writer(name, capacity);
+    std::cout << "writing " << source << " into /dev/shm/" << name << std::endl;
+    char buf[512];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+      int64_t now = telemetry_now_ns();
+      const char* p = buf;
+      while (parser.next(p, buf + n, s)) {
+        if (apply_sentence(s, sentence, rec)) {
+          rec.t_ns = now;
+          writer.write(rec);
+        }
+      }
+    }
+    close(fd);
+    print_stats(parser.stats());
+    return 0;
+  }
+
+  std::ifstream file(source, std::ios::binary);
+  if (!file.good()) {
+    std::cerr << "read " << source << " error!" << std::endl;
+    return -1;
+  }
+  std::vector<char> log((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  std::vector<TelemetryRecord> records;
+  const char* p = log.data();
+  while (parser.next(p, log.data() + log.size(), s)) {
+    if (apply_sentence(s, sentence, rec)) records.push_back(rec);
+  }
+  print_stats(parser.stats());
+
+  if (bench > 0) {
+    uint64_t parsed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < bench; i++) {
+      NmeaParser bench_parser;
+      const char* q = log.data();
+      while (bench_parser.next(q, log.data() + log.size(), s)) parsed++;
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "parsed " << log.size() * bench / sec / 1e6 << " MB/s, " << parsed / sec / 1e6 << " M sentences/s" << std::endl;
+    return 0;
+  }
+  if (records.empty()) {
+    std::cerr << "no valid records in " << source << std::endl;
+    return -1;
+  }
+
+  TelemetryWriter writer(name, capacity);
+  std::cout << "replaying " << records.size() << " records into /dev/shm/" << name << " at " << rate << " Hz" << std::endl;
+  auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate));
+  auto next = std::chrono::steady_clock::now();
+  do {
+    for (TelemetryRecord r : records) {
+      std::this_thread::sleep_until(next);
+      next += period;
+      r.t_ns = telemetry_now_ns();
+      writer.write(r);
+    }
+  } while (loop);
+  std::cout << "wrote " << writer.written() << " records" << std::endl;
+  return 0;
+}
@@ -0,0 +1,279 @@
+// Checks the tile grid (make_tile_grid), the mapping of tile and full frame
+// detections back to the frame and the cross-tile merge on fixed boxes,
+// then measures the merge:
+//
+//   ./tiling_bench                      // checks, then 300 boxes per frame
+//   ./tiling_bench --boxes 1000
+//
+// For frame sizes from a thumbnail to 4K and overlaps from 0 to 0.9 the
+// tiles have to cover every pixel, neighbours overlap by at least the
+// configured fraction of a tile, every tile lies inside the frame with the
+// last one on the border, and a frame no larger than a tile gets a single
+// tile and no full frame pass. One object seen by two tiles across a seam
+// has to come out once, a piece of it cut by the seam has to be dropped,
+// and TiledDetector (on a MockBackend) runs each tile plus the full frame
+// pass and maps the full frame boxes back at frame scale. Exits non-zero
+// when a check fails.
+#include "backend.h"
+#include "tiling.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const std::string& what, bool ok, double got) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << std::endl;
+}
+
+static Detection make_det(float l, float t, float r, float b, float conf, float class_id = 0.f) {
+  Detection d;
+  d.bbox[0] = (l + r) / 2.f;
+  d.bbox[1] = (t + b) / 2.f;
+  d.bbox[2] = r - l;
+  d.bbox[3] = b - t;
+  d.conf = conf;
+  d.class_id = class_id;
+  return d;
+}
+
+static bool near(const Detection& d, float cx, float cy, float w, float h, float tol) {
+  return std::fabs(d.bbox[0] - cx) <= tol && std::fabs(d.bbox[1] - cy) <= tol && std::fabs(d.bbox[2] - w) <= tol &&
+         std::fabs(d.bbox[3] - h) <= tol;
+}
+
+// Sorted distinct origins of the tiles along one axis
+static std::vector<int> starts(const TileGrid& g, bool x_axis) {
+  std::vector<int> s;
+  for (const cv::Rect& t : g.tiles) s.push_back(x_axis ? t.x : t.y);
+  std::sort(s.begin(), s.end());
+  s.erase(std::unique(s.begin(), s.end()), s.end());
+  return s;
+}
+
+static void check_grids() {
+  const int sizes[][2] = {{3840, 2160}, {1920, 1080}, {1280, 720}, {1000, 1000}, {641, 641},
+                          {640, 640},   {700, 300},   {300, 700},  {100, 80},    {4000, 650}};
+  const float overlaps[] = {0.f, 0.1f, 0.2f, 0.25f, 0.5f, 0.9f};
+  const int tile_w = 640, tile_h = 640;
+  int grids = 0, uncovered = 0, outside = 0, short_overlap = 0, uneven = 0, off_border = 0, wrong_size = 0;
+  int bad_single = 0, bad_full_frame = 0;
+  float min_overlap_margin = 1e9f;
+  for (const auto& size : sizes) {
+    int w = size[0], h = size[1];
+    for (float overlap : overlaps) {
+      grids++;
+      TileGrid g = make_tile_grid(w, h, tile_w, tile_h, overlap, true);
+      // Every pixel at least once
+      std::vector<uint8_t> covered((size_t)w * h, 0);
+      for (const cv::Rect& t : g.tiles) {
+        if (t.x < 0 || t.y < 0 || t.x + t.width > w || t.y + t.height > h) {
+          outside++;
+          continue;
+        }
+        if (t.width != std::min(tile_w, w) || t.height != std::min(tile_h, h)) wrong_size++;
+        for (int y = t.y; y < t.y + t.height; y++) std::fill_n(&covered[(size_t)y * w + t.x], t.width, 1);
+      }
+      uncovered += (int)std::count(covered.begin(), covered.end(), 0);
+
+      std::vector<int> xs = starts(g, true), ys = starts(g, false);
+      if (g.tiles.size() != xs.size() * ys.size()) wrong_size++;
+      const std::vector<int>* axes[] = {&xs, &ys};
+      const int lens[] = {w, h}, tiles[] = {tile_w, tile_h};
+      for (int a = 0; a < 2; a++) {
+        const std::vector<int>& s = *axes[a];
+        int len = lens[a], tile = std::min(tiles[a], lens[a]);
+        if (s.front() != 0 || s.back() + tile != len) off_border++;
+        int min_stride = len, max_stride = 0;
+        for (size_t i = 1; i < s.size(); i++) {
+          int stride = s[i] - s[i - 1];
+          float margin = (tile - stride) - overlap * tile;
+          min_overlap_margin = std::min(min_overlap_margin, margin);
+          if (margin < 0.f) short_overlap++;
+          min_stride = std::min(min_stride, stride);
+          max_stride = std::max(max_stride, stride);
+        }
+        if (s.size() > 1 && max_stride - min_stride > 1) uneven++;
+        if (len <= tiles[a] && s.size() != 1) bad_single++;
+      }
+      bool one_tile = w <= tile_w && h <= tile_h;
+      if (one_tile != (g.tiles.size() == 1)) bad_single++;
+      if (g.full_frame == one_tile || g.num_passes() != (int)g.tiles.size() + (one_tile ? 0 : 1)) bad_full_frame++;
+      TileGrid off = make_tile_grid(w, h, tile_w, tile_h, overlap, false);
+      if (off.full_frame || off.num_passes() != (int)off.tiles.size() || off.tiles.size() != g.tiles.size()) bad_full_frame++;
+    }
+  }
+  std::cout << grids << " grids" << std::endl;
+  check("every pixel covered", uncovered == 0, uncovered);
+  check("tiles inside the frame", outside == 0, outside);
+  check("tiles are tile sized, clamped to small frames", wrong_size == 0, wrong_size);
+  check("first tile at 0, last one on the border", off_border == 0, off_border);
+  check("neighbours overlap by at least overlap * tile", short_overlap == 0, min_overlap_margin);
+  check("tiles spread evenly (strides differ by <= 1px)", uneven == 0, uneven);
+  check("single tile along axes no larger than a tile", bad_single == 0, bad_single);
+  check("full frame pass only on multi tile grids, when asked", bad_full_frame == 0, bad_full_frame);
+
+  TileGrid g = make_tile_grid(1920, 1080, 640, 640, 0.2f, true);
+  check("1920x1080, 640 tiles, 0.2 overlap: 4 x 2 tiles", g.tiles.size() == 8, g.tiles.size());
+  std::vector<int> xs = starts(g, true), ys = starts(g, false);
+  check("1920 wide: columns at 0, 426, 853, 1280",
+        xs.size() == 4 && xs[0] == 0 && xs[1] == 426 && xs[2] == 853 && xs[3] == 1280, xs.size() > 1 ? xs[1] : -1);
+  check("1080 high: rows at 0, 440", ys.size() == 2 && ys[0] == 0 && ys[1] == 440, ys.size() > 1 ? ys[1] : -1);
+  check("num_passes counts the full frame pass", g.num_passes() == 9, g.num_passes());
+  TileGrid small = make_tile_grid(320, 240, 640, 640, 0.2f, true);
+  check("frame smaller than a tile: one frame sized tile",
+        small.tiles.size() == 1 && small.tiles[0] == cv::Rect(0, 0, 320, 240), small.tiles.size());
+  check("frame smaller than a tile: no full frame pass", !small.full_frame && small.num_passes() == 1, small.num_passes());
+  TileGrid strip = make_tile_grid(4000, 500, 640, 640, 0.2f, true);
+  check("frame lower than a tile: one row of 500 high tiles",
+        starts(strip, false).size() == 1 && strip.tiles[0].height == 500 && strip.tiles.back().x + 640 == 4000,
+        strip.tiles.size());
+}
+
+static void check_merge() {
+  // A 60x40 car at frame x 600..660 across the seam between the tile at 0
+  // and the one at 426: both see it whole, a few pixels apart
+  std::vector<Detection> dets;
+  dets.push_back(make_det(600, 300, 660, 340, 0.9f));
+  dets.push_back(make_det(602, 301, 662, 341, 0.6f));
+  merge_detections(dets, 0.45f, 0.8f, true);
+  check("duplicate across a seam merges into one", dets.size() == 1, dets.size());
+  if (dets.size() == 1) {
+    // Confidence weighted: 0.9 * 600 + 0.6 * 602 over 1.5
+    check("merged box is the confidence weighted average", near(dets[0], 630.8f, 320.4f, 60.f, 40.f, 0.01f), dets[0].bbox[0]);
+    check("merged box keeps the best confidence", dets[0].conf == 0.9f, dets[0].conf);
+  }
+
+  // A car at x 620..680: the tile ending at x 640 sees only the 20 pixels
+  // left of its border, a piece lying inside the whole box from the next
+  // tile (IoU 1/3, below nms_thresh, so only containment catches it)
+  dets.clear();
+  dets.push_back(make_det(620, 300, 640, 340, 0.7f));
+  dets.push_back(make_det(620, 300, 680, 340, 0.8f));
+  merge_detections(dets, 0.45f, 0.8f, false);
+  check("piece cut by a tile border is dropped", dets.size() == 1, dets.size());
+  if (dets.size() == 1) check("the whole box is kept", near(dets[0], 650.f, 320.f, 60.f, 40.f, 0.01f), dets[0].bbox[2]);
+  // A piece with the higher score extends to the whole object when fused
+  dets.clear();
+  dets.push_back(make_det(620, 300, 640, 340, 0.9f));
+  dets.push_back(make_det(620, 300, 680, 340, 0.5f));
+  merge_detections(dets, 0.45f, 0.8f, true);
+  check("higher scoring piece is extended to the whole box", dets.size() == 1 && near(dets[0], 650.f, 320.f, 60.f, 40.f, 0.01f),
+        dets.empty() ? -1 : dets[0].bbox[2]);
+
+  // Neighbours that only touch, another class at the same place, and a
+  // small box only partly inside a big one stay separate
+  dets.clear();
+  dets.push_back(make_det(100, 100, 160, 140, 0.9f));
+  dets.push_back(make_det(160, 100, 220, 140, 0.8f));
+  dets.push_back(make_det(100, 100, 160, 140, 0.7f, 1.f));
+  dets.push_back(make_det(400, 400, 600, 600, 0.9f));
+  dets.push_back(make_det(580, 500, 620, 540, 0.8f));
+  merge_detections(dets, 0.45f, 0.8f, true);
+  check("separate objects and classes are all kept", dets.size() == 5, dets.size());
+
+  // The same through tile_to_frame: network boxes of two 640 tiles at x 0
+  // and 426 (tile sized tiles map 1:1 plus the tile origin)
+  std::vector<Detection> a, b;
+  a.push_back(make_det(600, 300, 660, 340, 0.85f));
+  b.push_back(make_det(174, 300, 234, 340, 0.8f));
+  tile_to_frame(a, cv::Rect(0, 0, 640, 640), 640, 640);
+  tile_to_frame(b, cv::Rect(426, 0, 640, 640), 640, 640);
+  check("tile boxes map to the same frame box", near(a[0], b[0].bbox[0], b[0].bbox[1], b[0].bbox[2], b[0].bbox[3], 0.5f),
+        b[0].bbox[0]);
+  a.insert(a.end(), b.begin(), b.end());
+  merge_detections(a, 0.45f, 0.8f, true);
+  check("mapped seam duplicate merges into one", a.size() == 1 && near(a[0], 630.f, 320.f, 60.f, 40.f, 0.5f), a.size());
+
+  // Full frame pass: 1920x1080 letterboxed into 640x640 is scale 1/3 with
+  // 140 rows of padding on top
+  std::vector<Detection> full;
+  full.push_back(make_det(310, 310, 330, 330, 0.9f));
+  tile_to_frame(full, cv::Rect(0, 0, 1920, 1080), 640, 640);
+  check("full frame box maps back at frame scale", near(full[0], 960.f, 540.f, 60.f, 60.f, 0.5f), full[0].bbox[1]);
+}
+
+static void check_tiled_detector() {
+  // The mock reports one 40x40 box at the center of every pass
+  std::vector<Detection> canned(1, make_det(300, 300, 340, 340, 0.9f));
+  PipelineConfig cfg;
+  cfg.tile_overlap = 0.2f;
+  cfg.tile_full_frame = true;
+  Detector detector(std::unique_ptr<DetectorBackend>(new MockBackend(640, 640, 8, 0, canned)), cfg);
+  TiledDetector tiled(detector, cfg);
+
+  cv::Mat frame(1080, 1920, CV_8UC3, cv::Scalar(128, 128, 128));
+  std::vector<Detection> dets = tiled.detect(frame);
+  check("one pass per tile plus the full frame", tiled.stats().passes == 9, tiled.stats().passes);
+  // 8 tile centers, plus the full frame box: 120x120 at the frame center
+  int at_center = 0, at_tiles = 0;
+  for (const Detection& d : dets) {
+    if (near(d, 960.f, 540.f, 120.f, 120.f, 1.f)) at_center++;
+    for (const cv::Rect& t : tiled.grid(1920, 1080).tiles) {
+      if (near(d, t.x + 320.f, t.y + 320.f, 40.f, 40.f, 1.f)) at_tiles++;
+    }
+  }
+  check("full frame pass box at the frame center, frame scale", at_center == 1, at_center);
+  check("tile boxes at their tile centers", at_tiles == 8 && dets.size() == 9, at_tiles);
+
+  PipelineConfig no_full = cfg;
+  no_full.tile_full_frame = false;
+  TiledDetector tiles_only(detector, no_full);
+  tiles_only.detect(frame);
+  check("no full frame pass when off", tiles_only.stats().passes == 8, tiles_only.stats().passes);
+
+  cv::Mat thumb(240, 320, CV_8UC3, cv::Scalar(128, 128, 128));
+  TiledDetector small(detector, cfg);
+  dets = small.detect(thumb);
+  // 320x240 letterboxed into 640x640 is scale 2 with 80 rows of padding
+  check("frame smaller than a tile: one pass", small.stats().passes == 1, small.stats().passes);
+  check("frame smaller than a tile: box mapped back", dets.size() == 1 && near(dets[0], 160.f, 120.f, 20.f, 20.f, 1.f),
+        dets.empty() ? -1 : dets[0].bbox[1]);
+}
+
+int main(int argc, char** argv) {
+  int boxes = 300;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--boxes") {
+      boxes = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./tiling_bench [--boxes 300]" << std::endl;
+      return -1;
+    }
+  }
+  check_grids();
+  check_merge();
+  check_tiled_detector();
+
+  // Objects on a 4K frame, each seen by one or two tiles
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> pos(0.f, 3800.f), jitter(-2.f, 2.f), conf(0.3f, 1.f);
+  std::vector<Detection> frame_dets;
+  for (int i = 0; i < boxes; i++) {
+    float x = pos(rng), y = pos(rng) * 0.55f;
+    frame_dets.push_back(make_det(x, y, x + 40, y + 30, conf(rng)));
+    if (i % 2) frame_dets.push_back(make_det(x + jitter(rng), y + jitter(rng), x + 40, y + 30, conf(rng)));
+  }
+  const int runs = 200;
+  std::vector<Detection> dets;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; i++) {
+    dets = frame_dets;
+    merge_detections(dets, 0.45f, 0.8f, true);
+  }
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+  std::cout << "merge_detections, " << frame_dets.size() << " boxes: " << us << "us per frame, " << dets.size() << " kept"
+            << std::endl;
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,336 @@
+// Checks the tracker on synthetic scenes with known identities and
+// measures its update time:
+//
+//   ./tracker_bench                      // checks, then 200 targets
+//   ./tracker_bench --targets 500 --frames 2000
+//
+// The scenes are targets moving at constant velocity with box noise,
+// missed detections, stretches of low confidence (partly occluded) and
+// false positives. Scored like MOT: misses, false positives and identity
+// switches against the ground truth boxes at IoU 0.5. Exits non-zero when
+// a check fails.
+#include "tracker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const char* what, bool ok, double got) {
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << std::endl;
+}
+
+struct Target {
+  float x, y, vx, vy, w, h;
+  int cls;
+  int dim = 0;  // frames left at low confidence
+};
+
+struct Scene {
+  int width = 1920;
+  int height = 1080;
+  float noise = 1.f;     // pixels, on center and size
+  float miss = 0.f;      // chance a target goes undetected in a frame
+  float dim = 0.f;       // chance per frame a target turns low confidence ...
+  int dim_frames = 8;    // ... for this many frames
+  float false_pos = 0.f; // per frame on average
+};
+
+struct MotScore {
+  uint64_t gt = 0, misses = 0, false_pos = 0, switches = 0;
+  double mota() const { return gt ? 1.0 - (double)(misses + false_pos + switches) / gt : 1.0; }
+};
+
+static std::vector<Target> make_targets(std::mt19937& rng, const Scene& scene, int n) {
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  std::vector<Target> targets(n);
+  for (Target& t : targets) {
+    t.w = 20 + 40 * u(rng);
+    t.h = 20 + 40 * u(rng);
+    t.x = t.w + u(rng) * (scene.width - 2 * t.w);
+    t.y = t.h + u(rng) * (scene.height - 2 * t.h);
+    t.vx = -6 + 12 * u(rng);
+    t.vy = -6 + 12 * u(rng);
+    t.cls = (int)(u(rng) * 3);
+  }
+  return targets;
+}
+
+// Moves the targets one frame (bouncing off the frame edges) and detects them
+static void step(std::mt19937& rng, const Scene& scene, std::vector<Target>& targets, std::vector<Detection>& dets) {
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  std::normal_distribution<float> noise(0.f, scene.noise);
+  dets.clear();
+  for (Target& t : targets) {
+    t.x += t.vx;
+    t.y += t.vy;
+    if (t.x < t.w / 2 || t.x > scene.width - t.w / 2) t.vx = -t.vx;
+    if (t.y < t.h / 2 || t.y > scene.height - t.h / 2) t.vy = -t.vy;
+    if (t.dim > 0) {
+      t.dim--;
+    } else if (u(rng) < scene.dim) {
+      t.dim = scene.dim_frames;
+    }
+    if (u(rng) < scene.miss) continue;
+    Detection d;
+    d.bbox[0] = t.x + noise(rng);
+    d.bbox[1] = t.y + noise(rng);
+    d.bbox[2] = t.w + noise(rng);
+    d.bbox[3] = t.h + noise(rng);
+    d.conf = t.dim > 0 ? 0.15f + 0.3f * u(rng) : 0.6f + 0.4f * u(rng);
+    d.class_id = (float)t.cls;
+    dets.push_back(d);
+  }
+  int fps = (int)(scene.false_pos * 2 * u(rng) + 0.5f);
+  for (int k = 0; k < fps; k++) {
+    Detection d;
+    d.bbox[0] = u(rng) * scene.width;
+    d.bbox[1] = u(rng) * scene.height;
+    d.bbox[2] = d.bbox[3] = 20 + 40 * u(rng);
+    d.conf = 0.2f + 0.5f * u(rng);
+    d.class_id = (float)(int)(u(rng) * 3);
+    dets.push_back(d);
+  }
+  // The tracker must not depend on detection order
+  std::shuffle(dets.begin(), dets.end(), rng);
+}
+
+// Center, size boxes
+static float box_iou(const float* a, const float* b) {
+  float iw = std::min(a[0] + a[2] / 2, b[0] + b[2] / 2) - std::max(a[0] - a[2] / 2, b[0] - b[2] / 2);
+  float ih = std::min(a[1] + a[3] / 2, b[1] + b[3] / 2) - std::max(a[1] - a[3] / 2, b[1] - b[3] / 2);
+  if (iw <= 0 || ih <= 0) return 0.f;
+  return iw * ih / (a[2] * a[3] + b[2] * b[3] - iw * ih);
+}
+
+// Matches the tracker's output against the ground truth of this frame
+static void score(const std::vector<Target>& targets, const std::vector<Track>& tracks, std::vector<int>& last_id,
+                  MotScore& mot) {
+  int nr = (int)targets.size(), nc = (int)tracks.size();
+  std::vector<float> cost((size_t)nr * nc);
+  for (int i = 0; i < nr; i++) {
+    float gt[4] = {targets[i].x, targets[i].y, targets[i].w, targets[i].h};
+    for (int j = 0; j < nc; j++) {
+      cost[(size_t)i * nc + j] = 1.f - box_iou(gt, tracks[j].det.bbox);
+    }
+  }
+  std::vector<int> match(nr);
+  int matched = linear_assignment(cost.data(), nr, nc, 0.5f, match.data());
+  mot.gt += nr;
+  mot.misses += nr - matched;
+  mot.false_pos += nc - matched;
+  for (int i = 0; i < nr; i++) {
+    if (match[i] < 0) continue;
+    int id = tracks[match[i]].id;
+    if (last_id[i] >= 0 && last_id[i] != id) mot.switches++;
+    last_id[i] = id;
+  }
+}
+
+static MotScore run_scene(const Scene& scene, const TrackerConfig& cfg, int n, int frames, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::vector<Target> targets = make_targets(rng, scene, n);
+  ByteTracker tracker(cfg);
+  std::vector<Detection> dets;
+  std::vector<int> ids, last_id(n, -1);
+  std::vector<Track> tracks;
+  MotScore mot;
+  for (int f = 0; f < frames; f++) {
+    step(rng, scene, targets, dets);
+    tracker.update(dets, ids);
+    tracker.tracked(tracks);
+    score(targets, tracks, last_id, mot);
+  }
+  return mot;
+}
+
+// Total cost of the best assignment by trying them all, unmatched rows at limit
+static double brute_force(const std::vector<float>& cost, int rows, int cols, float limit, int row, unsigned used) {
+  if (row == rows) return 0;
+  double best = limit + brute_force(cost, rows, cols, limit, row + 1, used);
+  for (int j = 0; j < cols; j++) {
+    float c = cost[(size_t)row * cols + j];
+    if ((used >> j & 1) || c > limit) continue;
+    best = std::min(best, c + brute_force(cost, rows, cols, limit, row + 1, used | 1u << j));
+  }
+  return best;
+}
+
+static void check_assignment() {
+  std::cout << "linear assignment against brute force" << std::endl;
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  int wrong = 0, invalid = 0;
+  for (int trial = 0; trial < 5000; trial++) {
+    int rows = (int)(u(rng) * 7), cols = (int)(u(rng) * 7);
+    float limit = 0.2f + 0.7f * u(rng);
+    std::vector<float> cost((size_t)rows * cols);
+    // Mostly infeasible like real frames, with some exact ties
+    for (float& c : cost) c = u(rng) < 0.4f ? 0.1f * (int)(u(rng) * 10) : 1.f + u(rng);
+    std::vector<int> match(rows);
+    linear_assignment(cost.data(), rows, cols, limit, match.data());
+    double total = 0;
+    std::vector<bool> taken(cols, false);
+    for (int i = 0; i < rows; i++) {
+      if (match[i] < 0) {
+        total += limit;
+        continue;
+      }
+      if (taken[match[i]] || cost[(size_t)i * cols + match[i]] > limit) invalid++;
+      taken[match[i]] = true;
+      total += cost[(size_t)i * cols + match[i]];
+    }
+    if (std::fabs(total - brute_force(cost, rows, cols, limit, 0, 0)) > 1e-4) wrong++;
+  }
+  check("non-optimal of 5000", wrong == 0, wrong);
+  check("invalid pairs", invalid == 0, invalid);
+}
+
+// Two targets of the same class passing through each other
+static void check_crossing() {
+  std::cout << "crossing targets" << std::endl;
+  ByteTracker tracker((TrackerConfig()));
+  std::vector<Detection> dets(2);
+  std::vector<int> ids;
+  int first[2] = {-1, -1}, switches = 0;
+  for (int f = 0; f < 120; f++) {
+    for (int k = 0; k < 2; k++) {
+      float dir = k ? -1.f : 1.f;
+      dets[k].bbox[0] = 400 - dir * 240 + dir * 4 * f;
+      dets[k].bbox[1] = 300 + 8 * k;
+      dets[k].bbox[2] = dets[k].bbox[3] = 40;
+      dets[k].conf = 0.9f;
+      dets[k].class_id = 0;
+    }
+    tracker.update(dets, ids);
+    for (int k = 0; k < 2; k++) {
+      if (ids[k] < 0) continue;
+      if (first[k] < 0) first[k] = ids[k];
+      switches += ids[k] != first[k];
+    }
+  }
+  check("identity switches", switches == 0, switches);
+  check("both confirmed", first[0] > 0 && first[1] > 0 && first[0] != first[1], tracker.stats().confirmed);
+}
+
+// A target dims for a while, then disappears for 20 frames
+static void check_occlusion() {
+  std::cout << "occlusion" << std::endl;
+  for (int low_stage = 1; low_stage >= 0; low_stage--) {
+    TrackerConfig cfg;
+    if (!low_stage) cfg.low_thresh = cfg.high_thresh;
+    ByteTracker tracker(cfg);
+    std::vector<Detection> dets;
+    std::vector<int> ids;
+    std::vector<Track> tracks;
+    int id = -1, changed = 0, dim_reported = 0;
+    for (int f = 0; f < 100; f++) {
+      Detection d;
+      d.bbox[0] = 100 + 5 * f;
+      d.bbox[1] = 200 + 2 * f;
+      d.bbox[2] = 30;
+      d.bbox[3] = 20;
+      d.conf = f >= 20 && f < 30 ? 0.3f : 0.8f;
+      d.class_id = 1;
+      dets.assign(f >= 50 && f < 70 ? 0 : 1, d);
+      tracker.update(dets, ids);
+      if (dets.empty() || ids[0] < 0) continue;
+      if (f >= 20 && f < 30) dim_reported++;
+      if (id >= 0 && ids[0] != id) changed++;
+      id = ids[0];
+    }
+    if (low_stage) {
+      check("low confidence frames still tracked", dim_reported == 10, dim_reported);
+      check("same id after 20 missing frames", changed == 0, changed);
+    } else {
+      check("without the low stage the dim frames are lost", dim_reported == 0, dim_reported);
+    }
+  }
+}
+
+static void check_scenes() {
+  std::cout << "synthetic scenes, 50 targets x 500 frames" << std::endl;
+  Scene clean;
+  MotScore mot = run_scene(clean, TrackerConfig(), 50, 500, 2);
+  std::cout << "  clean: MOTA " << mot.mota() << ", " << mot.misses << " misses, " << mot.false_pos
+            << " false positives, " << mot.switches << " switches" << std::endl;
+  check("clean MOTA", mot.mota() > 0.99, mot.mota());
+
+  Scene noisy;
+  noisy.noise = 2.f;
+  noisy.miss = 0.05f;
+  noisy.dim = 0.02f;
+  noisy.false_pos = 3.f;
+  mot = run_scene(noisy, TrackerConfig(), 50, 500, 3);
+  std::cout << "  noisy: MOTA " << mot.mota() << ", " << mot.misses << " misses, " << mot.false_pos
+            << " false positives, " << mot.switches << " switches" << std::endl;
+  TrackerConfig no_low;
+  no_low.low_thresh = no_low.high_thresh;
+  MotScore single = run_scene(noisy, no_low, 50, 500, 3);
+  std::cout << "  noisy, high detections only: MOTA " << single.mota() << ", " << single.misses << " misses, "
+            << single.false_pos << " false positives, " << single.switches << " switches" << std::endl;
+  check("noisy MOTA", mot.mota() > 0.85, mot.mota());
+  // Same class targets do cross paths at random here, some of them swap
+  check("switches per 1000 boxes", mot.switches * 1000.0 / mot.gt < 1.0, mot.switches * 1000.0 / mot.gt);
+  check("low stage gain in MOTA", mot.mota() > single.mota(), mot.mota() - single.mota());
+}
+
+int main(int argc, char** argv) {
+  int targets = 200;
+  int frames = 1000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--targets") {
+      targets = atoi(argv[i + 1]);
+    } else if (key == "--frames") {
+      frames = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./tracker_bench [--targets 200] [--frames 1000]" << std::endl;
+      return -1;
+    }
+  }
+  check_assignment();
+  check_crossing();
+  check_occlusion();
+  check_scenes();
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+
+  // A 4K frame of targets with the noisy scene's misses and clutter
+  Scene scene;
+  scene.width = 3840;
+  scene.height = 2160;
+  scene.noise = 2.f;
+  scene.miss = 0.05f;
+  scene.dim = 0.02f;
+  scene.false_pos = 5.f;
+  std::mt19937 rng(5);
+  std::vector<Target> truth = make_targets(rng, scene, targets);
+  ByteTracker tracker((TrackerConfig()));
+  std::vector<Detection> dets;
+  std::vector<int> ids;
+  std::vector<double> times;
+  for (int f = 0; f < frames; f++) {
+    step(rng, scene, truth, dets);
+    auto start = std::chrono::steady_clock::now();
+    tracker.update(dets, ids);
+    times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+  }
+  std::sort(times.begin(), times.end());
+  double sum = 0;
+  for (double t : times) sum += t;
+  const TrackerStats& st = tracker.stats();
+  std::cout << targets << " targets, " << frames << " frames: " << tracker.size() << " live tracks, "
+            << (double)st.detections / st.frames << " detections per frame; update mean " << sum / times.size()
+            << "us, p50 " << times[times.size() / 2] << "us, p99 " << times[times.size() * 99 / 100] << "us, max "
+            << times.back() << "us" << std::endl;
+  return 0;
+}
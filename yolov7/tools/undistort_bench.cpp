@@ -0,0 +1,160 @@
+// Checks PointUndistorter against the lens model and OpenCV's iterative
+// cv::undistortPoints, then times both on the same points:
+//
+//   ./undistort_bench                    // synthetic wide angle lens, 1280x720
+//   ./undistort_bench --calib camera.yaml --points 1000 --rounds 2000
+//
+// --points is per call, 200 boxes' centres and corners by default. Exits
+// non-zero when a check fails.
+#include "undistort.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const char* what, double got, double want, double tol) {
+  bool ok = std::fabs(got - want) <= tol;
+  if (!ok) failures++;
+  std::cout << (ok ? "  ok   " : "  FAIL ") << what << ": " << got << " (want " << want << ")" << std::endl;
+}
+
+// OpenCV's model, written out independently of PointUndistorter
+static void distort_pixel(const CameraIntrinsics& cam, const std::vector<double>& dist, double u, double v, double& du,
+                          double& dv) {
+  double k[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  std::copy(dist.begin(), dist.end(), k);
+  double x = (u - cam.cx) / cam.fx, y = (v - cam.cy) / cam.fy;
+  double r2 = x * x + y * y, r4 = r2 * r2, r6 = r4 * r2;
+  double radial = (1 + k[0] * r2 + k[1] * r4 + k[4] * r6) / (1 + k[5] * r2 + k[6] * r4 + k[7] * r6);
+  double xd = x * radial + 2 * k[2] * x * y + k[3] * (r2 + 2 * x * x);
+  double yd = y * radial + k[2] * (r2 + 2 * y * y) + 2 * k[3] * x * y;
+  du = xd * cam.fx + cam.cx;
+  dv = yd * cam.fy + cam.cy;
+}
+
+static double worst_distance(const std::vector<cv::Point2f>& a, const float* x, const float* y, double* mean = nullptr) {
+  double worst = 0, sum = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    double d = std::hypot(a[i].x - x[i], a[i].y - y[i]);
+    worst = std::max(worst, d);
+    sum += d;
+  }
+  if (mean) *mean = sum / a.size();
+  return worst;
+}
+
+static double worst_distance(const std::vector<cv::Point2f>& a, const std::vector<cv::Point2f>& b) {
+  double worst = 0;
+  for (size_t i = 0; i < a.size(); i++) worst = std::max(worst, (double)std::hypot(a[i].x - b[i].x, a[i].y - b[i].y));
+  return worst;
+}
+
+int main(int argc, char** argv) {
+  std::string calib;
+  size_t points = 1000;
+  int rounds = 2000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--calib") {
+      calib = argv[i + 1];
+    } else if (key == "--points") {
+      points = atoi(argv[i + 1]);
+    } else if (key == "--rounds") {
+      rounds = atoi(argv[i + 1]);
+    } else {
+      std::cerr << "./undistort_bench [--calib camera.yaml] [--points 1000] [--rounds 2000]" << std::endl;
+      return -1;
+    }
+  }
+
+  CameraIntrinsics cam;
+  std::vector<double> dist;
+  if (calib.empty()) {
+    // About 77 degrees across with strong barrel distortion, ~300 px at the
+    // corners
+    cam.width = 1280;
+    cam.height = 720;
+    cam.fx = cam.fy = 800.f;
+    cam.cx = 641.5f;
+    cam.cy = 358.2f;
+    dist = {-0.28, 0.08, 4e-4, -3e-4, -0.01};
+  } else if (!load_calibration(calib, cam, dist)) {
+    return -1;
+  }
+  std::cout << cam.width << "x" << cam.height << ", fx " << cam.fx << ", fy " << cam.fy << ", " << dist.size()
+            << " coefficients" << std::endl;
+
+  auto start = std::chrono::steady_clock::now();
+  PointUndistorter undistorter(cam, dist);
+  double build = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "grid " << undistorter.grid_cols() << "x" << undistorter.grid_rows() << " every " << kUndistortStep
+            << " px built in " << build << "ms" << std::endl;
+
+  cv::Mat K(3, 3, CV_64F, cv::Scalar(0));
+  K.at<double>(0, 0) = cam.fx;
+  K.at<double>(1, 1) = cam.fy;
+  K.at<double>(0, 2) = cam.cx;
+  K.at<double>(1, 2) = cam.cy;
+  K.at<double>(2, 2) = 1;
+  cv::Mat D(1, (int)dist.size(), CV_64F, dist.data());
+
+  // Box centres and corners land anywhere in the frame and a little outside
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> ux(-20.f, cam.width + 20.f), uy(-20.f, cam.height + 20.f);
+  std::vector<cv::Point2f> src(points), exact(points), iter5, converged;
+  std::vector<float> px(points), py(points), gx(points), gy(points);
+  for (size_t i = 0; i < points; i++) {
+    src[i] = cv::Point2f(ux(rng), uy(rng));
+    px[i] = src[i].x;
+    py[i] = src[i].y;
+  }
+
+  std::cout << "exact solve against the lens model" << std::endl;
+  double round_trip = 0;
+  for (size_t i = 0; i < points; i++) {
+    double u, v, du, dv;
+    undistorter.undistort_exact(px[i], py[i], u, v);
+    exact[i] = cv::Point2f((float)u, (float)v);
+    distort_pixel(cam, dist, u, v, du, dv);
+    round_trip = std::max(round_trip, std::hypot(du - px[i], dv - py[i]));
+  }
+  check("worst round trip, px", round_trip, 0, 1e-6);
+
+  std::cout << "grid against cv::undistortPoints" << std::endl;
+  cv::undistortPoints(src, iter5, K, D, cv::Mat(), K);
+  cv::undistortPoints(src, converged, K, D, cv::Mat(), K,
+                      cv::TermCriteria(cv::TermCriteria::COUNT | cv::TermCriteria::EPS, 100, 1e-9));
+  undistorter.undistort(px.data(), py.data(), points, gx.data(), gy.data());
+  // A tenth of a pixel is centimetres on the ground from any useful height
+  double mean;
+  check("grid's own worst error at cell centres, px", undistorter.max_error(), 0, 0.1);
+  check("worst distance to the exact solve, px", worst_distance(exact, gx.data(), gy.data()), 0, 0.1);
+  check("worst distance to undistortPoints converged, px", worst_distance(converged, gx.data(), gy.data(), &mean), 0,
+        0.1);
+  std::cout << "  mean distance " << mean << " px" << std::endl;
+  std::cout << "  undistortPoints with its default 5 iterations is off by up to " << worst_distance(converged, iter5)
+            << " px" << std::endl;
+  if (failures) {
+    std::cout << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) undistorter.undistort(px.data(), py.data(), points, gx.data(), gy.data());
+  double grid_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) cv::undistortPoints(src, iter5, K, D, cv::Mat(), K);
+  double cv_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double total = points * (double)rounds;
+  std::cout << "grid " << total / grid_s / 1e6 << " M points/s, " << grid_s / rounds * 1e6 << "us per " << points
+            << " points; undistortPoints " << total / cv_s / 1e6 << " M points/s, " << cv_s / rounds * 1e6
+            << "us: " << cv_s / grid_s << "x faster" << std::endl;
+  return 0;
+}